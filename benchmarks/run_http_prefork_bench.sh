@@ -0,0 +1,42 @@
+#!/usr/bin/env sh
+set -eu
+
+# Load-tests benchmarks/http_prefork_bench.toi with lib/loadtest.toi, first
+# as a single process and then with one forked worker per CPU, and prints
+# requests/second for each.
+#
+#   sh benchmarks/run_http_prefork_bench.sh [duration_sec] [concurrency] [processes]
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+DURATION=${1:-10}
+CONCURRENCY=${2:-32}
+PROCESSES=${3:-$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)}
+PORT=8090
+
+if [ ! -x "$ROOT_DIR/toi" ]; then
+  echo "toi binary not found. Run 'make' first." >&2
+  exit 1
+fi
+
+SERVER_PID=
+cleanup() {
+  if [ -n "$SERVER_PID" ]; then
+    kill "$SERVER_PID" 2>/dev/null || true
+  fi
+}
+trap cleanup EXIT
+
+cd "$ROOT_DIR"
+for procs in 1 "$PROCESSES"; do
+  printf "\nprocesses=%s\n\n" "$procs"
+  "$ROOT_DIR/toi" benchmarks/http_prefork_bench.toi "$PORT" "$procs" >/dev/null &
+  SERVER_PID=$!
+  sleep 1
+  "$ROOT_DIR/toi" lib/loadtest.toi rps "http://127.0.0.1:$PORT/" "$DURATION" "$CONCURRENCY" 2000 false
+  # SIGTERM stops the master and its workers gracefully.
+  kill "$SERVER_PID" 2>/dev/null || true
+  wait "$SERVER_PID" 2>/dev/null || true
+  SERVER_PID=
+done
+
+printf "\nDone!\n"
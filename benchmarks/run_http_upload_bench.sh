@@ -0,0 +1,50 @@
+#!/usr/bin/env sh
+set -eu
+
+# Uploads a large file to benchmarks/http_upload_bench.toi with curl, once
+# with the body streamed to the handler and once buffered whole, and
+# reports the time taken and the server's peak resident memory.
+#
+#   sh benchmarks/run_http_upload_bench.sh [file_mb] [uploads]
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+FILE_MB=${1:-300}
+UPLOADS=${2:-3}
+PORT=8091
+
+if [ ! -x "$ROOT_DIR/toi" ]; then
+  echo "toi binary not found. Run 'make' first." >&2
+  exit 1
+fi
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/toi_upload_bench.XXXXXX")
+SERVER_PID=
+cleanup() {
+  if [ -n "$SERVER_PID" ]; then
+    kill "$SERVER_PID" 2>/dev/null || true
+  fi
+  rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+dd if=/dev/zero of="$DIR/upload.bin" bs=1048576 count="$FILE_MB" 2>/dev/null
+
+cd "$ROOT_DIR"
+for mode in stream buffered; do
+  printf "\n%s\n\n" "$mode"
+  "$ROOT_DIR/toi" benchmarks/http_upload_bench.toi "$PORT" "$mode" >/dev/null &
+  SERVER_PID=$!
+  sleep 1
+  i=0
+  while [ "$i" -lt "$UPLOADS" ]; do
+    curl -s -o /dev/null -w "upload: %{time_total}s  %{speed_upload} B/s\n" \
+      --data-binary "@$DIR/upload.bin" "http://127.0.0.1:$PORT/"
+    i=$((i + 1))
+  done
+  grep VmHWM "/proc/$SERVER_PID/status" 2>/dev/null || true
+  kill "$SERVER_PID" 2>/dev/null || true
+  wait "$SERVER_PID" 2>/dev/null || true
+  SERVER_PID=
+done
+
+printf "\nDone!\n"
@@ -0,0 +1,46 @@
+#!/usr/bin/env sh
+set -eu
+
+# Downloads a 100 MB file from benchmarks/static_file_bench.toi with
+# lib/loadtest.toi, once served with sock.sendfile and once read into
+# memory per request, and reports the server's peak resident memory.
+#
+#   sh benchmarks/run_static_file_bench.sh [duration_sec] [concurrency] [file_mb]
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+DURATION=${1:-10}
+CONCURRENCY=${2:-4}
+FILE_MB=${3:-100}
+PORT=8089
+
+if [ ! -x "$ROOT_DIR/toi" ]; then
+  echo "toi binary not found. Run 'make' first." >&2
+  exit 1
+fi
+
+DIR=$(mktemp -d "${TMPDIR:-/tmp}/toi_static_bench.XXXXXX")
+SERVER_PID=
+cleanup() {
+  if [ -n "$SERVER_PID" ]; then
+    kill "$SERVER_PID" 2>/dev/null || true
+  fi
+  rm -rf "$DIR"
+}
+trap cleanup EXIT
+
+dd if=/dev/urandom of="$DIR/big.bin" bs=1048576 count="$FILE_MB" 2>/dev/null
+
+cd "$ROOT_DIR"
+for mode in sendfile memory; do
+  printf "\n%s\n\n" "$mode"
+  "$ROOT_DIR/toi" benchmarks/static_file_bench.toi "$DIR" "$PORT" "$mode" >/dev/null &
+  SERVER_PID=$!
+  sleep 1
+  "$ROOT_DIR/toi" lib/loadtest.toi rps "http://127.0.0.1:$PORT/big.bin" "$DURATION" "$CONCURRENCY" 10000 false
+  grep VmHWM "/proc/$SERVER_PID/status" 2>/dev/null || true
+  kill "$SERVER_PID" 2>/dev/null || true
+  wait "$SERVER_PID" 2>/dev/null || true
+  SERVER_PID=
+done
+
+printf "\nDone!\n"
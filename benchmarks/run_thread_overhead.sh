@@ -0,0 +1,32 @@
+#!/usr/bin/env sh
+set -eu
+
+# Runs benchmarks/perf.toi twice: as-is, and after a thread has been
+# spawned and joined so the interpreter runs with per-OS-thread state
+# enabled. The two timings should match.
+
+ROOT_DIR=$(CDPATH= cd -- "$(dirname -- "$0")/.." && pwd)
+
+if [ ! -x "$ROOT_DIR/toi" ]; then
+  echo "toi binary not found. Run 'make' first." >&2
+  exit 1
+fi
+
+THREADED=$(mktemp "${TMPDIR:-/tmp}/toi_perf_thread.XXXXXX")
+trap 'rm -f "$THREADED"' EXIT
+
+cat > "$THREADED" <<'TOI'
+thread = import thread
+thread.join(thread.spawn(fn()
+  return 0
+))
+TOI
+cat "$ROOT_DIR/benchmarks/perf.toi" >> "$THREADED"
+
+printf "\nWithout thread\n\n"
+"$ROOT_DIR/toi" "$ROOT_DIR/benchmarks/perf.toi"
+
+printf "\nWith thread\n\n"
+"$ROOT_DIR/toi" "$THREADED"
+
+printf "\nDone!\n"
@@ -31,28 +31,33 @@ void free_chunk(Chunk* chunk) {
     init_chunk(chunk);
 }
 
+void reserve_chunk(Chunk* chunk, int capacity) {
+    if (capacity <= chunk->capacity) return;
+    int old_capacity = chunk->capacity;
+    chunk->capacity = capacity;
+    chunk->code = (uint8_t*)realloc(chunk->code, sizeof(uint8_t) * chunk->capacity);
+    chunk->lines = (int*)realloc(chunk->lines, sizeof(int) * chunk->capacity);
+    chunk->global_ic_versions = (uint32_t*)realloc(chunk->global_ic_versions, sizeof(uint32_t) * chunk->capacity);
+    chunk->global_ic_names = (struct ObjString**)realloc(chunk->global_ic_names, sizeof(struct ObjString*) * chunk->capacity);
+    chunk->global_ic_values = (Value*)realloc(chunk->global_ic_values, sizeof(Value) * chunk->capacity);
+    chunk->get_table_ic_versions = (uint32_t*)realloc(chunk->get_table_ic_versions, sizeof(uint32_t) * chunk->capacity);
+    chunk->get_table_ic_tables = (struct ObjTable**)realloc(chunk->get_table_ic_tables, sizeof(struct ObjTable*) * chunk->capacity);
+    chunk->get_table_ic_keys = (struct ObjString**)realloc(chunk->get_table_ic_keys, sizeof(struct ObjString*) * chunk->capacity);
+    chunk->get_table_ic_values = (Value*)realloc(chunk->get_table_ic_values, sizeof(Value) * chunk->capacity);
+    for (int i = old_capacity; i < chunk->capacity; i++) {
+        chunk->global_ic_versions[i] = 0;
+        chunk->global_ic_names[i] = NULL;
+        chunk->global_ic_values[i] = NIL_VAL;
+        chunk->get_table_ic_versions[i] = 0;
+        chunk->get_table_ic_tables[i] = NULL;
+        chunk->get_table_ic_keys[i] = NULL;
+        chunk->get_table_ic_values[i] = NIL_VAL;
+    }
+}
+
 void write_chunk(Chunk* chunk, uint8_t byte, int line) {
     if (chunk->capacity < chunk->count + 1) {
-        int old_capacity = chunk->capacity;
-        chunk->capacity = old_capacity < 8 ? 8 : old_capacity * 2;
-        chunk->code = (uint8_t*)realloc(chunk->code, sizeof(uint8_t) * chunk->capacity);
-        chunk->lines = (int*)realloc(chunk->lines, sizeof(int) * chunk->capacity);
-        chunk->global_ic_versions = (uint32_t*)realloc(chunk->global_ic_versions, sizeof(uint32_t) * chunk->capacity);
-        chunk->global_ic_names = (struct ObjString**)realloc(chunk->global_ic_names, sizeof(struct ObjString*) * chunk->capacity);
-        chunk->global_ic_values = (Value*)realloc(chunk->global_ic_values, sizeof(Value) * chunk->capacity);
-        chunk->get_table_ic_versions = (uint32_t*)realloc(chunk->get_table_ic_versions, sizeof(uint32_t) * chunk->capacity);
-        chunk->get_table_ic_tables = (struct ObjTable**)realloc(chunk->get_table_ic_tables, sizeof(struct ObjTable*) * chunk->capacity);
-        chunk->get_table_ic_keys = (struct ObjString**)realloc(chunk->get_table_ic_keys, sizeof(struct ObjString*) * chunk->capacity);
-        chunk->get_table_ic_values = (Value*)realloc(chunk->get_table_ic_values, sizeof(Value) * chunk->capacity);
-        for (int i = old_capacity; i < chunk->capacity; i++) {
-            chunk->global_ic_versions[i] = 0;
-            chunk->global_ic_names[i] = NULL;
-            chunk->global_ic_values[i] = NIL_VAL;
-            chunk->get_table_ic_versions[i] = 0;
-            chunk->get_table_ic_tables[i] = NULL;
-            chunk->get_table_ic_keys[i] = NULL;
-            chunk->get_table_ic_values[i] = NIL_VAL;
-        }
+        reserve_chunk(chunk, chunk->capacity < 8 ? 8 : chunk->capacity * 2);
     }
     
     chunk->code[chunk->count] = byte;
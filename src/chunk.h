@@ -84,6 +84,7 @@ typedef enum {
     OP_FMOD,
     OP_MOD_CONST,
     OP_GC,
+    OP_GC_CONFIG,
     OP_SET_METATABLE,
     OP_RETURN_N,
     OP_ADJUST_STACK,
@@ -103,6 +104,11 @@ typedef enum {
     OP_SLICE
 } OpCode;
 
+// Version stamped into .toic bytecode caches. Bump it whenever opcodes,
+// their operands or the compiler's output change so stale caches are
+// recompiled instead of loaded.
+#define TOI_BYTECODE_VERSION 4
+
 
 typedef struct {
     int count;
@@ -122,6 +128,8 @@ typedef struct {
 void init_chunk(Chunk* chunk);
 void free_chunk(Chunk* chunk);
 void write_chunk(Chunk* chunk, uint8_t byte, int line);
+// Grows the code, line and inline-cache arrays to hold `capacity` bytes.
+void reserve_chunk(Chunk* chunk, int capacity);
 int add_constant(Chunk* chunk, Value value);
 
 #endif
@@ -8,8 +8,18 @@
 // #define DEBUG_TRACE_EXECUTION
 // #define DEBUG_PRINT_CODE
 // #define DEBUG_MULTI_RETURN
+// #define DEBUG_STRESS_GC
 // #define DEBUG_VARIADIC
 
+// Storage class for per-OS-thread state. The wasm build is single-threaded.
+#ifdef TOI_WASM
+#define TOI_THREAD_LOCAL
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TOI_THREAD_LOCAL _Thread_local
+#else
+#define TOI_THREAD_LOCAL __thread
+#endif
+
 // ANSI color codes
 #define COLOR_RED     "\033[91m"
 #define COLOR_RESET   "\033[0m"
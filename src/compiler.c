@@ -20,16 +20,16 @@ typedef struct {
     Precedence precedence;
 } ParseRule;
 
-Parser parser;
-Compiler* current = NULL;
-Lexer lexer;
-int is_repl_mode = 0;  // If 1, don't pop expression results
-int last_expr_ends_with_call = 0;
-int last_expr_was_range = 0;
-int in_for_range_header = 0;
-int in_table_entry_expression = 0;
-static uint8_t type_stack[512];
-int type_stack_top = 0;
+TOI_THREAD_LOCAL Parser parser;
+TOI_THREAD_LOCAL Compiler* current = NULL;
+TOI_THREAD_LOCAL Lexer lexer;
+TOI_THREAD_LOCAL int is_repl_mode = 0;  // If 1, don't pop expression results
+TOI_THREAD_LOCAL int last_expr_ends_with_call = 0;
+TOI_THREAD_LOCAL int last_expr_was_range = 0;
+TOI_THREAD_LOCAL int in_for_range_header = 0;
+TOI_THREAD_LOCAL int in_table_entry_expression = 0;
+static TOI_THREAD_LOCAL uint8_t type_stack[512];
+TOI_THREAD_LOCAL int type_stack_top = 0;
 
 void type_push(uint8_t type) {
     if (type_stack_top < (int)(sizeof(type_stack) / sizeof(type_stack[0]))) {
@@ -222,6 +222,7 @@ static void init_compiler(Compiler* compiler, FunctionType type) {
     compiler->loop_context = NULL;
 
     // Claim stack slot 0
+    compiler->function->max_locals = 1;
     Local* local = &compiler->locals[compiler->local_count++];
     local->depth = 0;
     local->name.start = "";
@@ -640,6 +641,9 @@ void add_local(Token name) {
         return;
     }
     Local* local = &current->locals[current->local_count++];
+    if (current->local_count > current->function->max_locals) {
+        current->function->max_locals = current->local_count;
+    }
     local->name = name;
     local->depth = -1;
     local->is_captured = 0;
@@ -77,15 +77,15 @@ typedef struct {
     int finally_offset;
 } TryPatch;
 
-extern Parser parser;
-extern Compiler* current;
-extern Lexer lexer;
-extern int type_stack_top;
-extern int is_repl_mode;
-extern int last_expr_ends_with_call;
-extern int last_expr_was_range;
-extern int in_for_range_header;
-extern int in_table_entry_expression;
+extern TOI_THREAD_LOCAL Parser parser;
+extern TOI_THREAD_LOCAL Compiler* current;
+extern TOI_THREAD_LOCAL Lexer lexer;
+extern TOI_THREAD_LOCAL int type_stack_top;
+extern TOI_THREAD_LOCAL int is_repl_mode;
+extern TOI_THREAD_LOCAL int last_expr_ends_with_call;
+extern TOI_THREAD_LOCAL int last_expr_was_range;
+extern TOI_THREAD_LOCAL int in_for_range_header;
+extern TOI_THREAD_LOCAL int in_table_entry_expression;
 
 void type_push(uint8_t type);
 Chunk* current_chunk(void);
@@ -287,8 +287,8 @@ static void multi_assignment_statement(void) {
         }
     } while (match(TOKEN_COMMA));
 
+    int declared = 0;
     if (!(is_repl_mode && current->type == TYPE_SCRIPT)) {
-        int declared = 0;
         for (int i = 0; i < target_count; i++) {
             if (is_explicit_global_name(current, &targets[i])) continue;
             if (resolve_local(current, &targets[i]) != -1) continue;
@@ -313,7 +313,12 @@ static void multi_assignment_statement(void) {
     consume(TOKEN_EQUALS, "Expect '=' in assignment.");
 
     // Normalize evaluation stack to local slot depth before RHS evaluation.
-    emit_bytes(OP_ADJUST_STACK, (uint8_t)current->local_count);
+    // The new targets' slots are nil until assigned: the collector traces
+    // them meanwhile and must not find what an earlier statement left there.
+    emit_bytes(OP_ADJUST_STACK, (uint8_t)(current->local_count - declared));
+    for (int i = 0; i < declared; i++) {
+        emit_byte(OP_NIL);
+    }
 
     int expr_count = 0;
     do {
@@ -712,6 +717,7 @@ static void while_statement() {
     loop.scope_depth = current->scope_depth;
     loop.break_count = 0;
     loop.continue_count = 0;
+    loop.slots_to_pop = 0;
     loop.is_for_loop = 0;
     loop.enclosing = current->loop_context;
     current->loop_context = &loop;
@@ -1158,6 +1164,19 @@ static void yield_statement() {
     emit_call((uint8_t)value_count);
 }
 
+// `gc` and `gc()` collect the whole heap; `gc(options)` retunes the
+// collector without collecting.
+static void gc_statement() {
+    if (match(TOKEN_LEFT_PAREN) && !match(TOKEN_RIGHT_PAREN)) {
+        type_stack_top = 0;
+        expression();
+        consume(TOKEN_RIGHT_PAREN, "Expect ')' after gc options.");
+        emit_byte(OP_GC_CONFIG);
+        return;
+    }
+    emit_byte(OP_GC);
+}
+
 static void assert_statement() {
     type_stack_top = 0;
     expression();
@@ -1206,7 +1225,7 @@ void statement(void) {
     } else if (match(TOKEN_CONTINUE)) {
         continue_statement();
     } else if (match(TOKEN_GC)) {
-        emit_byte(OP_GC);
+        gc_statement();
     } else if (match(TOKEN_ASSERT)) {
         assert_statement();
     } else if (match(TOKEN_DEL)) {
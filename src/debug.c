@@ -273,6 +273,8 @@ int disassemble_instruction(Chunk* chunk, int offset) {
             return constant_instruction("OP_MOD_CONST", chunk, offset);
         case OP_GC:
             return simple_instruction("OP_GC", offset);
+        case OP_GC_CONFIG:
+            return simple_instruction("OP_GC_CONFIG", offset);
         case OP_SET_METATABLE:
             return simple_instruction("OP_SET_METATABLE", offset);
         case OP_ITER_PREP:
@@ -138,21 +138,6 @@ static int is_serializable(Value v) {
     return 0;
 }
 
-static int key_from_entry(VM* vm, Entry* entry, Value* out_key) {
-    ObjString* key = entry->key;
-    if (key == NULL) return 0;
-    if (key->length >= 2 && key->chars[0] == '\x1F' && key->chars[1] == 'n') {
-        char* endptr = NULL;
-        double num = strtod(key->chars + 2, &endptr);
-        if (endptr != key->chars + key->length) return 0;
-        *out_key = NUMBER_VAL(num);
-        return 1;
-    }
-    (void)vm;
-    *out_key = OBJ_VAL(key);
-    return 1;
-}
-
 static int serialize_value(VM* vm, BinWriter* w, Value v, int depth, int strict_table);
 
 static int serialize_table(VM* vm, BinWriter* w, ObjTable* t, int depth) {
@@ -178,11 +163,9 @@ static int serialize_table(VM* vm, BinWriter* w, ObjTable* t, int depth) {
 
     for (int i = 0; i < t->table.capacity; i++) {
         Entry* entry = &t->table.entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
+        if (IS_NIL(entry->key) || IS_NIL(entry->value)) continue;
 
-        Value key;
-        if (!key_from_entry(vm, entry, &key)) continue;
-        if (!(IS_STRING(key) || IS_NUMBER(key) || IS_BOOL(key))) continue;
+        Value key = entry->key;
         if (!is_serializable(entry->value)) continue;
 
         if (!serialize_value(vm, w, key, depth + 1, 1)) return 0;
@@ -218,12 +201,12 @@ static int serialize_value(VM* vm, BinWriter* w, Value v, int depth, int strict_
 }
 
 static int set_number_key(VM* vm, ObjTable* table, double num, Value value) {
+    if (num != num) return 0; // A NaN key could never be looked up.
     int idx = (int)num;
     if (num == (double)idx) {
         if (table_set_array(&table->table, idx, value)) return 1;
     }
-    ObjString* key = number_key_string(num);
-    table_set(&table->table, key, value);
+    table_set_value(&table->table, NUMBER_VAL(num), value);
     (void)vm;
     return 1;
 }
@@ -286,7 +269,11 @@ static Value deserialize_table(VM* vm, BinReader* r, int depth, int* ok) {
         if (IS_STRING(key)) {
             table_set(&t->table, AS_STRING(key), val);
         } else if (IS_NUMBER(key)) {
-            set_number_key(vm, t, AS_NUMBER(key), val);
+            if (!set_number_key(vm, t, AS_NUMBER(key), val)) {
+                *ok = 0;
+                pop(vm);
+                return NIL_VAL;
+            }
         } else if (IS_BOOL(key)) {
             ObjString* skey = copy_string(AS_BOOL(key) ? "true" : "false", AS_BOOL(key) ? 4 : 5);
             table_set(&t->table, skey, val);
@@ -343,6 +330,37 @@ static Value deserialize_value(VM* vm, BinReader* r, int depth, int* ok) {
     }
 }
 
+uint8_t* binary_encode(VM* vm, Value value, size_t* out_len) {
+    BinWriter w;
+    bw_init(&w);
+    int prev_disable = vm->disable_gc;
+    vm->disable_gc = 1;
+    int ok = serialize_value(vm, &w, value, 0, 0);
+    vm->disable_gc = prev_disable;
+    if (!ok || w.failed) {
+        bw_free(&w);
+        return NULL;
+    }
+    // An empty buffer is still a valid result; callers test for NULL.
+    if (w.data == NULL) w.data = (uint8_t*)malloc(1);
+    *out_len = w.len;
+    return w.data;
+}
+
+int binary_decode(VM* vm, const uint8_t* data, size_t len, Value* out) {
+    BinReader r;
+    r.data = data;
+    r.len = len;
+    r.pos = 0;
+    r.error = NULL;
+    int ok = 1;
+    int prev_disable = vm->disable_gc;
+    vm->disable_gc = 1;
+    *out = deserialize_value(vm, &r, 0, &ok);
+    vm->disable_gc = prev_disable;
+    return ok && r.pos == r.len;
+}
+
 static int binary_pack(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_EQ(1);
     BinWriter w;
@@ -41,7 +41,7 @@ static void sb_free(StringBuilder* sb) {
     }
 }
 
-static int next_native(VM* vm, int arg_count, Value* args) {
+int core_next(VM* vm, int arg_count, Value* args) {
 
     ASSERT_ARGC_EQ(2);
     Value state = args[0];
@@ -51,8 +51,10 @@ static int next_native(VM* vm, int arg_count, Value* args) {
         ObjTable* obj_table = AS_TABLE(state);
         Table* table = &obj_table->table;
 
-        // Array part first
-        if (IS_NIL(current_key) || IS_NUMBER(current_key)) {
+        // Array part first. A numeric key stored in the hash part resumes
+        // the hash scan below instead.
+        int hash_slot = IS_NIL(current_key) ? -1 : table_find_slot(table, current_key);
+        if (IS_NIL(current_key) || (IS_NUMBER(current_key) && hash_slot < 0)) {
             double num = IS_NUMBER(current_key) ? GET_NUMBER(1) : 0;
             int start = 1;
             if (IS_NUMBER(current_key) && num >= 1 && (double)(int)num == num) {
@@ -69,37 +71,23 @@ static int next_native(VM* vm, int arg_count, Value* args) {
             current_key = NIL_VAL; // Move to hash iteration
         }
 
-        // Hash part
-        int found_current = IS_NIL(current_key);
-        ObjString* num_key = NULL;
-        if (IS_NUMBER(current_key)) {
-            num_key = number_key_string(GET_NUMBER(1));
-        }
-
-        for (int i = 0; i < table->capacity; i++) {
-            Entry* entry = &table->entries[i];
-            if (entry->key == NULL) continue;
-
-            if (found_current) {
-                push(vm, OBJ_VAL(entry->key));
-                push(vm, entry->value);
+        // Hash part: resume right after the slot holding the current key.
+        int start_slot = 0;
+        if (!IS_NIL(current_key)) {
+            if (hash_slot < 0) {
+                push(vm, NIL_VAL);
+                push(vm, NIL_VAL);
                 return 2;
             }
+            start_slot = hash_slot + 1;
+        }
 
-            if (IS_STRING(current_key)) {
-                ObjString* s_key = GET_STRING(1);
-                if (entry->key == s_key || 
-                   (entry->key->length == s_key->length && 
-                    memcmp(entry->key->chars, s_key->chars, entry->key->length) == 0)) {
-                    found_current = 1;
-                }
-            } else if (IS_NUMBER(current_key)) {
-                if (entry->key == num_key ||
-                    (entry->key->length == num_key->length &&
-                     memcmp(entry->key->chars, num_key->chars, entry->key->length) == 0)) {
-                    found_current = 1;
-                }
-            }
+        for (int i = start_slot; i < table->capacity; i++) {
+            Entry* entry = &table->entries[i];
+            if (IS_NIL(entry->key)) continue;
+            push(vm, entry->key);
+            push(vm, entry->value);
+            return 2;
         }
 
         // Return 2 nils to match expected return count for for-in loops
@@ -156,8 +144,7 @@ static int inext_native(VM* vm, int arg_count, Value* args) {
     }
 
     if (!found) {
-        ObjString* key = number_key_string(next_index);
-        if (table_get(&table->table, key, &value) && !IS_NIL(value)) {
+        if (table_get_value(&table->table, NUMBER_VAL(next_index), &value) && !IS_NIL(value)) {
             found = 1;
         }
     }
@@ -201,6 +188,7 @@ static int setmetatable_native(VM* vm, int arg_count, Value* args) {
     if (!IS_TABLE(args[1]) && !IS_NIL(args[1])) { RETURN_NIL; }
 
     GET_TABLE(0)->metatable = IS_NIL(args[1]) ? NULL : GET_TABLE(1);
+    gc_write_barrier(AS_OBJ(args[0]), args[1]);
     RETURN_VAL(args[0]);
 }
 
@@ -279,14 +267,18 @@ static void format_value(VM* vm, Value val, StringBuilder* sb, int depth) {
         // Iterate hash part
         for (int i = 0; i < table->table.capacity; i++) {
             Entry* entry = &table->table.entries[i];
-            if (entry->key != NULL && !IS_NIL(entry->value)) {
-                if (entry->key->length == 7 &&
-                    memcmp(entry->key->chars, "__index", 7) == 0) {
+            if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
+                if (IS_STRING(entry->key) && AS_STRING(entry->key)->length == 7 &&
+                    memcmp(AS_CSTRING(entry->key), "__index", 7) == 0) {
                     continue;
                 }
                 if (count > 0) sb_append(sb, ", ", 2);
                 
-                sb_append(sb, entry->key->chars, entry->key->length);
+                if (IS_STRING(entry->key)) {
+                    sb_append(sb, AS_CSTRING(entry->key), AS_STRING(entry->key)->length);
+                } else {
+                    format_value(vm, entry->key, sb, depth + 1);
+                }
                 sb_append(sb, ": ", 2);
                 
                 format_value(vm, entry->value, sb, depth + 1);
@@ -302,9 +294,9 @@ static void format_value(VM* vm, Value val, StringBuilder* sb, int depth) {
         if (userdata->metatable != NULL) {
             for (int i = 0; i < userdata->metatable->table.capacity; i++) {
                 Entry* entry = &userdata->metatable->table.entries[i];
-                if (entry->key == NULL || IS_NIL(entry->value)) continue;
-                if (entry->key->length == 6 &&
-                    memcmp(entry->key->chars, "__name", 6) == 0 &&
+                if (!IS_STRING(entry->key) || IS_NIL(entry->value)) continue;
+                if (AS_STRING(entry->key)->length == 6 &&
+                    memcmp(AS_CSTRING(entry->key), "__name", 6) == 0 &&
                     IS_STRING(entry->value)) {
                     type_name = AS_STRING(entry->value);
                     break;
@@ -999,8 +991,7 @@ static int slice_native(VM* vm, int arg_count, Value* args) {
             if (i >= 1 && table_get_array(&src->table, i, &val) && !IS_NIL(val)) {
                 found = 1;
             } else {
-                ObjString* key = number_key_string((double)i);
-                if (table_get(&src->table, key, &val) && !IS_NIL(val)) {
+                if (table_get_value(&src->table, NUMBER_VAL((double)i), &val) && !IS_NIL(val)) {
                     found = 1;
                 }
             }
@@ -1016,8 +1007,7 @@ static int slice_native(VM* vm, int arg_count, Value* args) {
             if (i >= 1 && table_get_array(&src->table, i, &val) && !IS_NIL(val)) {
                 found = 1;
             } else {
-                ObjString* key = number_key_string((double)i);
-                if (table_get(&src->table, key, &val) && !IS_NIL(val)) {
+                if (table_get_value(&src->table, NUMBER_VAL((double)i), &val) && !IS_NIL(val)) {
                     found = 1;
                 }
             }
@@ -1035,8 +1025,44 @@ static int mem_native(VM* vm, int arg_count, Value* args) {
     (void)vm;
     (void)args;
     ASSERT_ARGC_EQ(0);
-    extern size_t bytes_allocated;
-    RETURN_NUMBER((double)bytes_allocated);
+    RETURN_NUMBER((double)gc_heap->bytes_allocated);
+}
+
+static ObjTable* gc_pause_histogram(VM* vm, const uint64_t* buckets) {
+    ObjTable* hist = new_table();
+    push(vm, OBJ_VAL(hist)); // GC protection
+    for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+        if (buckets[i] == 0) continue;
+        table_set_value(&hist->table, NUMBER_VAL((double)(1u << i)), NUMBER_VAL((double)buckets[i]));
+    }
+    pop(vm);
+    return hist;
+}
+
+// gc_stats() -> table of collection counts and pause histograms
+static int gc_stats_native(VM* vm, int arg_count, Value* args) {
+    (void)args;
+    ASSERT_ARGC_EQ(0);
+
+    ObjTable* out = new_table();
+    push(vm, OBJ_VAL(out)); // GC protection
+    table_set(&out->table, copy_string("minor", 5), NUMBER_VAL((double)gc_heap->stats.minor_count));
+    table_set(&out->table, copy_string("major", 5), NUMBER_VAL((double)gc_heap->stats.major_count));
+    table_set(&out->table, copy_string("major_steps", 11), NUMBER_VAL((double)gc_heap->stats.major_steps));
+    table_set(&out->table, copy_string("minor_max_us", 12), NUMBER_VAL(gc_heap->stats.minor_max_us));
+    table_set(&out->table, copy_string("major_max_us", 12), NUMBER_VAL(gc_heap->stats.major_max_us));
+    table_set(&out->table, copy_string("total_pause_us", 14), NUMBER_VAL(gc_heap->stats.total_pause_us));
+    table_set(&out->table, copy_string("heap_bytes", 10), NUMBER_VAL((double)gc_heap->bytes_allocated));
+#ifdef TOI_NO_GENERATIONAL_GC
+    table_set(&out->table, copy_string("generational", 12), BOOL_VAL(0));
+#else
+    table_set(&out->table, copy_string("generational", 12), BOOL_VAL(1));
+#endif
+    table_set(&out->table, copy_string("minor_pauses", 12),
+              OBJ_VAL(gc_pause_histogram(vm, gc_heap->stats.minor_pauses)));
+    table_set(&out->table, copy_string("major_pauses", 12),
+              OBJ_VAL(gc_pause_histogram(vm, gc_heap->stats.major_pauses)));
+    return 1; // result already on stack
 }
 
 void register_core(VM* vm) {
@@ -1049,7 +1075,8 @@ void register_core(VM* vm) {
         {"float", float_native},
         {"input", input_native},
         {"mem", mem_native},
-        {"next", next_native},
+        {"gc_stats", gc_stats_native},
+        {"next", core_next},
         {"inext", inext_native},
         {"gen_next", gen_next_native},
         {"range_iter", range_iter},
@@ -28,8 +28,9 @@ static int coroutine_do_yield(VM* vm, int arg_count, Value* args) {
         }
     }
 
+    // The caller keeps its own caller: it may itself be a coroutine that
+    // is iterating this generator and still has to yield to the loop.
     vm_set_current_thread(vm, caller);
-    vm_current_thread(vm)->caller = NULL;
 
     return 1;
 }
@@ -48,6 +49,15 @@ static int coroutine_create(VM* vm, int arg_count, Value* args) {
     frame->closure = closure;
     frame->ip = closure->function->chunk.code;
     frame->slots = thread->stack;
+    frame->restore_module_context = 0;
+    frame->cache_module_result = 0;
+    frame->had_prev_module_name = 0;
+    frame->had_prev_module_file = 0;
+    frame->had_prev_module_main = 0;
+    frame->module_cache_name = NIL_VAL;
+    frame->prev_module_name = NIL_VAL;
+    frame->prev_module_file = NIL_VAL;
+    frame->prev_module_main = NIL_VAL;
     thread->frame_count = 1;
     
     RETURN_OBJ(thread);
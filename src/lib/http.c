@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
+#include <limits.h>
 
 #ifndef TOI_WASM
 #include <errno.h>
@@ -11,6 +12,11 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <sys/time.h>
+#include <time.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
 #endif
 
 #ifdef TOI_HAVE_TLS
@@ -198,155 +204,143 @@ static int decode_chunked_body(const char* body_start, const char* end,
     }
 }
 
-// Parse HTTP request: http.parse(data) -> {method, path, version, headers, body}
-static int http_parse(VM* vm, int arg_count, Value* args) {
-    ASSERT_ARGC_EQ(1);
-    ASSERT_STRING(0);
-
-    ObjString* data = GET_STRING(0);
-    const char* src = data->chars;
-    int len = data->length;
-
-    const char* src_end = src + len;
-
-    // Find end of request line
-    const char* line_end = find_crlf(src, src_end);
-    if (!line_end) {
-        RETURN_NIL;
+// Case-insensitive match of a header name or method against a lowercase
+// name.
+static int name_is_ci(const char* s, int len, const char* name) {
+    for (int i = 0; i < len; i++) {
+        if (name[i] == '\0' || (char)tolower((unsigned char)s[i]) != name[i]) return 0;
     }
+    return name[len] == '\0';
+}
 
-    // Parse request line: METHOD PATH VERSION
+// The request line and headers of a request, as spans of the input.
+typedef struct {
+    const char* method;
+    int method_len;
+    const char* path;
+    int path_len;
+    const char* query; // NULL without a query string
+    int query_len;
+    const char* version;
+    int version_len;
+    const char* headers; // first header line
+    const char* body;    // just past the blank line
+    int content_length;  // -1 when absent
+    int chunked;
+} RequestHead;
+
+// Scans the request line and headers at src.
+// Returns: 1 complete head, 0 incomplete input, -1 malformed request.
+static int scan_request_head(const char* src, const char* end, RequestHead* head) {
+    const char* line_end = find_crlf(src, end);
+    if (!line_end) return 0;
+
+    // Request line: METHOD PATH[?QUERY] VERSION
     const char* p = src;
-
-    // Method
-    const char* method_start = p;
+    head->method = p;
     while (p < line_end && *p != ' ') p++;
-    if (p >= line_end) { RETURN_FALSE; }
-    int method_len = p - method_start;
-    p++; // skip space
+    if (p >= line_end) return -1;
+    head->method_len = (int)(p - head->method);
+    p++;
 
-    // Path
-    const char* path_start = p;
+    head->path = p;
     while (p < line_end && *p != ' ' && *p != '?') p++;
-    int path_len = p - path_start;
-
-    // Skip query string if present
-    const char* query_start = NULL;
-    int query_len = 0;
-    if (*p == '?') {
-        p++; // skip '?'
-        query_start = p;
+    head->path_len = (int)(p - head->path);
+
+    head->query = NULL;
+    head->query_len = 0;
+    if (p < line_end && *p == '?') {
+        p++;
+        head->query = p;
         while (p < line_end && *p != ' ') p++;
-        query_len = p - query_start;
+        head->query_len = (int)(p - head->query);
     }
 
-    if (p >= line_end) { RETURN_FALSE; }
-    p++; // skip space
-
-    // Version
-    const char* version_start = p;
-    int version_len = line_end - p;
-
-    // Create result table
-    ObjTable* result = new_table();
-    push(vm, OBJ_VAL(result));
-
-    // Set method
-    ObjString* method_key = copy_string("method", 6);
-    push(vm, OBJ_VAL(method_key));
-    ObjString* method_val = copy_string(method_start, method_len);
-    push(vm, OBJ_VAL(method_val));
-    table_set(&result->table, method_key, OBJ_VAL(method_val));
-    pop(vm); pop(vm);
-
-    // Set path
-    ObjString* path_key = copy_string("path", 4);
-    push(vm, OBJ_VAL(path_key));
-    ObjString* path_val = copy_string(path_start, path_len);
-    push(vm, OBJ_VAL(path_val));
-    table_set(&result->table, path_key, OBJ_VAL(path_val));
-    pop(vm); pop(vm);
-
-    // Set query (if present)
-    if (query_start) {
-        ObjString* query_key = copy_string("query", 5);
-        push(vm, OBJ_VAL(query_key));
-        ObjString* query_val = copy_string(query_start, query_len);
-        push(vm, OBJ_VAL(query_val));
-        table_set(&result->table, query_key, OBJ_VAL(query_val));
-        pop(vm); pop(vm);
-    }
-
-    // Set version
-    ObjString* version_key = copy_string("version", 7);
-    push(vm, OBJ_VAL(version_key));
-    ObjString* version_val = copy_string(version_start, version_len);
-    push(vm, OBJ_VAL(version_val));
-    table_set(&result->table, version_key, OBJ_VAL(version_val));
-    pop(vm); pop(vm);
+    if (p >= line_end) return -1;
+    p++;
+    head->version = p;
+    head->version_len = (int)(line_end - p);
 
-    // Parse headers
-    ObjTable* headers = new_table();
-    push(vm, OBJ_VAL(headers));
-    int content_length = -1;
-    int transfer_chunked = 0;
+    head->headers = line_end + 2;
+    head->content_length = -1;
+    head->chunked = 0;
 
-    p = line_end + 2; // Skip \r\n
-    while (p < src_end) {
-        line_end = find_crlf(p, src_end);
-        if (!line_end) {
-            pop(vm); // headers table
-            pop(vm); // result table
-            RETURN_NIL;
-        }
+    p = line_end + 2;
+    while (1) {
+        line_end = find_crlf(p, end);
+        if (!line_end) return 0;
 
         // Empty line = end of headers
         if (line_end == p) {
-            p += 2;
-            break;
+            head->body = p + 2;
+            return 1;
         }
 
-        // Find colon
-        const char* colon = strchr(p, ':');
-        if (!colon || colon > line_end) {
-            p = line_end + 2;
-            continue;
-        }
+        const char* colon = memchr(p, ':', (size_t)(line_end - p));
+        if (colon) {
+            int name_len = (int)(colon - p);
+            const char* val_start = colon + 1;
+            while (val_start < line_end && isspace((unsigned char)*val_start)) val_start++;
+            int val_len = (int)(line_end - val_start);
 
-        // Header name (lowercase for consistency)
-        int name_len = colon - p;
-        char name_buf[name_len + 1];
-        for (int i = 0; i < name_len; i++) {
-            name_buf[i] = (char)tolower((unsigned char)p[i]);
+            if (name_is_ci(p, name_len, "content-length")) {
+                if (!parse_content_length(val_start, val_len, &head->content_length)) {
+                    return -1;
+                }
+            } else if (name_is_ci(p, name_len, "transfer-encoding")) {
+                if (has_csv_token_ci(val_start, val_len, "chunked")) {
+                    head->chunked = 1;
+                }
+            }
         }
-        name_buf[name_len] = '\0';
 
-        // Header value (skip leading whitespace)
-        const char* val_start = colon + 1;
-        while (val_start < line_end && isspace((unsigned char)*val_start)) val_start++;
-        int val_len = line_end - val_start;
+        p = line_end + 2;
+    }
+}
 
-        if (name_len == 14 && memcmp(name_buf, "content-length", 14) == 0) {
-            int parsed_len = 0;
-            if (!parse_content_length(val_start, val_len, &parsed_len)) {
-                pop(vm); // headers table
-                pop(vm); // result table
-                RETURN_FALSE;
-            }
-            content_length = parsed_len;
-        } else if (name_len == 17 && memcmp(name_buf, "transfer-encoding", 17) == 0) {
-            if (has_csv_token_ci(val_start, val_len, "chunked")) {
-                transfer_chunked = 1;
-            }
-        }
+static void set_string_field(VM* vm, ObjTable* table, const char* key, const char* chars, int len) {
+    ObjString* key_str = copy_string(key, (int)strlen(key));
+    push(vm, OBJ_VAL(key_str));
+    ObjString* val_str = copy_string(chars, len);
+    push(vm, OBJ_VAL(val_str));
+    table_set(&table->table, key_str, OBJ_VAL(val_str));
+    pop(vm);
+    pop(vm);
+}
 
-        ObjString* hdr_key = copy_string(name_buf, name_len);
-        push(vm, OBJ_VAL(hdr_key));
-        ObjString* hdr_val = copy_string(val_start, val_len);
-        push(vm, OBJ_VAL(hdr_val));
-        table_set(&headers->table, hdr_key, OBJ_VAL(hdr_val));
-        pop(vm); pop(vm);
+// Pushes the request table for a scanned head:
+// {method, path, query?, version, headers, body?}. Header names are
+// lowercased.
+static ObjTable* push_request_table(VM* vm, const RequestHead* head, const char* body, int body_len) {
+    ObjTable* result = new_table();
+    push(vm, OBJ_VAL(result));
+
+    set_string_field(vm, result, "method", head->method, head->method_len);
+    set_string_field(vm, result, "path", head->path, head->path_len);
+    if (head->query) {
+        set_string_field(vm, result, "query", head->query, head->query_len);
+    }
+    set_string_field(vm, result, "version", head->version, head->version_len);
+
+    ObjTable* headers = new_table();
+    push(vm, OBJ_VAL(headers));
+    const char* p = head->headers;
+    const char* end = head->body - 2;
+    while (p < end) {
+        const char* line_end = find_crlf(p, head->body);
+        const char* colon = memchr(p, ':', (size_t)(line_end - p));
+        if (colon) {
+            int name_len = (int)(colon - p);
+            char name_buf[name_len + 1];
+            for (int i = 0; i < name_len; i++) {
+                name_buf[i] = (char)tolower((unsigned char)p[i]);
+            }
+            name_buf[name_len] = '\0';
 
+            const char* val_start = colon + 1;
+            while (val_start < line_end && isspace((unsigned char)*val_start)) val_start++;
+            set_string_field(vm, headers, name_buf, val_start, (int)(line_end - val_start));
+        }
         p = line_end + 2;
     }
 
@@ -356,46 +350,45 @@ static int http_parse(VM* vm, int arg_count, Value* args) {
     pop(vm);
     pop(vm); // headers table
 
-    int body_offset = (int)(p - src);
+    if (body_len > 0) {
+        set_string_field(vm, result, "body", body, body_len);
+    }
+    return result;
+}
+
+// Parse HTTP request: http.parse(data) -> {method, path, version, headers, body}
+static int http_parse(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(1);
+    ASSERT_STRING(0);
+
+    ObjString* data = GET_STRING(0);
+    const char* src = data->chars;
+    const char* src_end = src + data->length;
+
+    RequestHead head;
+    int status = scan_request_head(src, src_end, &head);
+    if (status == 0) { RETURN_NIL; }
+    if (status < 0) { RETURN_FALSE; }
+
+    const char* body_ptr = head.body;
     int body_len = 0;
-    const char* body_ptr = p;
     char* chunked_body = NULL;
-    int chunked_consumed = 0;
-    int consumed = body_offset;
+    int consumed = (int)(head.body - src);
 
-    if (transfer_chunked) {
-        int chunk_status = decode_chunked_body(p, src_end, &chunked_body, &body_len, &chunked_consumed);
-        if (chunk_status == 0) {
-            pop(vm); // result table
-            RETURN_NIL;
-        } else if (chunk_status < 0) {
-            pop(vm); // result table
-            RETURN_FALSE;
-        }
+    if (head.chunked) {
+        int chunked_consumed = 0;
+        int chunk_status = decode_chunked_body(head.body, src_end, &chunked_body, &body_len, &chunked_consumed);
+        if (chunk_status == 0) { RETURN_NIL; }
+        if (chunk_status < 0) { RETURN_FALSE; }
         body_ptr = chunked_body;
-        consumed = body_offset + chunked_consumed;
-    } else if (content_length >= 0) {
-        int available = (int)(src_end - p);
-        if (available < content_length) {
-            pop(vm); // result table
-            RETURN_NIL;
-        }
-        body_len = content_length;
-        consumed = body_offset + content_length;
-    } else {
-        body_len = 0;
-        consumed = body_offset;
-    }
-
-    if (body_len > 0) {
-        ObjString* body_key = copy_string("body", 4);
-        push(vm, OBJ_VAL(body_key));
-        ObjString* body_val = copy_string(body_ptr, body_len);
-        push(vm, OBJ_VAL(body_val));
-        table_set(&result->table, body_key, OBJ_VAL(body_val));
-        pop(vm); pop(vm);
+        consumed += chunked_consumed;
+    } else if (head.content_length >= 0) {
+        if ((int)(src_end - head.body) < head.content_length) { RETURN_NIL; }
+        body_len = head.content_length;
+        consumed += head.content_length;
     }
 
+    ObjTable* result = push_request_table(vm, &head, body_ptr, body_len);
     if (chunked_body != NULL) {
         free(chunked_body);
     }
@@ -409,49 +402,25 @@ static int http_parse(VM* vm, int arg_count, Value* args) {
     return 1;
 }
 
-// Format HTTP response: http.response(status, headers, body) -> string
-static int http_response(VM* vm, int arg_count, Value* args) {
-    if (arg_count < 1) {
-        RETURN_NIL;
-    }
-    ASSERT_NUMBER(0);
-
-    int status = (int)GET_NUMBER(0);
+// Formats the status line and headers of a response, through the blank
+// line that ends them, into a malloc'd buffer with room for reserve more
+// bytes after it. Adds Content-Length when body_len is positive.
+static char* format_response_head(int status, ObjTable* headers, int body_len, size_t reserve, size_t* out_len) {
     const char* reason = get_status_reason(status);
 
-    // Build response
     char status_line[64];
     int status_line_len = snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d %s\r\n", status, reason);
-    if (status_line_len < 0) {
-        RETURN_NIL;
-    }
-
-    // Calculate total size
-    size_t total_len = (size_t)status_line_len;
-
-    // Headers
-    ObjTable* headers = NULL;
-    if (arg_count >= 2 && IS_TABLE(args[1])) {
-        headers = GET_TABLE(1);
-    }
-
-    // Body
-    const char* body = "";
-    int body_len = 0;
-    if (arg_count >= 3 && IS_STRING(args[2])) {
-        body = AS_CSTRING(args[2]);
-        body_len = AS_STRING(args[2])->length;
-    }
+    if (status_line_len < 0) return NULL;
 
     // Compute headers length.
     size_t headers_len = 0;
     if (headers) {
         for (int i = 0; i < headers->table.capacity; i++) {
             Entry* entry = &headers->table.entries[i];
-            if (entry->key != NULL) {
+            if (IS_STRING(entry->key)) {
                 if (IS_STRING(entry->value)) {
                     ObjString* val = AS_STRING(entry->value);
-                    headers_len += (size_t)entry->key->length + 2 + (size_t)val->length + 2;
+                    headers_len += (size_t)AS_STRING(entry->key)->length + 2 + (size_t)val->length + 2;
                 }
             }
         }
@@ -462,16 +431,12 @@ static int http_response(VM* vm, int arg_count, Value* args) {
     int content_length_len = 0;
     if (body_len > 0) {
         content_length_len = snprintf(content_length, sizeof(content_length), "Content-Length: %d\r\n", body_len);
-        if (content_length_len < 0) {
-            RETURN_NIL;
-        }
+        if (content_length_len < 0) return NULL;
     }
 
-    total_len += headers_len + (size_t)content_length_len + 2 + (size_t)body_len; // +2 for final \r\n
-    char* response = (char*)malloc(total_len + 1);
-    if (response == NULL) {
-        RETURN_NIL;
-    }
+    size_t head_len = (size_t)status_line_len + headers_len + (size_t)content_length_len + 2; // +2 for final \r\n
+    char* response = (char*)malloc(head_len + reserve + 1);
+    if (response == NULL) return NULL;
 
     char* p = response;
     memcpy(p, status_line, (size_t)status_line_len);
@@ -480,8 +445,8 @@ static int http_response(VM* vm, int arg_count, Value* args) {
     if (headers) {
         for (int i = 0; i < headers->table.capacity; i++) {
             Entry* entry = &headers->table.entries[i];
-            if (entry->key != NULL && IS_STRING(entry->value)) {
-                ObjString* key = entry->key;
+            if (IS_STRING(entry->key) && IS_STRING(entry->value)) {
+                ObjString* key = AS_STRING(entry->key);
                 ObjString* val = AS_STRING(entry->value);
                 memcpy(p, key->chars, (size_t)key->length);
                 p += key->length;
@@ -503,6 +468,37 @@ static int http_response(VM* vm, int arg_count, Value* args) {
     memcpy(p, "\r\n", 2);
     p += 2;
 
+    *out_len = (size_t)(p - response);
+    return response;
+}
+
+// Format HTTP response: http.response(status, headers, body) -> string
+static int http_response(VM* vm, int arg_count, Value* args) {
+    if (arg_count < 1) {
+        RETURN_NIL;
+    }
+    ASSERT_NUMBER(0);
+
+    ObjTable* headers = NULL;
+    if (arg_count >= 2 && IS_TABLE(args[1])) {
+        headers = GET_TABLE(1);
+    }
+
+    // Body
+    const char* body = "";
+    int body_len = 0;
+    if (arg_count >= 3 && IS_STRING(args[2])) {
+        body = AS_CSTRING(args[2]);
+        body_len = AS_STRING(args[2])->length;
+    }
+
+    size_t head_len = 0;
+    char* response = format_response_head((int)GET_NUMBER(0), headers, body_len, (size_t)body_len, &head_len);
+    if (response == NULL) {
+        RETURN_NIL;
+    }
+
+    char* p = response + head_len;
     if (body_len > 0) {
         memcpy(p, body, body_len);
         p += body_len;
@@ -516,6 +512,47 @@ static int http_response(VM* vm, int arg_count, Value* args) {
     RETURN_OBJ(result);
 }
 
+// http.response_parts(status, headers, body) -> {head, body}
+// Same response as http.response, with the body left as its own segment
+// (the caller's string, not a copy) for sock.sendv. An empty body yields
+// just {head}.
+static int http_response_parts(VM* vm, int arg_count, Value* args) {
+    if (arg_count < 1) {
+        RETURN_NIL;
+    }
+    ASSERT_NUMBER(0);
+
+    ObjTable* headers = NULL;
+    if (arg_count >= 2 && IS_TABLE(args[1])) {
+        headers = GET_TABLE(1);
+    }
+
+    Value body = NIL_VAL;
+    int body_len = 0;
+    if (arg_count >= 3 && IS_STRING(args[2])) {
+        body = args[2];
+        body_len = AS_STRING(body)->length;
+    }
+
+    size_t head_len = 0;
+    char* head = format_response_head((int)GET_NUMBER(0), headers, body_len, 0, &head_len);
+    if (head == NULL) {
+        RETURN_NIL;
+    }
+
+    ObjTable* parts = new_table();
+    push(vm, OBJ_VAL(parts));
+    ObjString* head_str = copy_string(head, (int)head_len);
+    free(head);
+    push(vm, OBJ_VAL(head_str));
+    table_set_array(&parts->table, 1, OBJ_VAL(head_str));
+    pop(vm);
+    if (body_len > 0) {
+        table_set_array(&parts->table, 2, body);
+    }
+    return 1;
+}
+
 // URL decode: http.urldecode(str) -> str
 static int http_urldecode(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_EQ(1);
@@ -587,58 +624,862 @@ static int http_parsequery(VM* vm, int arg_count, Value* args) {
     return 1;
 }
 
-#ifndef TOI_WASM
+// --- Incremental request parser ---
+//
+// http.parser() keeps one connection's unparsed input in a growable buffer
+// and remembers how far it got between calls, so bytes are scanned once no
+// matter how many reads a request arrives in. Chunked bodies are decoded
+// in place as their chunks arrive.
+//
+// With max_body set, a request whose body grows past it is returned
+// without the body (body_streamed = true). parser:body() then hands the
+// body out piece by piece as it is read, so the buffer never holds much
+// more than one read of it.
+
+#define HTTP_PARSER_MAX_HEAD (64 * 1024)
+#define HTTP_PARSER_MAX_CHUNK_LINE 1024
+#define HTTP_PARSER_READ_SIZE 65536
+
+typedef enum {
+    PARSER_HEAD,
+    PARSER_BODY,
+    PARSER_CHUNK_SIZE,
+    PARSER_CHUNK_DATA,
+    PARSER_CHUNK_TRAILER,
+    PARSER_ERROR
+} HttpParserState;
+
 typedef struct {
-    char* host;
-    int port;
-    int use_tls;
-    char* target;
-} FetchUrl;
+    char* buf;
+    int len;        // bytes buffered
+    int cap;
+    int start;      // offset of the request being parsed
+    int scan;       // where parsing resumes
+    HttpParserState state;
+    int body_start; // offset of the body, once the head is complete
+    int body_len;   // Content-Length, or chunked bytes decoded so far
+    int chunk_left; // bytes of the current chunk still to come
+    int max_body;   // bodies larger than this are streamed; 0 never
+    int streaming;  // a streamed body is being read through parser:body()
+    int body_left;  // Content-Length bytes of a streamed body still to come
+} HttpParser;
+
+static void http_parser_finalizer(void* ptr) {
+    HttpParser* parser = (HttpParser*)ptr;
+    if (parser == NULL) return;
+    free(parser->buf);
+    free(parser);
+}
 
-static int fetch_table_get(ObjTable* table, const char* key, Value* out) {
-    ObjString* k = copy_string(key, (int)strlen(key));
-    return table_get(&table->table, k, out);
+static HttpParser* http_parser_from_userdata(VM* vm, Value v) {
+    if (!IS_USERDATA(v) || AS_USERDATA(v)->finalize != http_parser_finalizer) {
+        vm_runtime_error(vm, "parser expected.");
+        return NULL;
+    }
+    return (HttpParser*)AS_USERDATA(v)->data;
 }
 
-static int fetch_header_has(ObjTable* headers, const char* key) {
-    int key_len = (int)strlen(key);
-    for (int i = 0; i < headers->table.capacity; i++) {
-        Entry* entry = &headers->table.entries[i];
-        if (entry->key == NULL || !IS_STRING(entry->value)) continue;
-        if (entry->key->length != key_len) continue;
-        int match = 1;
-        for (int j = 0; j < key_len; j++) {
-            char a = (char)tolower((unsigned char)entry->key->chars[j]);
-            char b = (char)tolower((unsigned char)key[j]);
-            if (a != b) {
-                match = 0;
-                break;
-            }
+// Drops the requests already returned from the front of the buffer and
+// makes room for at least `extra` more bytes.
+static int http_parser_reserve(HttpParser* parser, int extra) {
+    if (parser->start > 0) {
+        int shift = parser->start;
+        memmove(parser->buf, parser->buf + shift, (size_t)(parser->len - shift));
+        parser->len -= shift;
+        parser->scan -= shift;
+        parser->body_start -= shift;
+        parser->start = 0;
+    }
+    if (extra > INT_MAX - parser->len) return 0;
+    int need = parser->len + extra;
+    if (need <= parser->cap) return 1;
+
+    int cap = parser->cap > 0 ? parser->cap : 4096;
+    while (cap < need) {
+        cap = cap > INT_MAX / 2 ? need : cap * 2;
+    }
+    char* buf = (char*)realloc(parser->buf, (size_t)cap);
+    if (buf == NULL) return 0;
+    parser->buf = buf;
+    parser->cap = cap;
+    return 1;
+}
+
+// Parses one chunk-size line; returns the size, or -1 when malformed.
+static int parse_chunk_size(const char* p, const char* line_end) {
+    const char* size_end = p;
+    while (size_end < line_end && *size_end != ';') size_end++;
+    while (p < size_end && isspace((unsigned char)*p)) p++;
+    while (size_end > p && isspace((unsigned char)size_end[-1])) size_end--;
+    if (size_end == p) return -1;
+
+    int size = 0;
+    for (; p < size_end; p++) {
+        char c = *p;
+        int digit;
+        if (c >= '0' && c <= '9') digit = c - '0';
+        else if (c >= 'a' && c <= 'f') digit = 10 + (c - 'a');
+        else if (c >= 'A' && c <= 'F') digit = 10 + (c - 'A');
+        else return -1;
+        if (size > 0x0FFFFFFF) return -1;
+        size = (size << 4) | digit;
+    }
+    return size;
+}
+
+// Reads the chunk-size line at scan. Returns 1 when consumed, 0 when more
+// input is needed, -1 when malformed.
+static int http_parser_chunk_size(HttpParser* parser) {
+    const char* line = parser->buf + parser->scan;
+    const char* line_end = find_crlf(line, parser->buf + parser->len);
+    if (line_end == NULL) {
+        return parser->len - parser->scan > HTTP_PARSER_MAX_CHUNK_LINE ? -1 : 0;
+    }
+    int size = parse_chunk_size(line, line_end);
+    if (size < 0) return -1;
+    parser->scan = (int)(line_end - parser->buf) + 2;
+    parser->chunk_left = size;
+    parser->state = size == 0 ? PARSER_CHUNK_TRAILER : PARSER_CHUNK_DATA;
+    return 1;
+}
+
+// Consumes the CRLF after a chunk's data. Same results as above.
+static int http_parser_chunk_end(HttpParser* parser) {
+    if (parser->len - parser->scan < 2) return 0;
+    if (parser->buf[parser->scan] != '\r' || parser->buf[parser->scan + 1] != '\n') return -1;
+    parser->scan += 2;
+    parser->state = PARSER_CHUNK_SIZE;
+    return 1;
+}
+
+// Skips trailer lines. Returns 1 past the blank line that ends the body,
+// 0 when more input is needed, -1 when the trailer is too large.
+static int http_parser_trailer(HttpParser* parser) {
+    while (1) {
+        const char* line = parser->buf + parser->scan;
+        const char* line_end = find_crlf(line, parser->buf + parser->len);
+        if (line_end == NULL) {
+            return parser->len - parser->scan > HTTP_PARSER_MAX_HEAD ? -1 : 0;
         }
-        if (match) return 1;
+        parser->scan = (int)(line_end - parser->buf) + 2;
+        if (line_end == line) return 1;
     }
-    return 0;
 }
 
-static int parse_fetch_url(const ObjString* input, FetchUrl* out, const char** err) {
-    const char* s = input->chars;
-    const char* end = s + input->length;
-    const char* scheme_end = strstr(s, "://");
-    if (scheme_end == NULL) {
-        *err = "URL must include scheme (http:// or https://)";
-        return 0;
-    }
+// Pushes the request head alone and switches to handing out its body
+// through parser:body(). Bytes of the body already buffered stay where
+// they are: raw after the head, or decoded at body_start for chunked.
+static void http_parser_start_stream(VM* vm, HttpParser* parser) {
+    RequestHead head;
+    scan_request_head(parser->buf + parser->start, parser->buf + parser->body_start, &head);
+    ObjTable* result = push_request_table(vm, &head, NULL, 0);
+    ObjString* key = copy_string("body_streamed", 13);
+    push(vm, OBJ_VAL(key));
+    table_set(&result->table, key, BOOL_VAL(true));
+    pop(vm);
 
-    int scheme_len = (int)(scheme_end - s);
-    if (scheme_len == 4 && memcmp(s, "http", 4) == 0) {
-        out->use_tls = 0;
-        out->port = 80;
-    } else if (scheme_len == 5 && memcmp(s, "https", 5) == 0) {
-        out->use_tls = 1;
-        out->port = 443;
-    } else {
-        *err = "unsupported URL scheme";
-        return 0;
+    parser->streaming = 1;
+    parser->start = parser->body_start;
+}
+
+// Pushes the finished request and moves on to the next one.
+static void http_parser_finish(VM* vm, HttpParser* parser, int end) {
+    RequestHead head;
+    const char* src = parser->buf + parser->start;
+    scan_request_head(src, parser->buf + parser->body_start, &head);
+    push_request_table(vm, &head, parser->buf + parser->body_start, parser->body_len);
+
+    parser->state = PARSER_HEAD;
+    parser->start = end;
+    parser->scan = end;
+    parser->body_len = 0;
+    if (parser->start == parser->len) {
+        parser->start = parser->scan = parser->len = 0;
+    }
+}
+
+// Advances the parser over buffered input. Pushes a request table, nil
+// when more input is needed, or false for a malformed request.
+static int http_parser_next(VM* vm, HttpParser* parser) {
+    char* buf = parser->buf;
+    // The next request starts after the streamed body.
+    if (parser->streaming) { RETURN_NIL; }
+    while (1) {
+        switch (parser->state) {
+            case PARSER_HEAD: {
+                // Resume the search for the blank line where the last one
+                // stopped, backing up over a CRLF split between reads.
+                int from = parser->scan - 3;
+                if (from < parser->start) from = parser->start;
+                const char* p = buf + from;
+                const char* end = buf + parser->len;
+                const char* head_end = NULL;
+                while (p + 3 < end) {
+                    p = memchr(p, '\r', (size_t)(end - p - 3));
+                    if (p == NULL) break;
+                    if (p[1] == '\n' && p[2] == '\r' && p[3] == '\n') {
+                        head_end = p + 4;
+                        break;
+                    }
+                    p++;
+                }
+                if (head_end == NULL) {
+                    parser->scan = parser->len;
+                    if (parser->len - parser->start > HTTP_PARSER_MAX_HEAD) {
+                        parser->state = PARSER_ERROR;
+                        RETURN_FALSE;
+                    }
+                    RETURN_NIL;
+                }
+
+                RequestHead head;
+                if (scan_request_head(buf + parser->start, head_end, &head) != 1) {
+                    parser->state = PARSER_ERROR;
+                    RETURN_FALSE;
+                }
+                parser->body_start = (int)(head_end - buf);
+                parser->scan = parser->body_start;
+                parser->body_len = 0;
+                if (head.chunked) {
+                    parser->state = PARSER_CHUNK_SIZE;
+                } else if (parser->max_body > 0 && head.content_length > parser->max_body) {
+                    parser->body_left = head.content_length;
+                    parser->state = PARSER_BODY;
+                    http_parser_start_stream(vm, parser);
+                    return 1;
+                } else if (head.content_length > 0) {
+                    parser->body_len = head.content_length;
+                    parser->state = PARSER_BODY;
+                } else {
+                    http_parser_finish(vm, parser, parser->body_start);
+                    return 1;
+                }
+                break;
+            }
+            case PARSER_BODY:
+                if (parser->len - parser->body_start < parser->body_len) {
+                    RETURN_NIL;
+                }
+                http_parser_finish(vm, parser, parser->body_start + parser->body_len);
+                return 1;
+            case PARSER_CHUNK_SIZE: {
+                int r = http_parser_chunk_size(parser);
+                if (r < 0) {
+                    parser->state = PARSER_ERROR;
+                    RETURN_FALSE;
+                }
+                if (r == 0) { RETURN_NIL; }
+                break;
+            }
+            case PARSER_CHUNK_DATA: {
+                // Decoded data is moved down over the framing before it,
+                // so the body ends up contiguous after the head.
+                int avail = parser->len - parser->scan;
+                int n = avail < parser->chunk_left ? avail : parser->chunk_left;
+                if (n > 0) {
+                    memmove(buf + parser->body_start + parser->body_len, buf + parser->scan, (size_t)n);
+                    parser->body_len += n;
+                    parser->scan += n;
+                    parser->chunk_left -= n;
+                }
+                if (parser->max_body > 0 && parser->body_len > parser->max_body) {
+                    http_parser_start_stream(vm, parser);
+                    return 1;
+                }
+                if (parser->chunk_left > 0) { RETURN_NIL; }
+                int r = http_parser_chunk_end(parser);
+                if (r < 0) {
+                    parser->state = PARSER_ERROR;
+                    RETURN_FALSE;
+                }
+                if (r == 0) { RETURN_NIL; }
+                break;
+            }
+            case PARSER_CHUNK_TRAILER: {
+                int r = http_parser_trailer(parser);
+                if (r < 0) {
+                    parser->state = PARSER_ERROR;
+                    RETURN_FALSE;
+                }
+                if (r == 0) { RETURN_NIL; }
+                http_parser_finish(vm, parser, parser->scan);
+                return 1;
+            }
+            case PARSER_ERROR:
+                RETURN_FALSE;
+        }
+    }
+}
+
+// http.parser([opts]) -> parser
+static int http_parser_new(VM* vm, int arg_count, Value* args) {
+    int max_body = 0;
+    if (arg_count >= 1 && IS_TABLE(args[0])) {
+        Value v = NIL_VAL;
+        ObjString* key = copy_string("max_body", 8);
+        if (table_get(&GET_TABLE(0)->table, key, &v) && IS_NUMBER(v)) {
+            double limit = AS_NUMBER(v);
+            if (limit < 0) limit = 0;
+            max_body = limit > INT_MAX ? INT_MAX : (int)limit;
+        }
+    }
+
+    HttpParser* parser = (HttpParser*)calloc(1, sizeof(HttpParser));
+    if (parser == NULL) {
+        vm_runtime_error(vm, "out of memory");
+        return 0;
+    }
+    parser->state = PARSER_HEAD;
+    parser->max_body = max_body;
+
+    ObjUserdata* u = new_userdata_with_finalizer(parser, http_parser_finalizer);
+    Value module_val = NIL_VAL;
+    Value mt = NIL_VAL;
+    ObjString* module_name = copy_string("http", 4);
+    if ((table_get(&vm->modules, module_name, &module_val) && IS_TABLE(module_val)) ||
+        (table_get(&vm->globals, module_name, &module_val) && IS_TABLE(module_val))) {
+        ObjString* mt_name = copy_string("_parser_mt", 10);
+        if (table_get(&AS_TABLE(module_val)->table, mt_name, &mt) && IS_TABLE(mt)) {
+            u->metatable = AS_TABLE(mt);
+        }
+    }
+    push(vm, OBJ_VAL(u));
+    return 1;
+}
+
+// parser:feed([bytes]) -> request|nil|false
+static int http_parser_feed(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    HttpParser* parser = http_parser_from_userdata(vm, args[0]);
+    if (parser == NULL) return 0;
+    if (parser->state == PARSER_ERROR) { RETURN_FALSE; }
+
+    if (arg_count >= 2 && !IS_NIL(args[1])) {
+        if (!IS_STRING(args[1])) {
+            vm_runtime_error(vm, "feed expects a string.");
+            return 0;
+        }
+        ObjString* data = AS_STRING(args[1]);
+        if (data->length > 0) {
+            if (!http_parser_reserve(parser, data->length)) {
+                vm_runtime_error(vm, "out of memory");
+                return 0;
+            }
+            memcpy(parser->buf + parser->len, data->chars, (size_t)data->length);
+            parser->len += data->length;
+        }
+    }
+    return http_parser_next(vm, parser);
+}
+
+// Finishes a streamed body; the parser moves on to the next request.
+static void http_parser_end_stream(HttpParser* parser) {
+    parser->streaming = 0;
+    parser->state = PARSER_HEAD;
+    parser->start = parser->scan;
+    parser->body_len = 0;
+    if (parser->start == parser->len) {
+        parser->start = parser->scan = parser->len = 0;
+    }
+}
+
+// parser:body([max]) -> bytes|nil|false
+// The next piece of a streamed body, at most `max` bytes: nil when more
+// input is needed, "" once the body has ended (or when none is streaming).
+static int http_parser_body(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    HttpParser* parser = http_parser_from_userdata(vm, args[0]);
+    if (parser == NULL) return 0;
+    if (parser->state == PARSER_ERROR) { RETURN_FALSE; }
+    if (!parser->streaming) { RETURN_STRING("", 0); }
+
+    int max = HTTP_PARSER_READ_SIZE;
+    if (arg_count >= 2 && IS_NUMBER(args[1]) && AS_NUMBER(args[1]) >= 1) {
+        max = AS_NUMBER(args[1]) > INT_MAX ? INT_MAX : (int)AS_NUMBER(args[1]);
+    }
+
+    char* buf = parser->buf;
+    while (1) {
+        int r = 1;
+        switch (parser->state) {
+            case PARSER_BODY: {
+                if (parser->body_left == 0) {
+                    http_parser_end_stream(parser);
+                    RETURN_STRING("", 0);
+                }
+                int n = parser->len - parser->scan;
+                if (n > parser->body_left) n = parser->body_left;
+                if (n > max) n = max;
+                if (n == 0) { RETURN_NIL; }
+                push(vm, OBJ_VAL(copy_string(buf + parser->scan, n)));
+                parser->scan += n;
+                parser->body_left -= n;
+                parser->start = parser->scan;
+                return 1;
+            }
+            case PARSER_CHUNK_DATA: {
+                // Decoded before the switch to streaming.
+                if (parser->body_len > 0) {
+                    int n = parser->body_len < max ? parser->body_len : max;
+                    push(vm, OBJ_VAL(copy_string(buf + parser->body_start, n)));
+                    parser->body_start += n;
+                    parser->body_len -= n;
+                    parser->start = parser->body_len > 0 ? parser->body_start : parser->scan;
+                    return 1;
+                }
+                if (parser->chunk_left > 0) {
+                    int n = parser->len - parser->scan;
+                    if (n > parser->chunk_left) n = parser->chunk_left;
+                    if (n > max) n = max;
+                    if (n == 0) { RETURN_NIL; }
+                    push(vm, OBJ_VAL(copy_string(buf + parser->scan, n)));
+                    parser->scan += n;
+                    parser->chunk_left -= n;
+                    parser->start = parser->scan;
+                    return 1;
+                }
+                r = http_parser_chunk_end(parser);
+                break;
+            }
+            case PARSER_CHUNK_SIZE:
+                r = http_parser_chunk_size(parser);
+                break;
+            case PARSER_CHUNK_TRAILER:
+                r = http_parser_trailer(parser);
+                if (r == 1) {
+                    http_parser_end_stream(parser);
+                    RETURN_STRING("", 0);
+                }
+                break;
+            default:
+                r = -1;
+                break;
+        }
+        if (r < 0) {
+            parser->state = PARSER_ERROR;
+            RETURN_FALSE;
+        }
+        if (r == 0) { RETURN_NIL; }
+        parser->start = parser->body_start = parser->scan;
+    }
+}
+
+// parser:pending() -> bytes buffered but not yet returned as a request
+static int http_parser_pending(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    HttpParser* parser = http_parser_from_userdata(vm, args[0]);
+    if (parser == NULL) return 0;
+    RETURN_NUMBER((double)(parser->len - parser->start));
+}
+
+#ifndef TOI_WASM
+// parser:recv(sock, [size]) -> bytes_read|nil, err
+static int http_parser_recv(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    HttpParser* parser = http_parser_from_userdata(vm, args[0]);
+    if (parser == NULL) return 0;
+
+    int size = HTTP_PARSER_READ_SIZE;
+    if (arg_count >= 3 && IS_NUMBER(args[2]) && AS_NUMBER(args[2]) > 0) {
+        size = (int)AS_NUMBER(args[2]);
+    }
+    if (!http_parser_reserve(parser, size)) {
+        vm_runtime_error(vm, "out of memory");
+        return 0;
+    }
+
+    const char* err = NULL;
+    int received = socket_read(args[1], parser->buf + parser->len, size, &err);
+    if (received <= 0) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(err, (int)strlen(err))));
+        return 2;
+    }
+    parser->len += received;
+    RETURN_NUMBER((double)received);
+}
+#endif
+
+// --- Router ---
+//
+// A trie over path segments. Each node has its static children sorted for
+// binary search, at most one `<param>` child, and the routes that end there
+// keyed by method. Matching walks the request path in place: segments and
+// captures are pointers into the path string, and the only allocation is
+// the params table for a route that has captures.
+
+#define ROUTER_MAX_PARAMS 32
+
+typedef struct RouteEntry {
+    char method[16];
+    Value value;
+    int param_count;
+    ObjString* params[ROUTER_MAX_PARAMS]; // capture names, in path order
+    struct RouteEntry* next;
+} RouteEntry;
+
+typedef struct RouteNode {
+    char* segment;
+    int segment_len;
+    struct RouteNode** children;
+    int child_count;
+    int child_capacity;
+    struct RouteNode* param;
+    RouteEntry* entries;
+} RouteNode;
+
+typedef struct {
+    RouteNode* root;
+    int count;
+} HttpRouter;
+
+typedef struct {
+    const char* method;
+    int method_len;
+    int saw_path; // some route has the path, whatever its method
+    const char* caps[ROUTER_MAX_PARAMS];
+    int cap_lens[ROUTER_MAX_PARAMS];
+} RouteMatch;
+
+static void route_node_free(RouteNode* node) {
+    if (node == NULL) return;
+    for (int i = 0; i < node->child_count; i++) route_node_free(node->children[i]);
+    route_node_free(node->param);
+    while (node->entries != NULL) {
+        RouteEntry* next = node->entries->next;
+        free(node->entries);
+        node->entries = next;
+    }
+    free(node->children);
+    free(node->segment);
+    free(node);
+}
+
+static void route_node_mark(RouteNode* node) {
+    if (node == NULL) return;
+    for (RouteEntry* e = node->entries; e != NULL; e = e->next) {
+        mark_value(e->value);
+        for (int i = 0; i < e->param_count; i++) mark_object((struct Obj*)e->params[i]);
+    }
+    for (int i = 0; i < node->child_count; i++) route_node_mark(node->children[i]);
+    route_node_mark(node->param);
+}
+
+static void http_router_finalizer(void* ptr) {
+    HttpRouter* router = (HttpRouter*)ptr;
+    if (router == NULL) return;
+    route_node_free(router->root);
+    free(router);
+}
+
+static void http_router_mark(void* ptr) {
+    HttpRouter* router = (HttpRouter*)ptr;
+    if (router != NULL) route_node_mark(router->root);
+}
+
+static HttpRouter* http_router_from_userdata(VM* vm, Value v) {
+    if (!IS_USERDATA(v) || AS_USERDATA(v)->finalize != http_router_finalizer) {
+        vm_runtime_error(vm, "router expected.");
+        return NULL;
+    }
+    return (HttpRouter*)AS_USERDATA(v)->data;
+}
+
+// Orders segments by length, then bytes.
+static int route_segment_cmp(const RouteNode* node, const char* s, int len) {
+    if (node->segment_len != len) return node->segment_len < len ? -1 : 1;
+    return memcmp(node->segment, s, (size_t)len);
+}
+
+// Index of the static child for a segment, or where it would be inserted
+// (as -1 - index).
+static int route_child_index(const RouteNode* node, const char* s, int len) {
+    int lo = 0;
+    int hi = node->child_count - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        int cmp = route_segment_cmp(node->children[mid], s, len);
+        if (cmp == 0) return mid;
+        if (cmp < 0) lo = mid + 1;
+        else hi = mid - 1;
+    }
+    return -1 - lo;
+}
+
+static RouteNode* route_node_new(const char* s, int len) {
+    RouteNode* node = (RouteNode*)calloc(1, sizeof(RouteNode));
+    if (node == NULL) return NULL;
+    if (len > 0) {
+        node->segment = (char*)malloc((size_t)len);
+        if (node->segment == NULL) {
+            free(node);
+            return NULL;
+        }
+        memcpy(node->segment, s, (size_t)len);
+        node->segment_len = len;
+    }
+    return node;
+}
+
+static RouteNode* route_static_child(RouteNode* node, const char* s, int len) {
+    int i = route_child_index(node, s, len);
+    if (i >= 0) return node->children[i];
+
+    int at = -1 - i;
+    if (node->child_count == node->child_capacity) {
+        int cap = node->child_capacity < 4 ? 4 : node->child_capacity * 2;
+        RouteNode** grown = (RouteNode**)realloc(node->children, sizeof(RouteNode*) * (size_t)cap);
+        if (grown == NULL) return NULL;
+        node->children = grown;
+        node->child_capacity = cap;
+    }
+    RouteNode* child = route_node_new(s, len);
+    if (child == NULL) return NULL;
+    memmove(node->children + at + 1, node->children + at, sizeof(RouteNode*) * (size_t)(node->child_count - at));
+    node->children[at] = child;
+    node->child_count++;
+    return child;
+}
+
+static int route_method_is(const RouteEntry* e, const char* method, int len) {
+    if ((int)strlen(e->method) != len) return 0;
+    for (int i = 0; i < len; i++) {
+        if (toupper((unsigned char)method[i]) != e->method[i]) return 0;
+    }
+    return 1;
+}
+
+// Static segments are tried before a capture at the same depth, falling
+// back to the capture when the static branch has no route for the method.
+static RouteEntry* route_find(RouteNode* node, const char* p, const char* end, RouteMatch* m, int ncaps) {
+    while (p < end && *p == '/') p++;
+    if (p == end) {
+        if (node->entries == NULL) return NULL;
+        m->saw_path = 1;
+        for (RouteEntry* e = node->entries; e != NULL; e = e->next) {
+            if (route_method_is(e, m->method, m->method_len)) return e;
+        }
+        return NULL;
+    }
+
+    const char* seg_end = p;
+    while (seg_end < end && *seg_end != '/') seg_end++;
+    int len = (int)(seg_end - p);
+
+    int i = route_child_index(node, p, len);
+    if (i >= 0) {
+        RouteEntry* e = route_find(node->children[i], seg_end, end, m, ncaps);
+        if (e != NULL) return e;
+    }
+    if (node->param != NULL && ncaps < ROUTER_MAX_PARAMS) {
+        m->caps[ncaps] = p;
+        m->cap_lens[ncaps] = len;
+        return route_find(node->param, seg_end, end, m, ncaps + 1);
+    }
+    return NULL;
+}
+
+// http.router() -> router
+static int http_router_new(VM* vm, int arg_count, Value* args) {
+    (void)args;
+    ASSERT_ARGC_EQ(0);
+
+    HttpRouter* router = (HttpRouter*)calloc(1, sizeof(HttpRouter));
+    if (router != NULL) router->root = route_node_new(NULL, 0);
+    if (router == NULL || router->root == NULL) {
+        free(router);
+        vm_runtime_error(vm, "out of memory");
+        return 0;
+    }
+
+    ObjUserdata* u = new_userdata_with_hooks(router, http_router_finalizer, http_router_mark);
+    Value module_val = NIL_VAL;
+    Value mt = NIL_VAL;
+    ObjString* module_name = copy_string("http", 4);
+    if ((table_get(&vm->modules, module_name, &module_val) && IS_TABLE(module_val)) ||
+        (table_get(&vm->globals, module_name, &module_val) && IS_TABLE(module_val))) {
+        ObjString* mt_name = copy_string("_router_mt", 10);
+        if (table_get(&AS_TABLE(module_val)->table, mt_name, &mt) && IS_TABLE(mt)) {
+            u->metatable = AS_TABLE(mt);
+        }
+    }
+    push(vm, OBJ_VAL(u));
+    return 1;
+}
+
+// router:add(method, path, value) -> true, or false when the method and
+// path already have a route (the earlier one is kept)
+static int http_router_add(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(4);
+    HttpRouter* router = http_router_from_userdata(vm, args[0]);
+    if (router == NULL) return 0;
+    ASSERT_STRING(1);
+    ASSERT_STRING(2);
+    ObjString* method = GET_STRING(1);
+    ObjString* path = GET_STRING(2);
+    if (method->length == 0 || method->length >= (int)sizeof(((RouteEntry*)0)->method)) {
+        vm_runtime_error(vm, "router.add: invalid method '%s'.", method->chars);
+        return 0;
+    }
+
+    RouteEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    for (int i = 0; i < method->length; i++) {
+        entry.method[i] = (char)toupper((unsigned char)method->chars[i]);
+    }
+    entry.value = args[3];
+
+    RouteNode* node = router->root;
+    const char* p = path->chars;
+    const char* end = p + path->length;
+    while (node != NULL) {
+        while (p < end && *p == '/') p++;
+        if (p == end) break;
+        const char* seg_end = p;
+        while (seg_end < end && *seg_end != '/') seg_end++;
+        int len = (int)(seg_end - p);
+
+        if (len >= 3 && p[0] == '<' && p[len - 1] == '>') {
+            if (entry.param_count == ROUTER_MAX_PARAMS) {
+                vm_runtime_error(vm, "router.add: more than %d parameters in '%s'.", ROUTER_MAX_PARAMS, path->chars);
+                return 0;
+            }
+            // On the stack until the entry is linked, where the mark hook
+            // finds it.
+            entry.params[entry.param_count] = copy_string(p + 1, len - 2);
+            push(vm, OBJ_VAL(entry.params[entry.param_count++]));
+            if (node->param == NULL) node->param = route_node_new(NULL, 0);
+            node = node->param;
+        } else {
+            node = route_static_child(node, p, len);
+        }
+        p = seg_end;
+    }
+
+    for (int i = 0; i < entry.param_count; i++) pop(vm);
+    RouteEntry* e = node != NULL ? (RouteEntry*)malloc(sizeof(RouteEntry)) : NULL;
+    if (e == NULL) {
+        vm_runtime_error(vm, "out of memory");
+        return 0;
+    }
+    for (RouteEntry* it = node->entries; it != NULL; it = it->next) {
+        if (strcmp(it->method, entry.method) == 0) {
+            free(e);
+            RETURN_FALSE;
+        }
+    }
+    *e = entry;
+    // Keep registration order, so a route added earlier is found first.
+    RouteEntry** link = &node->entries;
+    while (*link != NULL) link = &(*link)->next;
+    *link = e;
+    router->count++;
+    RETURN_TRUE;
+}
+
+// router:match(method, path) -> value, params|nil  or  nil, 404|405
+static int http_router_match(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    HttpRouter* router = http_router_from_userdata(vm, args[0]);
+    if (router == NULL) return 0;
+    ASSERT_STRING(1);
+    ASSERT_STRING(2);
+    ObjString* method = GET_STRING(1);
+    ObjString* path = GET_STRING(2);
+
+    RouteMatch m;
+    m.method = method->chars;
+    m.method_len = method->length;
+    m.saw_path = 0;
+    RouteEntry* e = route_find(router->root, path->chars, path->chars + path->length, &m, 0);
+    if (e == NULL) {
+        push(vm, NIL_VAL);
+        push(vm, NUMBER_VAL(m.saw_path ? 405 : 404));
+        return 2;
+    }
+
+    push(vm, e->value);
+    if (e->param_count == 0) {
+        push(vm, NIL_VAL);
+        return 2;
+    }
+    ObjTable* params = new_table();
+    push(vm, OBJ_VAL(params));
+    for (int i = 0; i < e->param_count; i++) {
+        ObjString* value = copy_string(m.caps[i], m.cap_lens[i]);
+        push(vm, OBJ_VAL(value));
+        table_set(&params->table, e->params[i], OBJ_VAL(value));
+        pop(vm);
+    }
+    return 2;
+}
+
+// router:count() -> number of routes
+static int http_router_count(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    HttpRouter* router = http_router_from_userdata(vm, args[0]);
+    if (router == NULL) return 0;
+    RETURN_NUMBER((double)router->count);
+}
+
+#ifndef TOI_WASM
+typedef struct {
+    char* host;
+    int port;
+    int use_tls;
+    char* target;
+} FetchUrl;
+
+static int fetch_table_get(ObjTable* table, const char* key, Value* out) {
+    ObjString* k = copy_string(key, (int)strlen(key));
+    return table_get(&table->table, k, out);
+}
+
+// The value of a header in a request headers table, matching the name
+// case-insensitively, or NULL.
+static ObjString* fetch_header_get(ObjTable* headers, const char* key) {
+    int key_len = (int)strlen(key);
+    for (int i = 0; i < headers->table.capacity; i++) {
+        Entry* entry = &headers->table.entries[i];
+        if (!IS_STRING(entry->key) || !IS_STRING(entry->value)) continue;
+        if (AS_STRING(entry->key)->length != key_len) continue;
+        int match = 1;
+        for (int j = 0; j < key_len; j++) {
+            char a = (char)tolower((unsigned char)AS_STRING(entry->key)->chars[j]);
+            char b = (char)tolower((unsigned char)key[j]);
+            if (a != b) {
+                match = 0;
+                break;
+            }
+        }
+        if (match) return AS_STRING(entry->value);
+    }
+    return NULL;
+}
+
+static int fetch_header_has(ObjTable* headers, const char* key) {
+    return fetch_header_get(headers, key) != NULL;
+}
+
+static int parse_fetch_url(const ObjString* input, FetchUrl* out, const char** err) {
+    const char* s = input->chars;
+    const char* end = s + input->length;
+    const char* scheme_end = strstr(s, "://");
+    if (scheme_end == NULL) {
+        *err = "URL must include scheme (http:// or https://)";
+        return 0;
+    }
+
+    int scheme_len = (int)(scheme_end - s);
+    if (scheme_len == 4 && memcmp(s, "http", 4) == 0) {
+        out->use_tls = 0;
+        out->port = 80;
+    } else if (scheme_len == 5 && memcmp(s, "https", 5) == 0) {
+        out->use_tls = 1;
+        out->port = 443;
+    } else {
+        *err = "unsupported URL scheme";
+        return 0;
     }
 
     const char* p = scheme_end + 3;
@@ -780,6 +1621,305 @@ static void free_fetch_url(FetchUrl* u) {
     u->target = NULL;
 }
 
+// --- Client connection pool ---
+//
+// Finished http.fetch and http.request exchanges leave their connection
+// here when the server allows keep-alive, and the next request to the
+// same scheme, host and port picks it up instead of connecting (and, for
+// https, handshaking) again. The pool belongs to the http module, so each
+// VM has its own.
+
+#define HTTP_POOL_MAX_PER_HOST 8
+#define HTTP_POOL_IDLE_TIMEOUT 30.0
+
+typedef struct HttpConn {
+    int fd;
+    char* host;
+    int port;
+    int use_tls;
+#ifdef TOI_HAVE_TLS
+    SSL_CTX* tls_ctx;
+    SSL* tls;
+#endif
+    double idle_since;
+    struct HttpConn* next;
+} HttpConn;
+
+typedef struct {
+    HttpConn* idle; // most recently released first
+    int max_per_host;
+    double idle_timeout;
+    double opened;
+    double reused;
+} HttpPool;
+
+static double http_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static HttpConn* http_conn_new(int fd, const FetchUrl* url) {
+    HttpConn* conn = (HttpConn*)calloc(1, sizeof(HttpConn));
+    if (conn == NULL) return NULL;
+    conn->host = (char*)malloc(strlen(url->host) + 1);
+    if (conn->host == NULL) {
+        free(conn);
+        return NULL;
+    }
+    strcpy(conn->host, url->host);
+    conn->fd = fd;
+    conn->port = url->port;
+    conn->use_tls = url->use_tls;
+    return conn;
+}
+
+static void http_conn_close(HttpConn* conn) {
+    if (conn == NULL) return;
+#ifdef TOI_HAVE_TLS
+    if (conn->tls != NULL) SSL_free(conn->tls);
+    if (conn->tls_ctx != NULL) SSL_CTX_free(conn->tls_ctx);
+#endif
+    if (conn->fd >= 0) close(conn->fd);
+    free(conn->host);
+    free(conn);
+}
+
+static int http_conn_matches(const HttpConn* conn, const FetchUrl* url) {
+    return conn->port == url->port && conn->use_tls == url->use_tls && strcmp(conn->host, url->host) == 0;
+}
+
+// Whether an idle connection can still carry a request: the server has
+// not closed it and, on plain connections, has not sent anything unasked.
+static int http_conn_alive(const HttpConn* conn) {
+    char byte;
+    ssize_t n = recv(conn->fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK;
+    // TLS connections may have session tickets waiting to be read.
+    return n > 0 && conn->use_tls;
+}
+
+static void http_pool_finalizer(void* ptr) {
+    HttpPool* pool = (HttpPool*)ptr;
+    if (pool == NULL) return;
+    while (pool->idle != NULL) {
+        HttpConn* next = pool->idle->next;
+        http_conn_close(pool->idle);
+        pool->idle = next;
+    }
+    free(pool);
+}
+
+static HttpPool* http_pool(VM* vm) {
+    ObjString* module_name = copy_string("http", 4);
+    Value module_val = NIL_VAL;
+    if ((!table_get(&vm->modules, module_name, &module_val) || !IS_TABLE(module_val)) &&
+        (!table_get(&vm->globals, module_name, &module_val) || !IS_TABLE(module_val))) {
+        return NULL;
+    }
+    ObjString* pool_name = copy_string("_pool", 5);
+    Value pool_val = NIL_VAL;
+    if (!table_get(&AS_TABLE(module_val)->table, pool_name, &pool_val) || !IS_USERDATA(pool_val)) {
+        return NULL;
+    }
+    return (HttpPool*)AS_USERDATA(pool_val)->data;
+}
+
+// Closes idle connections past the idle timeout.
+static void http_pool_expire(HttpPool* pool, double now) {
+    HttpConn** link = &pool->idle;
+    while (*link != NULL) {
+        HttpConn* conn = *link;
+        if (now - conn->idle_since > pool->idle_timeout) {
+            *link = conn->next;
+            http_conn_close(conn);
+        } else {
+            link = &conn->next;
+        }
+    }
+}
+
+// Takes an idle connection to the URL's origin out of the pool, or NULL.
+static HttpConn* http_pool_take(HttpPool* pool, const FetchUrl* url) {
+    if (pool == NULL) return NULL;
+    http_pool_expire(pool, http_now());
+    HttpConn** link = &pool->idle;
+    while (*link != NULL) {
+        HttpConn* conn = *link;
+        if (!http_conn_matches(conn, url)) {
+            link = &conn->next;
+            continue;
+        }
+        *link = conn->next;
+        conn->next = NULL;
+        if (http_conn_alive(conn)) {
+            pool->reused++;
+            return conn;
+        }
+        http_conn_close(conn);
+    }
+    return NULL;
+}
+
+// Returns a connection to the pool, or closes it when its origin already
+// has max_per_host idle connections.
+static void http_pool_put(HttpPool* pool, HttpConn* conn) {
+    if (pool == NULL) {
+        http_conn_close(conn);
+        return;
+    }
+    int same = 0;
+    for (HttpConn* it = pool->idle; it != NULL; it = it->next) {
+        if (it->port == conn->port && it->use_tls == conn->use_tls && strcmp(it->host, conn->host) == 0) {
+            same++;
+        }
+    }
+    if (same >= pool->max_per_host) {
+        http_conn_close(conn);
+        return;
+    }
+    conn->idle_since = http_now();
+    conn->next = pool->idle;
+    pool->idle = conn;
+}
+
+// http.pool([opts]) -> {idle, opened, reused, max_per_host, idle_timeout}
+static int http_pool_native(VM* vm, int arg_count, Value* args) {
+    HttpPool* pool = http_pool(vm);
+    if (pool == NULL) {
+        vm_runtime_error(vm, "http connection pool is not available.");
+        return 0;
+    }
+
+    if (arg_count >= 1 && IS_TABLE(args[0])) {
+        ObjTable* opts = GET_TABLE(0);
+        Value v;
+        if (fetch_table_get(opts, "max_per_host", &v) && IS_NUMBER(v)) {
+            pool->max_per_host = AS_NUMBER(v) < 0 ? 0 : (int)AS_NUMBER(v);
+        }
+        if (fetch_table_get(opts, "idle_timeout", &v) && IS_NUMBER(v)) {
+            pool->idle_timeout = AS_NUMBER(v) < 0 ? 0 : AS_NUMBER(v);
+        }
+        if (fetch_table_get(opts, "clear", &v) && IS_BOOL(v) && AS_BOOL(v)) {
+            while (pool->idle != NULL) {
+                HttpConn* next = pool->idle->next;
+                http_conn_close(pool->idle);
+                pool->idle = next;
+            }
+        }
+    }
+    http_pool_expire(pool, http_now());
+
+    int idle = 0;
+    for (HttpConn* it = pool->idle; it != NULL; it = it->next) idle++;
+
+    ObjTable* stats = new_table();
+    push(vm, OBJ_VAL(stats));
+    const char* keys[] = {"idle", "opened", "reused", "max_per_host", "idle_timeout"};
+    double values[] = {(double)idle, pool->opened, pool->reused, (double)pool->max_per_host, pool->idle_timeout};
+    for (int i = 0; i < 5; i++) {
+        ObjString* key = copy_string(keys[i], (int)strlen(keys[i]));
+        push(vm, OBJ_VAL(key));
+        table_set(&stats->table, key, NUMBER_VAL(values[i]));
+        pop(vm);
+    }
+    return 1;
+}
+
+// How much of a response has arrived, judged by its framing.
+typedef struct {
+    size_t total;   // bytes in the whole response, once known
+    int until_close; // no length: the body ends when the server closes
+    int keep_alive; // the connection can carry another request
+} ResponseFrame;
+
+// Returns 1 when buf holds the whole response, 0 when more is needed and
+// -1 when the framing is malformed. A response that ends at close never
+// completes here; its reader stops at end of stream.
+static int response_frame(const char* buf, size_t len, int head_request, ResponseFrame* frame) {
+    const char* end = buf + len;
+    const char* line_end = find_crlf(buf, end);
+    if (line_end == NULL) return 0;
+
+    int http11 = line_end - buf >= 8 && memcmp(buf, "HTTP/1.1", 8) == 0;
+    const char* p = buf;
+    while (p < line_end && *p != ' ') p++;
+    int status = 0;
+    if (p < line_end) status = atoi(p + 1);
+
+    int content_length = -1;
+    int chunked = 0;
+    int conn_close = 0;
+    int conn_keep_alive = 0;
+    p = line_end + 2;
+    while (1) {
+        line_end = find_crlf(p, end);
+        if (line_end == NULL) return 0;
+        if (line_end == p) {
+            p += 2;
+            break;
+        }
+        const char* colon = memchr(p, ':', (size_t)(line_end - p));
+        if (colon) {
+            int name_len = (int)(colon - p);
+            const char* val = colon + 1;
+            while (val < line_end && isspace((unsigned char)*val)) val++;
+            int val_len = (int)(line_end - val);
+            if (name_is_ci(p, name_len, "content-length")) {
+                if (!parse_content_length(val, val_len, &content_length)) return -1;
+            } else if (name_is_ci(p, name_len, "transfer-encoding")) {
+                chunked = has_csv_token_ci(val, val_len, "chunked");
+            } else if (name_is_ci(p, name_len, "connection")) {
+                conn_close = has_csv_token_ci(val, val_len, "close");
+                conn_keep_alive = has_csv_token_ci(val, val_len, "keep-alive");
+            }
+        }
+        p = line_end + 2;
+    }
+
+    frame->until_close = 0;
+    frame->keep_alive = !conn_close && (http11 || conn_keep_alive);
+    if (head_request || status == 204 || status == 304 || (status >= 100 && status < 200)) {
+        frame->total = (size_t)(p - buf);
+        return 1;
+    }
+    if (chunked) {
+        // Skip from size line to size line; chunk data is not scanned.
+        while (1) {
+            line_end = find_crlf(p, end);
+            if (line_end == NULL) return 0;
+            int size = parse_chunk_size(p, line_end);
+            if (size < 0) return -1;
+            p = line_end + 2;
+            if (size == 0) break;
+            if ((size_t)(end - p) < (size_t)size + 2) return 0;
+            p += size;
+            if (p[0] != '\r' || p[1] != '\n') return -1;
+            p += 2;
+        }
+        // Trailers, up to the blank line.
+        while (1) {
+            line_end = find_crlf(p, end);
+            if (line_end == NULL) return 0;
+            if (line_end == p) {
+                p += 2;
+                break;
+            }
+            p = line_end + 2;
+        }
+        frame->total = (size_t)(p - buf);
+        return 1;
+    }
+    if (content_length >= 0) {
+        if ((size_t)(end - p) < (size_t)content_length) return 0;
+        frame->total = (size_t)(p - buf) + (size_t)content_length;
+        return 1;
+    }
+    frame->until_close = 1;
+    frame->keep_alive = 0;
+    return 0;
+}
+
 typedef enum {
     HTTP_REQ_CONNECTING = 1,
     HTTP_REQ_SENDING = 2,
@@ -799,6 +1939,12 @@ typedef struct {
     char* resp_buf;
     size_t resp_len;
     size_t resp_cap;
+    FetchUrl url;
+    int head_request;
+    int keep_alive;
+    int reused; // fd came from the pool and has not answered yet
+    int may_retry;
+    ResponseFrame frame;
     char err[256];
 } HttpRequest;
 
@@ -825,6 +1971,7 @@ static void http_request_cleanup(HttpRequest* req) {
         free(req->resp_buf);
         req->resp_buf = NULL;
     }
+    free_fetch_url(&req->url);
     req->req_len = 0;
     req->req_sent = 0;
     req->resp_len = 0;
@@ -877,24 +2024,27 @@ static int build_http_request(
     ObjTable* headers,
     const char* body,
     int body_len,
+    int keep_alive,
     char** out_req,
     size_t* out_len) {
     int has_host = headers != NULL && fetch_header_has(headers, "host");
     int has_conn = headers != NULL && fetch_header_has(headers, "connection");
     int has_clen = headers != NULL && fetch_header_has(headers, "content-length");
+    // HTTP/1.1 connections stay open unless a side says otherwise.
+    int add_close = !has_conn && !keep_alive;
 
     size_t req_len = (size_t)method_len + 1 + strlen(url->target) + 11;
     req_len += 2;
     req_len += has_host ? 0 : strlen("Host: \r\n") + strlen(url->host) + 8;
-    req_len += has_conn ? 0 : strlen("Connection: close\r\n");
+    req_len += add_close ? strlen("Connection: close\r\n") : 0;
     req_len += body_len > 0 && !has_clen ? strlen("Content-Length: \r\n") + 20 : 0;
 
     if (headers != NULL) {
         for (int i = 0; i < headers->table.capacity; i++) {
             Entry* entry = &headers->table.entries[i];
-            if (entry->key == NULL || !IS_STRING(entry->value)) continue;
+            if (!IS_STRING(entry->key) || !IS_STRING(entry->value)) continue;
             ObjString* v = AS_STRING(entry->value);
-            req_len += (size_t)entry->key->length + 2 + (size_t)v->length + 2;
+            req_len += (size_t)AS_STRING(entry->key)->length + 2 + (size_t)v->length + 2;
         }
     }
     req_len += (size_t)body_len;
@@ -905,10 +2055,14 @@ static int build_http_request(
     int n = snprintf(req, req_len + 1, "%.*s %s HTTP/1.1\r\n", method_len, method, url->target);
     size_t off = (size_t)n;
     if (!has_host) {
-        n = snprintf(req + off, req_len + 1 - off, "Host: %s:%d\r\n", url->host, url->port);
+        if ((url->use_tls && url->port != 443) || (!url->use_tls && url->port != 80)) {
+            n = snprintf(req + off, req_len + 1 - off, "Host: %s:%d\r\n", url->host, url->port);
+        } else {
+            n = snprintf(req + off, req_len + 1 - off, "Host: %s\r\n", url->host);
+        }
         off += (size_t)n;
     }
-    if (!has_conn) {
+    if (add_close) {
         n = snprintf(req + off, req_len + 1 - off, "Connection: close\r\n");
         off += (size_t)n;
     }
@@ -919,10 +2073,10 @@ static int build_http_request(
     if (headers != NULL) {
         for (int i = 0; i < headers->table.capacity; i++) {
             Entry* entry = &headers->table.entries[i];
-            if (entry->key == NULL || !IS_STRING(entry->value)) continue;
+            if (!IS_STRING(entry->key) || !IS_STRING(entry->value)) continue;
             ObjString* v = AS_STRING(entry->value);
-            memcpy(req + off, entry->key->chars, (size_t)entry->key->length);
-            off += (size_t)entry->key->length;
+            memcpy(req + off, AS_STRING(entry->key)->chars, (size_t)AS_STRING(entry->key)->length);
+            off += (size_t)AS_STRING(entry->key)->length;
             memcpy(req + off, ": ", 2);
             off += 2;
             memcpy(req + off, v->chars, (size_t)v->length);
@@ -996,7 +2150,10 @@ static int socket_connect_host_nonblocking(const char* host, int port, int* out_
     return 1;
 }
 
-static int parse_http_response_table(VM* vm, const char* src, int len, const char** err) {
+// Pushes {status, version, reason, headers, body, consumed} for a whole
+// response. Responses to HEAD requests have no body whatever their
+// headers say.
+static int parse_http_response_table(VM* vm, const char* src, int len, int head_request, const char** err) {
     const char* src_end = src + len;
     const char* line_end = find_crlf(src, src_end);
     if (!line_end) {
@@ -1131,7 +2288,9 @@ static int parse_http_response_table(VM* vm, const char* src, int len, const cha
     char* chunked_body = NULL;
     int chunked_consumed = 0;
 
-    if (transfer_chunked) {
+    if (head_request) {
+        body_len = 0;
+    } else if (transfer_chunked) {
         int chunk_status = decode_chunked_body(p, src_end, &chunked_body, &body_len, &chunked_consumed);
         if (chunk_status <= 0) {
             pop(vm);
@@ -1201,21 +2360,216 @@ static int socket_connect_host(const char* host, int port, int timeout_ms, int*
             setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
         }
 
-        if (connect(fd, it->ai_addr, it->ai_addrlen) == 0) {
-            break;
+        if (connect(fd, it->ai_addr, it->ai_addrlen) == 0) {
+            break;
+        }
+        close(fd);
+        fd = -1;
+    }
+
+    freeaddrinfo(res);
+
+    if (fd < 0) {
+        *err = "connect failed";
+        return 0;
+    }
+
+    *out_fd = fd;
+    return 1;
+}
+
+// Methods that can be sent again when a pooled connection turns out to
+// have been closed by the server before it answered.
+static int method_is_idempotent(const char* method, int method_len) {
+    const char* names[] = {"get", "head", "put", "delete", "options", "trace"};
+    for (int i = 0; i < 6; i++) {
+        if (name_is_ci(method, method_len, names[i])) return 1;
+    }
+    return 0;
+}
+
+// Whether a request may leave its connection open: keep_alive was not
+// turned off and the caller's headers do not ask to close.
+static int fetch_keep_alive(ObjTable* options, ObjTable* headers) {
+    Value v;
+    if (options != NULL && fetch_table_get(options, "keep_alive", &v) && IS_BOOL(v) && !AS_BOOL(v)) {
+        return 0;
+    }
+    ObjString* conn = headers != NULL ? fetch_header_get(headers, "connection") : NULL;
+    return conn == NULL || !has_csv_token_ci(conn->chars, conn->length, "close");
+}
+
+static void fetch_set_timeouts(int fd, int timeout_ms) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags >= 0 && (flags & O_NONBLOCK)) fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+    struct timeval tv;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+// Opens a blocking connection to the URL's origin, with the TLS handshake
+// for https. Runs without the VM lock.
+static HttpConn* fetch_connect(const FetchUrl* url, int timeout_ms, int verify_tls, const char** err) {
+    int fd = -1;
+    if (!socket_connect_host(url->host, url->port, timeout_ms, &fd, err)) return NULL;
+    HttpConn* conn = http_conn_new(fd, url);
+    if (conn == NULL) {
+        close(fd);
+        *err = "out of memory";
+        return NULL;
+    }
+    if (!url->use_tls) return conn;
+
+#ifdef TOI_HAVE_TLS
+    SSL_library_init();
+    SSL_load_error_strings();
+    OpenSSL_add_ssl_algorithms();
+
+    conn->tls_ctx = SSL_CTX_new(TLS_client_method());
+    if (conn->tls_ctx == NULL) {
+        http_conn_close(conn);
+        *err = "failed to create TLS context";
+        return NULL;
+    }
+    if (verify_tls) {
+        SSL_CTX_set_verify(conn->tls_ctx, SSL_VERIFY_PEER, NULL);
+        if (SSL_CTX_set_default_verify_paths(conn->tls_ctx) != 1) {
+            http_conn_close(conn);
+            *err = "failed to load system CA certs";
+            return NULL;
+        }
+    } else {
+        SSL_CTX_set_verify(conn->tls_ctx, SSL_VERIFY_NONE, NULL);
+    }
+
+    conn->tls = SSL_new(conn->tls_ctx);
+    if (conn->tls == NULL) {
+        http_conn_close(conn);
+        *err = "failed to create TLS handle";
+        return NULL;
+    }
+    SSL_set_fd(conn->tls, fd);
+    SSL_set_tlsext_host_name(conn->tls, url->host);
+    if (SSL_connect(conn->tls) != 1) {
+        http_conn_close(conn);
+        *err = "TLS handshake failed";
+        return NULL;
+    }
+    return conn;
+#else
+    (void)verify_tls;
+    http_conn_close(conn);
+    *err = "https unsupported (built without TLS)";
+    return NULL;
+#endif
+}
+
+// Sends a request on a blocking connection and reads until the response's
+// framing says it is complete, or the server closes. Runs without the VM
+// lock. Returns 1 with the response in *out, or 0 with *err set;
+// *got_response says whether any of the response arrived.
+static int fetch_exchange(HttpConn* conn, const char* req, size_t req_len, int head_request,
+                          char** out, size_t* out_len, ResponseFrame* frame,
+                          int* got_response, const char** err) {
+    *got_response = 0;
+    size_t sent_total = 0;
+    while (sent_total < req_len) {
+        ssize_t sent;
+#ifdef TOI_HAVE_TLS
+        if (conn->tls != NULL) {
+            sent = SSL_write(conn->tls, req + sent_total, (int)(req_len - sent_total));
+            if (sent <= 0) {
+                *err = "send failed";
+                return 0;
+            }
+        } else
+#endif
+        {
+            sent = send(conn->fd, req + sent_total, req_len - sent_total, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) continue;
+                *err = "send failed";
+                return 0;
+            }
+        }
+        sent_total += (size_t)sent;
+    }
+
+    size_t cap = 16384;
+    size_t len = 0;
+    char* resp = (char*)malloc(cap);
+    if (resp == NULL) {
+        *err = "out of memory";
+        return 0;
+    }
+
+    frame->keep_alive = 0;
+    frame->until_close = 0;
+    while (1) {
+        if (len + 16384 + 1 > cap) {
+            char* grown = (char*)realloc(resp, cap * 2);
+            if (grown == NULL) {
+                free(resp);
+                *err = "out of memory";
+                return 0;
+            }
+            resp = grown;
+            cap *= 2;
+        }
+
+        ssize_t received;
+#ifdef TOI_HAVE_TLS
+        if (conn->tls != NULL) {
+            received = SSL_read(conn->tls, resp + len, 16384);
+            if (received <= 0) {
+                int ssl_err = SSL_get_error(conn->tls, (int)received);
+                if (ssl_err == SSL_ERROR_ZERO_RETURN || (received == 0 && ssl_err == SSL_ERROR_SYSCALL)) {
+                    received = 0;
+                } else {
+                    free(resp);
+                    *err = ssl_err == SSL_ERROR_WANT_READ ? "timeout" : "recv failed";
+                    return 0;
+                }
+            }
+        } else
+#endif
+        {
+            received = recv(conn->fd, resp + len, 16384, 0);
+            if (received < 0) {
+                if (errno == EINTR) continue;
+                free(resp);
+                *err = (errno == EAGAIN || errno == EWOULDBLOCK) ? "timeout" : "recv failed";
+                return 0;
+            }
         }
-        close(fd);
-        fd = -1;
-    }
 
-    freeaddrinfo(res);
+        if (received == 0) {
+            // The server closed: whatever arrived is the response.
+            if (len == 0) {
+                free(resp);
+                *err = "connection closed";
+                return 0;
+            }
+            frame->keep_alive = 0;
+            frame->total = len;
+            break;
+        }
 
-    if (fd < 0) {
-        *err = "connect failed";
-        return 0;
+        len += (size_t)received;
+        *got_response = 1;
+        int status = response_frame(resp, len, head_request, frame);
+        if (status < 0) {
+            free(resp);
+            *err = "invalid HTTP response";
+            return 0;
+        }
+        if (status > 0) break;
     }
 
-    *out_fd = fd;
+    *out = resp;
+    *out_len = frame->total;
     return 1;
 }
 
@@ -1269,274 +2623,65 @@ static int http_fetch(VM* vm, int arg_count, Value* args) {
         return 2;
     }
 
-    int fd = -1;
-    if (!socket_connect_host(url.host, url.port, timeout_ms, &fd, &err)) {
+    int keep_alive = fetch_keep_alive(options, headers);
+    int head_request = name_is_ci(method, method_len, "head");
+    int may_retry = method_is_idempotent(method, method_len);
+    char* req = NULL;
+    size_t req_len = 0;
+    if (!build_http_request(&url, method, method_len, headers, body, body_len, keep_alive, &req, &req_len)) {
         free_fetch_url(&url);
         push(vm, NIL_VAL);
-        push(vm, OBJ_VAL(copy_string(err, (int)strlen(err))));
+        push(vm, OBJ_VAL(copy_string("out of memory", 13)));
         return 2;
     }
 
-#ifdef TOI_HAVE_TLS
-    SSL_CTX* tls_ctx = NULL;
-    SSL* tls = NULL;
-#endif
-
-    if (url.use_tls) {
-#ifdef TOI_HAVE_TLS
-        SSL_library_init();
-        SSL_load_error_strings();
-        OpenSSL_add_ssl_algorithms();
+    HttpPool* pool = http_pool(vm);
+    HttpConn* conn = keep_alive ? http_pool_take(pool, &url) : NULL;
+    int reused = conn != NULL;
+    int opened = 0;
+    int ok = 0;
+    char* resp = NULL;
+    size_t resp_len = 0;
+    ResponseFrame frame = {0};
 
-        tls_ctx = SSL_CTX_new(TLS_client_method());
-        if (tls_ctx == NULL) {
-            close(fd);
-            free_fetch_url(&url);
-            push(vm, NIL_VAL);
-            push(vm, OBJ_VAL(copy_string("failed to create TLS context", 28)));
-            return 2;
-        }
-        if (verify_tls) {
-            SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_PEER, NULL);
-            if (SSL_CTX_set_default_verify_paths(tls_ctx) != 1) {
-                SSL_CTX_free(tls_ctx);
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("failed to load system CA certs", 30)));
-                return 2;
-            }
+    // Other threads run while this one waits on the network.
+    ObjThread* caller = vm->blocking_begin != NULL ? vm->blocking_begin(vm) : NULL;
+    while (1) {
+        if (conn == NULL) {
+            conn = fetch_connect(&url, timeout_ms, verify_tls, &err);
+            if (conn == NULL) break;
+            opened++;
         } else {
-            SSL_CTX_set_verify(tls_ctx, SSL_VERIFY_NONE, NULL);
-        }
-
-        tls = SSL_new(tls_ctx);
-        if (tls == NULL) {
-            SSL_CTX_free(tls_ctx);
-            close(fd);
-            free_fetch_url(&url);
-            push(vm, NIL_VAL);
-            push(vm, OBJ_VAL(copy_string("failed to create TLS handle", 27)));
-            return 2;
-        }
-        SSL_set_fd(tls, fd);
-        SSL_set_tlsext_host_name(tls, url.host);
-        if (SSL_connect(tls) != 1) {
-            SSL_free(tls);
-            SSL_CTX_free(tls_ctx);
-            close(fd);
-            free_fetch_url(&url);
-            push(vm, NIL_VAL);
-            push(vm, OBJ_VAL(copy_string("TLS handshake failed", 20)));
-            return 2;
-        }
-#else
-        close(fd);
-        free_fetch_url(&url);
-        push(vm, NIL_VAL);
-        push(vm, OBJ_VAL(copy_string("https unsupported (built without TLS)", 36)));
-        return 2;
-#endif
-    }
-
-    int has_host = headers != NULL && fetch_header_has(headers, "host");
-    int has_conn = headers != NULL && fetch_header_has(headers, "connection");
-    int has_clen = headers != NULL && fetch_header_has(headers, "content-length");
-
-    size_t req_len = (size_t)method_len + 1 + strlen(url.target) + 11;
-    req_len += 2;
-    req_len += has_host ? 0 : strlen("Host: \r\n") + strlen(url.host) + 8;
-    req_len += has_conn ? 0 : strlen("Connection: close\r\n");
-    req_len += body_len > 0 && !has_clen ? strlen("Content-Length: \r\n") + 20 : 0;
-
-    if (headers != NULL) {
-        for (int i = 0; i < headers->table.capacity; i++) {
-            Entry* entry = &headers->table.entries[i];
-            if (entry->key == NULL || !IS_STRING(entry->value)) continue;
-            ObjString* v = AS_STRING(entry->value);
-            req_len += (size_t)entry->key->length + 2 + (size_t)v->length + 2;
+            fetch_set_timeouts(conn->fd, timeout_ms);
         }
-    }
-    req_len += (size_t)body_len;
-
-    char* req = (char*)malloc(req_len + 1);
-    if (req == NULL) {
-#ifdef TOI_HAVE_TLS
-        if (tls != NULL) SSL_free(tls);
-        if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-        close(fd);
-        free_fetch_url(&url);
-        push(vm, NIL_VAL);
-        push(vm, OBJ_VAL(copy_string("out of memory", 13)));
-        return 2;
-    }
 
-    int n = snprintf(req, req_len + 1, "%.*s %s HTTP/1.1\r\n", method_len, method, url.target);
-    size_t off = (size_t)n;
-    if (!has_host) {
-        if ((url.use_tls && url.port != 443) || (!url.use_tls && url.port != 80)) {
-            n = snprintf(req + off, req_len + 1 - off, "Host: %s:%d\r\n", url.host, url.port);
-        } else {
-            n = snprintf(req + off, req_len + 1 - off, "Host: %s\r\n", url.host);
-        }
-        off += (size_t)n;
-    }
-    if (!has_conn) {
-        n = snprintf(req + off, req_len + 1 - off, "Connection: close\r\n");
-        off += (size_t)n;
-    }
-    if (body_len > 0 && !has_clen) {
-        n = snprintf(req + off, req_len + 1 - off, "Content-Length: %d\r\n", body_len);
-        off += (size_t)n;
-    }
-    if (headers != NULL) {
-        for (int i = 0; i < headers->table.capacity; i++) {
-            Entry* entry = &headers->table.entries[i];
-            if (entry->key == NULL || !IS_STRING(entry->value)) continue;
-            ObjString* v = AS_STRING(entry->value);
-            memcpy(req + off, entry->key->chars, (size_t)entry->key->length);
-            off += (size_t)entry->key->length;
-            memcpy(req + off, ": ", 2);
-            off += 2;
-            memcpy(req + off, v->chars, (size_t)v->length);
-            off += (size_t)v->length;
-            memcpy(req + off, "\r\n", 2);
-            off += 2;
-        }
-    }
-    memcpy(req + off, "\r\n", 2);
-    off += 2;
-    if (body_len > 0) {
-        memcpy(req + off, body, (size_t)body_len);
-        off += (size_t)body_len;
+        int got_response = 0;
+        ok = fetch_exchange(conn, req, req_len, head_request, &resp, &resp_len, &frame, &got_response, &err);
+        if (ok) break;
+        http_conn_close(conn);
+        conn = NULL;
+        // A pooled connection the server already closed: try a new one.
+        if (!reused || got_response || !may_retry) break;
+        reused = 0;
     }
-    req[off] = '\0';
+    if (vm->blocking_end != NULL) vm->blocking_end(vm, caller);
 
-    size_t sent_total = 0;
-    while (sent_total < off) {
-        int sent = 0;
-#ifdef TOI_HAVE_TLS
-        if (tls != NULL) {
-            sent = SSL_write(tls, req + sent_total, (int)(off - sent_total));
-            if (sent <= 0) {
-                int ssl_err = SSL_get_error(tls, sent);
-                if (ssl_err == SSL_ERROR_WANT_READ || ssl_err == SSL_ERROR_WANT_WRITE) continue;
-                free(req);
-                SSL_free(tls);
-                SSL_CTX_free(tls_ctx);
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("send failed", 11)));
-                return 2;
-            }
-        } else
-#endif
-        {
-            sent = (int)send(fd, req + sent_total, off - sent_total, 0);
-            if (sent < 0) {
-                if (errno == EINTR) continue;
-                free(req);
-#ifdef TOI_HAVE_TLS
-                if (tls != NULL) SSL_free(tls);
-                if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("send failed", 11)));
-                return 2;
-            }
-        }
-        sent_total += (size_t)sent;
-    }
     free(req);
-
-    size_t cap = 8192;
-    size_t len = 0;
-    char* resp = (char*)malloc(cap);
-    if (resp == NULL) {
-#ifdef TOI_HAVE_TLS
-        if (tls != NULL) SSL_free(tls);
-        if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-        close(fd);
-        free_fetch_url(&url);
+    free_fetch_url(&url);
+    if (pool != NULL) pool->opened += opened;
+    if (!ok) {
         push(vm, NIL_VAL);
-        push(vm, OBJ_VAL(copy_string("out of memory", 13)));
+        push(vm, OBJ_VAL(copy_string(err, (int)strlen(err))));
         return 2;
     }
-
-    while (1) {
-        if (len + 4096 + 1 > cap) {
-            size_t next = cap * 2;
-            char* grown = (char*)realloc(resp, next);
-            if (grown == NULL) {
-                free(resp);
-#ifdef TOI_HAVE_TLS
-                if (tls != NULL) SSL_free(tls);
-                if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("out of memory", 13)));
-                return 2;
-            }
-            resp = grown;
-            cap = next;
-        }
-
-        int received = 0;
-#ifdef TOI_HAVE_TLS
-        if (tls != NULL) {
-            received = SSL_read(tls, resp + len, 4096);
-            if (received <= 0) {
-                int ssl_err = SSL_get_error(tls, received);
-                if (ssl_err == SSL_ERROR_ZERO_RETURN) break;
-                if (ssl_err == SSL_ERROR_WANT_READ || ssl_err == SSL_ERROR_WANT_WRITE) continue;
-                free(resp);
-                SSL_free(tls);
-                SSL_CTX_free(tls_ctx);
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("recv failed", 11)));
-                return 2;
-            }
-        } else
-#endif
-        {
-            received = (int)recv(fd, resp + len, 4096, 0);
-            if (received == 0) break;
-            if (received < 0) {
-                if (errno == EINTR) continue;
-                free(resp);
-#ifdef TOI_HAVE_TLS
-                if (tls != NULL) SSL_free(tls);
-                if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-                close(fd);
-                free_fetch_url(&url);
-                push(vm, NIL_VAL);
-                push(vm, OBJ_VAL(copy_string("recv failed", 11)));
-                return 2;
-            }
-        }
-
-        len += (size_t)received;
+    if (keep_alive && frame.keep_alive) {
+        http_pool_put(pool, conn);
+    } else {
+        http_conn_close(conn);
     }
 
-#ifdef TOI_HAVE_TLS
-    if (tls != NULL) SSL_free(tls);
-    if (tls_ctx != NULL) SSL_CTX_free(tls_ctx);
-#endif
-    close(fd);
-    free_fetch_url(&url);
-
     const char* parse_err = NULL;
-    int ok = parse_http_response_table(vm, resp, (int)len, &parse_err);
+    ok = parse_http_response_table(vm, resp, (int)resp_len, head_request, &parse_err);
     free(resp);
     if (!ok) {
         push(vm, NIL_VAL);
@@ -1607,36 +2752,53 @@ static int http_request(VM* vm, int arg_count, Value* args) {
         return 2;
     }
 
+    int keep_alive = fetch_keep_alive(options, headers);
     char* req_buf = NULL;
     size_t req_len = 0;
-    if (!build_http_request(&url, method, method_len, headers, body, body_len, &req_buf, &req_len)) {
+    if (!build_http_request(&url, method, method_len, headers, body, body_len, keep_alive, &req_buf, &req_len)) {
         free_fetch_url(&url);
         push(vm, NIL_VAL);
         push(vm, OBJ_VAL(copy_string("out of memory", 13)));
         return 2;
     }
 
+    HttpPool* pool = http_pool(vm);
+    HttpConn* conn = keep_alive ? http_pool_take(pool, &url) : NULL;
     int fd = -1;
     int connecting = 0;
-    if (!socket_connect_host_nonblocking(url.host, url.port, &fd, &connecting, &err)) {
-        free(req_buf);
-        free_fetch_url(&url);
-        push(vm, NIL_VAL);
-        push(vm, OBJ_VAL(copy_string(err, (int)strlen(err))));
-        return 2;
+    if (conn != NULL && set_nonblocking_fd(conn->fd, &err)) {
+        fd = conn->fd;
+        conn->fd = -1;
+    }
+    http_conn_close(conn);
+    int reused = fd >= 0;
+    if (!reused) {
+        if (!socket_connect_host_nonblocking(url.host, url.port, &fd, &connecting, &err)) {
+            free(req_buf);
+            free_fetch_url(&url);
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string(err, (int)strlen(err))));
+            return 2;
+        }
+        if (pool != NULL) pool->opened++;
     }
-    free_fetch_url(&url);
 
     HttpRequest* req = (HttpRequest*)malloc(sizeof(HttpRequest));
     if (req == NULL) {
         close(fd);
         free(req_buf);
+        free_fetch_url(&url);
         push(vm, NIL_VAL);
         push(vm, OBJ_VAL(copy_string("out of memory", 13)));
         return 2;
     }
     memset(req, 0, sizeof(HttpRequest));
     req->fd = fd;
+    req->url = url;
+    req->head_request = name_is_ci(method, method_len, "head");
+    req->keep_alive = keep_alive;
+    req->reused = reused;
+    req->may_retry = method_is_idempotent(method, method_len);
     req->state = connecting ? HTTP_REQ_CONNECTING : HTTP_REQ_SENDING;
     req->want_read = 0;
     req->want_write = 1;
@@ -1699,6 +2861,30 @@ static int http_request_close(VM* vm, int arg_count, Value* args) {
     RETURN_TRUE;
 }
 
+// A pooled connection failed before any of the response arrived; the
+// server most likely closed it while idle. Idempotent requests start over
+// on a new connection; returns 0 when that is not allowed or fails.
+static int http_request_retry(VM* vm, HttpRequest* req) {
+    if (!req->reused || !req->may_retry || req->resp_len > 0) return 0;
+    close(req->fd);
+    req->fd = -1;
+    req->reused = 0;
+
+    int connecting = 0;
+    const char* err = NULL;
+    if (!socket_connect_host_nonblocking(req->url.host, req->url.port, &req->fd, &connecting, &err)) {
+        http_request_set_error(req, err);
+        return 1;
+    }
+    HttpPool* pool = http_pool(vm);
+    if (pool != NULL) pool->opened++;
+    req->req_sent = 0;
+    req->state = connecting ? HTTP_REQ_CONNECTING : HTTP_REQ_SENDING;
+    req->want_read = 0;
+    req->want_write = 1;
+    return 1;
+}
+
 // req:step() -> done, res|nil, err|nil
 static int http_request_step(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_GE(1);
@@ -1734,7 +2920,7 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
 
     if (req->state == HTTP_REQ_SENDING) {
         while (req->req_sent < req->req_len) {
-            ssize_t sent = send(req->fd, req->req_buf + req->req_sent, req->req_len - req->req_sent, 0);
+            ssize_t sent = send(req->fd, req->req_buf + req->req_sent, req->req_len - req->req_sent, MSG_NOSIGNAL);
             if (sent > 0) {
                 req->req_sent += (size_t)sent;
                 continue;
@@ -1745,7 +2931,7 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
                 break;
             }
             if (sent < 0 && errno == EINTR) continue;
-            http_request_set_error(req, "send failed");
+            if (!http_request_retry(vm, req)) http_request_set_error(req, "send failed");
             break;
         }
 
@@ -1772,9 +2958,23 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
             ssize_t received = recv(req->fd, req->resp_buf + req->resp_len, 4096, 0);
             if (received > 0) {
                 req->resp_len += (size_t)received;
+                int status = response_frame(req->resp_buf, req->resp_len, req->head_request, &req->frame);
+                if (status < 0) {
+                    http_request_set_error(req, "invalid HTTP response");
+                    break;
+                }
+                if (status > 0) {
+                    req->state = HTTP_REQ_DONE;
+                    req->want_read = 0;
+                    req->want_write = 0;
+                    break;
+                }
                 continue;
             }
             if (received == 0) {
+                if (http_request_retry(vm, req)) break;
+                req->frame.total = req->resp_len;
+                req->frame.keep_alive = 0;
                 req->state = HTTP_REQ_DONE;
                 req->want_read = 0;
                 req->want_write = 0;
@@ -1786,7 +2986,7 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
                 break;
             }
             if (errno == EINTR) continue;
-            http_request_set_error(req, "recv failed");
+            if (!http_request_retry(vm, req)) http_request_set_error(req, "recv failed");
             break;
         }
     }
@@ -1799,8 +2999,17 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
     }
 
     if (req->state == HTTP_REQ_DONE) {
+        if (req->keep_alive && req->frame.keep_alive) {
+            HttpConn* conn = http_conn_new(req->fd, &req->url);
+            if (conn != NULL) {
+                http_pool_put(http_pool(vm), conn);
+                req->fd = -1;
+            }
+        }
+        // The response is only parsed once; later steps report done.
         const char* parse_err = NULL;
-        int ok = parse_http_response_table(vm, req->resp_buf, (int)req->resp_len, &parse_err);
+        int ok = parse_http_response_table(vm, req->resp_buf, (int)req->frame.total, req->head_request, &parse_err);
+        http_request_cleanup(req);
         if (!ok) {
             push(vm, BOOL_VAL(1));
             push(vm, NIL_VAL);
@@ -1822,26 +3031,84 @@ static int http_request_step(VM* vm, int arg_count, Value* args) {
 }
 #endif
 
+// Builds a metatable of self methods named `type_name` and stores it in
+// the module under `key`.
+static void register_method_table(VM* vm, ObjTable* module, const char* key,
+                                  const char* type_name, const NativeReg* methods) {
+    ObjTable* mt = new_table();
+    push(vm, OBJ_VAL(mt));
+
+    for (int i = 0; methods[i].name != NULL; i++) {
+        ObjString* name_str = copy_string(methods[i].name, (int)strlen(methods[i].name));
+        push(vm, OBJ_VAL(name_str));
+        ObjNative* method = new_native(methods[i].function, name_str);
+        method->is_self = 1;
+        push(vm, OBJ_VAL(method));
+        table_set(&mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+        pop(vm);
+        pop(vm);
+    }
+
+    push(vm, OBJ_VAL(copy_string("__index", 7)));
+    push(vm, OBJ_VAL(mt));
+    table_set(&mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+
+    push(vm, OBJ_VAL(copy_string("__name", 6)));
+    push(vm, OBJ_VAL(copy_string(type_name, (int)strlen(type_name))));
+    table_set(&mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+
+    push(vm, OBJ_VAL(copy_string(key, (int)strlen(key))));
+    push(vm, OBJ_VAL(mt));
+    table_set(&module->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+    pop(vm); // mt
+}
+
 void register_http(VM* vm) {
     const NativeReg http_funcs[] = {
         {"parse", http_parse},
+        {"parser", http_parser_new},
+        {"router", http_router_new},
         {"response", http_response},
+        {"response_parts", http_response_parts},
         {"urldecode", http_urldecode},
         {"parsequery", http_parsequery},
 #ifndef TOI_WASM
         {"fetch", http_fetch},
         {"request", http_request},
+        {"pool", http_pool_native},
 #endif
         {NULL, NULL}
     };
 
     register_module(vm, "http", http_funcs);
-#ifndef TOI_WASM
     ObjTable* http_module = AS_TABLE(peek(vm, 0));
 
-    ObjTable* request_mt = new_table();
-    push(vm, OBJ_VAL(request_mt));
+    const NativeReg parser_methods[] = {
+        {"feed", http_parser_feed},
+        {"body", http_parser_body},
+        {"pending", http_parser_pending},
+#ifndef TOI_WASM
+        {"recv", http_parser_recv},
+#endif
+        {NULL, NULL}
+    };
+    register_method_table(vm, http_module, "_parser_mt", "http.parser", parser_methods);
+
+    const NativeReg router_methods[] = {
+        {"add", http_router_add},
+        {"match", http_router_match},
+        {"count", http_router_count},
+        {NULL, NULL}
+    };
+    register_method_table(vm, http_module, "_router_mt", "http.router", router_methods);
 
+#ifndef TOI_WASM
     const NativeReg request_methods[] = {
         {"step", http_request_step},
         {"want_read", http_request_want_read},
@@ -1850,36 +3117,18 @@ void register_http(VM* vm) {
         {"close", http_request_close},
         {NULL, NULL}
     };
-
-    for (int i = 0; request_methods[i].name != NULL; i++) {
-        ObjString* name_str = copy_string(request_methods[i].name, (int)strlen(request_methods[i].name));
-        push(vm, OBJ_VAL(name_str));
-        ObjNative* method = new_native(request_methods[i].function, name_str);
-        method->is_self = 1;
-        push(vm, OBJ_VAL(method));
-        table_set(&request_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    register_method_table(vm, http_module, "_request_mt", "http.request", request_methods);
+
+    HttpPool* pool = (HttpPool*)calloc(1, sizeof(HttpPool));
+    if (pool != NULL) {
+        pool->max_per_host = HTTP_POOL_MAX_PER_HOST;
+        pool->idle_timeout = HTTP_POOL_IDLE_TIMEOUT;
+        push(vm, OBJ_VAL(copy_string("_pool", 5)));
+        push(vm, OBJ_VAL(new_userdata_with_finalizer(pool, http_pool_finalizer)));
+        table_set(&http_module->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
         pop(vm);
         pop(vm);
     }
-
-    push(vm, OBJ_VAL(copy_string("__index", 7)));
-    push(vm, OBJ_VAL(request_mt));
-    table_set(&request_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-    pop(vm);
-    pop(vm);
-
-    push(vm, OBJ_VAL(copy_string("__name", 6)));
-    push(vm, OBJ_VAL(copy_string("http.request", 12)));
-    table_set(&request_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-    pop(vm);
-    pop(vm);
-
-    push(vm, OBJ_VAL(copy_string("_request_mt", 11)));
-    push(vm, OBJ_VAL(request_mt));
-    table_set(&http_module->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-    pop(vm);
-    pop(vm);
-    pop(vm); // request_mt
 #endif
     pop(vm);
 }
@@ -158,6 +158,13 @@ static int io_buffer(VM* vm, int arg_count, Value* args) {
     RETURN_OBJ(udata);
 }
 
+FILE* io_file(VM* vm, Value value) {
+    if (!IS_USERDATA(value)) return NULL;
+    ObjUserdata* udata = AS_USERDATA(value);
+    if (udata->metatable == NULL || udata->metatable != io_lookup_metatable(vm, "_file_mt", 8)) return NULL;
+    return (FILE*)udata->data;
+}
+
 static int file_close(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_EQ(1);
     ASSERT_USERDATA(0);
@@ -370,8 +377,8 @@ static int file_write(VM* vm, int arg_count, Value* args) {
     FILE* fp = (FILE*)udata->data;
     if (!fp) { RETURN_NIL; }
     
-    const char* s = GET_CSTRING(1);
-    fputs(s, fp);
+    ObjString* s = GET_STRING(1);
+    fwrite(s->chars, 1, (size_t)s->length, fp);
     RETURN_VAL(args[0]); // Return self for chaining
 }
 
@@ -67,6 +67,22 @@ static void encode_string(StringBuilder* sb, const char* str, int len) {
     sb_append_char(sb, '"');
 }
 
+// Object keys are always JSON strings; numeric table keys are quoted.
+static void encode_key(StringBuilder* sb, Value key) {
+    if (IS_STRING(key)) {
+        encode_string(sb, AS_CSTRING(key), AS_STRING(key)->length);
+        return;
+    }
+    double num = AS_NUMBER(key);
+    char buf[64];
+    if (num == floor(num) && fabs(num) < 1e15) {
+        snprintf(buf, sizeof(buf), "%.0f", num);
+    } else {
+        snprintf(buf, sizeof(buf), "%.17g", num);
+    }
+    encode_string(sb, buf, (int)strlen(buf));
+}
+
 static void encode_table(StringBuilder* sb, ObjTable* table, int depth) {
     if (depth > 100) {
         sb_append(sb, "null", 4); // Prevent infinite recursion
@@ -87,7 +103,7 @@ static void encode_table(StringBuilder* sb, ObjTable* table, int depth) {
     int has_string_keys = 0;
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key != NULL && !IS_NIL(entry->value)) {
+        if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
             has_string_keys = 1;
             break;
         }
@@ -111,10 +127,10 @@ static void encode_table(StringBuilder* sb, ObjTable* table, int depth) {
         // String keys
         for (int i = 0; i < table->table.capacity; i++) {
             Entry* entry = &table->table.entries[i];
-            if (entry->key != NULL && !IS_NIL(entry->value)) {
+            if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
                 if (!first) sb_append_char(sb, ',');
                 first = 0;
-                encode_string(sb, entry->key->chars, entry->key->length);
+                encode_key(sb, entry->key);
                 sb_append_char(sb, ':');
                 encode_value(sb, entry->value, depth + 1);
             }
@@ -19,6 +19,7 @@ void register_dir(VM* vm);
 void register_signal(VM* vm);
 void register_mmap(VM* vm);
 void register_poll(VM* vm);
+void register_loop(VM* vm);
 #endif
 void register_coroutine(VM* vm);
 void register_string(VM* vm);
@@ -80,6 +81,7 @@ static int load_dir(VM* vm) { return load_registered_module(vm, "dir", register_
 static int load_signal(VM* vm) { return load_registered_module(vm, "signal", register_signal); }
 static int load_mmap(VM* vm) { return load_registered_module(vm, "mmap", register_mmap); }
 static int load_poll(VM* vm) { return load_registered_module(vm, "poll", register_poll); }
+static int load_loop(VM* vm) { return load_registered_module(vm, "loop", register_loop); }
 #endif
 static int load_coroutine(VM* vm) { return load_registered_module(vm, "coroutine", register_coroutine); }
 static int load_string(VM* vm) { return load_registered_module(vm, "string", register_string); }
@@ -125,6 +127,7 @@ static const ModuleReg native_modules[] = {
     {"signal", load_signal},
     {"mmap", load_mmap},
     {"poll", load_poll},
+    {"loop", load_loop},
 #endif
     {"coroutine", load_coroutine},
     {"string", load_string},
@@ -1,6 +1,8 @@
 #ifndef LIBS_H
 #define LIBS_H
 
+#include <stdio.h>
+
 #include "../vm.h"
 
 // Structure for native function registration
@@ -33,8 +35,34 @@ void register_libs(VM* vm);
 // Helper to register a module with a list of native functions
 void register_module(VM* vm, const char* name, const NativeReg* funcs);
 
-// Exposed Core Function
+// binary.pack's encoding, for natives that move values between VMs.
+// binary_encode returns a malloc'd buffer, or NULL on failure;
+// binary_decode returns 0 for malformed data.
+uint8_t* binary_encode(VM* vm, Value value, size_t* out_len);
+int binary_decode(VM* vm, const uint8_t* data, size_t len, Value* out);
+
+// The descriptor of a socket object, or -1 for anything else or a
+// closed socket.
+int socket_fd(Value value);
+
+// Whether a socket object has TLS enabled.
+int socket_is_tls(Value value);
+
+// Reads up to `len` bytes from a socket object into `buf`, through TLS
+// when it is enabled. Returns the byte count, or 0 with `*err` set to
+// "closed", "timeout" or an error message.
+int socket_read(Value value, char* buf, int len, const char** err);
+
+// Wraps an accepted descriptor in a socket object; closes `fd` and
+// returns NULL when out of memory.
+ObjUserdata* socket_from_fd(VM* vm, int fd);
+
+// The stream behind an open io.open file object, or NULL.
+FILE* io_file(VM* vm, Value value);
+
+// Exposed Core Functions
 int core_tostring(VM* vm, int arg_count, Value* args);
+int core_next(VM* vm, int arg_count, Value* args);
 
 // --- Macros for Native Functions ---
 
@@ -0,0 +1,1622 @@
+#ifdef __linux__
+#define _GNU_SOURCE // syscall(2) and MAP_POPULATE for the io_uring backend
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef __linux__
+#define LOOP_EPOLL 1
+#include <sys/epoll.h>
+#if !defined(TOI_NO_URING) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define LOOP_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+#endif
+
+#include "libs.h"
+#include "../object.h"
+#include "../value.h"
+#include "../vm.h"
+
+// Event loop with a persistent descriptor registry: epoll on Linux, and
+// poll(2) over the registry elsewhere. Descriptors are used either with
+// loop:add/loop:wait, which report readiness, or with await_readable and
+// await_writable, which park the calling coroutine until the loop resumes
+// it. Awaited descriptors are registered once, edge-triggered for both
+// directions; readiness that arrives while nobody waits is remembered in
+// `pending`, so an await after a short read costs no system call.
+//
+// loop:recv/send/accept/read/write park the coroutine on an I/O request
+// instead. With io_uring (Linux, probed when the loop is created) the
+// requests made during one round are submitted together and the loop
+// resumes each coroutine from its completion. Without it a request is
+// tried with a non-blocking system call and, if that would block, waits
+// on the registry like an await and is retried when the descriptor
+// becomes ready.
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define LOOP_IN 1
+#define LOOP_OUT 2
+#define LOOP_HUP 4
+#define LOOP_ERR 8
+
+#define LOOP_DEFAULT_EVENTS 256
+#define LOOP_RING_ENTRIES 256
+#define LOOP_READ_SIZE 65536
+
+enum { ENTRY_FREE, ENTRY_ADDED, ENTRY_AWAITED };
+enum { MODE_LEVEL, MODE_EDGE, MODE_ONESHOT };
+enum { OP_RECV, OP_SEND, OP_ACCEPT, OP_READ, OP_WRITE };
+
+// An I/O request made by a parked coroutine. Each one is allocated on its
+// own because an io_uring request holds pointers into it until it
+// completes.
+typedef struct {
+    int id;                  // Index in LoopData.ops + 1; io_uring user_data
+    int kind;
+    int fd;
+    ObjThread* thread;
+    Value target;            // Socket or file the request is for
+    Value data;              // String being sent or written
+    char* buffer;            // recv/read destination
+    size_t size;             // recv/read size, or length of `data`
+    size_t done;             // Bytes sent or written so far
+    off_t offset;            // File position, -1 for sockets
+    FILE* file;              // Repositioned after the request when non-NULL
+    struct sockaddr_in addr; // accept's peer address
+    socklen_t addr_len;
+    uint8_t in_flight;       // Submitted to the ring, completion not reaped
+    uint8_t polling;         // Waiting in a ring poll before retrying
+} LoopOp;
+
+typedef struct {
+    Value target;       // Socket or fd number it was registered with
+    Value data;         // Reported by loop:wait
+    ObjThread* reader;  // Coroutine parked in await_readable or recv/accept
+    ObjThread* writer;  // Coroutine parked in await_writable or send
+    LoopOp* reader_op;  // Request to retry when the reader is woken
+    LoopOp* writer_op;
+    uint8_t state;
+    uint8_t events;     // loop:add interest
+    uint8_t mode;
+    uint8_t armed;      // Cleared once a oneshot registration fires
+    uint8_t pending;    // Await readiness nobody has consumed yet
+} LoopEntry;
+
+typedef struct {
+    int fd;
+    int flags;
+} LoopReady;
+
+#ifdef LOOP_URING
+typedef struct {
+    int fd;             // -1 when io_uring is not in use
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_sqe* sqes;
+    struct io_uring_cqe* cqes;
+    void* sq_map;
+    size_t sq_map_len;
+    void* cq_map;
+    size_t cq_map_len;
+    size_t sqes_len;
+    unsigned sq_entries;
+    unsigned sq_pending;  // Prepared but not yet submitted
+    int in_flight;        // Requests whose completion has not been reaped
+    int in_epoll;         // Ring descriptor added to the epoll set
+    int timeout_armed;
+    struct __kernel_timespec timeout;
+} LoopRing;
+#endif
+
+typedef struct {
+    int backend_fd;     // epoll descriptor
+    int closed;
+    int running;        // Inside wait/run; they do not nest
+    LoopEntry* entries; // Indexed by descriptor
+    int entry_capacity;
+    int count;          // Registered descriptors
+    int waiting;        // Coroutines parked in await_*
+    LoopReady* ready;
+    int max_events;
+    LoopOp** ops;       // I/O requests by id - 1; NULL slots are free
+    int* op_free;       // Free slots in `ops`
+    int op_capacity;
+    int op_used;        // Slots of `ops` handed out so far
+    int op_free_count;
+#ifdef LOOP_URING
+    LoopRing ring;
+#endif
+#ifdef LOOP_EPOLL
+    struct epoll_event* events;
+#else
+    struct pollfd* pfds;
+    int pfd_capacity;
+#endif
+} LoopData;
+
+// --- Backend ---
+
+static int backend_open(LoopData* lp) {
+#ifdef LOOP_EPOLL
+    lp->backend_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (lp->backend_fd < 0) return 0;
+    lp->events = (struct epoll_event*)malloc(sizeof(struct epoll_event) * (size_t)lp->max_events);
+    return lp->events != NULL;
+#else
+    lp->backend_fd = -1;
+    return 1;
+#endif
+}
+
+static void backend_close(LoopData* lp) {
+#ifdef LOOP_EPOLL
+    if (lp->backend_fd >= 0) close(lp->backend_fd);
+    free(lp->events);
+    lp->events = NULL;
+#else
+    free(lp->pfds);
+    lp->pfds = NULL;
+#endif
+    lp->backend_fd = -1;
+}
+
+// Registers or updates `fd`. Returns 0 or an errno value.
+static int backend_set(LoopData* lp, int fd, int flags, int mode, int existing) {
+#ifdef LOOP_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.fd = fd;
+    if (flags & LOOP_IN) ev.events |= EPOLLIN | EPOLLRDHUP;
+    if (flags & LOOP_OUT) ev.events |= EPOLLOUT;
+    if (mode == MODE_EDGE) ev.events |= EPOLLET;
+    if (mode == MODE_ONESHOT) ev.events |= EPOLLONESHOT;
+    int rc = epoll_ctl(lp->backend_fd, existing ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &ev);
+    // A registry entry can outlive its descriptor (closed and reopened
+    // under the same number), and the kernel can still hold a duplicate.
+    if (rc < 0 && !existing && errno == EEXIST) rc = epoll_ctl(lp->backend_fd, EPOLL_CTL_MOD, fd, &ev);
+    if (rc < 0 && existing && errno == ENOENT) rc = epoll_ctl(lp->backend_fd, EPOLL_CTL_ADD, fd, &ev);
+    return rc < 0 ? errno : 0;
+#else
+    (void)lp; (void)fd; (void)flags; (void)mode; (void)existing;
+    return 0;
+#endif
+}
+
+static void backend_remove(LoopData* lp, int fd) {
+#ifdef LOOP_EPOLL
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    epoll_ctl(lp->backend_fd, EPOLL_CTL_DEL, fd, &ev); // Already gone if the fd was closed
+#else
+    (void)lp; (void)fd;
+#endif
+}
+
+// Waits for readiness and fills lp->ready. Returns the number of ready
+// descriptors, or -1 with errno set.
+static int backend_wait(LoopData* lp, int timeout_ms) {
+#ifdef LOOP_EPOLL
+    int n = epoll_wait(lp->backend_fd, lp->events, lp->max_events, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : -1;
+    for (int i = 0; i < n; i++) {
+        uint32_t e = lp->events[i].events;
+        int flags = 0;
+        if (e & EPOLLIN) flags |= LOOP_IN;
+        if (e & EPOLLOUT) flags |= LOOP_OUT;
+        if (e & (EPOLLHUP | EPOLLRDHUP)) flags |= LOOP_HUP;
+        if (e & EPOLLERR) flags |= LOOP_ERR;
+        lp->ready[i].fd = lp->events[i].data.fd;
+        lp->ready[i].flags = flags;
+    }
+    return n;
+#else
+    int count = 0;
+    for (int fd = 0; fd < lp->entry_capacity; fd++) {
+        LoopEntry* e = &lp->entries[fd];
+        int flags = 0;
+        if (e->state == ENTRY_ADDED && e->armed) flags = e->events;
+        if (e->state == ENTRY_AWAITED) flags = (e->reader ? LOOP_IN : 0) | (e->writer ? LOOP_OUT : 0);
+        if (flags == 0) continue;
+        if (count == lp->pfd_capacity) {
+            int capacity = lp->pfd_capacity < 64 ? 64 : lp->pfd_capacity * 2;
+            struct pollfd* grown = (struct pollfd*)realloc(lp->pfds, sizeof(struct pollfd) * (size_t)capacity);
+            if (grown == NULL) {
+                errno = ENOMEM;
+                return -1;
+            }
+            lp->pfds = grown;
+            lp->pfd_capacity = capacity;
+        }
+        lp->pfds[count].fd = fd;
+        lp->pfds[count].events = (short)(((flags & LOOP_IN) ? POLLIN : 0) | ((flags & LOOP_OUT) ? POLLOUT : 0));
+        lp->pfds[count].revents = 0;
+        count++;
+    }
+    int rc = poll(lp->pfds, (nfds_t)count, timeout_ms);
+    if (rc < 0) return errno == EINTR ? 0 : -1;
+    int n = 0;
+    for (int i = 0; i < count && n < lp->max_events; i++) {
+        short r = lp->pfds[i].revents;
+        if (r == 0) continue;
+        int flags = 0;
+        if (r & POLLIN) flags |= LOOP_IN;
+        if (r & POLLOUT) flags |= LOOP_OUT;
+        if (r & POLLHUP) flags |= LOOP_HUP;
+        if (r & (POLLERR | POLLNVAL)) flags |= LOOP_ERR;
+        lp->ready[n].fd = lp->pfds[i].fd;
+        lp->ready[n].flags = flags;
+        n++;
+    }
+    return n;
+#endif
+}
+
+#ifdef LOOP_URING
+// --- io_uring ---
+//
+// A minimal ring over the raw system calls. Only the loop's own thread
+// touches the submission queue and the kernel reads it only inside
+// io_uring_enter, so publishing the tail before the entry is filled in
+// is safe.
+
+#define RING_TAG_TIMEOUT ((uint64_t)-1)
+#define RING_TAG_CANCEL ((uint64_t)-2)
+
+static void ring_close(LoopRing* r) {
+    if (r->sqes != NULL && r->sqes != MAP_FAILED) munmap(r->sqes, r->sqes_len);
+    if (r->cq_map != NULL && r->cq_map != MAP_FAILED && r->cq_map != r->sq_map) munmap(r->cq_map, r->cq_map_len);
+    if (r->sq_map != NULL && r->sq_map != MAP_FAILED) munmap(r->sq_map, r->sq_map_len);
+    if (r->fd >= 0) close(r->fd);
+    memset(r, 0, sizeof(*r));
+    r->fd = -1;
+}
+
+// Every opcode the loop submits must be supported. Kernels older than
+// 5.6 fail the probe itself.
+static int ring_probe(int fd) {
+    static const int needed[] = {
+        IORING_OP_RECV, IORING_OP_SEND, IORING_OP_ACCEPT, IORING_OP_READ,
+        IORING_OP_WRITE, IORING_OP_POLL_ADD, IORING_OP_TIMEOUT, IORING_OP_ASYNC_CANCEL
+    };
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*)calloc(1, len);
+    if (probe == NULL) return 0;
+    int ok = syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, 256) == 0;
+    for (size_t i = 0; ok && i < sizeof(needed) / sizeof(needed[0]); i++) {
+        ok = needed[i] <= probe->last_op && (probe->ops[needed[i]].flags & IO_URING_OP_SUPPORTED);
+    }
+    free(probe);
+    return ok;
+}
+
+// Returns 0 or an errno value; on failure the ring is left closed.
+static int ring_open(LoopRing* r, unsigned entries) {
+    struct io_uring_params p;
+    memset(r, 0, sizeof(*r));
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if (r->fd < 0) {
+        int err = errno;
+        r->fd = -1;
+        return err;
+    }
+    if (!(p.features & IORING_FEAT_NODROP) || !ring_probe(r->fd)) {
+        ring_close(r);
+        return ENOSYS;
+    }
+
+    int single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    r->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    r->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (single) {
+        if (r->cq_map_len > r->sq_map_len) r->sq_map_len = r->cq_map_len;
+        r->cq_map_len = r->sq_map_len;
+    }
+    r->sq_map = mmap(NULL, r->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                     r->fd, IORING_OFF_SQ_RING);
+    r->cq_map = single ? r->sq_map
+                       : mmap(NULL, r->cq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                              r->fd, IORING_OFF_CQ_RING);
+    r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = (struct io_uring_sqe*)mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                         r->fd, IORING_OFF_SQES);
+    if (r->sq_map == MAP_FAILED || r->cq_map == MAP_FAILED || r->sqes == MAP_FAILED) {
+        int err = errno;
+        ring_close(r);
+        return err;
+    }
+
+    char* sq = (char*)r->sq_map;
+    char* cq = (char*)r->cq_map;
+    r->sq_head = (unsigned*)(sq + p.sq_off.head);
+    r->sq_tail = (unsigned*)(sq + p.sq_off.tail);
+    r->sq_mask = (unsigned*)(sq + p.sq_off.ring_mask);
+    r->sq_array = (unsigned*)(sq + p.sq_off.array);
+    r->cq_head = (unsigned*)(cq + p.cq_off.head);
+    r->cq_tail = (unsigned*)(cq + p.cq_off.tail);
+    r->cq_mask = (unsigned*)(cq + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    r->sq_entries = p.sq_entries;
+    return 0;
+}
+
+// Submits everything queued and, with IORING_ENTER_GETEVENTS, waits for
+// `min_complete` completions. An interrupted wait counts as a wakeup.
+static int ring_submit(LoopRing* r, unsigned min_complete, unsigned flags) {
+    for (;;) {
+        int rc = (int)syscall(__NR_io_uring_enter, r->fd, r->sq_pending, min_complete, flags, NULL, 0);
+        if (rc >= 0) {
+            r->sq_pending -= (unsigned)rc < r->sq_pending ? (unsigned)rc : r->sq_pending;
+            return rc;
+        }
+        if (errno != EINTR) return -1;
+        if (flags & IORING_ENTER_GETEVENTS) return 0;
+    }
+}
+
+// A zeroed submission entry, flushing the queue first when it is full.
+static struct io_uring_sqe* ring_sqe(LoopRing* r) {
+    unsigned tail = *r->sq_tail;
+    if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+        if (ring_submit(r, 0, 0) < 0) return NULL;
+        if (tail - __atomic_load_n(r->sq_head, __ATOMIC_ACQUIRE) >= r->sq_entries) {
+            errno = EBUSY;
+            return NULL;
+        }
+    }
+    unsigned index = tail & *r->sq_mask;
+    struct io_uring_sqe* sqe = &r->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    r->sq_array[index] = index;
+    __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    r->sq_pending++;
+    return sqe;
+}
+
+static int ring_has_completions(LoopRing* r) {
+    return *r->cq_head != __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+}
+
+// Pops one completion. Returns 0 when the queue is empty.
+static int ring_next(LoopRing* r, uint64_t* tag, int* res) {
+    unsigned head = *r->cq_head;
+    if (head == __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE)) return 0;
+    struct io_uring_cqe* cqe = &r->cqes[head & *r->cq_mask];
+    *tag = cqe->user_data;
+    *res = cqe->res;
+    __atomic_store_n(r->cq_head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Arms a timeout that ends a ring-only wait; it also completes as soon as
+// any other request does.
+static int ring_arm_timeout(LoopRing* r, int timeout_ms) {
+    if (r->timeout_armed) return 0;
+    struct io_uring_sqe* sqe = ring_sqe(r);
+    if (sqe == NULL) return 0;
+    r->timeout.tv_sec = timeout_ms / 1000;
+    r->timeout.tv_nsec = (long long)(timeout_ms % 1000) * 1000000LL;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->fd = -1;
+    sqe->addr = (uint64_t)(uintptr_t)&r->timeout;
+    sqe->len = 1;
+    sqe->off = 1;
+    sqe->user_data = RING_TAG_TIMEOUT;
+    r->timeout_armed = 1;
+    return 1;
+}
+
+// Queues the next system call of `op`, or a poll for its descriptor when
+// `op->polling` is set. Returns 0 or an errno value.
+static int ring_queue(LoopData* lp, LoopOp* op) {
+    struct io_uring_sqe* sqe = ring_sqe(&lp->ring);
+    if (sqe == NULL) return errno;
+    const char* chars = IS_STRING(op->data) ? AS_STRING(op->data)->chars : NULL;
+    sqe->fd = op->fd;
+    sqe->user_data = (uint64_t)op->id;
+    if (op->polling) {
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->poll_events = op->kind == OP_SEND ? POLLOUT : POLLIN;
+    } else {
+        switch (op->kind) {
+            case OP_RECV:
+                sqe->opcode = IORING_OP_RECV;
+                sqe->addr = (uint64_t)(uintptr_t)op->buffer;
+                sqe->len = (unsigned)op->size;
+                break;
+            case OP_SEND:
+                sqe->opcode = IORING_OP_SEND;
+                sqe->addr = (uint64_t)(uintptr_t)(chars + op->done);
+                sqe->len = (unsigned)(op->size - op->done);
+                sqe->msg_flags = MSG_NOSIGNAL;
+                break;
+            case OP_ACCEPT:
+                op->addr_len = sizeof(op->addr);
+                sqe->opcode = IORING_OP_ACCEPT;
+                sqe->addr = (uint64_t)(uintptr_t)&op->addr;
+                sqe->addr2 = (uint64_t)(uintptr_t)&op->addr_len;
+                break;
+            case OP_READ:
+                sqe->opcode = IORING_OP_READ;
+                sqe->addr = (uint64_t)(uintptr_t)op->buffer;
+                sqe->len = (unsigned)op->size;
+                sqe->off = (uint64_t)(int64_t)op->offset;
+                break;
+            case OP_WRITE:
+                sqe->opcode = IORING_OP_WRITE;
+                sqe->addr = (uint64_t)(uintptr_t)(chars + op->done);
+                sqe->len = (unsigned)(op->size - op->done);
+                sqe->off = (uint64_t)(int64_t)op->offset;
+                break;
+        }
+    }
+    op->in_flight = 1;
+    lp->ring.in_flight++;
+    return 0;
+}
+
+// Cancels the requests still in flight and waits for them: the kernel
+// may write into their buffers until their completions arrive.
+static void ring_shutdown(LoopData* lp) {
+    LoopRing* r = &lp->ring;
+    if (r->fd < 0) return;
+    for (int i = 0; i < lp->op_used; i++) {
+        LoopOp* op = lp->ops[i];
+        if (op == NULL || !op->in_flight) continue;
+        struct io_uring_sqe* sqe = ring_sqe(r);
+        if (sqe == NULL) break;
+        sqe->opcode = IORING_OP_ASYNC_CANCEL;
+        sqe->fd = -1;
+        sqe->addr = (uint64_t)op->id;
+        sqe->user_data = RING_TAG_CANCEL;
+    }
+    while (r->in_flight > 0) {
+        if (!ring_has_completions(r) && ring_submit(r, 1, IORING_ENTER_GETEVENTS) < 0) break;
+        uint64_t tag;
+        int res;
+        while (ring_next(r, &tag, &res)) {
+            if (tag == 0 || tag > (uint64_t)lp->op_used) continue;
+            LoopOp* op = lp->ops[tag - 1];
+            if (op != NULL && op->in_flight) {
+                op->in_flight = 0;
+                r->in_flight--;
+            }
+        }
+    }
+    ring_close(r);
+}
+#endif
+
+// --- Registry ---
+
+static void loop_free_data(LoopData* lp) {
+#ifdef LOOP_URING
+    ring_shutdown(lp);
+#endif
+    backend_close(lp);
+    for (int i = 0; i < lp->op_used; i++) {
+        if (lp->ops[i] == NULL) continue;
+        free(lp->ops[i]->buffer);
+        free(lp->ops[i]);
+    }
+    free(lp->ops);
+    free(lp->op_free);
+    free(lp->entries);
+    free(lp->ready);
+    lp->ops = NULL;
+    lp->op_free = NULL;
+    lp->op_capacity = 0;
+    lp->op_used = 0;
+    lp->op_free_count = 0;
+    lp->entries = NULL;
+    lp->ready = NULL;
+    lp->entry_capacity = 0;
+    lp->count = 0;
+    lp->waiting = 0;
+    lp->closed = 1;
+}
+
+static void loop_finalizer(void* ptr) {
+    LoopData* lp = (LoopData*)ptr;
+    if (lp == NULL) return;
+    loop_free_data(lp);
+    free(lp);
+}
+
+static void loop_mark(void* ptr) {
+    LoopData* lp = (LoopData*)ptr;
+    if (lp == NULL) return;
+    for (int i = 0; i < lp->entry_capacity; i++) {
+        LoopEntry* e = &lp->entries[i];
+        if (e->state == ENTRY_FREE) continue;
+        mark_value(e->target);
+        mark_value(e->data);
+        if (e->reader != NULL) mark_object((struct Obj*)e->reader);
+        if (e->writer != NULL) mark_object((struct Obj*)e->writer);
+    }
+    for (int i = 0; i < lp->op_used; i++) {
+        LoopOp* op = lp->ops[i];
+        if (op == NULL) continue;
+        if (op->thread != NULL) mark_object((struct Obj*)op->thread);
+        mark_value(op->target);
+        mark_value(op->data);
+    }
+}
+
+static LoopData* get_loop(VM* vm, Value value) {
+    if (!IS_USERDATA(value) || AS_USERDATA(value)->finalize != loop_finalizer) {
+        vm_runtime_error(vm, "Expected an event loop.");
+        return NULL;
+    }
+    LoopData* lp = (LoopData*)AS_USERDATA(value)->data;
+    if (lp == NULL || lp->closed) {
+        vm_runtime_error(vm, "Event loop is closed.");
+        return NULL;
+    }
+    return lp;
+}
+
+// Accepts a socket or a descriptor number.
+static int target_fd(VM* vm, Value target, const char* method) {
+    int fd = -1;
+    if (IS_NUMBER(target)) {
+        fd = (int)AS_NUMBER(target);
+    } else {
+        fd = socket_fd(target);
+    }
+    if (fd < 0) {
+        vm_runtime_error(vm, "loop:%s expects a socket or file descriptor.", method);
+    }
+    return fd;
+}
+
+static int same_target(Value a, Value b) {
+    if (IS_NUMBER(a) && IS_NUMBER(b)) return AS_NUMBER(a) == AS_NUMBER(b);
+    return IS_OBJ(a) && IS_OBJ(b) && AS_OBJ(a) == AS_OBJ(b);
+}
+
+static LoopEntry* loop_entry(VM* vm, LoopData* lp, int fd) {
+    if (fd >= lp->entry_capacity) {
+        int capacity = lp->entry_capacity < 64 ? 64 : lp->entry_capacity;
+        while (capacity <= fd) capacity *= 2;
+        LoopEntry* grown = (LoopEntry*)realloc(lp->entries, sizeof(LoopEntry) * (size_t)capacity);
+        if (grown == NULL) {
+            vm_runtime_error(vm, "Event loop out of memory.");
+            return NULL;
+        }
+        memset(grown + lp->entry_capacity, 0, sizeof(LoopEntry) * (size_t)(capacity - lp->entry_capacity));
+        for (int i = lp->entry_capacity; i < capacity; i++) {
+            grown[i].target = NIL_VAL;
+            grown[i].data = NIL_VAL;
+        }
+        lp->entries = grown;
+        lp->entry_capacity = capacity;
+    }
+    return &lp->entries[fd];
+}
+
+static LoopOp* op_new(VM* vm, LoopData* lp, int kind, int fd, Value target) {
+    if (lp->op_free_count == 0 && lp->op_used == lp->op_capacity) {
+        int capacity = lp->op_capacity < 16 ? 16 : lp->op_capacity * 2;
+        LoopOp** ops = (LoopOp**)realloc(lp->ops, sizeof(LoopOp*) * (size_t)capacity);
+        if (ops != NULL) lp->ops = ops;
+        int* free_slots = ops != NULL ? (int*)realloc(lp->op_free, sizeof(int) * (size_t)capacity) : NULL;
+        if (free_slots == NULL) {
+            vm_runtime_error(vm, "Event loop out of memory.");
+            return NULL;
+        }
+        lp->op_free = free_slots;
+        lp->op_capacity = capacity;
+    }
+    LoopOp* op = (LoopOp*)calloc(1, sizeof(LoopOp));
+    if (op == NULL) {
+        vm_runtime_error(vm, "Event loop out of memory.");
+        return NULL;
+    }
+    int index = lp->op_free_count > 0 ? lp->op_free[--lp->op_free_count] : lp->op_used++;
+    lp->ops[index] = op;
+    op->id = index + 1;
+    op->kind = kind;
+    op->fd = fd;
+    op->target = target;
+    op->data = NIL_VAL;
+    op->offset = -1;
+    return op;
+}
+
+static void op_free_one(LoopData* lp, LoopOp* op) {
+    lp->ops[op->id - 1] = NULL;
+    lp->op_free[lp->op_free_count++] = op->id - 1;
+    free(op->buffer);
+    free(op);
+}
+
+static void clear_entry(LoopData* lp, LoopEntry* e) {
+    if (e->reader != NULL) lp->waiting--;
+    if (e->writer != NULL) lp->waiting--;
+    if (e->reader_op != NULL) op_free_one(lp, e->reader_op);
+    if (e->writer_op != NULL) op_free_one(lp, e->writer_op);
+    if (e->state != ENTRY_FREE) lp->count--;
+    memset(e, 0, sizeof(*e));
+    e->target = NIL_VAL;
+    e->data = NIL_VAL;
+}
+
+static int event_flag(ObjString* name, int* out) {
+    if (name->length == 2 && memcmp(name->chars, "in", 2) == 0) { *out = LOOP_IN; return 1; }
+    if (name->length == 3 && memcmp(name->chars, "out", 3) == 0) { *out = LOOP_OUT; return 1; }
+    return 0;
+}
+
+// "in", "out" or a list of them.
+static int parse_events(VM* vm, Value value, int* out) {
+    *out = 0;
+    if (IS_STRING(value)) {
+        if (!event_flag(AS_STRING(value), out)) {
+            vm_runtime_error(vm, "Unknown loop event name; use \"in\" or \"out\".");
+            return 0;
+        }
+        return 1;
+    }
+    if (!IS_TABLE(value)) {
+        vm_runtime_error(vm, "loop events must be a string or table.");
+        return 0;
+    }
+    for (int i = 1;; i++) {
+        Value v = NIL_VAL;
+        if (!table_get_array(&AS_TABLE(value)->table, i, &v) || IS_NIL(v)) break;
+        int flag = 0;
+        if (!IS_STRING(v) || !event_flag(AS_STRING(v), &flag)) {
+            vm_runtime_error(vm, "Unknown loop event name; use \"in\" or \"out\".");
+            return 0;
+        }
+        *out |= flag;
+    }
+    if (*out == 0) {
+        vm_runtime_error(vm, "loop events must not be empty.");
+        return 0;
+    }
+    return 1;
+}
+
+static int parse_mode(VM* vm, int arg_count, Value* args, int index, int* out) {
+    *out = MODE_LEVEL;
+    if (arg_count <= index || IS_NIL(args[index])) return 1;
+    if (IS_STRING(args[index])) {
+        const char* s = AS_CSTRING(args[index]);
+        if (strcmp(s, "level") == 0) return 1;
+        if (strcmp(s, "edge") == 0) { *out = MODE_EDGE; return 1; }
+        if (strcmp(s, "oneshot") == 0) { *out = MODE_ONESHOT; return 1; }
+    }
+    vm_runtime_error(vm, "loop mode must be \"level\", \"edge\" or \"oneshot\".");
+    return 0;
+}
+
+static int push_errno(VM* vm, int err) {
+    const char* msg = strerror(err);
+    push(vm, NIL_VAL);
+    push(vm, OBJ_VAL(copy_string(msg, (int)strlen(msg))));
+    return 2;
+}
+
+// --- Coroutines ---
+
+// Resumes `thread` with `args` and runs it until it awaits, yields or
+// returns; whatever it yields is dropped. An error that escapes the
+// coroutine has already been reported by the VM and ends only that
+// coroutine.
+static void loop_resume(VM* vm, ObjThread* thread, int arg_count, Value* args) {
+    if (thread->frame_count == 0) return;
+    ObjThread* caller = vm_current_thread(vm);
+    Value* base = caller->stack_top;
+    thread->caller = caller;
+    for (int i = 0; i < arg_count; i++) {
+        *thread->stack_top = args[i];
+        thread->stack_top++;
+    }
+    vm_set_current_thread(vm, thread);
+    if (vm_run_until_thread(vm, 0, caller) != INTERPRET_OK) {
+        thread->caller = NULL;
+        vm_set_current_thread(vm, caller);
+    }
+    caller->stack_top = base;
+}
+
+// The running coroutine, or NULL after raising an error.
+static ObjThread* loop_coroutine(VM* vm, const char* method) {
+    ObjThread* thread = vm_current_thread(vm);
+    if (thread->caller == NULL || thread->is_generator) {
+        vm_runtime_error(vm, "loop:%s must be called from a coroutine.", method);
+        return NULL;
+    }
+    return thread;
+}
+
+// Suspends `thread` like coroutine.yield("await"); the loop resumes it
+// with the results of whatever it waits for.
+static int park(VM* vm, ObjThread* thread) {
+    ObjThread* caller = thread->caller;
+    *caller->stack_top = BOOL_VAL(1);
+    caller->stack_top++;
+    *caller->stack_top = OBJ_VAL(vm->await_name);
+    caller->stack_top++;
+    vm_set_current_thread(vm, caller);
+    thread->caller = NULL;
+    return 1;
+}
+
+// The registry entry for awaiting `fd`, registering it edge-triggered on
+// first use.
+static LoopEntry* await_entry(VM* vm, LoopData* lp, int fd, Value target, const char* method) {
+    LoopEntry* e = loop_entry(vm, lp, fd);
+    if (e == NULL) return NULL;
+    if (e->state == ENTRY_ADDED) {
+        vm_runtime_error(vm, "loop:%s: descriptor %d is registered with loop:add.", method, fd);
+        return NULL;
+    }
+    if (e->state == ENTRY_FREE || !same_target(e->target, target)) {
+        // First await on this descriptor, or a new socket that reuses the
+        // number of one that was closed.
+        int err = backend_set(lp, fd, LOOP_IN | LOOP_OUT, MODE_EDGE, e->state != ENTRY_FREE);
+        if (err != 0) {
+            vm_runtime_error(vm, "loop:%s: %s", method, strerror(err));
+            return NULL;
+        }
+        clear_entry(lp, e);
+        lp->count++;
+        e->state = ENTRY_AWAITED;
+        e->target = target;
+    }
+    return e;
+}
+
+// One non-blocking attempt at the system call behind `op`: a byte count
+// or accepted descriptor, or -errno.
+static ssize_t op_syscall(LoopOp* op) {
+    const char* chars = IS_STRING(op->data) ? AS_STRING(op->data)->chars : NULL;
+    ssize_t n = -1;
+    switch (op->kind) {
+        case OP_RECV:
+            n = recv(op->fd, op->buffer, op->size, MSG_DONTWAIT);
+            break;
+        case OP_SEND:
+            n = send(op->fd, chars + op->done, op->size - op->done, MSG_DONTWAIT | MSG_NOSIGNAL);
+            break;
+        case OP_ACCEPT: {
+            // The listener may be in blocking mode; accept only once it is ready.
+            struct pollfd pfd;
+            pfd.fd = op->fd;
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+            if (poll(&pfd, 1, 0) == 0) return -EAGAIN;
+            op->addr_len = sizeof(op->addr);
+            n = accept(op->fd, (struct sockaddr*)&op->addr, &op->addr_len);
+            break;
+        }
+        case OP_READ:
+            n = op->offset >= 0 ? pread(op->fd, op->buffer, op->size, op->offset)
+                                : read(op->fd, op->buffer, op->size);
+            break;
+        case OP_WRITE:
+            n = op->offset >= 0 ? pwrite(op->fd, chars + op->done, op->size - op->done, op->offset)
+                                : write(op->fd, chars + op->done, op->size - op->done);
+            break;
+    }
+    return n < 0 ? -(ssize_t)errno : n;
+}
+
+// Records `n` bytes of progress. Returns 1 if a send or write still has
+// data left.
+static int op_partial(LoopOp* op, ssize_t n) {
+    if (op->kind != OP_SEND && op->kind != OP_WRITE) return 0;
+    op->done += (size_t)n;
+    if (op->kind == OP_WRITE && op->offset >= 0) op->offset += n;
+    return n > 0 && op->done < op->size;
+}
+
+// Runs `op` with non-blocking system calls until it has a result in
+// `*res`. Returns 0 if it would block.
+static int op_try(LoopOp* op, ssize_t* res) {
+    for (;;) {
+        ssize_t n = op_syscall(op);
+        if (n == -EINTR) continue;
+        if (n == -EAGAIN || n == -EWOULDBLOCK) return 0;
+        if (n > 0 && op_partial(op, n)) continue;
+        *res = n;
+        return 1;
+    }
+}
+
+// The values a finished request returns to its coroutine.
+static int op_results(VM* vm, LoopOp* op, ssize_t res, Value* out) {
+    if (res >= 0 && op->file != NULL && io_file(vm, op->target) == op->file) {
+        // Leave the stream where an ordinary read or write would have.
+        fseeko(op->file, op->kind == OP_READ ? op->offset + res : op->offset, SEEK_SET);
+    }
+    if (res < 0 || (res == 0 && op->kind == OP_RECV)) {
+        const char* msg = res == 0 ? "closed" : strerror((int)-res);
+        out[0] = NIL_VAL;
+        out[1] = OBJ_VAL(copy_string(msg, (int)strlen(msg)));
+        return 2;
+    }
+    switch (op->kind) {
+        case OP_RECV:
+        case OP_READ:
+            out[0] = OBJ_VAL(copy_string(op->buffer, (int)res));
+            return 1;
+        case OP_SEND:
+        case OP_WRITE:
+            out[0] = NUMBER_VAL((double)op->done);
+            return 1;
+        default: {
+            ObjUserdata* client = socket_from_fd(vm, (int)res);
+            if (client == NULL) {
+                out[0] = NIL_VAL;
+                out[1] = OBJ_VAL(copy_string("out of memory", 13));
+                return 2;
+            }
+            push(vm, OBJ_VAL(client));
+            char ip[INET_ADDRSTRLEN];
+            inet_ntop(AF_INET, &op->addr.sin_addr, ip, sizeof(ip));
+            out[1] = OBJ_VAL(copy_string(ip, (int)strlen(ip)));
+            out[0] = pop(vm);
+            return 2;
+        }
+    }
+}
+
+// Frees a finished request and resumes its coroutine with the result.
+static void op_resume(VM* vm, LoopData* lp, LoopOp* op, ssize_t res) {
+    ObjThread* thread = op->thread;
+    Value out[2];
+    int count = op_results(vm, op, res, out);
+    op_free_one(lp, op);
+    lp->waiting--;
+    loop_resume(vm, thread, count, out);
+}
+
+// Starts `op` for the running coroutine. It finishes at once if it does
+// not block; otherwise the coroutine is parked until the loop completes
+// the request.
+static int op_start(VM* vm, LoopData* lp, LoopOp* op, ObjThread* thread, const char* method) {
+    op->thread = thread;
+#ifdef LOOP_URING
+    if (lp->ring.fd >= 0) {
+        int err = ring_queue(lp, op);
+        if (err != 0) {
+            op_free_one(lp, op);
+            return push_errno(vm, err);
+        }
+        lp->waiting++;
+        return park(vm, thread);
+    }
+#endif
+    ssize_t res = 0;
+    if (op_try(op, &res)) {
+        Value out[2];
+        int count = op_results(vm, op, res, out);
+        op_free_one(lp, op);
+        for (int i = 0; i < count; i++) push(vm, out[i]);
+        return count;
+    }
+
+    LoopEntry* e = await_entry(vm, lp, op->fd, op->target, method);
+    if (e == NULL) {
+        op_free_one(lp, op);
+        return 0;
+    }
+    int flag = op->kind == OP_SEND ? LOOP_OUT : LOOP_IN;
+    ObjThread** slot = flag == LOOP_IN ? &e->reader : &e->writer;
+    if (*slot != NULL) {
+        vm_runtime_error(vm, "loop:%s: another coroutine is already waiting on descriptor %d.", method, op->fd);
+        op_free_one(lp, op);
+        return 0;
+    }
+    // The attempt just saw EAGAIN, so readiness seen before it is used up.
+    e->pending &= (uint8_t)~flag;
+    *slot = thread;
+    if (flag == LOOP_IN) {
+        e->reader_op = op;
+    } else {
+        e->writer_op = op;
+    }
+    lp->waiting++;
+    return park(vm, thread);
+}
+
+static void wake(VM* vm, LoopData* lp, int fd, int flag) {
+    LoopEntry* e = &lp->entries[fd];
+    if (e->state != ENTRY_AWAITED) return;
+    ObjThread** slot = flag == LOOP_IN ? &e->reader : &e->writer;
+    LoopOp** op_slot = flag == LOOP_IN ? &e->reader_op : &e->writer_op;
+    if (*slot == NULL) {
+        e->pending |= (uint8_t)flag;
+        return;
+    }
+    LoopOp* op = *op_slot;
+    if (op != NULL) {
+        ssize_t res = 0;
+        if (!op_try(op, &res)) return; // Stays parked until the next edge
+        *slot = NULL;
+        *op_slot = NULL;
+        op_resume(vm, lp, op, res);
+        return;
+    }
+    ObjThread* thread = *slot;
+    *slot = NULL;
+    lp->waiting--;
+    Value result = BOOL_VAL(1);
+    loop_resume(vm, thread, 1, &result);
+}
+
+#ifdef LOOP_URING
+// Handles one completion: retries a request that would have blocked,
+// queues the rest of a partial send or write, or resumes the coroutine.
+static void ring_finish(VM* vm, LoopData* lp, LoopOp* op, int res) {
+    if (op->polling) {
+        op->polling = 0;
+        if (res >= 0) {
+            int err = ring_queue(lp, op);
+            if (err == 0) return;
+            res = -err;
+        }
+    } else if (res == -EAGAIN || res == -EINTR) {
+        // A descriptor in non-blocking mode fails at once instead of
+        // waiting in the ring; poll it, then try again.
+        op->polling = 1;
+        int err = ring_queue(lp, op);
+        if (err == 0) return;
+        op->polling = 0;
+        res = -err;
+    } else if (res > 0 && op_partial(op, res)) {
+        int err = ring_queue(lp, op);
+        if (err == 0) return;
+        res = -err;
+    }
+    op_resume(vm, lp, op, res);
+}
+
+// Resumes the coroutines whose requests completed, stopping early if one
+// of them closes the loop.
+static void ring_reap(VM* vm, LoopData* lp) {
+    LoopRing* r = &lp->ring;
+    uint64_t tag;
+    int res;
+    while (!lp->closed && ring_next(r, &tag, &res)) {
+        if (tag == RING_TAG_TIMEOUT) {
+            r->timeout_armed = 0;
+            continue;
+        }
+        if (tag == 0 || tag > (uint64_t)lp->op_used) continue;
+        LoopOp* op = lp->ops[tag - 1];
+        if (op == NULL || !op->in_flight) continue;
+        op->in_flight = 0;
+        r->in_flight--;
+        ring_finish(vm, lp, op, res);
+    }
+}
+#endif
+
+static int timeout_ms_arg(VM* vm, int arg_count, Value* args, int index, int* out) {
+    *out = -1;
+    if (arg_count <= index || IS_NIL(args[index])) return 1;
+    if (!IS_NUMBER(args[index])) {
+        vm_runtime_error(vm, "loop timeout must be a number of seconds.");
+        return 0;
+    }
+    double seconds = AS_NUMBER(args[index]);
+    if (seconds < 0) return 1;
+    double ms = seconds * 1000.0;
+    *out = ms > 2147483647.0 ? 2147483647 : (int)ms;
+    if (*out == 0 && seconds > 0) *out = 1;
+    return 1;
+}
+
+// Submits the queued requests, then blocks for readiness or completions.
+// Returns the number of ready descriptors in lp->ready, or -1 with errno
+// set.
+static int loop_poll(LoopData* lp, int timeout_ms) {
+#ifdef LOOP_URING
+    LoopRing* r = &lp->ring;
+    if (r->fd >= 0 && (r->in_flight > 0 || r->sq_pending > 0)) {
+        if (ring_has_completions(r)) timeout_ms = 0;
+        if (lp->count == 0 && timeout_ms != 0 && (timeout_ms < 0 || ring_arm_timeout(r, timeout_ms))) {
+            // Nothing registered for readiness: submit and wait in one call.
+            return ring_submit(r, 1, IORING_ENTER_GETEVENTS) < 0 ? -1 : 0;
+        }
+        if (ring_submit(r, 0, 0) < 0) return -1;
+        if (!r->in_epoll) {
+            struct epoll_event ev;
+            memset(&ev, 0, sizeof(ev));
+            ev.events = EPOLLIN;
+            ev.data.fd = r->fd;
+            if (epoll_ctl(lp->backend_fd, EPOLL_CTL_ADD, r->fd, &ev) < 0) return -1;
+            r->in_epoll = 1;
+        }
+        if (ring_has_completions(r)) timeout_ms = 0;
+    }
+#endif
+    return backend_wait(lp, timeout_ms);
+}
+
+// One round: block for readiness, resume the coroutines it wakes and, if
+// `rows` is given, append a row for every loop:add descriptor that fired.
+// Returns 0 after raising an error.
+static int loop_once(VM* vm, LoopData* lp, int timeout_ms, ObjTable* rows) {
+    ObjThread* caller = vm->blocking_begin != NULL ? vm->blocking_begin(vm) : NULL;
+    int n = loop_poll(lp, timeout_ms);
+    int err = errno;
+    if (vm->blocking_end != NULL) vm->blocking_end(vm, caller);
+    if (n < 0) {
+        vm_runtime_error(vm, "loop wait failed: %s", strerror(err));
+        return 0;
+    }
+#ifdef LOOP_URING
+    if (lp->ring.fd >= 0) ring_reap(vm, lp);
+#endif
+
+    int out_i = 1;
+    for (int i = 0; i < n && !lp->closed; i++) {
+        int fd = lp->ready[i].fd;
+        int flags = lp->ready[i].flags;
+        if (fd < 0 || fd >= lp->entry_capacity) continue;
+        LoopEntry* e = &lp->entries[fd];
+
+        if (e->state == ENTRY_ADDED) {
+            if (e->mode == MODE_ONESHOT) e->armed = 0;
+            if (rows == NULL) continue;
+            ObjTable* row = new_table();
+            push(vm, OBJ_VAL(row));
+            table_set(&row->table, vm->fd_key, NUMBER_VAL((double)fd));
+            table_set(&row->table, vm->data_key, e->data);
+            table_set(&row->table, vm->in_key, BOOL_VAL((flags & LOOP_IN) != 0));
+            table_set(&row->table, vm->out_key, BOOL_VAL((flags & LOOP_OUT) != 0));
+            table_set(&row->table, vm->hup_key, BOOL_VAL((flags & LOOP_HUP) != 0));
+            table_set(&row->table, vm->err_key, BOOL_VAL((flags & LOOP_ERR) != 0));
+            table_set_array(&rows->table, out_i++, OBJ_VAL(row));
+            pop(vm);
+        } else if (e->state == ENTRY_AWAITED) {
+            // A hangup or error wakes both sides so they see it on their
+            // next recv/send. Resuming can change the registry, so the
+            // entry is looked up again for the second side.
+            if (flags & (LOOP_IN | LOOP_HUP | LOOP_ERR)) wake(vm, lp, fd, LOOP_IN);
+            if (lp->closed) break;
+            if (flags & (LOOP_OUT | LOOP_HUP | LOOP_ERR)) wake(vm, lp, fd, LOOP_OUT);
+        }
+    }
+    return 1;
+}
+
+// --- Module functions and methods ---
+
+#ifdef LOOP_EPOLL
+#define LOOP_READY_BACKEND "epoll"
+#else
+#define LOOP_READY_BACKEND "poll"
+#endif
+
+// loop.new([max_events], [backend]) -> loop | nil, err
+// `backend` is "auto" (io_uring when the kernel supports it), "io_uring",
+// or the readiness backend's own name to leave io_uring out.
+static int loop_new(VM* vm, int arg_count, Value* args) {
+    int max_events = LOOP_DEFAULT_EVENTS;
+    if (arg_count >= 1 && !IS_NIL(args[0])) {
+        ASSERT_NUMBER(0);
+        max_events = (int)GET_NUMBER(0);
+        if (max_events < 1 || max_events > 65536) {
+            vm_runtime_error(vm, "loop.new max_events must be 1..65536.");
+            return 0;
+        }
+    }
+    int want_ring = 1;
+    int need_ring = 0;
+    if (arg_count >= 2 && !IS_NIL(args[1])) {
+        const char* name = IS_STRING(args[1]) ? AS_CSTRING(args[1]) : "";
+        if (strcmp(name, "io_uring") == 0) {
+            need_ring = 1;
+        } else if (strcmp(name, LOOP_READY_BACKEND) == 0) {
+            want_ring = 0;
+        } else if (strcmp(name, "auto") != 0) {
+            vm_runtime_error(vm, "loop.new backend must be \"auto\", \"io_uring\" or \"%s\".", LOOP_READY_BACKEND);
+            return 0;
+        }
+    }
+
+    LoopData* lp = (LoopData*)calloc(1, sizeof(LoopData));
+    if (lp == NULL) {
+        vm_runtime_error(vm, "Event loop out of memory.");
+        return 0;
+    }
+    lp->max_events = max_events;
+#ifdef LOOP_URING
+    lp->ring.fd = -1;
+#endif
+    lp->ready = (LoopReady*)malloc(sizeof(LoopReady) * (size_t)max_events);
+    if (lp->ready == NULL || !backend_open(lp)) {
+        int err = lp->ready == NULL ? ENOMEM : errno;
+        loop_free_data(lp);
+        free(lp);
+        return push_errno(vm, err);
+    }
+    int ring_err = ENOSYS;
+#ifdef LOOP_URING
+    if (want_ring) ring_err = ring_open(&lp->ring, LOOP_RING_ENTRIES);
+#else
+    (void)want_ring;
+#endif
+    if (need_ring && ring_err != 0) {
+        loop_free_data(lp);
+        free(lp);
+        return push_errno(vm, ring_err);
+    }
+
+    ObjUserdata* udata = new_userdata_with_hooks(lp, loop_finalizer, loop_mark);
+    push(vm, OBJ_VAL(udata));
+    Value module = NIL_VAL;
+    if (table_get(&vm->modules, copy_string("loop", 4), &module) && IS_TABLE(module)) {
+        Value mt = NIL_VAL;
+        if (table_get(&AS_TABLE(module)->table, copy_string("_loop_mt", 8), &mt) && IS_TABLE(mt)) {
+            udata->metatable = AS_TABLE(mt);
+        }
+    }
+    return 1;
+}
+
+// loop:add(target, events, [data], [mode]) -> true | nil, err
+static int loop_add(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(3);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int fd = target_fd(vm, args[1], "add");
+    int events = 0;
+    int mode = MODE_LEVEL;
+    if (fd < 0 || !parse_events(vm, args[2], &events) || !parse_mode(vm, arg_count, args, 4, &mode)) {
+        return 0;
+    }
+    LoopEntry* e = loop_entry(vm, lp, fd);
+    if (e == NULL) return 0;
+    if (e->state == ENTRY_AWAITED && (e->reader != NULL || e->writer != NULL)) {
+        vm_runtime_error(vm, "loop:add: descriptor %d has a coroutine awaiting it.", fd);
+        return 0;
+    }
+    if (e->state == ENTRY_ADDED) {
+        vm_runtime_error(vm, "loop:add: descriptor %d is already registered; use loop:modify.", fd);
+        return 0;
+    }
+
+    int err = backend_set(lp, fd, events, mode, e->state != ENTRY_FREE);
+    if (err != 0) return push_errno(vm, err);
+    if (e->state == ENTRY_FREE) lp->count++;
+    e->state = ENTRY_ADDED;
+    e->target = args[1];
+    e->data = arg_count >= 4 && !IS_NIL(args[3]) ? args[3] : args[1];
+    e->events = (uint8_t)events;
+    e->mode = (uint8_t)mode;
+    e->armed = 1;
+    e->pending = 0;
+    RETURN_TRUE;
+}
+
+// loop:modify(target, events, [mode]) -> true | nil, err
+static int loop_modify(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(3);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int fd = target_fd(vm, args[1], "modify");
+    int events = 0;
+    int mode = MODE_LEVEL;
+    if (fd < 0 || !parse_events(vm, args[2], &events) || !parse_mode(vm, arg_count, args, 3, &mode)) {
+        return 0;
+    }
+    if (fd >= lp->entry_capacity || lp->entries[fd].state != ENTRY_ADDED) {
+        vm_runtime_error(vm, "loop:modify: descriptor %d is not registered with loop:add.", fd);
+        return 0;
+    }
+    int err = backend_set(lp, fd, events, mode, 1);
+    if (err != 0) return push_errno(vm, err);
+    LoopEntry* e = &lp->entries[fd];
+    e->events = (uint8_t)events;
+    e->mode = (uint8_t)mode;
+    e->armed = 1;
+    RETURN_TRUE;
+}
+
+// loop:remove(target) -> bool
+// Coroutines still awaiting the descriptor are dropped without resuming.
+static int loop_remove(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int fd = target_fd(vm, args[1], "remove");
+    if (fd < 0) return 0;
+    if (fd >= lp->entry_capacity || lp->entries[fd].state == ENTRY_FREE) {
+        RETURN_FALSE;
+    }
+    backend_remove(lp, fd);
+    clear_entry(lp, &lp->entries[fd]);
+    RETURN_TRUE;
+}
+
+// loop:wait([timeout]) -> rows for loop:add descriptors that are ready
+static int loop_wait(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int timeout_ms = -1;
+    if (!timeout_ms_arg(vm, arg_count, args, 1, &timeout_ms)) return 0;
+    if (lp->running) {
+        vm_runtime_error(vm, "loop:wait cannot be called while the loop is running.");
+        return 0;
+    }
+
+    ObjTable* rows = new_table();
+    push(vm, OBJ_VAL(rows));
+    lp->running = 1;
+    int ok = loop_once(vm, lp, timeout_ms, rows);
+    lp->running = 0;
+    if (lp->closed) loop_free_data(lp);
+    if (!ok) return 0;
+    return 1;
+}
+
+// loop:run([timeout]) -> true once no coroutine is waiting, false on timeout
+static int loop_run(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int timeout_ms = -1;
+    if (!timeout_ms_arg(vm, arg_count, args, 1, &timeout_ms)) return 0;
+    if (lp->running) {
+        vm_runtime_error(vm, "loop:run cannot be called while the loop is running.");
+        return 0;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    lp->running = 1;
+    while (!lp->closed && lp->waiting > 0) {
+        int wait_ms = timeout_ms;
+        if (timeout_ms >= 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            long elapsed = (long)(now.tv_sec - start.tv_sec) * 1000 + (now.tv_nsec - start.tv_nsec) / 1000000;
+            if (elapsed >= timeout_ms) break;
+            wait_ms = timeout_ms - (int)elapsed;
+        }
+        if (!loop_once(vm, lp, wait_ms, NULL)) {
+            lp->running = 0;
+            if (lp->closed) loop_free_data(lp);
+            return 0;
+        }
+    }
+    lp->running = 0;
+    if (lp->closed) loop_free_data(lp);
+    RETURN_BOOL(lp->closed || lp->waiting == 0);
+}
+
+static int loop_await(VM* vm, int arg_count, Value* args, int flag, const char* method) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    int fd = target_fd(vm, args[1], method);
+    if (fd < 0) return 0;
+    ObjThread* thread = loop_coroutine(vm, method);
+    if (thread == NULL) return 0;
+    LoopEntry* e = await_entry(vm, lp, fd, args[1], method);
+    if (e == NULL) return 0;
+
+    if (e->pending & flag) {
+        e->pending &= (uint8_t)~flag;
+        RETURN_TRUE;
+    }
+    ObjThread** slot = flag == LOOP_IN ? &e->reader : &e->writer;
+    if (*slot != NULL) {
+        vm_runtime_error(vm, "loop:%s: another coroutine is already waiting on descriptor %d.", method, fd);
+        return 0;
+    }
+    *slot = thread;
+    lp->waiting++;
+    return park(vm, thread);
+}
+
+// loop:await_readable(target) -> true, from inside a coroutine
+static int loop_await_readable(VM* vm, int arg_count, Value* args) {
+    return loop_await(vm, arg_count, args, LOOP_IN, "await_readable");
+}
+
+// loop:await_writable(target) -> true, from inside a coroutine
+static int loop_await_writable(VM* vm, int arg_count, Value* args) {
+    return loop_await(vm, arg_count, args, LOOP_OUT, "await_writable");
+}
+
+// The descriptor of an open, non-TLS socket, or -1 after raising an error.
+static int op_socket(VM* vm, Value target, const char* method) {
+    int fd = socket_fd(target);
+    if (fd < 0) {
+        vm_runtime_error(vm, "loop:%s expects an open socket.", method);
+        return -1;
+    }
+    if (socket_is_tls(target)) {
+        vm_runtime_error(vm, "loop:%s does not support TLS sockets; use await_readable/await_writable.", method);
+        return -1;
+    }
+    return fd;
+}
+
+static int op_size_arg(VM* vm, int arg_count, Value* args, int index, size_t fallback, size_t* out) {
+    *out = fallback;
+    if (arg_count <= index || IS_NIL(args[index])) return 1;
+    if (!IS_NUMBER(args[index]) || AS_NUMBER(args[index]) < 1 || AS_NUMBER(args[index]) > 1073741824.0) {
+        vm_runtime_error(vm, "loop size must be a number from 1 to 1073741824.");
+        return 0;
+    }
+    *out = (size_t)AS_NUMBER(args[index]);
+    return 1;
+}
+
+// A file request at `offset`, or at the stream's position when it is nil.
+static LoopOp* op_file(VM* vm, LoopData* lp, int kind, int arg_count, Value* args, int offset_index,
+                       const char* method) {
+    FILE* fp = io_file(vm, args[1]);
+    if (fp == NULL) {
+        vm_runtime_error(vm, "loop:%s expects an open file.", method);
+        return NULL;
+    }
+    off_t offset = -1;
+    int follow = arg_count <= offset_index || IS_NIL(args[offset_index]);
+    if (follow) {
+        fflush(fp);
+        offset = ftello(fp);
+    } else if (!IS_NUMBER(args[offset_index]) || AS_NUMBER(args[offset_index]) < 0) {
+        vm_runtime_error(vm, "loop:%s offset must be a non-negative number.", method);
+        return NULL;
+    } else {
+        offset = (off_t)AS_NUMBER(args[offset_index]);
+    }
+    LoopOp* op = op_new(vm, lp, kind, fileno(fp), args[1]);
+    if (op == NULL) return NULL;
+    op->offset = offset;
+    if (follow && offset >= 0) op->file = fp;
+    return op;
+}
+
+// loop:recv(sock, [size]) -> data | nil, err, from inside a coroutine
+static int loop_recv(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    ObjThread* thread = loop_coroutine(vm, "recv");
+    size_t size = 0;
+    int fd = thread != NULL ? op_socket(vm, args[1], "recv") : -1;
+    if (fd < 0 || !op_size_arg(vm, arg_count, args, 2, 4096, &size)) return 0;
+    LoopOp* op = op_new(vm, lp, OP_RECV, fd, args[1]);
+    if (op == NULL) return 0;
+    op->size = size;
+    op->buffer = (char*)malloc(size);
+    if (op->buffer == NULL) {
+        op_free_one(lp, op);
+        return push_errno(vm, ENOMEM);
+    }
+    return op_start(vm, lp, op, thread, "recv");
+}
+
+// loop:send(sock, data) -> bytes | nil, err; sends all of `data`
+static int loop_send(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(3);
+    ASSERT_STRING(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    ObjThread* thread = loop_coroutine(vm, "send");
+    int fd = thread != NULL ? op_socket(vm, args[1], "send") : -1;
+    if (fd < 0) return 0;
+    LoopOp* op = op_new(vm, lp, OP_SEND, fd, args[1]);
+    if (op == NULL) return 0;
+    op->data = args[2];
+    op->size = (size_t)GET_STRING(2)->length;
+    return op_start(vm, lp, op, thread, "send");
+}
+
+// loop:accept(server) -> client, ip | nil, err
+static int loop_accept(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    ObjThread* thread = loop_coroutine(vm, "accept");
+    int fd = thread != NULL ? op_socket(vm, args[1], "accept") : -1;
+    if (fd < 0) return 0;
+    LoopOp* op = op_new(vm, lp, OP_ACCEPT, fd, args[1]);
+    if (op == NULL) return 0;
+    return op_start(vm, lp, op, thread, "accept");
+}
+
+// loop:read(file, [size], [offset]) -> data | nil, err; "" at end of file
+static int loop_read(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    ObjThread* thread = loop_coroutine(vm, "read");
+    size_t size = 0;
+    if (thread == NULL || !op_size_arg(vm, arg_count, args, 2, LOOP_READ_SIZE, &size)) return 0;
+    LoopOp* op = op_file(vm, lp, OP_READ, arg_count, args, 3, "read");
+    if (op == NULL) return 0;
+    op->size = size;
+    op->buffer = (char*)malloc(size);
+    if (op->buffer == NULL) {
+        op_free_one(lp, op);
+        return push_errno(vm, ENOMEM);
+    }
+    return op_start(vm, lp, op, thread, "read");
+}
+
+// loop:write(file, data, [offset]) -> bytes | nil, err; writes all of `data`
+static int loop_write(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(3);
+    ASSERT_STRING(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    if (loop_coroutine(vm, "write") == NULL) return 0;
+    LoopOp* op = op_file(vm, lp, OP_WRITE, arg_count, args, 3, "write");
+    if (op == NULL) return 0;
+    op->data = args[2];
+    op->size = (size_t)GET_STRING(2)->length;
+    return op_start(vm, lp, op, vm_current_thread(vm), "write");
+}
+
+// loop:spawn(fn, ...) -> coroutine, run until its first await
+static int loop_spawn(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    if (!IS_CLOSURE(args[1])) {
+        vm_runtime_error(vm, "loop:spawn requires a function.");
+        return 0;
+    }
+
+    ObjClosure* closure = AS_CLOSURE(args[1]);
+    ObjThread* thread = new_thread();
+    thread->vm = vm;
+    thread->stack[0] = args[1];
+    thread->stack_top = thread->stack + 1;
+    CallFrame* frame = &thread->frames[0];
+    frame->closure = closure;
+    frame->ip = closure->function->chunk.code;
+    frame->slots = thread->stack;
+    frame->restore_module_context = 0;
+    frame->cache_module_result = 0;
+    frame->had_prev_module_name = 0;
+    frame->had_prev_module_file = 0;
+    frame->had_prev_module_main = 0;
+    frame->module_cache_name = NIL_VAL;
+    frame->prev_module_name = NIL_VAL;
+    frame->prev_module_file = NIL_VAL;
+    frame->prev_module_main = NIL_VAL;
+    thread->frame_count = 1;
+
+    push(vm, OBJ_VAL(thread));
+    loop_resume(vm, thread, arg_count - 2, args + 2);
+    return 1;
+}
+
+// loop:count() -> registered descriptors, waiting coroutines
+static int loop_count(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+    push(vm, NUMBER_VAL((double)lp->count));
+    push(vm, NUMBER_VAL((double)lp->waiting));
+    return 2;
+}
+
+// loop:backend() -> "io_uring" | "epoll" | "poll"
+static int loop_backend(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    LoopData* lp = get_loop(vm, args[0]);
+    if (lp == NULL) return 0;
+#ifdef LOOP_URING
+    if (lp->ring.fd >= 0) RETURN_STRING("io_uring", 8);
+#endif
+    RETURN_STRING(LOOP_READY_BACKEND, (int)strlen(LOOP_READY_BACKEND));
+}
+
+// loop:close() -> bool
+static int loop_close(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    ASSERT_USERDATA(0);
+    LoopData* lp = (LoopData*)GET_USERDATA(0)->data;
+    if (lp == NULL || lp->closed) {
+        RETURN_FALSE;
+    }
+    if (lp->running) {
+        // Called from a coroutine the loop resumed; wait/run frees it.
+        lp->closed = 1;
+        RETURN_TRUE;
+    }
+    loop_free_data(lp);
+    RETURN_TRUE;
+}
+
+void register_loop(VM* vm) {
+    const NativeReg loop_funcs[] = {
+        {"new", loop_new},
+        {NULL, NULL}
+    };
+    register_module(vm, "loop", loop_funcs);
+    ObjTable* loop_module = AS_TABLE(peek(vm, 0));
+
+    ObjTable* loop_mt = new_table();
+    push(vm, OBJ_VAL(loop_mt));
+
+    const NativeReg methods[] = {
+        {"add", loop_add},
+        {"modify", loop_modify},
+        {"remove", loop_remove},
+        {"wait", loop_wait},
+        {"run", loop_run},
+        {"await_readable", loop_await_readable},
+        {"await_writable", loop_await_writable},
+        {"recv", loop_recv},
+        {"send", loop_send},
+        {"accept", loop_accept},
+        {"read", loop_read},
+        {"write", loop_write},
+        {"spawn", loop_spawn},
+        {"count", loop_count},
+        {"backend", loop_backend},
+        {"close", loop_close},
+        {NULL, NULL}
+    };
+
+    for (int i = 0; methods[i].name != NULL; i++) {
+        ObjString* name_str = copy_string(methods[i].name, (int)strlen(methods[i].name));
+        push(vm, OBJ_VAL(name_str));
+        ObjNative* method = new_native(methods[i].function, name_str);
+        method->is_self = 1;
+        push(vm, OBJ_VAL(method));
+        table_set(&loop_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+        pop(vm);
+        pop(vm);
+    }
+
+    push(vm, OBJ_VAL(copy_string("__index", 7)));
+    push(vm, OBJ_VAL(loop_mt));
+    table_set(&loop_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+
+    push(vm, OBJ_VAL(copy_string("__name", 6)));
+    push(vm, OBJ_VAL(copy_string("loop.loop", 9)));
+    table_set(&loop_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+
+    push(vm, OBJ_VAL(copy_string("_loop_mt", 8)));
+    push(vm, OBJ_VAL(loop_mt));
+    table_set(&loop_module->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm);
+    pop(vm);
+    pop(vm); // loop_mt
+    pop(vm); // loop module
+}
@@ -6,6 +6,8 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 #if defined(__GLIBC__)
 #include <malloc.h>
 #endif
@@ -135,6 +137,59 @@ static int os_system(VM* vm, int arg_count, Value* args) {
     RETURN_NUMBER((double)status);
 }
 
+// os.fork() -> pid (0 in the child) | nil, err
+static int os_fork(VM* vm, int arg_count, Value* args) {
+    (void)args;
+    ASSERT_ARGC_EQ(0);
+    // Output still buffered would otherwise be written by both processes.
+    fflush(NULL);
+    pid_t pid = fork();
+    if (pid < 0) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(strerror(errno), (int)strlen(strerror(errno)))));
+        return 2;
+    }
+    RETURN_NUMBER((double)pid);
+}
+
+// os.getpid() -> number
+static int os_getpid(VM* vm, int arg_count, Value* args) {
+    (void)args;
+    ASSERT_ARGC_EQ(0);
+    RETURN_NUMBER((double)getpid());
+}
+
+// os.waitpid([pid=-1], [nohang=false]) -> pid, code | 0 | nil, err
+// code is the exit status, or -signal for a child killed by a signal.
+static int os_waitpid(VM* vm, int arg_count, Value* args) {
+    pid_t pid = -1;
+    int options = 0;
+    if (arg_count >= 1 && !IS_NIL(args[0])) {
+        ASSERT_NUMBER(0);
+        pid = (pid_t)GET_NUMBER(0);
+    }
+    if (arg_count >= 2 && IS_BOOL(args[1]) && AS_BOOL(args[1])) options = WNOHANG;
+
+    int status = 0;
+    pid_t done;
+    do {
+        done = waitpid(pid, &status, options);
+    } while (done < 0 && errno == EINTR);
+    if (done < 0) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(strerror(errno), (int)strlen(strerror(errno)))));
+        return 2;
+    }
+    if (done == 0) RETURN_NUMBER(0);
+
+    int code = 0;
+    if (WIFEXITED(status)) code = WEXITSTATUS(status);
+    else if (WIFSIGNALED(status)) code = -WTERMSIG(status);
+    push(vm, NUMBER_VAL((double)done));
+    push(vm, NUMBER_VAL((double)code));
+    return 2;
+}
+
 // os.remove(path)
 static int os_remove(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_EQ(1);
@@ -362,6 +417,9 @@ void register_os(VM* vm) {
         {"getenv", os_getenv},
         {"setenv", os_setenv},
         {"system", os_system},
+        {"fork", os_fork},
+        {"getpid", os_getpid},
+        {"waitpid", os_waitpid},
         {"remove", os_remove},
         {"rename", os_rename},
         {"clock", os_clock},
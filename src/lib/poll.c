@@ -106,7 +106,7 @@ static int poll_wait_native(VM* vm, int arg_count, Value* args) {
         } else if (IS_TABLE(v)) {
             ObjTable* row = AS_TABLE(v);
             Value fdv = NIL_VAL;
-            if (!table_get(&row->table, copy_string("fd", 2), &fdv) || !IS_NUMBER(fdv)) {
+            if (!table_get(&row->table, vm->fd_key, &fdv) || !IS_NUMBER(fdv)) {
                 free(pfds);
                 free(indices);
                 vm_runtime_error(vm, "poll item table requires numeric 'fd'.");
@@ -115,7 +115,7 @@ static int poll_wait_native(VM* vm, int arg_count, Value* args) {
             fd = (int)AS_NUMBER(fdv);
 
             Value evv = NIL_VAL;
-            if (table_get(&row->table, copy_string("events", 6), &evv) && !IS_NIL(evv)) {
+            if (table_get(&row->table, vm->events_key, &evv) && !IS_NIL(evv)) {
                 if (!parse_events(vm, evv, &events)) {
                     free(pfds);
                     free(indices);
@@ -135,9 +135,12 @@ static int poll_wait_native(VM* vm, int arg_count, Value* args) {
         indices[i] = i + 1;
     }
 
+    // Other threads run while this one waits.
+    ObjThread* caller = timeout_ms != 0 && vm->blocking_begin != NULL ? vm->blocking_begin(vm) : NULL;
     int rc = poll(pfds, (nfds_t)count, timeout_ms);
+    int err = errno;
+    if (caller != NULL) vm->blocking_end(vm, caller);
     if (rc < 0) {
-        int err = errno;
         free(pfds);
         free(indices);
         vm_runtime_error(vm, "poll.wait failed: %s", strerror(err));
@@ -151,16 +154,16 @@ static int poll_wait_native(VM* vm, int arg_count, Value* args) {
         if (pfds[i].revents == 0) continue;
         ObjTable* row = new_table();
         push(vm, OBJ_VAL(row));
-        table_set(&row->table, copy_string("index", 5), NUMBER_VAL((double)indices[i]));
-        table_set(&row->table, copy_string("fd", 2), NUMBER_VAL((double)pfds[i].fd));
+        table_set(&row->table, vm->index_key, NUMBER_VAL((double)indices[i]));
+        table_set(&row->table, vm->fd_key, NUMBER_VAL((double)pfds[i].fd));
 
-        table_set(&row->table, copy_string("in", 2), BOOL_VAL((pfds[i].revents & POLLIN) != 0));
-        table_set(&row->table, copy_string("out", 3), BOOL_VAL((pfds[i].revents & POLLOUT) != 0));
-        table_set(&row->table, copy_string("pri", 3), BOOL_VAL((pfds[i].revents & POLLPRI) != 0));
-        table_set(&row->table, copy_string("err", 3), BOOL_VAL((pfds[i].revents & POLLERR) != 0));
-        table_set(&row->table, copy_string("hup", 3), BOOL_VAL((pfds[i].revents & POLLHUP) != 0));
-        table_set(&row->table, copy_string("nval", 4), BOOL_VAL((pfds[i].revents & POLLNVAL) != 0));
-        table_set(&row->table, copy_string("revents", 7), NUMBER_VAL((double)pfds[i].revents));
+        table_set(&row->table, vm->in_key, BOOL_VAL((pfds[i].revents & POLLIN) != 0));
+        table_set(&row->table, vm->out_key, BOOL_VAL((pfds[i].revents & POLLOUT) != 0));
+        table_set(&row->table, vm->pri_key, BOOL_VAL((pfds[i].revents & POLLPRI) != 0));
+        table_set(&row->table, vm->err_key, BOOL_VAL((pfds[i].revents & POLLERR) != 0));
+        table_set(&row->table, vm->hup_key, BOOL_VAL((pfds[i].revents & POLLHUP) != 0));
+        table_set(&row->table, vm->nval_key, BOOL_VAL((pfds[i].revents & POLLNVAL) != 0));
+        table_set(&row->table, vm->revents_key, NUMBER_VAL((double)pfds[i].revents));
 
         table_set_array(&out->table, out_i++, OBJ_VAL(row));
         pop(vm);
@@ -168,7 +171,7 @@ static int poll_wait_native(VM* vm, int arg_count, Value* args) {
 
     free(pfds);
     free(indices);
-    RETURN_OBJ(out);
+    return 1;
 }
 
 void register_poll(VM* vm) {
@@ -1,5 +1,6 @@
 #include <signal.h>
 #include <string.h>
+#include <sys/types.h>
 
 #include "libs.h"
 #include "../object.h"
@@ -132,9 +133,62 @@ static int signal_default_native(VM* vm, int arg_count, Value* args) {
     RETURN_BOOL(signal(sig, SIG_DFL) != SIG_ERR);
 }
 
+// signal.kill(pid, sig) -> bool
+static int signal_kill_native(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(2);
+    ASSERT_NUMBER(0);
+    int sig = 0;
+    if (!signal_from_value(vm, args[1], &sig)) return 0;
+    RETURN_BOOL(kill((pid_t)GET_NUMBER(0), sig) == 0);
+}
+
+// NSIG is not POSIX; 65 covers the Linux real-time range.
+#ifdef NSIG
+#define SIGNAL_SLOTS NSIG
+#else
+#define SIGNAL_SLOTS 65
+#endif
+
+// Signals taken by signal.catch, counted until signal.pending reads them.
+static volatile sig_atomic_t caught[SIGNAL_SLOTS];
+
+static void count_signal(int sig) {
+    if (sig > 0 && sig < SIGNAL_SLOTS) caught[sig]++;
+}
+
+// signal.catch(sig) -> bool
+static int signal_catch_native(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(1);
+    int sig = 0;
+    if (!signal_from_value(vm, args[0], &sig)) return 0;
+    if (sig <= 0 || sig >= SIGNAL_SLOTS) RETURN_FALSE;
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = count_signal;
+    sigemptyset(&sa.sa_mask);
+    // Interrupted system calls resume, so I/O in progress is not disturbed.
+    sa.sa_flags = SA_RESTART;
+    caught[sig] = 0;
+    RETURN_BOOL(sigaction(sig, &sa, NULL) == 0);
+}
+
+// signal.pending(sig) -> times caught since the last call
+static int signal_pending_native(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(1);
+    int sig = 0;
+    if (!signal_from_value(vm, args[0], &sig)) return 0;
+    if (sig <= 0 || sig >= SIGNAL_SLOTS) RETURN_NUMBER(0);
+    int count = caught[sig];
+    caught[sig] -= count;
+    RETURN_NUMBER((double)count);
+}
+
 void register_signal(VM* vm) {
     const NativeReg funcs[] = {
         {"raise", signal_raise_native},
+        {"kill", signal_kill_native},
+        {"catch", signal_catch_native},
+        {"pending", signal_pending_native},
         {"ignore", signal_ignore_native},
         {"default", signal_default_native},
         {NULL, NULL}
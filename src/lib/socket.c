@@ -1,3 +1,4 @@
+#define _DEFAULT_SOURCE // SO_REUSEPORT
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -10,6 +11,12 @@
 #include <netdb.h>
 #include <fcntl.h>
 #include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <limits.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
 
 #ifdef TOI_HAVE_TLS
 #include <openssl/ssl.h>
@@ -90,6 +97,27 @@ static SocketData* get_socket_data(ObjUserdata* udata) {
     return (SocketData*)udata->data;
 }
 
+// A socket that may wait in the kernel lets other threads run meanwhile;
+// a non-blocking one returns at once and keeps the lock. Callers pass
+// errno through socket_wait_end, which preserves it.
+static ObjThread* socket_wait_begin(VM* vm, SocketData* sock) {
+    if (sock->timeout_ms == 0 || vm->blocking_begin == NULL) return NULL;
+    return vm->blocking_begin(vm);
+}
+
+static void socket_wait_end(VM* vm, ObjThread* caller) {
+    if (caller == NULL) return;
+    int err = errno;
+    vm->blocking_end(vm, caller);
+    errno = err;
+}
+
+int socket_fd(Value value) {
+    if (!IS_USERDATA(value) || AS_USERDATA(value)->finalize != socket_userdata_finalizer) return -1;
+    SocketData* sock = get_socket_data(AS_USERDATA(value));
+    return sock != NULL ? sock->fd : -1;
+}
+
 // Helper to set socket metatable
 static void set_socket_metatable(VM* vm, ObjUserdata* udata) {
     Value socket_val;
@@ -201,7 +229,10 @@ static int sock_connect(VM* vm, int arg_count, Value* args) {
         memcpy(&addr.sin_addr, he->h_addr_list[0], he->h_length);
     }
 
-    if (connect(sock->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+    ObjThread* caller = socket_wait_begin(vm, sock);
+    int rc = connect(sock->fd, (struct sockaddr*)&addr, sizeof(addr));
+    socket_wait_end(vm, caller);
+    if (rc < 0) {
         push(vm, NIL_VAL);
         push(vm, OBJ_VAL(copy_string(strerror(errno), strlen(strerror(errno)))));
         return 2;
@@ -210,7 +241,9 @@ static int sock_connect(VM* vm, int arg_count, Value* args) {
     RETURN_TRUE;
 }
 
-// sock:bind(host, port)
+// sock:bind(host, port, [opts])
+// opts.reuseport lets several sockets, in this or other processes, bind
+// the same address; the kernel spreads incoming connections across them.
 static int sock_bind(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_GE(3);
     ASSERT_USERDATA(0);
@@ -231,6 +264,24 @@ static int sock_bind(VM* vm, int arg_count, Value* args) {
     int opt = 1;
     setsockopt(sock->fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
 
+    if (arg_count >= 4 && IS_TABLE(args[3])) {
+        Value v;
+        ObjString* key = copy_string("reuseport", 9);
+        if (table_get(&AS_TABLE(args[3])->table, key, &v) && IS_BOOL(v) && AS_BOOL(v)) {
+#ifdef SO_REUSEPORT
+            if (setsockopt(sock->fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+                push(vm, NIL_VAL);
+                push(vm, OBJ_VAL(copy_string(strerror(errno), strlen(strerror(errno)))));
+                return 2;
+            }
+#else
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string("SO_REUSEPORT unsupported", 24)));
+            return 2;
+#endif
+        }
+    }
+
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
@@ -296,7 +347,9 @@ static int sock_accept(VM* vm, int arg_count, Value* args) {
     struct sockaddr_in client_addr;
     socklen_t addr_len = sizeof(client_addr);
 
+    ObjThread* caller = socket_wait_begin(vm, sock);
     int client_fd = accept(sock->fd, (struct sockaddr*)&client_addr, &addr_len);
+    socket_wait_end(vm, caller);
     if (client_fd < 0) {
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
             push(vm, NIL_VAL);
@@ -333,6 +386,75 @@ static int sock_accept(VM* vm, int arg_count, Value* args) {
     return 2;
 }
 
+int socket_is_tls(Value value) {
+    if (!IS_USERDATA(value) || AS_USERDATA(value)->finalize != socket_userdata_finalizer) return 0;
+#ifdef TOI_HAVE_TLS
+    SocketData* sock = get_socket_data(AS_USERDATA(value));
+    return sock != NULL && sock->tls != NULL;
+#else
+    return 0;
+#endif
+}
+
+int socket_read(Value value, char* buf, int len, const char** err) {
+    if (!IS_USERDATA(value) || AS_USERDATA(value)->finalize != socket_userdata_finalizer) {
+        *err = "socket expected";
+        return 0;
+    }
+    SocketData* sock = get_socket_data(AS_USERDATA(value));
+    if (sock == NULL || sock->fd < 0) {
+        *err = "socket closed";
+        return 0;
+    }
+#ifdef TOI_HAVE_TLS
+    if (sock->tls != NULL) {
+        int received = SSL_read(sock->tls, buf, len);
+        if (received > 0) return received;
+        int tls_err = SSL_get_error(sock->tls, received);
+        if (received == 0 && tls_err == SSL_ERROR_ZERO_RETURN) {
+            *err = "closed";
+        } else if (tls_err == SSL_ERROR_WANT_READ || tls_err == SSL_ERROR_WANT_WRITE) {
+            *err = "timeout";
+        } else if (received == 0) {
+            *err = "closed";
+        } else {
+            *err = "tls read failed";
+        }
+        return 0;
+    }
+#endif
+    ssize_t received;
+    do {
+        received = recv(sock->fd, buf, (size_t)len, 0);
+    } while (received < 0 && errno == EINTR);
+    if (received > 0) return (int)received;
+    if (received == 0) {
+        *err = "closed";
+    } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        *err = "timeout";
+    } else {
+        *err = strerror(errno);
+    }
+    return 0;
+}
+
+ObjUserdata* socket_from_fd(VM* vm, int fd) {
+    SocketData* data = (SocketData*)malloc(sizeof(SocketData));
+    if (data == NULL) {
+        close(fd);
+        return NULL;
+    }
+    data->fd = fd;
+    data->timeout_ms = -1;
+#ifdef TOI_HAVE_TLS
+    data->tls_ctx = NULL;
+    data->tls = NULL;
+#endif
+    ObjUserdata* udata = new_userdata_with_finalizer(data, socket_userdata_finalizer);
+    set_socket_metatable(vm, udata);
+    return udata;
+}
+
 // sock:send(data)
 static int sock_send(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_GE(2);
@@ -362,9 +484,16 @@ static int sock_send(VM* vm, int arg_count, Value* args) {
         RETURN_NUMBER((double)sent);
     }
 #endif
+    ObjThread* caller = socket_wait_begin(vm, sock);
     ssize_t sent = send(sock->fd, data->chars, data->length, 0);
+    socket_wait_end(vm, caller);
 
     if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string("timeout", 7)));
+            return 2;
+        }
         push(vm, NIL_VAL);
         push(vm, OBJ_VAL(copy_string(strerror(errno), strlen(strerror(errno)))));
         return 2;
@@ -373,6 +502,269 @@ static int sock_send(VM* vm, int arg_count, Value* args) {
     RETURN_NUMBER((double)sent);
 }
 
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// sock:sendv({segment, ...}, offset?) -> bytes sent
+// Sends the strings of a list as one stream with a single writev, so a
+// response never has to be joined into one string. offset skips bytes
+// already sent; like send, it may send less than the rest and reports
+// how much went out.
+static int sock_sendv(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    ASSERT_USERDATA(0);
+    ASSERT_TABLE(1);
+
+    SocketData* sock = get_socket_data(GET_USERDATA(0));
+    if (sock == NULL || sock->fd < 0) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string("socket closed", 13)));
+        return 2;
+    }
+
+    double skip_arg = 0;
+    if (arg_count >= 3 && !IS_NIL(args[2])) {
+        ASSERT_NUMBER(2);
+        skip_arg = GET_NUMBER(2);
+        if (skip_arg < 0) {
+            vm_runtime_error(vm, "sendv offset must be non-negative.");
+            return 0;
+        }
+    }
+
+    Table* list = &GET_TABLE(1)->table;
+    struct iovec iov[IOV_MAX];
+    int iov_count = 0;
+    size_t skip = (size_t)skip_arg;
+    size_t total = 0;
+    for (int i = 1; i <= list->array_max && iov_count < IOV_MAX; i++) {
+        Value segment = NIL_VAL;
+        table_get_array(list, i, &segment);
+        if (!IS_STRING(segment)) {
+            vm_runtime_error(vm, "sendv segment %d must be a string.", i);
+            return 0;
+        }
+        ObjString* str = AS_STRING(segment);
+        size_t len = (size_t)str->length;
+        if (skip >= len) {
+            skip -= len;
+            continue;
+        }
+        iov[iov_count].iov_base = str->chars + skip;
+        iov[iov_count].iov_len = len - skip;
+        total += len - skip;
+        skip = 0;
+        iov_count++;
+    }
+    if (total == 0) {
+        RETURN_NUMBER(0);
+    }
+
+#ifdef TOI_HAVE_TLS
+    if (sock->tls != NULL) {
+        // TLS records are built from one buffer; join the pending segments.
+        char* joined = (char*)malloc(total);
+        if (joined == NULL) {
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string("out of memory", 13)));
+            return 2;
+        }
+        size_t at = 0;
+        for (int i = 0; i < iov_count; i++) {
+            memcpy(joined + at, iov[i].iov_base, iov[i].iov_len);
+            at += iov[i].iov_len;
+        }
+        int sent = SSL_write(sock->tls, joined, total > INT_MAX ? INT_MAX : (int)total);
+        free(joined);
+        if (sent <= 0) {
+            int err = SSL_get_error(sock->tls, sent);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                push(vm, NIL_VAL);
+                push(vm, OBJ_VAL(copy_string("timeout", 7)));
+                return 2;
+            }
+            return push_tls_error(vm, "tls write failed");
+        }
+        RETURN_NUMBER((double)sent);
+    }
+#endif
+
+    ObjThread* caller = socket_wait_begin(vm, sock);
+    ssize_t sent;
+    do {
+        sent = writev(sock->fd, iov, iov_count);
+    } while (sent < 0 && errno == EINTR);
+    socket_wait_end(vm, caller);
+
+    if (sent < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string("timeout", 7)));
+            return 2;
+        }
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(strerror(errno), strlen(strerror(errno)))));
+        return 2;
+    }
+
+    RETURN_NUMBER((double)sent);
+}
+
+// Copy one slice of a file through user space, for TLS sockets and
+// platforms without sendfile(2).
+static ssize_t sendfile_copy(SocketData* sock, int in_fd, off_t offset, size_t count, int* tls_err) {
+    char buffer[65536];
+    if (count > sizeof(buffer)) count = sizeof(buffer);
+    ssize_t got;
+    do {
+        got = pread(in_fd, buffer, count, offset);
+    } while (got < 0 && errno == EINTR);
+    if (got <= 0) return got;
+#ifdef TOI_HAVE_TLS
+    if (sock->tls != NULL) {
+        int sent = SSL_write(sock->tls, buffer, (int)got);
+        if (sent <= 0) {
+            int err = SSL_get_error(sock->tls, sent);
+            if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+                errno = EAGAIN;
+            } else {
+                *tls_err = 1;
+            }
+            return -1;
+        }
+        return sent;
+    }
+#endif
+    (void)tls_err;
+    ssize_t sent;
+    do {
+        sent = send(sock->fd, buffer, (size_t)got, 0);
+    } while (sent < 0 && errno == EINTR);
+    return sent;
+}
+
+// sock:sendfile(fd_or_file_or_path, offset?, count?) -> bytes sent
+// Makes one transfer attempt and reports how far it got, so non-blocking
+// callers advance offset by the result and retry after "timeout". Returns 0
+// once offset reaches the end of the file.
+static int sock_sendfile(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    ASSERT_USERDATA(0);
+
+    SocketData* sock = get_socket_data(GET_USERDATA(0));
+    if (sock == NULL || sock->fd < 0) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string("socket closed", 13)));
+        return 2;
+    }
+
+    double offset_arg = 0;
+    if (arg_count >= 3 && !IS_NIL(args[2])) {
+        ASSERT_NUMBER(2);
+        offset_arg = GET_NUMBER(2);
+    }
+    if (offset_arg < 0) {
+        vm_runtime_error(vm, "sendfile offset must be non-negative.");
+        return 0;
+    }
+    double count_arg = -1;
+    if (arg_count >= 4 && !IS_NIL(args[3])) {
+        ASSERT_NUMBER(3);
+        count_arg = GET_NUMBER(3);
+        if (count_arg < 0) {
+            vm_runtime_error(vm, "sendfile count must be non-negative.");
+            return 0;
+        }
+    }
+
+    int in_fd = -1;
+    int owned = 0;
+    if (IS_NUMBER(args[1])) {
+        in_fd = (int)AS_NUMBER(args[1]);
+    } else if (IS_STRING(args[1])) {
+        in_fd = open(AS_CSTRING(args[1]), O_RDONLY);
+        if (in_fd < 0) {
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string(strerror(errno), strlen(strerror(errno)))));
+            return 2;
+        }
+        owned = 1;
+    } else {
+        FILE* fp = io_file(vm, args[1]);
+        if (fp == NULL) {
+            vm_runtime_error(vm, "sendfile expects a file descriptor, file or path.");
+            return 0;
+        }
+        // Flush pending writes so the descriptor sees them.
+        fflush(fp);
+        in_fd = fileno(fp);
+    }
+
+    struct stat st;
+    if (in_fd < 0 || fstat(in_fd, &st) != 0) {
+        int err = in_fd < 0 ? EBADF : errno;
+        if (owned) close(in_fd);
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(strerror(err), strlen(strerror(err)))));
+        return 2;
+    }
+
+    off_t offset = (off_t)offset_arg;
+    size_t count = 0;
+    if (offset < st.st_size) {
+        count = (size_t)(st.st_size - offset);
+        if (count_arg >= 0 && (double)count > count_arg) count = (size_t)count_arg;
+    }
+    // Keep each attempt bounded so blocking sockets return progress
+    // periodically and the result always fits a double exactly.
+    if (count > (size_t)0x40000000) count = (size_t)0x40000000;
+    if (count == 0) {
+        if (owned) close(in_fd);
+        RETURN_NUMBER(0);
+    }
+
+    ssize_t sent;
+    int tls_err = 0;
+#ifdef __linux__
+#ifdef TOI_HAVE_TLS
+    if (sock->tls != NULL) {
+        sent = sendfile_copy(sock, in_fd, offset, count, &tls_err);
+    } else
+#endif
+    {
+        ObjThread* caller = socket_wait_begin(vm, sock);
+        do {
+            sent = sendfile(sock->fd, in_fd, &offset, count);
+        } while (sent < 0 && errno == EINTR);
+        // Not every descriptor pair supports sendfile; copy instead.
+        if (sent < 0 && (errno == EINVAL || errno == ENOSYS)) {
+            sent = sendfile_copy(sock, in_fd, offset, count, &tls_err);
+        }
+        socket_wait_end(vm, caller);
+    }
+#else
+    sent = sendfile_copy(sock, in_fd, offset, count, &tls_err);
+#endif
+    int err = errno;
+    if (owned) close(in_fd);
+
+    if (sent < 0) {
+#ifdef TOI_HAVE_TLS
+        if (tls_err) return push_tls_error(vm, "tls write failed");
+#endif
+        if (err == EAGAIN || err == EWOULDBLOCK) {
+            push(vm, NIL_VAL);
+            push(vm, OBJ_VAL(copy_string("timeout", 7)));
+            return 2;
+        }
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(strerror(err), strlen(strerror(err)))));
+        return 2;
+    }
+    RETURN_NUMBER((double)sent);
+}
+
 // sock:recv(size?)
 static int sock_recv(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_GE(1);
@@ -416,7 +808,9 @@ static int sock_recv(VM* vm, int arg_count, Value* args) {
         return 1;
     }
 #endif
+    ObjThread* caller = socket_wait_begin(vm, sock);
     ssize_t received = recv(sock->fd, buffer, size, 0);
+    socket_wait_end(vm, caller);
 
     if (received < 0) {
         free(buffer);
@@ -748,7 +1142,7 @@ static int add_sockets_from_table(ObjTable* table, fd_set* fds, int* max_fd,
     // Process hash part (string keys)
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key != NULL && IS_USERDATA(entry->value)) {
+        if (!IS_NIL(entry->key) && IS_USERDATA(entry->value)) {
             ObjUserdata* udata = AS_USERDATA(entry->value);
             SocketData* sock = (SocketData*)udata->data;
             if (sock == NULL) continue;
@@ -800,8 +1194,11 @@ static int socket_select(VM* vm, int arg_count, Value* args) {
         tvp = &tv;
     }
 
-    // Call select
+    // Call select; other threads run unless it is only a poll.
+    int polling = tvp != NULL && tv.tv_sec == 0 && tv.tv_usec == 0;
+    ObjThread* caller = !polling && vm->blocking_begin != NULL ? vm->blocking_begin(vm) : NULL;
     int result = select(max_fd + 1, &read_fds, &write_fds, NULL, tvp);
+    if (caller != NULL) vm->blocking_end(vm, caller);
 
     if (result < 0) {
         push(vm, NIL_VAL);
@@ -815,7 +1212,8 @@ static int socket_select(VM* vm, int arg_count, Value* args) {
     int ready_read_count = 0;
     for (int i = 0; i < read_count; i++) {
         SocketData* sock = (SocketData*)read_sockets[i]->data;
-        if (sock == NULL) continue;
+        // Another thread may have closed it while select waited.
+        if (sock == NULL || sock->fd < 0) continue;
         if (FD_ISSET(sock->fd, &read_fds)) {
             ready_read_count++;
             table_set_array(&ready_read->table, ready_read_count, OBJ_VAL(read_sockets[i]));
@@ -828,7 +1226,7 @@ static int socket_select(VM* vm, int arg_count, Value* args) {
     int ready_write_count = 0;
     for (int i = 0; i < write_count; i++) {
         SocketData* sock = (SocketData*)write_sockets[i]->data;
-        if (sock == NULL) continue;
+        if (sock == NULL || sock->fd < 0) continue;
         if (FD_ISSET(sock->fd, &write_fds)) {
             ready_write_count++;
             table_set_array(&ready_write->table, ready_write_count, OBJ_VAL(write_sockets[i]));
@@ -864,6 +1262,8 @@ void register_socket(VM* vm) {
         {"listen", sock_listen},
         {"accept", sock_accept},
         {"send", sock_send},
+        {"sendv", sock_sendv},
+        {"sendfile", sock_sendfile},
         {"recv", sock_recv},
         {"settimeout", sock_settimeout},
         {"tls", sock_tls},
@@ -762,8 +762,7 @@ static int string_join(VM* vm, int arg_count, Value* args) {
         // Try array optimization first
         if (!table_get_array(&list->table, i, &val)) {
             // Fallback to hash lookup (for numeric keys stored in hash part)
-            ObjString* key = number_key_string((double)i);
-            if (!table_get(&list->table, key, &val) || IS_NIL(val)) {
+            if (!table_get_value(&list->table, NUMBER_VAL((double)i), &val) || IS_NIL(val)) {
                 // End of sequence
                 break;
             }
@@ -802,8 +801,7 @@ static int string_join(VM* vm, int arg_count, Value* args) {
     i = 1;
     while (1) {
         if (!table_get_array(&list->table, i, &val)) {
-            ObjString* key = number_key_string((double)i);
-            if (!table_get(&list->table, key, &val) || IS_NIL(val)) {
+            if (!table_get_value(&list->table, NUMBER_VAL((double)i), &val) || IS_NIL(val)) {
                 break;
             }
         }
@@ -1102,6 +1100,7 @@ void register_string(VM* vm) {
     pop(vm); // call_str
 
     AS_TABLE(string_module)->metatable = mt;
+    gc_write_barrier(AS_OBJ(string_module), OBJ_VAL(mt));
 
     // Alias 'str' global to 'string' module so str(x) works via __call
     ObjString* str_name = copy_string("str", 3);
@@ -6,10 +6,9 @@
 #include "../vm.h"
 
 static int value_equals_for_find(Value a, Value b) {
-    if (a.type != b.type) return 0;
-    if (IS_NIL(a)) return 1;
-    if (IS_NUMBER(a)) return AS_NUMBER(a) == AS_NUMBER(b);
-    if (IS_BOOL(a)) return AS_BOOL(a) == AS_BOOL(b);
+    if (IS_NIL(a)) return IS_NIL(b);
+    if (IS_NUMBER(a)) return IS_NUMBER(b) && AS_NUMBER(a) == AS_NUMBER(b);
+    if (IS_BOOL(a)) return IS_BOOL(b) && AS_BOOL(a) == AS_BOOL(b);
     if (IS_OBJ(a) && IS_OBJ(b)) {
         if (AS_OBJ(a) == AS_OBJ(b)) return 1;
         if (IS_STRING(a) && IS_STRING(b)) {
@@ -86,7 +85,7 @@ static int table_clone_recursive(VM* vm, ObjTable* source, int deep,
 
     for (int i = 0; i < source->table.capacity; i++) {
         Entry* entry = &source->table.entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
+        if (IS_NIL(entry->key) || IS_NIL(entry->value)) continue;
 
         Value v = entry->value;
         if (deep && IS_TABLE(v)) {
@@ -98,7 +97,7 @@ static int table_clone_recursive(VM* vm, ObjTable* source, int deep,
             v = OBJ_VAL(child);
         }
 
-        table_set(&clone->table, entry->key, v);
+        table_set_value(&clone->table, entry->key, v);
     }
 
     pop(vm);
@@ -262,6 +261,7 @@ static int table_push(VM* vm, int arg_count, Value* args) {
 
     table->table.array[raw_index] = args[1];
     table->table.array_max = index;
+    gc_write_barrier(&table->obj, args[1]);
     RETURN_NUMBER((double)index);
 }
 
@@ -496,8 +496,8 @@ static int table_keys(VM* vm, int arg_count, Value* args) {
     // String keys
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key != NULL && !IS_NIL(entry->value)) {
-            table_set_array(&result->table, index++, OBJ_VAL(entry->key));
+        if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
+            table_set_array(&result->table, index++, entry->key);
         }
     }
 
@@ -525,7 +525,7 @@ static int table_values(VM* vm, int arg_count, Value* args) {
     // String key values
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key != NULL && !IS_NIL(entry->value)) {
+        if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
             table_set_array(&result->table, index++, entry->value);
         }
     }
@@ -1,23 +1,56 @@
+#define _DEFAULT_SOURCE // MAP_ANONYMOUS for process-shared buffers
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <pthread.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/mman.h>
+
+#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
 
 #include "libs.h"
+#include "../compiler.h"
 #include "../object.h"
+#include "../toic.h"
 #include "../value.h"
 #include "../vm.h"
 
-// Global Interpreter Lock
-static pthread_mutex_t gil = PTHREAD_MUTEX_INITIALIZER;
+// Global Interpreter Lock. There is one per VM: threads started with
+// thread.spawn share their spawner's, each isolate runs under its own.
+//
+// A thread that has waited a full switch interval raises the VM's
+// switch_request, and the running thread hands the lock over at its next
+// safepoint. The handoff waits until a waiter has actually taken the
+// lock, so a hot loop cannot win it straight back.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t released;
+    pthread_cond_t switched;
+    int locked;
+    int waiters;
+    unsigned long switches;
+    VM* vm;
+} Gil;
+
+static Gil gil = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    0, 0, 0, NULL
+};
+static TOI_THREAD_LOCAL Gil* thread_gil = &gil;
 static int gil_initialized = 0;
 static int no_gil_enabled = 0;
+static volatile long switch_interval_us = 5000;
 
 // Thread data structure
 typedef struct {
     pthread_t pthread;
     VM* vm;
+    GcHeap* heap;
+    Gil* gil;
     ObjThread* caller_thread;
     ObjClosure* closure;
     Value* args;
@@ -35,23 +68,93 @@ typedef struct {
     int locked;
 } MutexData;
 
-// Channel for thread communication
-typedef struct ChannelNode {
+// Channel for thread communication: a ring buffer of messages behind one
+// mutex. Bounded channels allocate all their slots up front; unbounded
+// ones start small and double. Once a channel is handed to an isolate its
+// messages are stored encoded (binary.pack format) and decoded by the
+// receiver into its own heap.
+typedef struct {
     Value value;
-    struct ChannelNode* next;
-} ChannelNode;
+    uint8_t* bytes;
+    size_t length;
+} ChannelSlot;
+
+// A thread.select call parked on several channels. Each channel it waits
+// on links a SelectWaiter into its `selects` list; whichever channel
+// becomes ready first sets `fired`.
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int fired;
+} Selector;
+
+typedef struct SelectWaiter {
+    Selector* selector;
+    int sending;
+    struct SelectWaiter* prev;
+    struct SelectWaiter* next;
+} SelectWaiter;
 
 typedef struct {
     pthread_mutex_t mutex;
     pthread_cond_t not_empty;
     pthread_cond_t not_full;
-    ChannelNode* head;
-    ChannelNode* tail;
+    SelectWaiter* selects;
+    ChannelSlot* slots;
+    int slot_count;
+    int head;     // Oldest message
     int count;
     int capacity; // 0 = unbounded
     int closed;
+    int recv_waiters; // Threads parked on not_empty
+    int send_waiters; // Threads parked on not_full
+    int shared;   // Reachable from more than one VM
+    int refs;     // Userdata handles, one per VM holding the channel
 } ChannelData;
 
+// thread.shared_buffer memory. It lives outside every heap, so all the
+// VMs holding a handle see the same bytes; numeric slots are read and
+// written with atomic instructions rather than under a lock.
+typedef struct {
+    int refs;       // Handles across all VMs, updated atomically
+    size_t size;
+    uint8_t* bytes; // Zero-filled, 8-byte aligned
+    int mapped;     // bytes is a shared mapping that outlives fork
+} SharedBuffer;
+
+// An argument for an isolate: encoded, or a channel or shared buffer
+// shared with it.
+typedef struct {
+    uint8_t* bytes;
+    size_t length;
+    ChannelData* channel;
+    SharedBuffer* buffer;
+} IsolateArg;
+
+// thread.isolate handle. The isolate's VM and heap live entirely on its
+// own OS thread; only encoded bytes cross over.
+typedef struct {
+    pthread_t pthread;
+    pthread_mutex_t lock;   // Guards done/detached
+    uint8_t* code;          // Serialized entry function, or NULL
+    size_t code_length;
+    char* module;           // Module to import when `code` is NULL
+    IsolateArg* args;
+    int arg_count;
+    uint8_t* result;
+    size_t result_length;
+    int error;
+    char error_msg[256];
+    int done;
+    int detached;
+} IsolateData;
+
+static void isolate_release(void* ptr);
+static int isolate_join(VM* vm, ObjUserdata* udata);
+static void shared_buffer_release(void* ptr);
+static ObjUserdata* wrap_shared_buffer(VM* vm, SharedBuffer* buffer);
+static int is_shared_buffer(Value value);
+
 static int get_thread_module(VM* vm, Value* out) {
     ObjString* thread_name = copy_string("thread", 6);
     if (table_get(&vm->modules, thread_name, out) && IS_TABLE(*out)) {
@@ -81,20 +184,107 @@ static void channel_mark(void* ptr) {
     ChannelData* data = (ChannelData*)ptr;
     if (data == NULL) return;
     pthread_mutex_lock(&data->mutex);
-    for (ChannelNode* node = data->head; node != NULL; node = node->next) {
-        mark_value(node->value);
+    for (int i = 0; i < data->count; i++) {
+        ChannelSlot* slot = &data->slots[(data->head + i) % data->slot_count];
+        if (slot->bytes == NULL) mark_value(slot->value);
+    }
+    pthread_mutex_unlock(&data->mutex);
+}
+
+// Finalizer of a channel handle; the last handle frees the channel.
+static void channel_release(void* ptr) {
+    ChannelData* data = (ChannelData*)ptr;
+    pthread_mutex_lock(&data->mutex);
+    int refs = --data->refs;
+    pthread_mutex_unlock(&data->mutex);
+    if (refs > 0) return;
+
+    for (int i = 0; i < data->count; i++) {
+        free(data->slots[(data->head + i) % data->slot_count].bytes);
+    }
+    free(data->slots);
+    pthread_mutex_destroy(&data->mutex);
+    pthread_cond_destroy(&data->not_empty);
+    pthread_cond_destroy(&data->not_full);
+    free(data);
+}
+
+// Switches a channel to encoded messages before another VM can see it.
+// Runs under the owning VM's lock, so queued values can still be read.
+static void share_channel(VM* vm, ChannelData* data) {
+    pthread_mutex_lock(&data->mutex);
+    data->refs++;
+    if (!data->shared) {
+        for (int i = 0; i < data->count; i++) {
+            ChannelSlot* slot = &data->slots[(data->head + i) % data->slot_count];
+            slot->bytes = binary_encode(vm, slot->value, &slot->length);
+            if (slot->bytes == NULL) slot->bytes = binary_encode(vm, NIL_VAL, &slot->length);
+            slot->value = NIL_VAL;
+        }
+        data->shared = 1;
     }
     pthread_mutex_unlock(&data->mutex);
 }
 
+static void init_gil(Gil* g, VM* vm) {
+    pthread_mutex_init(&g->mutex, NULL);
+    pthread_cond_init(&g->released, NULL);
+    pthread_cond_init(&g->switched, NULL);
+    g->locked = 0;
+    g->waiters = 0;
+    g->switches = 0;
+    g->vm = vm;
+}
+
+static void destroy_gil(Gil* g) {
+    pthread_cond_destroy(&g->switched);
+    pthread_cond_destroy(&g->released);
+    pthread_mutex_destroy(&g->mutex);
+}
+
+// Waits on g->released for one switch interval. Caller holds g->mutex.
+static int wait_released(Gil* g) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long interval = switch_interval_us;
+    deadline.tv_sec += interval / 1000000;
+    deadline.tv_nsec += (interval % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000L) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000L;
+    }
+    return pthread_cond_timedwait(&g->released, &g->mutex, &deadline);
+}
+
 static void acquire_gil(void) {
     if (no_gil_enabled) return;
-    pthread_mutex_lock(&gil);
+    Gil* g = thread_gil;
+    pthread_mutex_lock(&g->mutex);
+    if (g->locked) {
+        g->waiters++;
+        while (g->locked) {
+            unsigned long switches = g->switches;
+            if (wait_released(g) == ETIMEDOUT && g->locked && g->switches == switches &&
+                g->vm != NULL) {
+                g->vm->switch_request = 1;
+            }
+        }
+        g->waiters--;
+    }
+    g->locked = 1;
+    g->switches++;
+    if (g->vm != NULL) g->vm->switch_request = 0;
+    pthread_cond_broadcast(&g->switched);
+    pthread_mutex_unlock(&g->mutex);
 }
 
 static void release_gil(void) {
     if (no_gil_enabled) return;
-    pthread_mutex_unlock(&gil);
+    Gil* g = thread_gil;
+    pthread_mutex_lock(&g->mutex);
+    g->locked = 0;
+    pthread_cond_signal(&g->released);
+    pthread_mutex_unlock(&g->mutex);
 }
 
 static void park_vm_thread(VM* vm, ObjThread* thread) {
@@ -151,10 +341,42 @@ static void resume_vm_thread(VM* vm, ObjThread* caller) {
     vm_set_current_thread(vm, caller);
 }
 
+// vm->switch_hook: give the lock to a thread that has waited a switch
+// interval, then queue up behind it.
+static void gil_switch(VM* vm) {
+    vm->switch_request = 0;
+    if (no_gil_enabled) return;
+
+    ObjThread* caller = vm_current_thread(vm);
+    park_vm_thread(vm, caller);
+
+    Gil* g = thread_gil;
+    pthread_mutex_lock(&g->mutex);
+    unsigned long switches = g->switches;
+    g->locked = 0;
+    pthread_cond_signal(&g->released);
+    while (g->waiters > 0 && g->switches == switches) {
+        pthread_cond_wait(&g->switched, &g->mutex);
+    }
+    pthread_mutex_unlock(&g->mutex);
+
+    acquire_gil();
+    unpark_vm_thread(vm, caller);
+    vm_set_current_thread(vm, caller);
+}
+
+static void install_gil_hooks(VM* vm) {
+    vm->switch_hook = gil_switch;
+    vm->blocking_begin = suspend_vm_thread;
+    vm->blocking_end = resume_vm_thread;
+}
+
 // Thread entry point
 static void* thread_runner(void* arg) {
     ThreadData* data = (ThreadData*)arg;
 
+    gc_heap = data->heap;
+    thread_gil = data->gil;
     acquire_gil();
 
     // Restore to the spawning VM thread, not whatever happens to be current.
@@ -190,9 +412,9 @@ static void* thread_runner(void* arg) {
         return NULL;
     }
 
-    // Run until this worker frame returns; min_frame_count=1 keeps the
-    // return value on the worker stack without touching global REPL mode.
-    InterpretResult result = vm_run(data->vm, 1);
+    // Run until this worker frame returns, keeping its return value on
+    // the worker stack.
+    InterpretResult result = vm_run_entry(data->vm);
 
     if (result != INTERPRET_OK) {
         data->error = 1;
@@ -240,6 +462,8 @@ static int thread_spawn(VM* vm, int arg_count, Value* args) {
     }
 
     data->vm = vm;
+    data->heap = gc_heap;
+    data->gil = thread_gil;
     data->caller_thread = vm_current_thread(vm);
     data->closure = AS_CLOSURE(args[0]);
     data->arg_count = arg_count - 1;
@@ -296,6 +520,9 @@ static int thread_join(VM* vm, int arg_count, Value* args) {
     ASSERT_USERDATA(0);
 
     ObjUserdata* udata = GET_USERDATA(0);
+    if (udata->data != NULL && udata->finalize == isolate_release) {
+        return isolate_join(vm, udata);
+    }
     ThreadData* data = (ThreadData*)udata->data;
 
     if (!data) {
@@ -343,6 +570,24 @@ static int thread_yield_native(VM* vm, int arg_count, Value* args) {
     RETURN_NIL;
 }
 
+// thread.switch_interval([seconds]) - how long a thread waits for the GIL
+// before the running thread is asked to hand it over; returns the
+// previous value
+static int thread_switch_interval(VM* vm, int arg_count, Value* args) {
+    double previous = (double)switch_interval_us / 1000000.0;
+    if (arg_count >= 1) {
+        ASSERT_NUMBER(0);
+        double seconds = GET_NUMBER(0);
+        if (!(seconds > 0) || seconds > 60) {
+            vm_runtime_error(vm, "thread.switch_interval expects a value between 0 and 60 seconds");
+            return 0;
+        }
+        long us = (long)(seconds * 1000000.0);
+        switch_interval_us = us < 1 ? 1 : us;
+    }
+    RETURN_NUMBER(previous);
+}
+
 // thread.sleep(seconds) - sleep and release GIL
 static int thread_sleep(VM* vm, int arg_count, Value* args) {
     ASSERT_ARGC_GE(1);
@@ -426,81 +671,274 @@ static int mutex_trylock(VM* vm, int arg_count, Value* args) {
     RETURN_FALSE;
 }
 
+static ObjTable* thread_metatable(VM* vm, const char* name) {
+    Value thread_val;
+    if (!get_thread_module(vm, &thread_val)) {
+        if (!load_native_module(vm, "thread")) return NULL;
+        thread_val = pop(vm);
+    }
+    Value mt;
+    ObjString* mt_name = copy_string(name, (int)strlen(name));
+    if (table_get(&AS_TABLE(thread_val)->table, mt_name, &mt) && IS_TABLE(mt)) {
+        return AS_TABLE(mt);
+    }
+    return NULL;
+}
+
+static ObjUserdata* wrap_channel(VM* vm, ChannelData* data) {
+    ObjUserdata* udata = new_userdata_with_hooks(data, channel_release, channel_mark);
+    push(vm, OBJ_VAL(udata));
+    udata->metatable = thread_metatable(vm, "_channel_mt");
+    pop(vm);
+    return udata;
+}
+
+static int is_channel(Value value) {
+    return IS_USERDATA(value) && AS_USERDATA(value)->finalize == channel_release &&
+           AS_USERDATA(value)->data != NULL;
+}
+
+#define CHANNEL_INITIAL_SLOTS 16
+#define CHANNEL_SPIN_LIMIT 1000
+
 // thread.channel(capacity?) - create a channel for thread communication
 static int thread_channel(VM* vm, int arg_count, Value* args) {
     int capacity = 0; // unbounded by default
-    if (arg_count >= 1 && IS_NUMBER(args[0])) {
+    if (arg_count >= 1 && IS_NUMBER(args[0]) && AS_NUMBER(args[0]) >= 1) {
         capacity = (int)AS_NUMBER(args[0]);
     }
 
-    ChannelData* data = (ChannelData*)malloc(sizeof(ChannelData));
+    ChannelData* data = (ChannelData*)calloc(1, sizeof(ChannelData));
+    if (data != NULL) {
+        data->slot_count = capacity > 0 ? capacity : CHANNEL_INITIAL_SLOTS;
+        data->slots = (ChannelSlot*)malloc((size_t)data->slot_count * sizeof(ChannelSlot));
+    }
+    if (data == NULL || data->slots == NULL) {
+        free(data);
+        vm_runtime_error(vm, "thread.channel: out of memory for %d slots", capacity);
+        return 0;
+    }
     pthread_mutex_init(&data->mutex, NULL);
     pthread_cond_init(&data->not_empty, NULL);
     pthread_cond_init(&data->not_full, NULL);
-    data->head = NULL;
-    data->tail = NULL;
-    data->count = 0;
     data->capacity = capacity;
-    data->closed = 0;
+    data->refs = 1;
 
-    ObjUserdata* udata = new_userdata_with_hooks(data, NULL, channel_mark);
+    RETURN_OBJ(wrap_channel(vm, data));
+}
 
-    // Set metatable
-    Value thread_val;
-    if (get_thread_module(vm, &thread_val)) {
-        Value mt;
-        ObjString* mt_name = copy_string("_channel_mt", 11);
-        if (table_get(&AS_TABLE(thread_val)->table, mt_name, &mt) && IS_TABLE(mt)) {
-            udata->metatable = AS_TABLE(mt);
-        }
+// Makes room for one more message: 1 on success, 0 when a bounded channel
+// is full, -1 when an unbounded one cannot grow. Caller holds data->mutex.
+static int channel_reserve(ChannelData* data) {
+    if (data->count < data->slot_count) return 1;
+    if (data->capacity > 0) return 0;
+
+    int slot_count = data->slot_count * 2;
+    ChannelSlot* slots = (ChannelSlot*)malloc((size_t)slot_count * sizeof(ChannelSlot));
+    if (slots == NULL) return -1;
+    for (int i = 0; i < data->count; i++) {
+        slots[i] = data->slots[(data->head + i) % data->slot_count];
     }
+    free(data->slots);
+    data->slots = slots;
+    data->slot_count = slot_count;
+    data->head = 0;
+    return 1;
+}
 
-    RETURN_OBJ(udata);
+// Appends a message after channel_reserve. On a shared channel the value
+// is encoded, which is safe here: the channel only becomes shared while
+// its VM's lock is held, and senders hold their VM's lock. Returns 0 if
+// the value cannot be encoded.
+static int channel_push(VM* vm, ChannelData* data, Value value) {
+    ChannelSlot* slot = &data->slots[(data->head + data->count) % data->slot_count];
+    slot->value = value;
+    slot->bytes = NULL;
+    slot->length = 0;
+    if (data->shared) {
+        slot->bytes = binary_encode(vm, value, &slot->length);
+        if (slot->bytes == NULL) return 0;
+        slot->value = NIL_VAL;
+    }
+    data->count++;
+    return 1;
 }
 
-// channel:send(value)
-static int channel_send(VM* vm, int arg_count, Value* args) {
-    ASSERT_ARGC_GE(2);
-    ASSERT_USERDATA(0);
+static ChannelSlot channel_pop(ChannelData* data) {
+    ChannelSlot slot = data->slots[data->head];
+    data->head = (data->head + 1) % data->slot_count;
+    data->count--;
+    return slot;
+}
 
-    ChannelData* data = (ChannelData*)GET_USERDATA(0)->data;
-    if (!data || data->closed) { RETURN_FALSE; }
+static void select_fire(Selector* selector) {
+    pthread_mutex_lock(&selector->mutex);
+    selector->fired = 1;
+    pthread_cond_signal(&selector->cond);
+    pthread_mutex_unlock(&selector->mutex);
+}
 
-    Value value = args[1];
+// Wakes threads waiting to receive (`receivers`) or to send after `n`
+// messages were added or removed, including thread.select calls parked
+// on this channel. Caller holds data->mutex; nothing is signalled when
+// nobody is waiting.
+static void channel_wake(ChannelData* data, int receivers, int n) {
+    if (n == 0) return;
+    int waiters = receivers ? data->recv_waiters : data->send_waiters;
+    pthread_cond_t* cond = receivers ? &data->not_empty : &data->not_full;
+    if (waiters == 1 || (waiters > 0 && n == 1)) {
+        pthread_cond_signal(cond);
+    } else if (waiters > 0) {
+        pthread_cond_broadcast(cond);
+    }
+    for (SelectWaiter* w = data->selects; w != NULL; w = w->next) {
+        if (w->sending != receivers) select_fire(w->selector);
+    }
+}
+
+static int online_cpus(void) {
+    static int cpus = 0;
+    if (cpus == 0) {
+        long n = sysconf(_SC_NPROCESSORS_ONLN);
+        cpus = n > 0 ? (int)n : 1;
+    }
+    return cpus;
+}
 
-    // Release lock while waiting on channel mutex/condition.
+// Blocks, without the VM lock, until the channel can make progress: a
+// message is queued (receiving), there is room (sending) or it is closed.
+// On multi-core machines it spins first, since a partner on another core
+// usually answers sooner than a park and wake-up would take.
+static void channel_wait(VM* vm, ChannelData* data, int sending) {
     ObjThread* caller = suspend_vm_thread(vm);
+
+    if (online_cpus() > 1) {
+        for (int i = 0; i < CHANNEL_SPIN_LIMIT; i++) {
+            int count = __atomic_load_n(&data->count, __ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&data->closed, __ATOMIC_ACQUIRE)) break;
+            if (sending ? (data->capacity == 0 || count < data->capacity) : count > 0) break;
+        }
+    }
+
     pthread_mutex_lock(&data->mutex);
+    if (sending) {
+        data->send_waiters++;
+        while (!data->closed && data->capacity > 0 && data->count >= data->capacity) {
+            pthread_cond_wait(&data->not_full, &data->mutex);
+        }
+        data->send_waiters--;
+    } else {
+        data->recv_waiters++;
+        while (!data->closed && data->count == 0) {
+            pthread_cond_wait(&data->not_empty, &data->mutex);
+        }
+        data->recv_waiters--;
+    }
+    pthread_mutex_unlock(&data->mutex);
+
+    resume_vm_thread(vm, caller);
+}
 
-    // Wait if channel is full (bounded)
-    while (data->capacity > 0 && data->count >= data->capacity && !data->closed) {
-        pthread_cond_wait(&data->not_full, &data->mutex);
+// Turns a dequeued message into a value of this VM.
+static int channel_unwrap(VM* vm, ChannelSlot* slot, Value* out) {
+    if (slot->bytes == NULL) {
+        *out = slot->value;
+        return 1;
     }
+    int ok = binary_decode(vm, slot->bytes, slot->length, out);
+    free(slot->bytes);
+    slot->bytes = NULL;
+    if (!ok) vm_runtime_error(vm, "channel:recv: corrupt message.");
+    return ok;
+}
 
-    if (data->closed) {
+// list[index] of a Toi list, or 0 when it is nil.
+static int list_get(ObjTable* list, int index, Value* out) {
+    if (table_get_array(&list->table, index, out)) return 1;
+    return table_get_value(&list->table, NUMBER_VAL((double)index), out) && !IS_NIL(*out);
+}
+
+// Sends values[0..count) in order, waiting for room as needed. Returns
+// how many were sent (fewer if the channel closed), or -1 after raising
+// an error.
+static int channel_put(VM* vm, ChannelData* data, ObjTable* list, Value single, int count) {
+    int sent = 0;
+    while (sent < count) {
+        pthread_mutex_lock(&data->mutex);
+        if (data->closed) {
+            pthread_mutex_unlock(&data->mutex);
+            break;
+        }
+        int batch = 0;
+        int room = 1;
+        while (sent < count && (room = channel_reserve(data)) > 0) {
+            Value value = single;
+            if (list != NULL) list_get(list, sent + 1, &value);
+            if (!channel_push(vm, data, value)) {
+                room = -2;
+                break;
+            }
+            sent++;
+            batch++;
+        }
+        channel_wake(data, 1, batch);
         pthread_mutex_unlock(&data->mutex);
-        resume_vm_thread(vm, caller);
-        RETURN_FALSE;
+
+        if (room == -1) {
+            vm_runtime_error(vm, "channel:send: out of memory.");
+            return -1;
+        }
+        if (room == -2) {
+            vm_runtime_error(vm, "channel:send: value cannot be sent to another isolate.");
+            return -1;
+        }
+        if (sent < count) channel_wait(vm, data, 1);
     }
+    return sent;
+}
+
+// channel:send(value)
+static int channel_send(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    ASSERT_USERDATA(0);
 
-    // Add to queue
-    ChannelNode* node = (ChannelNode*)malloc(sizeof(ChannelNode));
-    node->value = value;
-    node->next = NULL;
+    ChannelData* data = (ChannelData*)GET_USERDATA(0)->data;
+    if (!data) { RETURN_FALSE; }
 
-    if (data->tail) {
-        data->tail->next = node;
-    } else {
-        data->head = node;
-    }
-    data->tail = node;
-    data->count++;
+    int sent = channel_put(vm, data, NULL, args[1], 1);
+    if (sent < 0) return 0;
+    RETURN_BOOL(sent == 1);
+}
 
-    pthread_cond_signal(&data->not_empty);
-    pthread_mutex_unlock(&data->mutex);
+// channel:send_many(list) - send list[1..#list] in order; returns the
+// number sent
+static int channel_send_many(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    ASSERT_USERDATA(0);
+    ASSERT_TABLE(1);
 
-    resume_vm_thread(vm, caller);
-    RETURN_TRUE;
+    ChannelData* data = (ChannelData*)GET_USERDATA(0)->data;
+    if (!data) { RETURN_NUMBER(0); }
+
+    ObjTable* list = GET_TABLE(1);
+    int count = 0;
+    Value value;
+    while (list_get(list, count + 1, &value)) count++;
+
+    int sent = channel_put(vm, data, list, NIL_VAL, count);
+    if (sent < 0) return 0;
+    RETURN_NUMBER(sent);
+}
+
+// Waits until the channel holds a message or is closed, then returns with
+// data->mutex held.
+static void channel_lock_ready(VM* vm, ChannelData* data) {
+    for (;;) {
+        pthread_mutex_lock(&data->mutex);
+        if (data->count > 0 || data->closed) return;
+        pthread_mutex_unlock(&data->mutex);
+        channel_wait(vm, data, 0);
+    }
 }
 
 // channel:recv()
@@ -511,34 +949,71 @@ static int channel_recv(VM* vm, int arg_count, Value* args) {
     ChannelData* data = (ChannelData*)GET_USERDATA(0)->data;
     if (!data) { RETURN_NIL; }
 
-    // Release lock while waiting on channel mutex/condition.
-    ObjThread* caller = suspend_vm_thread(vm);
-    pthread_mutex_lock(&data->mutex);
+    channel_lock_ready(vm, data);
+    if (data->count == 0) {
+        pthread_mutex_unlock(&data->mutex);
+        RETURN_NIL;
+    }
+    ChannelSlot slot = channel_pop(data);
+    channel_wake(data, 0, 1);
+    pthread_mutex_unlock(&data->mutex);
+
+    Value value;
+    if (!channel_unwrap(vm, &slot, &value)) return 0;
+    RETURN_VAL(value);
+}
+
+// channel:recv_many(n) - wait for at least one message, then take up to n
+// without waiting again; nil once the channel is closed and drained
+static int channel_recv_many(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    ASSERT_USERDATA(0);
+    ASSERT_NUMBER(1);
 
-    // Wait for data
-    while (data->count == 0 && !data->closed) {
-        pthread_cond_wait(&data->not_empty, &data->mutex);
+    ChannelData* data = (ChannelData*)GET_USERDATA(0)->data;
+    if (!data) { RETURN_NIL; }
+    double limit = GET_NUMBER(1);
+    if (limit < 1) {
+        vm_runtime_error(vm, "channel:recv_many expects a count of at least 1");
+        return 0;
     }
 
-    if (data->count == 0 && data->closed) {
+    channel_lock_ready(vm, data);
+    int n = data->count < limit ? data->count : (int)limit;
+    if (n == 0) {
         pthread_mutex_unlock(&data->mutex);
-        resume_vm_thread(vm, caller);
         RETURN_NIL;
     }
-
-    // Get from queue
-    ChannelNode* node = data->head;
-    Value value = node->value;
-    data->head = node->next;
-    if (!data->head) data->tail = NULL;
-    data->count--;
-    free(node);
-
-    pthread_cond_signal(&data->not_full);
+    ChannelSlot small[64];
+    ChannelSlot* batch = n <= 64 ? small : (ChannelSlot*)malloc((size_t)n * sizeof(ChannelSlot));
+    if (batch == NULL) {
+        pthread_mutex_unlock(&data->mutex);
+        vm_runtime_error(vm, "channel:recv_many: out of memory.");
+        return 0;
+    }
+    for (int i = 0; i < n; i++) {
+        batch[i] = channel_pop(data);
+    }
+    channel_wake(data, 0, n);
     pthread_mutex_unlock(&data->mutex);
 
-    resume_vm_thread(vm, caller);
-    RETURN_VAL(value);
+    // Natives never trigger a collection, so the popped values stay valid
+    // until they are stored in the result.
+    ObjTable* result = new_table();
+    push(vm, OBJ_VAL(result));
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        Value value;
+        if (ok && channel_unwrap(vm, &batch[i], &value)) {
+            table_set_array(&result->table, i + 1, value);
+        } else {
+            ok = 0;
+            free(batch[i].bytes);
+        }
+    }
+    if (batch != small) free(batch);
+    if (!ok) return 0;
+    return 1;
 }
 
 // channel:close()
@@ -553,6 +1028,9 @@ static int channel_close(VM* vm, int arg_count, Value* args) {
     data->closed = 1;
     pthread_cond_broadcast(&data->not_empty);
     pthread_cond_broadcast(&data->not_full);
+    for (SelectWaiter* w = data->selects; w != NULL; w = w->next) {
+        select_fire(w->selector);
+    }
     pthread_mutex_unlock(&data->mutex);
 
     RETURN_TRUE;
@@ -579,78 +1057,1668 @@ static int channel_tryrecv(VM* vm, int arg_count, Value* args) {
         return 2;
     }
 
-    ChannelNode* node = data->head;
-    Value value = node->value;
-    data->head = node->next;
-    if (!data->head) data->tail = NULL;
-    data->count--;
-    free(node);
-
-    pthread_cond_signal(&data->not_full);
+    ChannelSlot slot = channel_pop(data);
+    channel_wake(data, 0, 1);
     pthread_mutex_unlock(&data->mutex);
 
+    Value value;
+    if (!channel_unwrap(vm, &slot, &value)) return 0;
     push(vm, value);
     push(vm, BOOL_VAL(1));
     return 2;
 }
 
-void register_thread(VM* vm) {
-    // Initialize VM-state lock once.
-    if (!gil_initialized) {
-        gil_initialized = 1;
-        const char* no_gil = getenv("TOI_NO_GIL");
-        if (no_gil && (no_gil[0] == '1' || no_gil[0] == 'y' || no_gil[0] == 'Y')) {
-            no_gil_enabled = 1;
-            fprintf(stderr, "WARNING: TOI_NO_GIL enabled (experimental/unsafe).\n");
-            fprintf(stderr, "         Shared-VM execution may race or crash.\n");
+typedef struct {
+    ChannelData* data;
+    Value channel;
+    Value value;
+    int sending;
+} SelectCase;
+
+static TOI_THREAD_LOCAL unsigned int select_rotation = 0;
+
+// Can a case on this channel proceed? Caller holds data->mutex.
+static int channel_ready(ChannelData* data, int sending) {
+    if (data->closed) return 1;
+    if (sending) return data->capacity == 0 || data->count < data->capacity;
+    return data->count > 0;
+}
+
+// Attempts one case without waiting. Returns 1 with (channel, result)
+// pushed when it completed, 0 when it would block and -1 after raising an
+// error.
+static int select_try(VM* vm, SelectCase* c) {
+    ChannelData* data = c->data;
+    pthread_mutex_lock(&data->mutex);
+    if (c->sending) {
+        int room = data->closed ? 0 : channel_reserve(data);
+        if (room > 0 && !channel_push(vm, data, c->value)) room = -2;
+        if (room > 0) channel_wake(data, 1, 1);
+        int closed = data->closed;
+        pthread_mutex_unlock(&data->mutex);
+
+        if (room == -1) {
+            vm_runtime_error(vm, "thread.select: out of memory.");
+            return -1;
         }
-        if (!no_gil_enabled) {
-            acquire_gil();
+        if (room == -2) {
+            vm_runtime_error(vm, "thread.select: value cannot be sent to another isolate.");
+            return -1;
         }
+        if (room == 0 && !closed) return 0;
+        push(vm, c->channel);
+        push(vm, BOOL_VAL(room > 0));
+        return 1;
     }
 
-    const NativeReg thread_funcs[] = {
-        {"spawn", thread_spawn},
-        {"join", thread_join},
-        {"yield", thread_yield_native},
-        {"runtime_yield", thread_yield_native},
-        {"sleep", thread_sleep},
-        {"mutex", thread_mutex},
-        {"channel", thread_channel},
-        {NULL, NULL}
-    };
-    register_module(vm, "thread", thread_funcs);
-    ObjTable* thread_module = AS_TABLE(peek(vm, 0));
+    if (data->count == 0) {
+        int closed = data->closed;
+        pthread_mutex_unlock(&data->mutex);
+        if (!closed) return 0;
+        push(vm, c->channel);
+        push(vm, NIL_VAL);
+        return 1;
+    }
+    ChannelSlot slot = channel_pop(data);
+    channel_wake(data, 0, 1);
+    pthread_mutex_unlock(&data->mutex);
 
-    // Thread handle metatable
-    ObjTable* thread_mt = new_table();
-    push(vm, OBJ_VAL(thread_mt));
+    Value value;
+    if (!channel_unwrap(vm, &slot, &value)) return -1;
+    push(vm, c->channel);
+    push(vm, value);
+    return 1;
+}
 
-    const NativeReg thread_methods[] = {
-        {"join", thread_join},
-        {NULL, NULL}
-    };
+static int deadline_passed(const struct timespec* deadline) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return now.tv_sec > deadline->tv_sec ||
+           (now.tv_sec == deadline->tv_sec && now.tv_nsec >= deadline->tv_nsec);
+}
 
-    for (int i = 0; thread_methods[i].name != NULL; i++) {
-        ObjString* name_str = copy_string(thread_methods[i].name, (int)strlen(thread_methods[i].name));
-        push(vm, OBJ_VAL(name_str));
-        push(vm, OBJ_VAL(new_native(thread_methods[i].function, name_str)));
-        table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-        pop(vm);
-        pop(vm);
+// thread.select(cases, timeout?) - wait until one of several channel
+// operations can proceed. A case is a channel to receive from or a
+// {channel, value} pair to send. Returns the channel and the received
+// value (nil once closed), or for a send whether it was sent; nil, nil
+// when the timeout expires.
+static int thread_select(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    ASSERT_TABLE(0);
+
+    double timeout = -1; // wait forever
+    if (arg_count >= 2 && !IS_NIL(args[1])) {
+        ASSERT_NUMBER(1);
+        timeout = GET_NUMBER(1) < 0 ? 0 : GET_NUMBER(1);
     }
 
-    push(vm, OBJ_VAL(copy_string("__index", 7)));
-    push(vm, OBJ_VAL(thread_mt));
-    table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-    pop(vm); pop(vm);
+    ObjTable* list = GET_TABLE(0);
+    int count = 0;
+    Value entry;
+    while (list_get(list, count + 1, &entry)) count++;
+    if (count == 0 && timeout < 0) {
+        vm_runtime_error(vm, "thread.select needs at least one channel or a timeout");
+        return 0;
+    }
 
-    push(vm, OBJ_VAL(copy_string("__name", 6)));
-    push(vm, OBJ_VAL(copy_string("thread.handle", 13)));
-    table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
-    pop(vm); pop(vm);
+    SelectCase small_cases[8];
+    SelectWaiter small_waiters[8];
+    SelectCase* cases = small_cases;
+    SelectWaiter* waiters = small_waiters;
+    if (count > 8) {
+        cases = (SelectCase*)malloc((size_t)count * sizeof(SelectCase));
+        waiters = (SelectWaiter*)malloc((size_t)count * sizeof(SelectWaiter));
+        if (cases == NULL || waiters == NULL) {
+            free(cases);
+            free(waiters);
+            vm_runtime_error(vm, "thread.select: out of memory.");
+            return 0;
+        }
+    }
 
-    push(vm, OBJ_VAL(copy_string("_thread_mt", 10)));
+    for (int i = 0; i < count; i++) {
+        SelectCase* c = &cases[i];
+        list_get(list, i + 1, &entry);
+        c->channel = entry;
+        c->value = NIL_VAL;
+        c->sending = 0;
+        if (IS_TABLE(entry)) {
+            list_get(AS_TABLE(entry), 1, &c->channel);
+            list_get(AS_TABLE(entry), 2, &c->value);
+            c->sending = 1;
+        }
+        if (!is_channel(c->channel)) {
+            if (cases != small_cases) {
+                free(cases);
+                free(waiters);
+            }
+            vm_runtime_error(vm, "thread.select: case %d is not a channel or {channel, value} pair", i + 1);
+            return 0;
+        }
+        c->data = (ChannelData*)AS_USERDATA(c->channel)->data;
+    }
+
+    struct timespec deadline;
+    if (timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double whole = (double)(long)timeout;
+        deadline.tv_sec += (time_t)whole;
+        deadline.tv_nsec += (long)((timeout - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    Selector selector;
+    pthread_mutex_init(&selector.mutex, NULL);
+    pthread_cond_init(&selector.cond, NULL);
+
+    int result = 0;
+    for (;;) {
+        // Rotate the starting case so a busy channel cannot starve the rest.
+        unsigned int start = select_rotation++;
+        for (int k = 0; k < count && result == 0; k++) {
+            result = select_try(vm, &cases[(start + (unsigned int)k) % (unsigned int)count]);
+        }
+        if (result != 0 || timeout == 0 || (timeout > 0 && deadline_passed(&deadline))) break;
+
+        // Park on every channel; a case that became ready since the
+        // attempt above fires the selector right away.
+        selector.fired = 0;
+        for (int i = 0; i < count; i++) {
+            ChannelData* data = cases[i].data;
+            SelectWaiter* w = &waiters[i];
+            w->selector = &selector;
+            w->sending = cases[i].sending;
+            pthread_mutex_lock(&data->mutex);
+            w->prev = NULL;
+            w->next = data->selects;
+            if (data->selects != NULL) data->selects->prev = w;
+            data->selects = w;
+            if (channel_ready(data, w->sending)) select_fire(&selector);
+            pthread_mutex_unlock(&data->mutex);
+        }
+
+        ObjThread* caller = suspend_vm_thread(vm);
+        pthread_mutex_lock(&selector.mutex);
+        while (!selector.fired) {
+            if (timeout < 0) {
+                pthread_cond_wait(&selector.cond, &selector.mutex);
+            } else if (pthread_cond_timedwait(&selector.cond, &selector.mutex, &deadline) == ETIMEDOUT) {
+                break;
+            }
+        }
+        pthread_mutex_unlock(&selector.mutex);
+        resume_vm_thread(vm, caller);
+
+        for (int i = 0; i < count; i++) {
+            ChannelData* data = cases[i].data;
+            SelectWaiter* w = &waiters[i];
+            pthread_mutex_lock(&data->mutex);
+            if (w->prev != NULL) {
+                w->prev->next = w->next;
+            } else {
+                data->selects = w->next;
+            }
+            if (w->next != NULL) w->next->prev = w->prev;
+            pthread_mutex_unlock(&data->mutex);
+        }
+    }
+
+    pthread_cond_destroy(&selector.cond);
+    pthread_mutex_destroy(&selector.mutex);
+    if (cases != small_cases) {
+        free(cases);
+        free(waiters);
+    }
+
+    if (result < 0) return 0;
+    if (result == 0) {
+        push(vm, NIL_VAL);
+        push(vm, NIL_VAL);
+    }
+    return 2;
+}
+
+// Shared buffers. Elements are addressed by 1-based index in units of
+// their own width: i64 and f64 slot 1 is bytes 1..8, u8 slot 9 is byte 9.
+// Every access is atomic, so threads under different locks (isolates, or
+// TOI_NO_GIL) can update the same slots without tearing.
+
+#define SHARED_BUFFER_MAX ((double)(1u << 31))
+
+static void shared_buffer_release(void* ptr) {
+    SharedBuffer* buffer = (SharedBuffer*)ptr;
+    if (__atomic_sub_fetch(&buffer->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    if (buffer->mapped) {
+        munmap(buffer->bytes, (buffer->size + 7) / 8 * 8);
+    } else {
+        free(buffer->bytes);
+    }
+    free(buffer);
+}
+
+static ObjUserdata* wrap_shared_buffer(VM* vm, SharedBuffer* buffer) {
+    ObjUserdata* udata = new_userdata_with_finalizer(buffer, shared_buffer_release);
+    push(vm, OBJ_VAL(udata));
+    udata->metatable = thread_metatable(vm, "_shared_buffer_mt");
+    pop(vm);
+    return udata;
+}
+
+static int is_shared_buffer(Value value) {
+    return IS_USERDATA(value) && AS_USERDATA(value)->finalize == shared_buffer_release &&
+           AS_USERDATA(value)->data != NULL;
+}
+
+// thread.shared_buffer(nbytes, [opts]) - zero-filled memory visible to
+// every thread and isolate holding it; with opts.processes, also to
+// processes forked after it is created
+static int thread_shared_buffer(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    ASSERT_NUMBER(0);
+    double n = AS_NUMBER(args[0]);
+    if (!(n >= 1 && n <= SHARED_BUFFER_MAX) || n != (double)(size_t)n) {
+        vm_runtime_error(vm, "thread.shared_buffer size must be an integer from 1 to 2^31");
+        return 0;
+    }
+    int processes = 0;
+    if (arg_count >= 2 && IS_TABLE(args[1])) {
+        Value v;
+        ObjString* key = copy_string("processes", 9);
+        processes = table_get(&AS_TABLE(args[1])->table, key, &v) && IS_BOOL(v) && AS_BOOL(v);
+    }
+
+    SharedBuffer* buffer = (SharedBuffer*)calloc(1, sizeof(SharedBuffer));
+    size_t size = (size_t)n;
+    if (buffer != NULL && processes) {
+        // Anonymous shared pages come zero-filled and page aligned.
+        void* bytes = mmap(NULL, (size + 7) / 8 * 8, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        buffer->bytes = bytes == MAP_FAILED ? NULL : (uint8_t*)bytes;
+        buffer->mapped = 1;
+    } else if (buffer != NULL) {
+        // Whole 8-byte words, so every i64/f64 slot is aligned.
+        buffer->bytes = (uint8_t*)calloc((size + 7) / 8, 8);
+    }
+    if (buffer == NULL || buffer->bytes == NULL) {
+        free(buffer);
+        vm_runtime_error(vm, "thread.shared_buffer: out of memory for %.0f bytes", n);
+        return 0;
+    }
+    buffer->size = size;
+    buffer->refs = 1;
+    RETURN_OBJ(wrap_shared_buffer(vm, buffer));
+}
+
+// The address of element args[1] of `width` bytes in the buffer args[0].
+static void* buffer_slot(VM* vm, int arg_count, Value* args, size_t width, const char* method) {
+    if (arg_count < 2 || !is_shared_buffer(args[0])) {
+        vm_runtime_error(vm, "buffer:%s expects a thread.shared_buffer and an index", method);
+        return NULL;
+    }
+    if (!IS_NUMBER(args[1])) {
+        vm_runtime_error(vm, "buffer:%s index must be a number", method);
+        return NULL;
+    }
+    SharedBuffer* buffer = (SharedBuffer*)AS_USERDATA(args[0])->data;
+    double index = AS_NUMBER(args[1]);
+    size_t slots = buffer->size / width;
+    if (!(index >= 1 && index <= (double)slots) || index != (double)(size_t)index) {
+        vm_runtime_error(vm, "buffer:%s index %g out of range 1..%lu", method, index,
+                         (unsigned long)slots);
+        return NULL;
+    }
+    return buffer->bytes + ((size_t)index - 1) * width;
+}
+
+static int buffer_int(VM* vm, Value value, int64_t* out, const char* method) {
+    double d = IS_NUMBER(value) ? AS_NUMBER(value) : 0.5;
+    // 2^63 is exact as a double; the cast is undefined at or beyond it.
+    if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0) || d != (double)(int64_t)d) {
+        vm_runtime_error(vm, "buffer:%s expects an integer value", method);
+        return 0;
+    }
+    *out = (int64_t)d;
+    return 1;
+}
+
+static int buffer_float(VM* vm, Value value, double* out, const char* method) {
+    if (!IS_NUMBER(value)) {
+        vm_runtime_error(vm, "buffer:%s expects a number value", method);
+        return 0;
+    }
+    *out = AS_NUMBER(value);
+    return 1;
+}
+
+// buffer:len() - size in bytes
+static int shared_buffer_len(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    if (!is_shared_buffer(args[0])) {
+        vm_runtime_error(vm, "buffer:len expects a thread.shared_buffer");
+        return 0;
+    }
+    RETURN_NUMBER((double)((SharedBuffer*)AS_USERDATA(args[0])->data)->size);
+}
+
+static int shared_buffer_get_i64(VM* vm, int arg_count, Value* args) {
+    int64_t* slot = (int64_t*)buffer_slot(vm, arg_count, args, 8, "get_i64");
+    if (slot == NULL) return 0;
+    RETURN_NUMBER((double)__atomic_load_n(slot, __ATOMIC_SEQ_CST));
+}
+
+static int shared_buffer_set_i64(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    int64_t* slot = (int64_t*)buffer_slot(vm, arg_count, args, 8, "set_i64");
+    int64_t value;
+    if (slot == NULL || !buffer_int(vm, args[2], &value, "set_i64")) return 0;
+    __atomic_store_n(slot, value, __ATOMIC_SEQ_CST);
+    RETURN_NIL;
+}
+
+static int shared_buffer_get_f64(VM* vm, int arg_count, Value* args) {
+    double* slot = (double*)buffer_slot(vm, arg_count, args, 8, "get_f64");
+    if (slot == NULL) return 0;
+    double value;
+    __atomic_load(slot, &value, __ATOMIC_SEQ_CST);
+    RETURN_NUMBER(value);
+}
+
+static int shared_buffer_set_f64(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    double* slot = (double*)buffer_slot(vm, arg_count, args, 8, "set_f64");
+    double value;
+    if (slot == NULL || !buffer_float(vm, args[2], &value, "set_f64")) return 0;
+    __atomic_store(slot, &value, __ATOMIC_SEQ_CST);
+    RETURN_NIL;
+}
+
+static int shared_buffer_get_u8(VM* vm, int arg_count, Value* args) {
+    uint8_t* slot = (uint8_t*)buffer_slot(vm, arg_count, args, 1, "get_u8");
+    if (slot == NULL) return 0;
+    RETURN_NUMBER((double)__atomic_load_n(slot, __ATOMIC_SEQ_CST));
+}
+
+static int shared_buffer_set_u8(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    uint8_t* slot = (uint8_t*)buffer_slot(vm, arg_count, args, 1, "set_u8");
+    int64_t value;
+    if (slot == NULL || !buffer_int(vm, args[2], &value, "set_u8")) return 0;
+    if (value < 0 || value > 255) {
+        vm_runtime_error(vm, "buffer:set_u8 value must be 0..255");
+        return 0;
+    }
+    __atomic_store_n(slot, (uint8_t)value, __ATOMIC_SEQ_CST);
+    RETURN_NIL;
+}
+
+// buffer:add(index, delta) - atomic i64 add; returns the previous value
+static int shared_buffer_add(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    int64_t* slot = (int64_t*)buffer_slot(vm, arg_count, args, 8, "add");
+    int64_t delta;
+    if (slot == NULL || !buffer_int(vm, args[2], &delta, "add")) return 0;
+    RETURN_NUMBER((double)__atomic_fetch_add(slot, delta, __ATOMIC_SEQ_CST));
+}
+
+// buffer:add_f64(index, delta) - atomic f64 add; returns the previous value
+static int shared_buffer_add_f64(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    double* slot = (double*)buffer_slot(vm, arg_count, args, 8, "add_f64");
+    double delta;
+    if (slot == NULL || !buffer_float(vm, args[2], &delta, "add_f64")) return 0;
+    double old;
+    double sum;
+    __atomic_load(slot, &old, __ATOMIC_RELAXED);
+    do {
+        sum = old + delta;
+    } while (!__atomic_compare_exchange(slot, &old, &sum, 1, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+    RETURN_NUMBER(old);
+}
+
+// buffer:cas(index, expected, new) - atomic i64 compare-and-swap; returns
+// whether it swapped and the value it found
+static int shared_buffer_cas(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(4);
+    int64_t* slot = (int64_t*)buffer_slot(vm, arg_count, args, 8, "cas");
+    int64_t expected;
+    int64_t desired;
+    if (slot == NULL || !buffer_int(vm, args[2], &expected, "cas") ||
+        !buffer_int(vm, args[3], &desired, "cas")) {
+        return 0;
+    }
+    int swapped = __atomic_compare_exchange_n(slot, &expected, desired, 0, __ATOMIC_SEQ_CST,
+                                              __ATOMIC_SEQ_CST);
+    push(vm, BOOL_VAL(swapped));
+    push(vm, NUMBER_VAL((double)expected));
+    return 2;
+}
+
+// buffer:exchange(index, value) - atomic i64 swap; returns the previous value
+static int shared_buffer_exchange(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_EQ(3);
+    int64_t* slot = (int64_t*)buffer_slot(vm, arg_count, args, 8, "exchange");
+    int64_t value;
+    if (slot == NULL || !buffer_int(vm, args[2], &value, "exchange")) return 0;
+    RETURN_NUMBER((double)__atomic_exchange_n(slot, value, __ATOMIC_SEQ_CST));
+}
+
+static void free_isolate_data(IsolateData* data) {
+    for (int i = 0; i < data->arg_count; i++) {
+        free(data->args[i].bytes);
+        if (data->args[i].channel != NULL) channel_release(data->args[i].channel);
+        if (data->args[i].buffer != NULL) shared_buffer_release(data->args[i].buffer);
+    }
+    free(data->args);
+    free(data->code);
+    free(data->module);
+    free(data->result);
+    pthread_mutex_destroy(&data->lock);
+    free(data);
+}
+
+// Writes the message of the error just raised in `vm` to `buf`.
+static void capture_error(VM* vm, char* buf, size_t size, const char* fallback) {
+    ObjThread* t = vm_current_thread(vm);
+    Value error = t != NULL ? t->last_error : NIL_VAL;
+    if (IS_TABLE(error)) {
+        // error("...") raises {type = ..., msg = ...}
+        Value msg = NIL_VAL;
+        table_get(&AS_TABLE(error)->table, copy_string("msg", 3), &msg);
+        error = msg;
+    }
+    if (IS_STRING(error)) {
+        ObjString* msg = AS_STRING(error);
+        snprintf(buf, size, "%.*s", msg->length, msg->chars);
+    } else {
+        snprintf(buf, size, "%s", fallback);
+    }
+    if (t != NULL) t->last_error = NIL_VAL;
+}
+
+// Calls the function below the stack's top `arg_count` values with them
+// as arguments and leaves its result in their place. On failure the error
+// message is written to `buf`.
+static int call_entry(VM* vm, int arg_count, char* buf, size_t size) {
+    Value callee = peek(vm, arg_count);
+    if (!IS_CLOSURE(callee)) {
+        snprintf(buf, size, "Entry point is not a function");
+        return 0;
+    }
+    if (!call(vm, AS_CLOSURE(callee), arg_count)) {
+        capture_error(vm, buf, size, "Thread setup error");
+        return 0;
+    }
+    if (vm_run_entry(vm) != INTERPRET_OK) {
+        capture_error(vm, buf, size, "Thread execution error");
+        return 0;
+    }
+    return 1;
+}
+
+static int isolate_call(VM* vm, IsolateData* data, int arg_count) {
+    if (call_entry(vm, arg_count, data->error_msg, sizeof(data->error_msg))) return 1;
+    data->error = 1;
+    return 0;
+}
+
+static void run_isolate(VM* vm, IsolateData* data) {
+    ObjFunction* entry = NULL;
+    if (data->code != NULL) {
+        entry = toic_deserialize(data->code, data->code_length);
+    } else {
+        char source[320];
+        snprintf(source, sizeof(source), "return import %s\n", data->module);
+        entry = compile(source);
+    }
+    if (entry == NULL) {
+        data->error = 1;
+        snprintf(data->error_msg, sizeof(data->error_msg), "Could not load isolate code");
+        return;
+    }
+    push(vm, OBJ_VAL(new_closure(entry)));
+
+    // A module's export is the entry point: a function, or a table with
+    // a `main` function.
+    if (data->module != NULL) {
+        if (!isolate_call(vm, data, 0)) return;
+        Value exported = peek(vm, 0);
+        if (IS_TABLE(exported)) {
+            Value main_fn = NIL_VAL;
+            table_get(&AS_TABLE(exported)->table, copy_string("main", 4), &main_fn);
+            pop(vm);
+            push(vm, main_fn);
+        }
+    }
+
+    for (int i = 0; i < data->arg_count; i++) {
+        IsolateArg* arg = &data->args[i];
+        if (arg->channel != NULL) {
+            // The handle takes over the reference taken for this isolate.
+            push(vm, OBJ_VAL(wrap_channel(vm, arg->channel)));
+            arg->channel = NULL;
+            continue;
+        }
+        if (arg->buffer != NULL) {
+            push(vm, OBJ_VAL(wrap_shared_buffer(vm, arg->buffer)));
+            arg->buffer = NULL;
+            continue;
+        }
+        Value value = NIL_VAL;
+        if (!binary_decode(vm, arg->bytes, arg->length, &value)) {
+            data->error = 1;
+            snprintf(data->error_msg, sizeof(data->error_msg), "Corrupt isolate argument");
+            return;
+        }
+        push(vm, value);
+    }
+
+    if (!isolate_call(vm, data, data->arg_count)) return;
+    data->result = binary_encode(vm, peek(vm, 0), &data->result_length);
+    if (data->result == NULL) {
+        data->error = 1;
+        snprintf(data->error_msg, sizeof(data->error_msg), "Isolate result cannot be returned");
+    }
+}
+
+static void* isolate_runner(void* arg) {
+    IsolateData* data = (IsolateData*)arg;
+
+    GcHeap* heap = heap_new();
+    gc_heap = heap;
+    VM vm;
+    Gil isolate_gil;
+    init_gil(&isolate_gil, &vm);
+    thread_gil = &isolate_gil;
+    acquire_gil();
+
+    init_vm(&vm);
+    install_gil_hooks(&vm);
+    run_isolate(&vm, data);
+    free_vm(&vm);
+
+    release_gil();
+    heap_free(heap);
+    destroy_gil(&isolate_gil);
+
+    pthread_mutex_lock(&data->lock);
+    data->done = 1;
+    int detached = data->detached;
+    pthread_mutex_unlock(&data->lock);
+    if (detached) free_isolate_data(data);
+    return NULL;
+}
+
+// Finalizer of an isolate handle that was never joined.
+static void isolate_release(void* ptr) {
+    IsolateData* data = (IsolateData*)ptr;
+    pthread_mutex_lock(&data->lock);
+    if (data->done) {
+        pthread_mutex_unlock(&data->lock);
+        pthread_join(data->pthread, NULL);
+        free_isolate_data(data);
+        return;
+    }
+    data->detached = 1;
+    pthread_mutex_unlock(&data->lock);
+    pthread_detach(data->pthread);
+}
+
+static int valid_module_name(ObjString* name) {
+    if (name->length == 0 || name->length > 256) return 0;
+    for (int i = 0; i < name->length; i++) {
+        char c = name->chars[i];
+        if (!(c == '_' || c == '.' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+              (c >= '0' && c <= '9'))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// thread.isolate(fn_or_module, ...) - run on a new OS thread with its own
+// VM, heap and lock
+static int thread_isolate(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+
+    IsolateData* data = (IsolateData*)calloc(1, sizeof(IsolateData));
+    if (!data) {
+        RETURN_NIL;
+    }
+    pthread_mutex_init(&data->lock, NULL);
+
+    if (IS_CLOSURE(args[0])) {
+        ObjClosure* closure = AS_CLOSURE(args[0]);
+        if (closure->upvalue_count > 0) {
+            free_isolate_data(data);
+            vm_runtime_error(vm, "thread.isolate function cannot capture local variables.");
+            return 0;
+        }
+        data->code = toic_serialize(closure->function, &data->code_length);
+    } else if (IS_STRING(args[0]) && valid_module_name(AS_STRING(args[0]))) {
+        ObjString* name = AS_STRING(args[0]);
+        data->module = (char*)malloc((size_t)name->length + 1);
+        memcpy(data->module, name->chars, (size_t)name->length + 1);
+    } else {
+        free_isolate_data(data);
+        vm_runtime_error(vm, "thread.isolate requires a function or module name as first argument");
+        return 0;
+    }
+    if (data->code == NULL && data->module == NULL) {
+        free_isolate_data(data);
+        vm_runtime_error(vm, "thread.isolate could not copy the function.");
+        return 0;
+    }
+
+    data->arg_count = arg_count - 1;
+    if (data->arg_count > 0) {
+        data->args = (IsolateArg*)calloc((size_t)data->arg_count, sizeof(IsolateArg));
+    }
+    for (int i = 0; i < data->arg_count; i++) {
+        Value value = args[i + 1];
+        if (is_channel(value)) {
+            data->args[i].channel = (ChannelData*)AS_USERDATA(value)->data;
+            share_channel(vm, data->args[i].channel);
+            continue;
+        }
+        if (is_shared_buffer(value)) {
+            data->args[i].buffer = (SharedBuffer*)AS_USERDATA(value)->data;
+            __atomic_add_fetch(&data->args[i].buffer->refs, 1, __ATOMIC_ACQ_REL);
+            continue;
+        }
+        data->args[i].bytes = binary_encode(vm, value, &data->args[i].length);
+        if (data->args[i].bytes == NULL) {
+            free_isolate_data(data);
+            vm_runtime_error(vm, "thread.isolate argument %d cannot be copied.", i + 2);
+            return 0;
+        }
+    }
+
+    if (pthread_create(&data->pthread, NULL, isolate_runner, data) != 0) {
+        free_isolate_data(data);
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string("Failed to create thread", 23)));
+        return 2;
+    }
+
+    ObjUserdata* udata = new_userdata_with_finalizer(data, isolate_release);
+    push(vm, OBJ_VAL(udata));
+    udata->metatable = thread_metatable(vm, "_thread_mt");
+    return 1;
+}
+
+static int isolate_join(VM* vm, ObjUserdata* udata) {
+    IsolateData* data = (IsolateData*)udata->data;
+
+    ObjThread* caller = suspend_vm_thread(vm);
+    pthread_join(data->pthread, NULL);
+    resume_vm_thread(vm, caller);
+    udata->data = NULL;
+
+    if (data->error) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(data->error_msg, (int)strlen(data->error_msg))));
+        free_isolate_data(data);
+        return 2;
+    }
+
+    Value result = NIL_VAL;
+    int ok = binary_decode(vm, data->result, data->result_length, &result);
+    free_isolate_data(data);
+    if (!ok) {
+        vm_runtime_error(vm, "thread.join: corrupt isolate result.");
+        return 0;
+    }
+    RETURN_VAL(result);
+}
+
+// Worker pools. Each worker owns a deque of tasks: it runs its newest
+// task first and, when its deque is empty, steals the oldest task from
+// another worker. Workers of a shared-VM pool run under the VM lock on a
+// VM thread they keep for their lifetime; workers of an isolated pool
+// each own a VM and heap, and tasks reach them encoded.
+
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int done;
+    int error;
+    char error_msg[256];
+    Value result;           // Shared-VM pools
+    uint8_t* result_bytes;  // Isolated pools
+    size_t result_length;
+    int refs;               // The task plus the handle or pool:map call
+} FutureData;
+
+// A serialized function, shared by the tasks of an isolated pool.
+typedef struct {
+    int refs;
+    uint8_t* bytes;
+    size_t length;
+} PoolCode;
+
+typedef struct {
+    FutureData* future;
+    ObjClosure* closure;    // Shared-VM pools
+    Value* args;
+    int arg_count;
+    Value items;            // pool:map chunk: items[first..last]
+    Value out;              // Shared-VM map: results are stored here
+    int first;              // 0 for submitted tasks
+    int last;
+    PoolCode* code;         // Isolated pools
+    uint8_t* payload;       // Encoded argument list, or the map chunk
+    size_t payload_length;
+} PoolTask;
+
+typedef struct {
+    pthread_mutex_t lock;
+    PoolTask** tasks;       // Ring: the owner pops the newest, thieves the oldest
+    int capacity;
+    int head;
+    int count;
+} PoolDeque;
+
+struct PoolData;
+
+typedef struct {
+    struct PoolData* pool;
+    pthread_t pthread;
+    PoolDeque deque;
+    ObjThread* thread;      // Shared-VM pools
+    int index;
+} PoolWorker;
+
+typedef struct PoolData {
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    int pending;            // Tasks queued across all deques
+    int closed;             // No new tasks; workers drain and exit
+    int abandoned;          // Handle collected; queued tasks are dropped
+    int refs;               // The handle plus each running worker
+    int isolated;
+    int worker_count;
+    unsigned int next_worker;
+    PoolWorker* workers;
+    VM* vm;
+    Gil* gil;
+    GcHeap* heap;
+    ObjFunction* code_function; // Last function serialized for isolates
+    PoolCode* code;
+} PoolData;
+
+static TOI_THREAD_LOCAL PoolWorker* current_pool_worker = NULL;
+
+static FutureData* future_new(void) {
+    FutureData* future = (FutureData*)calloc(1, sizeof(FutureData));
+    if (future == NULL) return NULL;
+    pthread_mutex_init(&future->lock, NULL);
+    pthread_cond_init(&future->cond, NULL);
+    future->result = NIL_VAL;
+    future->refs = 2;
+    return future;
+}
+
+static void future_free(FutureData* future) {
+    free(future->result_bytes);
+    pthread_cond_destroy(&future->cond);
+    pthread_mutex_destroy(&future->lock);
+    free(future);
+}
+
+static void future_release(FutureData* future) {
+    pthread_mutex_lock(&future->lock);
+    int refs = --future->refs;
+    pthread_mutex_unlock(&future->lock);
+    if (refs == 0) future_free(future);
+}
+
+static void future_handle_release(void* ptr) {
+    future_release((FutureData*)ptr);
+}
+
+static void future_finish(FutureData* future, int error, const char* msg) {
+    pthread_mutex_lock(&future->lock);
+    future->done = 1;
+    future->error = error;
+    if (error) snprintf(future->error_msg, sizeof(future->error_msg), "%s", msg);
+    pthread_cond_broadcast(&future->cond);
+    pthread_mutex_unlock(&future->lock);
+}
+
+static void future_mark(void* ptr) {
+    FutureData* future = (FutureData*)ptr;
+    mark_value(future->result);
+}
+
+static void pool_code_release(PoolCode* code) {
+    if (code == NULL) return;
+    if (__atomic_sub_fetch(&code->refs, 1, __ATOMIC_ACQ_REL) > 0) return;
+    free(code->bytes);
+    free(code);
+}
+
+static void pool_task_free(PoolTask* task) {
+    free(task->args);
+    free(task->payload);
+    pool_code_release(task->code);
+    free(task);
+}
+
+static int deque_push(PoolDeque* deque, PoolTask* task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        int capacity = deque->capacity < 8 ? 8 : deque->capacity * 2;
+        PoolTask** tasks = (PoolTask**)malloc((size_t)capacity * sizeof(PoolTask*));
+        if (tasks == NULL) {
+            pthread_mutex_unlock(&deque->lock);
+            return 0;
+        }
+        for (int i = 0; i < deque->count; i++) {
+            tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->capacity = capacity;
+        deque->head = 0;
+    }
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+    return 1;
+}
+
+// Removes the newest task (`steal` = 0) or the oldest one.
+static PoolTask* deque_take(PoolDeque* deque, int steal) {
+    PoolTask* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count > 0) {
+        if (steal) {
+            task = deque->tasks[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        } else {
+            task = deque->tasks[(deque->head + deque->count - 1) % deque->capacity];
+        }
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return task;
+}
+
+static void pool_mark(void* ptr) {
+    PoolData* pool = (PoolData*)ptr;
+    for (int i = 0; i < pool->worker_count; i++) {
+        PoolWorker* worker = &pool->workers[i];
+        if (worker->thread != NULL) mark_object((struct Obj*)worker->thread);
+        PoolDeque* deque = &worker->deque;
+        pthread_mutex_lock(&deque->lock);
+        for (int j = 0; j < deque->count; j++) {
+            PoolTask* task = deque->tasks[(deque->head + j) % deque->capacity];
+            if (task->closure != NULL) mark_object((struct Obj*)task->closure);
+            for (int k = 0; k < task->arg_count; k++) mark_value(task->args[k]);
+            mark_value(task->items);
+            mark_value(task->out);
+        }
+        pthread_mutex_unlock(&deque->lock);
+    }
+}
+
+static void pool_enqueue(PoolData* pool, PoolTask* task) {
+    PoolWorker* worker = current_pool_worker;
+    if (worker == NULL || worker->pool != pool) {
+        worker = &pool->workers[pool->next_worker++ % (unsigned int)pool->worker_count];
+    }
+    if (!deque_push(&worker->deque, task)) {
+        future_finish(task->future, 1, "Out of memory queueing task");
+        future_release(task->future);
+        pool_task_free(task);
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->pending++;
+    pthread_cond_signal(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// The worker's own newest task, else the oldest task of another worker.
+static PoolTask* pool_take(PoolWorker* worker) {
+    PoolData* pool = worker->pool;
+    PoolTask* task = deque_take(&worker->deque, 0);
+    for (int i = 1; task == NULL && i < pool->worker_count; i++) {
+        task = deque_take(&pool->workers[(worker->index + i) % pool->worker_count].deque, 1);
+    }
+    if (task != NULL) {
+        pthread_mutex_lock(&pool->lock);
+        pool->pending--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return task;
+}
+
+// Parks until a task is queued. Returns 0 when the worker should exit.
+static int pool_wait(PoolData* pool) {
+    pthread_mutex_lock(&pool->lock);
+    while (pool->pending == 0 && !pool->closed && !pool->abandoned) {
+        pthread_cond_wait(&pool->work, &pool->lock);
+    }
+    int more = pool->pending > 0 && !pool->abandoned;
+    pthread_mutex_unlock(&pool->lock);
+    return more;
+}
+
+static void pool_release(PoolData* pool) {
+    pthread_mutex_lock(&pool->lock);
+    int refs = --pool->refs;
+    pthread_mutex_unlock(&pool->lock);
+    if (refs > 0) return;
+
+    for (int i = 0; i < pool->worker_count; i++) {
+        PoolDeque* deque = &pool->workers[i].deque;
+        PoolTask* task;
+        while ((task = deque_take(deque, 0)) != NULL) {
+            future_finish(task->future, 1, "Pool was closed");
+            future_release(task->future);
+            pool_task_free(task);
+        }
+        free(deque->tasks);
+        pthread_mutex_destroy(&deque->lock);
+    }
+    pool_code_release(pool->code);
+    free(pool->workers);
+    pthread_cond_destroy(&pool->work);
+    pthread_mutex_destroy(&pool->lock);
+    free(pool);
+}
+
+// Runs a shared-VM task on `thread`. Caller holds the VM lock.
+static void pool_run_shared(VM* vm, ObjThread* thread, PoolTask* task) {
+    FutureData* future = task->future;
+    char msg[256];
+    int ok = 1;
+
+    ObjThread* previous = vm_current_thread(vm);
+    vm_set_current_thread(vm, thread);
+    if (task->first == 0) {
+        push(vm, OBJ_VAL(task->closure));
+        for (int i = 0; i < task->arg_count; i++) push(vm, task->args[i]);
+        ok = call_entry(vm, task->arg_count, msg, sizeof(msg));
+        if (ok) future->result = pop(vm);
+    } else {
+        ObjTable* items = AS_TABLE(task->items);
+        ObjTable* out = AS_TABLE(task->out);
+        for (int i = task->first; ok && i <= task->last; i++) {
+            Value item = NIL_VAL;
+            list_get(items, i, &item);
+            push(vm, OBJ_VAL(task->closure));
+            push(vm, item);
+            ok = call_entry(vm, 1, msg, sizeof(msg));
+            if (ok) table_set_array(&out->table, i, pop(vm));
+        }
+    }
+    thread->stack_top = thread->stack;
+    thread->frame_count = 0;
+    thread->open_upvalues = NULL;
+    vm_set_current_thread(vm, previous);
+
+    future_finish(future, !ok, msg);
+    future_release(future);
+    pool_task_free(task);
+}
+
+static void* pool_shared_runner(void* arg) {
+    PoolWorker* worker = (PoolWorker*)arg;
+    PoolData* pool = worker->pool;
+    gc_heap = pool->heap;
+    thread_gil = pool->gil;
+    current_pool_worker = worker;
+
+    while (pool_wait(pool)) {
+        acquire_gil();
+        PoolTask* task = pool->abandoned ? NULL : pool_take(worker);
+        if (task != NULL) pool_run_shared(pool->vm, worker->thread, task);
+        release_gil();
+    }
+    pool_release(pool);
+    return NULL;
+}
+
+// Runs an isolated task. The worker keeps the closure for the last code
+// it loaded in stack slot 0.
+static void pool_run_isolated(VM* vm, PoolTask* task, PoolCode** loaded) {
+    FutureData* future = task->future;
+    ObjThread* thread = vm_current_thread(vm);
+    char msg[256];
+    int ok = 1;
+
+    if (task->code != *loaded) {
+        ObjFunction* function = toic_deserialize(task->code->bytes, task->code->length);
+        if (function == NULL) {
+            future_finish(future, 1, "Could not load task code");
+            future_release(future);
+            pool_task_free(task);
+            return;
+        }
+        thread->stack[0] = OBJ_VAL(new_closure(function));
+        pool_code_release(*loaded);
+        *loaded = task->code;
+        __atomic_add_fetch(&task->code->refs, 1, __ATOMIC_ACQ_REL);
+    }
+
+    Value input = NIL_VAL;
+    if (!binary_decode(vm, task->payload, task->payload_length, &input) || !IS_TABLE(input)) {
+        snprintf(msg, sizeof(msg), "Corrupt task arguments");
+        ok = 0;
+    }
+    Value result = NIL_VAL;
+    if (ok) {
+        push(vm, input);
+        ObjTable* list = AS_TABLE(input);
+        if (task->first == 0) {
+            int count = 0;
+            Value arg;
+            push(vm, thread->stack[0]);
+            while (list_get(list, count + 1, &arg)) {
+                push(vm, arg);
+                count++;
+            }
+            ok = call_entry(vm, count, msg, sizeof(msg));
+            if (ok) result = peek(vm, 0);
+        } else {
+            ObjTable* out = new_table();
+            push(vm, OBJ_VAL(out));
+            for (int i = 1; ok && i <= task->last - task->first + 1; i++) {
+                Value item = NIL_VAL;
+                list_get(list, i, &item);
+                push(vm, thread->stack[0]);
+                push(vm, item);
+                ok = call_entry(vm, 1, msg, sizeof(msg));
+                if (ok) table_set_array(&out->table, i, pop(vm));
+            }
+            result = OBJ_VAL(out);
+        }
+    }
+    if (ok) {
+        future->result_bytes = binary_encode(vm, result, &future->result_length);
+        if (future->result_bytes == NULL) {
+            snprintf(msg, sizeof(msg), "Task result cannot be returned");
+            ok = 0;
+        }
+    }
+    thread->stack_top = thread->stack + 1;
+    thread->frame_count = 0;
+    thread->open_upvalues = NULL;
+
+    future_finish(future, !ok, msg);
+    future_release(future);
+    pool_task_free(task);
+}
+
+static void* pool_isolated_runner(void* arg) {
+    PoolWorker* worker = (PoolWorker*)arg;
+    PoolData* pool = worker->pool;
+    current_pool_worker = worker;
+
+    GcHeap* heap = heap_new();
+    gc_heap = heap;
+    VM vm;
+    Gil worker_gil;
+    init_gil(&worker_gil, &vm);
+    thread_gil = &worker_gil;
+    acquire_gil();
+    init_vm(&vm);
+    install_gil_hooks(&vm);
+    push(&vm, NIL_VAL);
+
+    PoolCode* loaded = NULL;
+    for (;;) {
+        release_gil();
+        int more = pool_wait(pool);
+        acquire_gil();
+        if (!more) break;
+        PoolTask* task = pool_take(worker);
+        if (task != NULL) pool_run_isolated(&vm, task, &loaded);
+    }
+    pool_code_release(loaded);
+
+    free_vm(&vm);
+    release_gil();
+    heap_free(heap);
+    destroy_gil(&worker_gil);
+    pool_release(pool);
+    return NULL;
+}
+
+// Finalizer of a pool handle that was never closed: idle workers exit and
+// queued tasks are dropped.
+static void pool_handle_release(void* ptr) {
+    PoolData* pool = (PoolData*)ptr;
+    pthread_mutex_lock(&pool->lock);
+    pool->abandoned = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+    if (!pool->closed) {
+        for (int i = 0; i < pool->worker_count; i++) {
+            pthread_detach(pool->workers[i].pthread);
+        }
+    }
+    pool_release(pool);
+}
+
+// thread.pool(n, opts?) - start n worker threads; opts.isolated gives
+// each worker its own VM and heap
+static int thread_pool(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    ASSERT_NUMBER(0);
+    int count = (int)GET_NUMBER(0);
+    if (count < 1 || count > 1024) {
+        vm_runtime_error(vm, "thread.pool expects between 1 and 1024 workers");
+        return 0;
+    }
+    int isolated = 0;
+    if (arg_count >= 2 && IS_TABLE(args[1])) {
+        Value flag = NIL_VAL;
+        table_get(&AS_TABLE(args[1])->table, copy_string("isolated", 8), &flag);
+        isolated = !IS_NIL(flag) && !(IS_BOOL(flag) && !AS_BOOL(flag));
+    }
+
+    PoolData* pool = (PoolData*)calloc(1, sizeof(PoolData));
+    PoolWorker* workers = (PoolWorker*)calloc((size_t)count, sizeof(PoolWorker));
+    if (pool == NULL || workers == NULL) {
+        free(pool);
+        free(workers);
+        vm_runtime_error(vm, "thread.pool: out of memory");
+        return 0;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->work, NULL);
+    pool->isolated = isolated;
+    pool->workers = workers;
+    pool->vm = vm;
+    pool->gil = thread_gil;
+    pool->heap = gc_heap;
+    pool->refs = 1;
+
+    ObjUserdata* udata = new_userdata_with_hooks(pool, pool_handle_release, pool_mark);
+    push(vm, OBJ_VAL(udata));
+    udata->metatable = thread_metatable(vm, "_pool_mt");
+    if (!isolated) vm_enable_thread_tls(vm);
+
+    for (int i = 0; i < count; i++) {
+        PoolWorker* worker = &workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_mutex_init(&worker->deque.lock, NULL);
+        if (!isolated) {
+            worker->thread = new_thread();
+            worker->thread->vm = vm;
+        }
+        pool->worker_count = i + 1;
+        pool->refs++;
+        if (pthread_create(&worker->pthread, NULL,
+                           isolated ? pool_isolated_runner : pool_shared_runner, worker) != 0) {
+            pool->refs--;
+            pool->worker_count = i;
+            pthread_mutex_destroy(&worker->deque.lock);
+            break;
+        }
+    }
+    if (pool->worker_count == 0) {
+        vm_runtime_error(vm, "thread.pool: failed to create threads");
+        return 0;
+    }
+    return 1;
+}
+
+static PoolData* get_pool(VM* vm, Value value) {
+    if (!IS_USERDATA(value) || AS_USERDATA(value)->finalize != pool_handle_release) {
+        vm_runtime_error(vm, "Expected a thread.pool");
+        return NULL;
+    }
+    PoolData* pool = (PoolData*)AS_USERDATA(value)->data;
+    if (pool->closed) {
+        vm_runtime_error(vm, "thread.pool is closed");
+        return NULL;
+    }
+    return pool;
+}
+
+// For isolated pools: the serialized form of `closure`, reusing the last
+// one when the same function is submitted again.
+static PoolCode* pool_code_for(VM* vm, PoolData* pool, ObjClosure* closure) {
+    if (closure->upvalue_count > 0) {
+        vm_runtime_error(vm, "Isolated pool functions cannot capture local variables.");
+        return NULL;
+    }
+    if (pool->code == NULL || pool->code_function != closure->function) {
+        PoolCode* code = (PoolCode*)malloc(sizeof(PoolCode));
+        if (code == NULL) {
+            vm_runtime_error(vm, "thread.pool: out of memory");
+            return NULL;
+        }
+        code->refs = 1;
+        code->bytes = toic_serialize(closure->function, &code->length);
+        if (code->bytes == NULL) {
+            free(code);
+            vm_runtime_error(vm, "thread.pool could not copy the function.");
+            return NULL;
+        }
+        pool_code_release(pool->code);
+        pool->code = code;
+        pool->code_function = closure->function;
+    }
+    __atomic_add_fetch(&pool->code->refs, 1, __ATOMIC_ACQ_REL);
+    return pool->code;
+}
+
+// Encodes a Toi list of `count` values from `values` (or items[first..]).
+static uint8_t* encode_list(VM* vm, Value* values, ObjTable* items, int first, int count,
+                            size_t* out_len) {
+    ObjTable* list = new_table();
+    push(vm, OBJ_VAL(list));
+    for (int i = 0; i < count; i++) {
+        Value value = NIL_VAL;
+        if (values != NULL) {
+            value = values[i];
+        } else {
+            list_get(items, first + i, &value);
+        }
+        table_set_array(&list->table, i + 1, value);
+    }
+    uint8_t* bytes = binary_encode(vm, OBJ_VAL(list), out_len);
+    pop(vm);
+    return bytes;
+}
+
+static PoolTask* pool_task_new(VM* vm, PoolData* pool, ObjClosure* closure, FutureData* future) {
+    PoolTask* task = (PoolTask*)calloc(1, sizeof(PoolTask));
+    if (task == NULL) {
+        vm_runtime_error(vm, "thread.pool: out of memory");
+        return NULL;
+    }
+    task->future = future;
+    task->items = NIL_VAL;
+    task->out = NIL_VAL;
+    if (pool->isolated) {
+        task->code = pool_code_for(vm, pool, closure);
+        if (task->code == NULL) {
+            free(task);
+            return NULL;
+        }
+    } else {
+        task->closure = closure;
+    }
+    return task;
+}
+
+// pool:submit(fn, ...) - queue fn(...) and return a future for its result
+static int pool_submit(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(2);
+    PoolData* pool = get_pool(vm, args[0]);
+    if (pool == NULL) return 0;
+    if (!IS_CLOSURE(args[1])) {
+        vm_runtime_error(vm, "pool:submit requires a function");
+        return 0;
+    }
+
+    FutureData* future = future_new();
+    if (future == NULL) {
+        vm_runtime_error(vm, "thread.pool: out of memory");
+        return 0;
+    }
+    PoolTask* task = pool_task_new(vm, pool, AS_CLOSURE(args[1]), future);
+    if (task == NULL) {
+        future_free(future);
+        return 0;
+    }
+    int count = arg_count - 2;
+    if (pool->isolated) {
+        task->payload = encode_list(vm, args + 2, NULL, 0, count, &task->payload_length);
+        if (task->payload == NULL) {
+            pool_task_free(task);
+            future_free(future);
+            vm_runtime_error(vm, "pool:submit arguments cannot be copied to an isolated worker.");
+            return 0;
+        }
+    } else if (count > 0) {
+        task->args = (Value*)malloc((size_t)count * sizeof(Value));
+        for (int i = 0; i < count; i++) task->args[i] = args[i + 2];
+        task->arg_count = count;
+    }
+
+    ObjUserdata* udata = new_userdata_with_hooks(future, future_handle_release, future_mark);
+    push(vm, OBJ_VAL(udata));
+    udata->metatable = thread_metatable(vm, "_future_mt");
+    pool_enqueue(pool, task);
+    return 1;
+}
+
+// Waits for a future without the VM lock. Returns 0 on timeout.
+static int future_wait(VM* vm, FutureData* future, double timeout) {
+    pthread_mutex_lock(&future->lock);
+    int done = future->done;
+    pthread_mutex_unlock(&future->lock);
+    if (done || timeout == 0) return done;
+
+    struct timespec deadline;
+    if (timeout > 0) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        double whole = (double)(long)timeout;
+        deadline.tv_sec += (time_t)whole;
+        deadline.tv_nsec += (long)((timeout - whole) * 1e9);
+        if (deadline.tv_nsec >= 1000000000L) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+    }
+
+    ObjThread* caller = suspend_vm_thread(vm);
+    pthread_mutex_lock(&future->lock);
+    while (!future->done) {
+        if (timeout < 0) {
+            pthread_cond_wait(&future->cond, &future->lock);
+        } else if (pthread_cond_timedwait(&future->cond, &future->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    done = future->done;
+    pthread_mutex_unlock(&future->lock);
+    resume_vm_thread(vm, caller);
+    return done;
+}
+
+// A worker waiting on its own pool's future runs queued tasks meanwhile,
+// so nested submits cannot deadlock the pool.
+static void future_help(VM* vm, FutureData* future) {
+    PoolWorker* worker = current_pool_worker;
+    if (worker == NULL || worker->pool->isolated) return;
+    for (;;) {
+        pthread_mutex_lock(&future->lock);
+        int done = future->done;
+        pthread_mutex_unlock(&future->lock);
+        if (done) return;
+        PoolTask* task = pool_take(worker);
+        if (task == NULL) return;
+        ObjThread* helper = new_thread();
+        helper->vm = vm;
+        push(vm, OBJ_VAL(helper));
+        pool_run_shared(vm, helper, task);
+        pop(vm);
+    }
+}
+
+// future:result(timeout?) - the task's return value, waiting for it if
+// needed; nil, message if it raised an error; nil, "timeout" on timeout
+static int future_result(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    if (!IS_USERDATA(args[0]) || AS_USERDATA(args[0])->finalize != future_handle_release) {
+        vm_runtime_error(vm, "Expected a thread.future");
+        return 0;
+    }
+    FutureData* future = (FutureData*)AS_USERDATA(args[0])->data;
+    double timeout = -1;
+    if (arg_count >= 2 && !IS_NIL(args[1])) {
+        ASSERT_NUMBER(1);
+        timeout = GET_NUMBER(1) < 0 ? 0 : GET_NUMBER(1);
+    }
+
+    future_help(vm, future);
+    if (!future_wait(vm, future, timeout)) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string("timeout", 7)));
+        return 2;
+    }
+    if (future->error) {
+        push(vm, NIL_VAL);
+        push(vm, OBJ_VAL(copy_string(future->error_msg, (int)strlen(future->error_msg))));
+        return 2;
+    }
+    if (future->result_bytes != NULL) {
+        Value result = NIL_VAL;
+        if (!binary_decode(vm, future->result_bytes, future->result_length, &result)) {
+            vm_runtime_error(vm, "future:result: corrupt result.");
+            return 0;
+        }
+        RETURN_VAL(result);
+    }
+    RETURN_VAL(future->result);
+}
+
+// future:done() - whether the task has finished
+static int future_done(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    ASSERT_USERDATA(0);
+    FutureData* future = (FutureData*)GET_USERDATA(0)->data;
+    pthread_mutex_lock(&future->lock);
+    int done = future->done;
+    pthread_mutex_unlock(&future->lock);
+    RETURN_BOOL(done);
+}
+
+// pool:map(fn, items, chunk_size?) - {fn(items[1]), fn(items[2]), ...},
+// computed by the workers in chunks
+static int pool_map(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(3);
+    PoolData* pool = get_pool(vm, args[0]);
+    if (pool == NULL) return 0;
+    if (!IS_CLOSURE(args[1])) {
+        vm_runtime_error(vm, "pool:map requires a function");
+        return 0;
+    }
+    ASSERT_TABLE(2);
+    ObjClosure* closure = AS_CLOSURE(args[1]);
+    ObjTable* items = GET_TABLE(2);
+    int count = 0;
+    Value item;
+    while (list_get(items, count + 1, &item)) count++;
+
+    int chunk = 0;
+    if (arg_count >= 4 && IS_NUMBER(args[3])) chunk = (int)AS_NUMBER(args[3]);
+    if (chunk < 1) {
+        // About four chunks per worker evens out uneven items.
+        int chunks = pool->worker_count * 4;
+        chunk = (count + chunks - 1) / chunks;
+        if (chunk < 1) chunk = 1;
+    }
+
+    ObjTable* out = new_table();
+    push(vm, OBJ_VAL(out));
+    // Size the result up front: chunks finish out of order and the array
+    // part only grows by appending.
+    for (int i = 1; i <= count; i++) {
+        table_set_array(&out->table, i, BOOL_VAL(0));
+    }
+    int chunk_count = (count + chunk - 1) / chunk;
+    FutureData** futures = (FutureData**)calloc(chunk_count > 0 ? (size_t)chunk_count : 1,
+                                               sizeof(FutureData*));
+    if (futures == NULL) {
+        vm_runtime_error(vm, "thread.pool: out of memory");
+        return 0;
+    }
+
+    int ok = 1;
+    int queued = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        FutureData* future = future_new();
+        PoolTask* task = future != NULL ? pool_task_new(vm, pool, closure, future) : NULL;
+        if (task == NULL) {
+            if (future != NULL) future_free(future);
+            ok = 0;
+            break;
+        }
+        task->first = c * chunk + 1;
+        task->last = task->first + chunk - 1;
+        if (task->last > count) task->last = count;
+        if (pool->isolated) {
+            task->payload = encode_list(vm, NULL, items, task->first,
+                                        task->last - task->first + 1, &task->payload_length);
+            if (task->payload == NULL) {
+                pool_task_free(task);
+                future_free(future);
+                vm_runtime_error(vm, "pool:map items cannot be copied to an isolated worker.");
+                ok = 0;
+                break;
+            }
+        } else {
+            task->items = OBJ_VAL(items);
+            task->out = OBJ_VAL(out);
+        }
+        futures[queued++] = future;
+        pool_enqueue(pool, task);
+    }
+
+    // Wait for every queued chunk, even after a failure: shared-VM tasks
+    // write into `out`, which must stay reachable until they finish.
+    char error_msg[256] = "";
+    for (int c = 0; c < queued; c++) {
+        FutureData* future = futures[c];
+        future_help(vm, future);
+        future_wait(vm, future, -1);
+        if (ok && future->error) {
+            snprintf(error_msg, sizeof(error_msg), "%s", future->error_msg);
+            ok = 0;
+        }
+        if (ok && future->result_bytes != NULL) {
+            Value part = NIL_VAL;
+            if (!binary_decode(vm, future->result_bytes, future->result_length, &part) ||
+                !IS_TABLE(part)) {
+                snprintf(error_msg, sizeof(error_msg), "corrupt result");
+                ok = 0;
+            } else {
+                int first = c * chunk + 1;
+                Value value;
+                for (int i = 0; first + i <= count && i < chunk; i++) {
+                    value = NIL_VAL;
+                    list_get(AS_TABLE(part), i + 1, &value);
+                    table_set_array(&out->table, first + i, value);
+                }
+            }
+        }
+        future_release(future);
+    }
+    free(futures);
+
+    if (!ok) {
+        if (error_msg[0] != '\0') vm_runtime_error(vm, "pool:map: %s", error_msg);
+        return 0;
+    }
+    return 1;
+}
+
+// pool:close() - finish queued tasks, then stop the workers
+static int pool_close(VM* vm, int arg_count, Value* args) {
+    ASSERT_ARGC_GE(1);
+    if (!IS_USERDATA(args[0]) || AS_USERDATA(args[0])->finalize != pool_handle_release) {
+        vm_runtime_error(vm, "Expected a thread.pool");
+        return 0;
+    }
+    PoolData* pool = (PoolData*)AS_USERDATA(args[0])->data;
+    if (pool->closed) { RETURN_FALSE; }
+    if (current_pool_worker != NULL && current_pool_worker->pool == pool) {
+        vm_runtime_error(vm, "pool:close cannot be called from one of its own workers");
+        return 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    pool->closed = 1;
+    pthread_cond_broadcast(&pool->work);
+    pthread_mutex_unlock(&pool->lock);
+
+    ObjThread* caller = suspend_vm_thread(vm);
+    for (int i = 0; i < pool->worker_count; i++) {
+        pthread_join(pool->workers[i].pthread, NULL);
+    }
+    resume_vm_thread(vm, caller);
+    for (int i = 0; i < pool->worker_count; i++) {
+        pool->workers[i].thread = NULL;
+    }
+    RETURN_TRUE;
+}
+
+static void register_metatable(VM* vm, ObjTable* module, const char* key, const char* type_name,
+                               const NativeReg* methods) {
+    ObjTable* mt = new_table();
+    push(vm, OBJ_VAL(mt));
+    for (int i = 0; methods[i].name != NULL; i++) {
+        ObjString* name_str = copy_string(methods[i].name, (int)strlen(methods[i].name));
+        push(vm, OBJ_VAL(name_str));
+        push(vm, OBJ_VAL(new_native(methods[i].function, name_str)));
+        table_set(&mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+        pop(vm);
+        pop(vm);
+    }
+    table_set(&mt->table, copy_string("__index", 7), OBJ_VAL(mt));
+    push(vm, OBJ_VAL(copy_string(type_name, (int)strlen(type_name))));
+    table_set(&mt->table, copy_string("__name", 6), peek(vm, 0));
+    pop(vm);
+    table_set(&module->table, copy_string(key, (int)strlen(key)), OBJ_VAL(mt));
+    pop(vm); // mt
+}
+
+void register_thread(VM* vm) {
+    // Initialize VM-state lock once.
+    if (!gil_initialized) {
+        gil_initialized = 1;
+        const char* no_gil = getenv("TOI_NO_GIL");
+        if (no_gil && (no_gil[0] == '1' || no_gil[0] == 'y' || no_gil[0] == 'Y')) {
+            no_gil_enabled = 1;
+            fprintf(stderr, "WARNING: TOI_NO_GIL enabled (experimental/unsafe).\n");
+            fprintf(stderr, "         Shared-VM execution may race or crash.\n");
+        }
+        if (!no_gil_enabled) {
+            acquire_gil();
+        }
+    }
+    if (thread_gil->vm == NULL) thread_gil->vm = vm;
+    if (thread_gil->vm == vm) install_gil_hooks(vm);
+
+    const NativeReg thread_funcs[] = {
+        {"spawn", thread_spawn},
+        {"join", thread_join},
+        {"yield", thread_yield_native},
+        {"runtime_yield", thread_yield_native},
+        {"sleep", thread_sleep},
+        {"switch_interval", thread_switch_interval},
+        {"mutex", thread_mutex},
+        {"channel", thread_channel},
+        {"isolate", thread_isolate},
+        {"select", thread_select},
+        {"pool", thread_pool},
+        {"shared_buffer", thread_shared_buffer},
+        {NULL, NULL}
+    };
+    register_module(vm, "thread", thread_funcs);
+    ObjTable* thread_module = AS_TABLE(peek(vm, 0));
+
+    // Thread handle metatable
+    ObjTable* thread_mt = new_table();
+    push(vm, OBJ_VAL(thread_mt));
+
+    const NativeReg thread_methods[] = {
+        {"join", thread_join},
+        {NULL, NULL}
+    };
+
+    for (int i = 0; thread_methods[i].name != NULL; i++) {
+        ObjString* name_str = copy_string(thread_methods[i].name, (int)strlen(thread_methods[i].name));
+        push(vm, OBJ_VAL(name_str));
+        push(vm, OBJ_VAL(new_native(thread_methods[i].function, name_str)));
+        table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+        pop(vm);
+        pop(vm);
+    }
+
+    push(vm, OBJ_VAL(copy_string("__index", 7)));
+    push(vm, OBJ_VAL(thread_mt));
+    table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm); pop(vm);
+
+    push(vm, OBJ_VAL(copy_string("__name", 6)));
+    push(vm, OBJ_VAL(copy_string("thread.handle", 13)));
+    table_set(&thread_mt->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
+    pop(vm); pop(vm);
+
+    push(vm, OBJ_VAL(copy_string("_thread_mt", 10)));
     push(vm, OBJ_VAL(thread_mt));
     table_set(&thread_module->table, AS_STRING(peek(vm, 1)), peek(vm, 0));
     pop(vm); pop(vm);
@@ -698,7 +2766,9 @@ void register_thread(VM* vm) {
 
     const NativeReg channel_methods[] = {
         {"send", channel_send},
+        {"send_many", channel_send_many},
         {"recv", channel_recv},
+        {"recv_many", channel_recv_many},
         {"tryrecv", channel_tryrecv},
         {"close", channel_close},
         {NULL, NULL}
@@ -729,5 +2799,37 @@ void register_thread(VM* vm) {
     pop(vm); pop(vm);
     pop(vm); // channel_mt
 
+    const NativeReg pool_methods[] = {
+        {"submit", pool_submit},
+        {"map", pool_map},
+        {"close", pool_close},
+        {NULL, NULL}
+    };
+    register_metatable(vm, thread_module, "_pool_mt", "thread.pool", pool_methods);
+
+    const NativeReg future_methods[] = {
+        {"result", future_result},
+        {"done", future_done},
+        {NULL, NULL}
+    };
+    register_metatable(vm, thread_module, "_future_mt", "thread.future", future_methods);
+
+    const NativeReg shared_buffer_methods[] = {
+        {"len", shared_buffer_len},
+        {"get_i64", shared_buffer_get_i64},
+        {"set_i64", shared_buffer_set_i64},
+        {"get_f64", shared_buffer_get_f64},
+        {"set_f64", shared_buffer_set_f64},
+        {"get_u8", shared_buffer_get_u8},
+        {"set_u8", shared_buffer_set_u8},
+        {"add", shared_buffer_add},
+        {"add_f64", shared_buffer_add_f64},
+        {"cas", shared_buffer_cas},
+        {"exchange", shared_buffer_exchange},
+        {NULL, NULL}
+    };
+    register_metatable(vm, thread_module, "_shared_buffer_mt", "thread.shared_buffer",
+                       shared_buffer_methods);
+
     pop(vm); // thread_module
 }
@@ -745,7 +745,7 @@ static int toml_is_array_table(ObjTable* t) {
     if (t->table.array_max <= 0) return 0;
     for (int i = 0; i < t->table.capacity; i++) {
         Entry* e = &t->table.entries[i];
-        if (e->key != NULL && !IS_NIL(e->value)) return 0;
+        if (!IS_NIL(e->key) && !IS_NIL(e->value)) return 0;
     }
     return 1;
 }
@@ -843,9 +843,10 @@ static int toml_emit_inline_table(StrBuf* out, ObjTable* t, int depth) {
     int first = 1;
     for (int i = 0; i < t->table.capacity; i++) {
         Entry* e = &t->table.entries[i];
-        if (e->key == NULL || IS_NIL(e->value)) continue;
+        if (IS_NIL(e->key) || IS_NIL(e->value)) continue;
+        if (!IS_STRING(e->key)) return 0;
         if (!first && !sb_append(out, ", ", 2)) return 0;
-        if (!toml_emit_key(out, e->key)) return 0;
+        if (!toml_emit_key(out, AS_STRING(e->key))) return 0;
         if (!sb_append(out, " = ", 3)) return 0;
         if (!toml_emit_value(out, e->value, depth + 1)) return 0;
         first = 0;
@@ -862,14 +863,15 @@ static int toml_emit_table_body(StrBuf* out, ObjTable* table, ObjString** path,
 
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* e = &table->table.entries[i];
-        if (e->key == NULL || IS_NIL(e->value)) continue;
+        if (IS_NIL(e->key) || IS_NIL(e->value)) continue;
+        if (!IS_STRING(e->key)) return 0;
         if (IS_TABLE(e->value)) {
             ObjTable* t = AS_TABLE(e->value);
             if (toml_is_array_of_tables(t)) continue;
             if (!toml_is_array_table(t)) continue;
         }
 
-        if (!toml_emit_key(out, e->key)) return 0;
+        if (!toml_emit_key(out, AS_STRING(e->key))) return 0;
         if (!sb_append(out, " = ", 3)) return 0;
         if (!toml_emit_value(out, e->value, depth + 1)) return 0;
         if (!sb_append_char(out, '\n')) return 0;
@@ -877,22 +879,22 @@ static int toml_emit_table_body(StrBuf* out, ObjTable* table, ObjString** path,
 
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* e = &table->table.entries[i];
-        if (e->key == NULL || IS_NIL(e->value) || !IS_TABLE(e->value)) continue;
+        if (!IS_STRING(e->key) || IS_NIL(e->value) || !IS_TABLE(e->value)) continue;
         ObjTable* t = AS_TABLE(e->value);
         if (toml_is_array_table(t)) continue;
 
         if (!sb_append_char(out, '\n')) return 0;
-        path[path_len] = e->key;
+        path[path_len] = AS_STRING(e->key);
         if (!toml_emit_table(out, t, path, path_len + 1, depth + 1)) return 0;
     }
 
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* e = &table->table.entries[i];
-        if (e->key == NULL || IS_NIL(e->value) || !IS_TABLE(e->value)) continue;
+        if (!IS_STRING(e->key) || IS_NIL(e->value) || !IS_TABLE(e->value)) continue;
         ObjTable* t = AS_TABLE(e->value);
         if (!toml_is_array_of_tables(t)) continue;
 
-        path[path_len] = e->key;
+        path[path_len] = AS_STRING(e->key);
         if (!toml_emit_array_of_tables(out, t, path, path_len + 1, depth + 1)) return 0;
     }
 
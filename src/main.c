@@ -7,6 +7,7 @@
 #include "vm.h"
 #include "compiler.h"
 #include "repl.h"
+#include "toic.h"
 
 static int leading_indent_columns(const char* s, size_t len) {
     int col = 0;
@@ -343,15 +344,35 @@ static int run_fmt(int argc, char* argv[]) {
     return rc;
 }
 
+static int run_compile(int argc, char* argv[]) {
+    if (argc == 0) {
+        fprintf(stderr, "Usage: toi compile <path|dir>...\n");
+        return 64;
+    }
+
+    // The compiler allocates through the VM heap, so it needs a VM.
+    VM vm;
+    init_vm(&vm);
+    int rc = 0;
+    for (int i = 0; i < argc; i++) {
+        int path_rc = toic_compile_path(argv[i]);
+        if (rc == 0) rc = path_rc;
+    }
+    free_vm(&vm);
+    return rc;
+}
+
 int main(int argc, char* argv[]) {
     if (argc == 1) {
         start_repl();
     } else if (argc >= 2 && strcmp(argv[1], "fmt") == 0) {
         return run_fmt(argc - 2, argv + 2);
+    } else if (argc >= 2 && strcmp(argv[1], "compile") == 0) {
+        return run_compile(argc - 2, argv + 2);
     } else if (argc >= 2) {
         return run_file(argv[1], argc - 2, argv + 2);
     } else {
-        fprintf(stderr, "Usage: toi [path [args...]] | toi fmt [-w|--check] [path|-]\n");
+        fprintf(stderr, "Usage: toi [path [args...]] | toi fmt [-w|--check] [path|-] | toi compile <path|dir>...\n");
         exit(64);
     }
 
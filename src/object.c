@@ -3,11 +3,38 @@
 #include <stdlib.h>
 
 #include "object.h"
+#include "slab.h"
 #include "value.h"
 
-struct Obj* objects = NULL;
-size_t bytes_allocated = 0;
-size_t next_gc = 1024 * 1024; // 1MB initial threshold
+static GcHeap main_heap = {
+    .next_gc = 1024 * 1024, // 1MB initial threshold
+    .config = {1, 500, 0, 64, 128},
+    .phase = GC_IDLE,
+    .black = 1,
+};
+
+TOI_THREAD_LOCAL GcHeap* gc_heap = &main_heap;
+
+GcHeap* heap_new(void) {
+    GcHeap* heap = (GcHeap*)calloc(1, sizeof(GcHeap));
+    if (heap == NULL) {
+        fprintf(stderr, "Out of memory allocating GC heap.\n");
+        exit(1);
+    }
+    heap->next_gc = main_heap.next_gc;
+    heap->config = gc_heap->config;
+    heap->phase = GC_IDLE;
+    heap->black = 1;
+    init_table(&heap->strings);
+    return heap;
+}
+
+// A string the sweeper has not reached yet may be unmarked and still be
+// returned by the intern table; marking it keeps the sweeper off it.
+static ObjString* gc_revive_string(ObjString* string) {
+    if (gc_heap->phase == GC_SWEEPING) string->obj.is_marked = gc_heap->black;
+    return string;
+}
 
 // Simple FNV-1a hash function
 static uint32_t hash_string(const char* key, int length) {
@@ -20,41 +47,49 @@ static uint32_t hash_string(const char* key, int length) {
 }
 
 static struct Obj* allocate_object(size_t size, ObjType type) {
-    struct Obj* object = (struct Obj*)malloc(size);
+    struct Obj* object = (struct Obj*)slab_alloc(&gc_heap->slab, size);
     object->type = type;
-    object->is_marked = 0;
-    object->next = objects;
-    objects = object;
+    object->is_marked = !gc_heap->black;
+    object->next = gc_heap->objects;
+    gc_heap->objects = object;
     
-    bytes_allocated += size;
+    gc_heap->bytes_allocated += size;
     return object;
 }
 
-static ObjString* allocate_string(char* chars, int length, uint32_t hash) {
-    bytes_allocated += length + 1; // Track string content too
-    ObjString* string = (ObjString*)allocate_object(sizeof(ObjString), OBJ_STRING);
+static size_t string_size(int length) {
+    return sizeof(ObjString) + (size_t)length + 1;
+}
+
+static ObjString* allocate_string(const char* chars, int length, uint32_t hash) {
+    ObjString* string = (ObjString*)allocate_object(string_size(length), OBJ_STRING);
     string->length = length;
-    string->chars = chars;
     string->hash = hash;
+    memcpy(string->chars, chars, (size_t)length);
+    string->chars[length] = '\0';
+    table_set(&gc_heap->strings, string, NIL_VAL);
     return string;
 }
 
 ObjString* copy_string(const char* chars, int length) {
     uint32_t hash = hash_string(chars, length);
-    char* heap_chars = (char*)malloc(length + 1);
-    memcpy(heap_chars, chars, length);
-    heap_chars[length] = '\0';
-    return allocate_string(heap_chars, length, hash);
+    ObjString* interned = table_find_string(&gc_heap->strings, chars, length, hash);
+    if (interned != NULL) return gc_revive_string(interned);
+    return allocate_string(chars, length, hash);
 }
 
+// Takes ownership of a malloc'd buffer. The bytes are copied into the
+// string object, so the buffer is always freed.
 ObjString* take_string(char* chars, int length) {
-    uint32_t hash = hash_string(chars, length);
-    return allocate_string(chars, length, hash);
+    ObjString* string = copy_string(chars, length);
+    free(chars);
+    return string;
 }
 
 ObjTable* new_table() {
     ObjTable* table = (ObjTable*)allocate_object(sizeof(ObjTable), OBJ_TABLE);
     init_table(&table->table);
+    table->table.in_object = 1;
     table->metatable = NULL;
     table->is_module = 0;
     return table;
@@ -64,6 +99,7 @@ ObjFunction* new_function() {
     ObjFunction* function = (ObjFunction*)allocate_object(sizeof(ObjFunction), OBJ_FUNCTION);
     function->arity = 0;
     function->upvalue_count = 0;
+    function->max_locals = 0;
     function->name = NULL;
     function->doc = NULL;
     function->defaults = NULL;
@@ -96,18 +132,19 @@ ObjUpvalue* new_upvalue(Value* slot) {
     return upvalue;
 }
 
-ObjClosure* new_closure(ObjFunction* function) {
-    // Allocate upvalues array - will be filled in by VM/compiler
-    ObjUpvalue** upvalues = (ObjUpvalue**)malloc(sizeof(ObjUpvalue*) * 256);
-    for (int i = 0; i < 256; i++) {
-        upvalues[i] = NULL;
-    }
+static size_t closure_size(int upvalue_count) {
+    return sizeof(ObjClosure) + sizeof(ObjUpvalue*) * (size_t)upvalue_count;
+}
 
-    ObjClosure* closure = (ObjClosure*)allocate_object(sizeof(ObjClosure), OBJ_CLOSURE);
+ObjClosure* new_closure(ObjFunction* function) {
+    int count = function->upvalue_count;
+    ObjClosure* closure = (ObjClosure*)allocate_object(closure_size(count), OBJ_CLOSURE);
     closure->function = function;
-    closure->upvalues = upvalues;
-    closure->upvalue_count = 0;  // Will be set by compiler
-    bytes_allocated += sizeof(ObjUpvalue*) * 256;
+    closure->upvalue_count = count;
+    // Filled in by OP_CLOSURE; NULL slots are skipped by the collector.
+    for (int i = 0; i < count; i++) {
+        closure->upvalues[i] = NULL;
+    }
     return closure;
 }
 
@@ -141,9 +178,10 @@ ObjThread* new_thread_with_caps(int stack_cap, int frame_cap, int handler_cap) {
     thread->exception = NIL_VAL;
     thread->last_error = NIL_VAL;
     thread->pending_set_local_count = 0;
-    bytes_allocated += sizeof(Value) * (size_t)stack_cap;
-    bytes_allocated += sizeof(CallFrame) * (size_t)frame_cap;
-    bytes_allocated += sizeof(ExceptionHandler) * (size_t)handler_cap;
+    gc_remember((struct Obj*)thread);
+    gc_heap->bytes_allocated += sizeof(Value) * (size_t)stack_cap;
+    gc_heap->bytes_allocated += sizeof(CallFrame) * (size_t)frame_cap;
+    gc_heap->bytes_allocated += sizeof(ExceptionHandler) * (size_t)handler_cap;
     return thread;
 }
 
@@ -165,6 +203,20 @@ ObjUserdata* new_userdata_with_hooks(void* data, UserdataFinalizer finalize, Use
     userdata->finalize = finalize;
     userdata->mark = mark;
     userdata->metatable = NULL;
+    userdata->inline_size = 0;
+    gc_remember((struct Obj*)userdata);
+    return userdata;
+}
+
+ObjUserdata* new_userdata_inline(size_t size, UserdataMarker mark) {
+    ObjUserdata* userdata = (ObjUserdata*)allocate_object(sizeof(ObjUserdata) + size, OBJ_USERDATA);
+    userdata->data = (void*)(userdata + 1);
+    memset(userdata->data, 0, size);
+    userdata->finalize = NULL;
+    userdata->mark = mark;
+    userdata->metatable = NULL;
+    userdata->inline_size = size;
+    gc_remember((struct Obj*)userdata);
     return userdata;
 }
 
@@ -188,9 +240,10 @@ static ObjString* metatable_name(ObjTable* metatable) {
     if (metatable == NULL) return NULL;
     for (int i = 0; i < metatable->table.capacity; i++) {
         Entry* entry = &metatable->table.entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
-        if (entry->key->length == 6 &&
-            memcmp(entry->key->chars, "__name", 6) == 0 &&
+        if (!IS_STRING(entry->key) || IS_NIL(entry->value)) continue;
+        ObjString* key = AS_STRING(entry->key);
+        if (key->length == 6 &&
+            memcmp(key->chars, "__name", 6) == 0 &&
             IS_STRING(entry->value)) {
             return AS_STRING(entry->value);
         }
@@ -225,13 +278,19 @@ static void print_table(ObjTable* table, int depth) {
     // Hash part
     for (int i = 0; i < table->table.capacity; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key != NULL && !IS_NIL(entry->value)) {
-            if (entry->key->length == 7 &&
-                memcmp(entry->key->chars, "__index", 7) == 0) {
+        if (!IS_NIL(entry->key) && !IS_NIL(entry->value)) {
+            if (IS_STRING(entry->key) &&
+                AS_STRING(entry->key)->length == 7 &&
+                memcmp(AS_CSTRING(entry->key), "__index", 7) == 0) {
                 continue;
             }
             if (count > 0) printf(", ");
-            printf("%s: ", entry->key->chars);
+            if (IS_STRING(entry->key)) {
+                printf("%s: ", AS_CSTRING(entry->key));
+            } else {
+                print_value(entry->key);
+                printf(": ");
+            }
             print_value_rec(entry->value, depth + 1);
             count++;
         }
@@ -346,15 +405,64 @@ void print_object(Value value) {
 
 static void mark_table(Table* table);
 
+// Tables with more slots than this are traced a slice per drain iteration,
+// so a single huge table cannot blow an incremental step's budget.
+#define GC_TABLE_SLICE 1024
+
+typedef struct TableCursor {
+    ObjTable* table;
+    int capacity;     // Hash capacity when hash_index was last valid.
+    int hash_index;
+    int array_index;
+} TableCursor;
+
+static void push_table_cursor(ObjTable* table) {
+    if (gc_heap->table_cursor_count == gc_heap->table_cursor_capacity) {
+        int capacity = gc_heap->table_cursor_capacity < 16 ? 16 : gc_heap->table_cursor_capacity * 2;
+        TableCursor* grown = (TableCursor*)realloc(gc_heap->table_cursors, sizeof(TableCursor) * (size_t)capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Out of memory growing GC table cursors.\n");
+            exit(1);
+        }
+        gc_heap->table_cursors = grown;
+        gc_heap->table_cursor_capacity = capacity;
+    }
+    TableCursor* cursor = &gc_heap->table_cursors[gc_heap->table_cursor_count++];
+    cursor->table = table;
+    cursor->capacity = table->table.capacity;
+    cursor->hash_index = 0;
+    cursor->array_index = 0;
+}
+
+static void blacken_object(struct Obj* object);
+
 void mark_object(struct Obj* object) {
     if (object == NULL) return;
-    if (object->is_marked) return;
-
-    object->is_marked = 1;
+    if (gc_is_marked(object)) return;
+
+    object->is_marked = gc_heap->black;
+    if (object->type == OBJ_STRING) return;  // No children to trace.
+    if (gc_heap->gray_count == gc_heap->gray_capacity) {
+        int capacity = gc_heap->gray_capacity < 256 ? 256 : gc_heap->gray_capacity * 2;
+        struct Obj** grown = (struct Obj**)realloc(gc_heap->gray_stack, sizeof(struct Obj*) * (size_t)capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Out of memory growing GC gray stack.\n");
+            exit(1);
+        }
+        gc_heap->gray_stack = grown;
+        gc_heap->gray_capacity = capacity;
+    }
+    gc_heap->gray_stack[gc_heap->gray_count++] = object;
+}
 
+static void blacken_object(struct Obj* object) {
     if (object->type == OBJ_TABLE) {
         ObjTable* table = (ObjTable*)object;
-        mark_table(&table->table);
+        if (table->table.capacity + table->table.array_capacity > GC_TABLE_SLICE) {
+            push_table_cursor(table);
+        } else {
+            mark_table(&table->table);
+        }
         if (table->metatable) {
             mark_object((struct Obj*)table->metatable);
         }
@@ -455,87 +563,87 @@ void mark_value(Value value) {
     if (IS_OBJ(value)) mark_object(AS_OBJ(value));
 }
 
+// Most slots of a large table point at objects that are already marked.
+#define MARK_SLOT(value) \
+    do { \
+        if (IS_OBJ(value) && !gc_is_marked(AS_OBJ(value))) mark_object(AS_OBJ(value)); \
+    } while (0)
+
 static void mark_table(Table* table) {
     for (int i = 0; i < table->capacity; i++) {
         Entry* entry = &table->entries[i];
-        if (entry->key != NULL) {
-            mark_object((struct Obj*)entry->key);
-            mark_value(entry->value);
+        if (!IS_NIL(entry->key)) {
+            MARK_SLOT(entry->key);
+            MARK_SLOT(entry->value);
         }
     }
     // Mark array part
     for (int i = 0; i < table->array_capacity; i++) {
-        if (!IS_NIL(table->array[i])) {
-            mark_value(table->array[i]);
-        }
+        MARK_SLOT(table->array[i]);
     }
 }
 
+// Returns the object's slot to the allocator with the size it was
+// allocated with; bytes_allocated drops by the same amount.
+static void release_slot(struct Obj* object, size_t size) {
+    gc_heap->bytes_allocated -= size;
+    slab_free(&gc_heap->slab, object, size);
+}
+
 void free_object(struct Obj* object) {
     switch (object->type) {
         case OBJ_STRING: {
             ObjString* string = (ObjString*)object;
-            bytes_allocated -= string->length + 1;
-            bytes_allocated -= sizeof(ObjString);
-            free(string->chars);
-            free(string);
+            release_slot(object, string_size(string->length));
             break;
         }
         case OBJ_TABLE: {
             ObjTable* table = (ObjTable*)object;
             // Note: Table entries size is complex to track perfectly here, 
             // but we can estimate or just track the table struct.
-            bytes_allocated -= sizeof(ObjTable);
             free_table(&table->table);
-            free(table);
+            release_slot(object, sizeof(ObjTable));
             break;
         }
         case OBJ_FUNCTION: {
             ObjFunction* function = (ObjFunction*)object;
             free_chunk(&function->chunk);
             if (function->defaults != NULL) {
-                bytes_allocated -= sizeof(Value) * function->defaults_count;
+                gc_heap->bytes_allocated -= sizeof(Value) * function->defaults_count;
                 free(function->defaults);
             }
             if (function->param_types != NULL) {
-                bytes_allocated -= sizeof(uint8_t) * function->param_types_count;
+                gc_heap->bytes_allocated -= sizeof(uint8_t) * function->param_types_count;
                 free(function->param_types);
             }
             if (function->param_names != NULL) {
                 free(function->param_names);
             }
-            bytes_allocated -= sizeof(ObjFunction);
-            free(function);
+            release_slot(object, sizeof(ObjFunction));
             break;
         }
         case OBJ_NATIVE: {
-            bytes_allocated -= sizeof(ObjNative);
-            free(object);
+            release_slot(object, sizeof(ObjNative));
             break;
         }
         case OBJ_UPVALUE: {
-            bytes_allocated -= sizeof(ObjUpvalue);
-            free(object);
+            release_slot(object, sizeof(ObjUpvalue));
             break;
         }
         case OBJ_CLOSURE: {
             ObjClosure* closure = (ObjClosure*)object;
-            bytes_allocated -= sizeof(ObjUpvalue*) * 256;
-            bytes_allocated -= sizeof(ObjClosure);
-            free(closure->upvalues);
-            free(closure);
+            release_slot(object, closure_size(closure->upvalue_count));
             break;
         }
         case OBJ_THREAD: {
             ObjThread* thread = (ObjThread*)object;
-            bytes_allocated -= sizeof(ObjThread);
-            bytes_allocated -= sizeof(Value) * (size_t)thread->stack_capacity;
-            bytes_allocated -= sizeof(CallFrame) * (size_t)thread->frame_capacity;
-            bytes_allocated -= sizeof(ExceptionHandler) * (size_t)thread->handler_capacity;
+            gc_heap->bytes_allocated -= sizeof(Value) * (size_t)thread->stack_capacity;
+            gc_heap->bytes_allocated -= sizeof(CallFrame) * (size_t)thread->frame_capacity;
+            gc_heap->bytes_allocated -= sizeof(ExceptionHandler) * (size_t)thread->handler_capacity;
             free(thread->stack);
             free(thread->frames);
             free(thread->handlers);
-            free(object);
+            release_slot(object, sizeof(ObjThread));
             break;
         }
         case OBJ_USERDATA: {
@@ -544,41 +652,217 @@ void free_object(struct Obj* object) {
                 userdata->finalize(userdata->data);
                 userdata->data = NULL;
             }
-            bytes_allocated -= sizeof(ObjUserdata);
-            free(object);
+            release_slot(object, sizeof(ObjUserdata) + userdata->inline_size);
             break;
         }
         case OBJ_BOUND_METHOD: {
-            bytes_allocated -= sizeof(ObjBoundMethod);
-            free(object);
+            release_slot(object, sizeof(ObjBoundMethod));
             break;
         }
     }
 }
 
 
-void sweep_objects() {
-    struct Obj* previous = NULL;
-    struct Obj* object = objects;
-    
-    while (object != NULL) {
-        if (object->is_marked) {
-            object->is_marked = 0; // Unmark for next cycle
-            previous = object;
-            object = object->next;
+void gc_remember(struct Obj* object) {
+    if (gc_heap->remembered_count == gc_heap->remembered_capacity) {
+        int capacity = gc_heap->remembered_capacity < 64 ? 64 : gc_heap->remembered_capacity * 2;
+        struct Obj** grown = (struct Obj**)realloc(gc_heap->remembered, sizeof(struct Obj*) * (size_t)capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Out of memory growing GC remembered set.\n");
+            exit(1);
+        }
+        gc_heap->remembered = grown;
+        gc_heap->remembered_capacity = capacity;
+    }
+    gc_heap->remembered[gc_heap->remembered_count++] = object;
+}
+
+// Unmarked entries are either unreachable or will be traced when reached.
+void gc_trace_remembered(void) {
+    for (int i = 0; i < gc_heap->remembered_count; i++) {
+        struct Obj* object = gc_heap->remembered[i];
+        if (gc_is_marked(object)) {
+            blacken_object(object);
+        }
+    }
+}
+
+// Called once tracing is complete, before the sweep frees anything.
+static void gc_forget_unmarked(void) {
+    int kept = 0;
+    for (int i = 0; i < gc_heap->remembered_count; i++) {
+        if (gc_is_marked(gc_heap->remembered[i])) {
+            gc_heap->remembered[kept++] = gc_heap->remembered[i];
+        }
+    }
+    gc_heap->remembered_count = kept;
+}
+
+// Traces up to GC_TABLE_SLICE slots; returns 1 once the table is done.
+// Array slots never move without a barrier, but growing the hash part
+// rehashes every entry, so the hash scan starts over when that happens.
+static int trace_table_slice(TableCursor* cursor) {
+    Table* table = &cursor->table->table;
+    if (table->capacity != cursor->capacity) {
+        cursor->capacity = table->capacity;
+        cursor->hash_index = 0;
+    }
+    int left = GC_TABLE_SLICE;
+    while (cursor->hash_index < table->capacity && left-- > 0) {
+        Entry* entry = &table->entries[cursor->hash_index++];
+        if (!IS_NIL(entry->key)) {
+            MARK_SLOT(entry->key);
+            MARK_SLOT(entry->value);
+        }
+    }
+    while (cursor->array_index < table->array_capacity && left-- > 0) {
+        MARK_SLOT(table->array[cursor->array_index]);
+        cursor->array_index++;
+    }
+    return cursor->hash_index >= table->capacity && cursor->array_index >= table->array_capacity;
+}
+
+// A table slice counts as this many objects against the budget.
+#define GC_TABLE_SLICE_WORK 32
+
+int gc_drain_gray(long budget) {
+    while (gc_heap->gray_count > 0 || gc_heap->table_cursor_count > 0) {
+        if (budget == 0) return 0;
+        long work = 1;
+        if (gc_heap->gray_count > 0) {
+            blacken_object(gc_heap->gray_stack[--gc_heap->gray_count]);
         } else {
-            struct Obj* unreached = object;
-            object = object->next;
-            if (previous != NULL) {
-                previous->next = object;
-            } else {
-                objects = object;
+            if (trace_table_slice(&gc_heap->table_cursors[gc_heap->table_cursor_count - 1])) {
+                gc_heap->table_cursor_count--;
             }
-            free_object(unreached);
+            work = GC_TABLE_SLICE_WORK;
         }
+        if (budget > 0) budget = budget > work ? budget - work : 0;
     }
-    
+    return 1;
+}
+
+void heap_free(GcHeap* heap) {
+    GcHeap* saved = gc_heap;
+    gc_heap = heap;
+    struct Obj* lists[3] = {heap->objects, heap->old_objects, heap->sweep_young};
+    for (int i = 0; i < 3; i++) {
+        struct Obj* object = lists[i];
+        while (object != NULL) {
+            struct Obj* next = object->next;
+            free_object(object);
+            object = next;
+        }
+    }
+    free_table(&heap->strings);
+    free(heap->gray_stack);
+    free(heap->remembered);
+    free(heap->table_cursors);
+    slab_release(&heap->slab);
+    gc_heap = saved;
+    free(heap);
+}
+
+static void release_object(struct Obj* object) {
+    if (object->type == OBJ_STRING) {
+        table_delete_value(&gc_heap->strings, OBJ_VAL(object));
+    }
+    free_object(object);
+}
+
+// Moves a marked nursery object to the old list. It keeps its mark bit.
+static void promote_object(struct Obj* object) {
+    object->next = gc_heap->old_objects;
+    gc_heap->old_objects = object;
+}
+
+void sweep_young_objects(void) {
+    gc_forget_unmarked();
+
+    struct Obj* object = gc_heap->objects;
+    gc_heap->objects = NULL;
+    while (object != NULL) {
+        struct Obj* next = object->next;
+        if (gc_is_marked(object)) {
+            promote_object(object);
+        } else {
+            release_object(object);
+        }
+        object = next;
+    }
+}
+
+// Flipping gc_black whitens the old heap in O(1). The nursery is rewhitened
+// by hand: its unmarked objects would otherwise read as marked, and objects
+// the barrier marked since the last minor collection are traced again from
+// the roots anyway.
+void gc_begin_major(void) {
+    gc_heap->black = !gc_heap->black;
+    for (struct Obj* object = gc_heap->objects; object != NULL; object = object->next) {
+        object->is_marked = !gc_heap->black;
+    }
+    gc_heap->gray_count = 0;
+    gc_heap->table_cursor_count = 0;
+    gc_heap->phase = GC_MARKING;
+}
+
+void gc_finish_mark(void) {
+    gc_forget_unmarked();
+    gc_heap->sweep_young = gc_heap->objects;
+    gc_heap->objects = NULL;
+    gc_heap->sweep_link = &gc_heap->old_objects;
+    gc_heap->phase = GC_SWEEPING;
+}
+
+int gc_sweep_step(long budget) {
+    // Objects allocated before marking finished: promote or free.
+    while (gc_heap->sweep_young != NULL) {
+        if (budget >= 0 && budget-- == 0) return 0;
+        struct Obj* object = gc_heap->sweep_young;
+        gc_heap->sweep_young = object->next;
+        if (gc_is_marked(object)) {
+            promote_object(object);
+        } else {
+            release_object(object);
+        }
+    }
+
+    // Minor collections may push promoted objects in front of sweep_link
+    // meanwhile; they are marked and are simply stepped over.
+    while (*gc_heap->sweep_link != NULL) {
+        if (budget >= 0 && budget-- == 0) return 0;
+        struct Obj* object = *gc_heap->sweep_link;
+        if (gc_is_marked(object)) {
+            gc_heap->sweep_link = &object->next;
+        } else {
+            *gc_heap->sweep_link = object->next;
+            release_object(object);
+        }
+    }
+
+    gc_heap->sweep_link = NULL;
+    gc_heap->phase = GC_IDLE;
+    gc_heap->stats.major_count++;
+
     // Adjust threshold: target 2x live memory
-    next_gc = bytes_allocated * 2;
-    if (next_gc < 1024 * 1024) next_gc = 1024 * 1024; 
+    gc_heap->next_gc = gc_heap->bytes_allocated * 2;
+    if (gc_heap->next_gc < 1024 * 1024) gc_heap->next_gc = 1024 * 1024;
+    return 1;
+}
+
+void gc_record_pause(int major, double micros) {
+    int bucket = 0;
+    while (bucket < GC_PAUSE_BUCKETS - 1 && micros >= (double)(1u << bucket)) {
+        bucket++;
+    }
+    if (major) {
+        gc_heap->stats.major_steps++;
+        gc_heap->stats.major_pauses[bucket]++;
+        if (micros > gc_heap->stats.major_max_us) gc_heap->stats.major_max_us = micros;
+    } else {
+        gc_heap->stats.minor_count++;
+        gc_heap->stats.minor_pauses[bucket]++;
+        if (micros > gc_heap->stats.minor_max_us) gc_heap->stats.minor_max_us = micros;
+    }
+    gc_heap->stats.total_pause_us += micros;
 }
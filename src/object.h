@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "value.h"
 #include "chunk.h"
+#include "slab.h"
 
 struct VM;
 typedef void (*UserdataFinalizer)(void*);
@@ -58,15 +59,16 @@ typedef struct ExceptionHandler {
 
 struct Obj {
     ObjType type;
-    int is_marked;
+    uint8_t is_marked;  // Marked when equal to gc_black.
     struct Obj* next;
 };
 
+// The characters (plus a NUL) live in the same allocation as the header.
 typedef struct ObjString {
     struct Obj obj;
     int length;
-    char* chars;
     uint32_t hash;
+    char chars[];
 } ObjString;
 
 typedef struct ObjThread {
@@ -130,6 +132,7 @@ typedef struct {
     struct Obj obj;
     int arity;
     int upvalue_count;
+    int max_locals;  // Most local slots live at once, slot 0 included.
     Chunk chunk;
     ObjString* name;
     ObjString* doc;
@@ -154,8 +157,8 @@ typedef struct ObjUpvalue {
 typedef struct ObjClosure {
     struct Obj obj;
     ObjFunction* function;
-    ObjUpvalue** upvalues;
     int upvalue_count;
+    ObjUpvalue* upvalues[];  // Exactly function->upvalue_count slots.
 } ObjClosure;
 
 typedef struct ObjTable ObjTable; // Forward decl
@@ -166,6 +169,7 @@ typedef struct {
     UserdataFinalizer finalize;
     UserdataMarker mark;
     ObjTable* metatable;
+    size_t inline_size;  // Bytes of payload stored after the struct, or 0.
 } ObjUserdata;
 
 typedef struct {
@@ -223,12 +227,132 @@ ObjThread* new_thread_with_caps(int stack_cap, int frame_cap, int handler_cap);
 ObjUserdata* new_userdata(void* data);
 ObjUserdata* new_userdata_with_finalizer(void* data, UserdataFinalizer finalize);
 ObjUserdata* new_userdata_with_hooks(void* data, UserdataFinalizer finalize, UserdataMarker mark);
+// Userdata whose zeroed payload of `size` bytes lives in the object itself,
+// so it needs no malloc and no finalizer.
+ObjUserdata* new_userdata_inline(size_t size, UserdataMarker mark);
 ObjBoundMethod* new_bound_method(Value receiver, struct Obj* method);
 void print_object(Value value);
 
 
 void mark_object(struct Obj* object);
 void mark_value(Value value);
-void sweep_objects();
+
+// Generational collection. New objects start in the nursery; a minor
+// collection traces only nursery objects reachable from the roots and the
+// remembered set, then promotes the survivors. Old objects keep their mark
+// bit between major collections, so tracing stops as soon as it reaches one.
+//
+// Major collections are incremental: marking works off a gray stack and,
+// like sweeping, runs in bounded steps between allocations. Minor
+// collections wait while a major one is marking.
+#define GC_PAUSE_BUCKETS 24
+
+typedef enum {
+    GC_IDLE,
+    GC_MARKING,
+    GC_SWEEPING,
+} GcPhase;
+
+typedef struct {
+    uint64_t minor_count;
+    uint64_t major_count;   // Completed major collections.
+    uint64_t major_steps;   // Pauses spent on major work, atomic or incremental.
+    // Bucket i counts pauses shorter than 2^i microseconds (and at least
+    // 2^(i-1)); the last bucket also takes everything longer.
+    uint64_t minor_pauses[GC_PAUSE_BUCKETS];
+    uint64_t major_pauses[GC_PAUSE_BUCKETS];
+    double minor_max_us;
+    double major_max_us;
+    double total_pause_us;
+} GcStats;
+
+// Tunables, set from scripts with `gc({...})`.
+typedef struct {
+    int incremental;    // 0: major collections run to completion.
+    int pause_us;       // Time budget of one major step; 0 for none.
+    int step_objects;   // Object budget of one major step; 0 for none.
+    int step_kb;        // Allocation between major steps.
+    int nursery_kb;     // Allocation between minor collections.
+} GcConfig;
+
+// Everything the collector and allocator own. A process starts on one
+// heap; each isolate (thread.isolate) gets its own, so the heap an OS
+// thread allocates from and collects is reached through `gc_heap`.
+typedef struct GcHeap {
+    struct Obj* objects;        // Nursery: allocated since the last collection
+    struct Obj* old_objects;    // Survivors of at least one collection
+    size_t bytes_allocated;
+    size_t next_gc;
+    size_t bytes_after_gc;      // Heap size when the nursery was last emptied
+    size_t next_gc_step;        // Allocation mark for the next major step
+    GcStats stats;
+    GcConfig config;
+    GcPhase phase;
+    // Value of Obj.is_marked that means "marked". A major collection flips
+    // it, which turns every old object white at once instead of walking
+    // the heap.
+    uint8_t black;
+
+    // Marked objects whose children have not been traced yet.
+    struct Obj** gray_stack;
+    int gray_count;
+    int gray_capacity;
+
+    // Every thread and userdata. Their stacks and native payloads change
+    // without going through a write barrier, so each collection retraces
+    // the ones that are already marked.
+    struct Obj** remembered;
+    int remembered_count;
+    int remembered_capacity;
+
+    // Large tables being blackened a slice at a time.
+    struct TableCursor* table_cursors;
+    int table_cursor_count;
+    int table_cursor_capacity;
+
+    // Lazy sweep state: the nursery detached at the end of marking, and
+    // the link in old_objects that the sweeper resumes from.
+    struct Obj* sweep_young;
+    struct Obj** sweep_link;
+
+    // Weak set of every live ObjString. Equal strings share one object, so
+    // table probes and string equality reduce to a pointer compare.
+    // Entries are dropped as the sweeper frees their strings.
+    Table strings;
+
+    SlabArena slab;
+} GcHeap;
+
+extern TOI_THREAD_LOCAL GcHeap* gc_heap;
+
+// heap_new returns an empty heap; make it current by assigning gc_heap.
+// heap_free releases everything still allocated on a heap that no VM
+// uses any more.
+GcHeap* heap_new(void);
+void heap_free(GcHeap* heap);
+
+static inline int gc_is_marked(struct Obj* object) {
+    return object->is_marked == gc_heap->black;
+}
+
+void gc_remember(struct Obj* object);
+void gc_trace_remembered(void);
+int gc_drain_gray(long budget);
+void gc_begin_major(void);
+void gc_finish_mark(void);
+int gc_sweep_step(long budget);
+void sweep_young_objects(void);
+void gc_record_pause(int major, double micros);
+
+// Write barrier for storing `value` into `owner`. A marked owner must not
+// point at an unmarked object: between collections that would be an old
+// object referring into the nursery, and during incremental marking a
+// traced object hiding an untraced one. Marking the target covers both and
+// never rescans the owner, however large it is.
+static inline void gc_write_barrier(struct Obj* owner, Value value) {
+    if (IS_OBJ(value) && gc_is_marked(owner) && !gc_is_marked(AS_OBJ(value))) {
+        mark_object(AS_OBJ(value));
+    }
+}
 
 #endif
@@ -163,9 +163,9 @@ static void add_globals_matches(const char *buf, int replace_start, const char*
 
     for (int i = 0; i < globals->capacity && (int)lc->len < REPL_COMPLETION_MAX; i++) {
         Entry* entry = &globals->entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
+        if (!IS_STRING(entry->key) || IS_NIL(entry->value)) continue;
 
-        ObjString* key = entry->key;
+        ObjString* key = AS_STRING(entry->key);
         if (!is_valid_identifier(key->chars, key->length)) continue;
         if (!starts_with(key->chars, key->length, prefix, prefix_len)) continue;
         add_completion_candidate(buf, replace_start, key->chars, lc);
@@ -176,8 +176,8 @@ static int lookup_global_by_slice(VM* vm, const char* name, int name_len, Value*
     Table* globals = &vm->globals;
     for (int i = 0; i < globals->capacity; i++) {
         Entry* entry = &globals->entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
-        ObjString* key = entry->key;
+        if (!IS_STRING(entry->key) || IS_NIL(entry->value)) continue;
+        ObjString* key = AS_STRING(entry->key);
         if (key->length == name_len && memcmp(key->chars, name, (size_t)name_len) == 0) {
             *out = entry->value;
             return 1;
@@ -190,9 +190,9 @@ static void add_table_member_matches(const char *buf, int member_start, const ch
                                   ObjTable* table, toi_lineedit_completions *lc) {
     for (int i = 0; i < table->table.capacity && (int)lc->len < REPL_COMPLETION_MAX; i++) {
         Entry* entry = &table->table.entries[i];
-        if (entry->key == NULL || IS_NIL(entry->value)) continue;
+        if (!IS_STRING(entry->key) || IS_NIL(entry->value)) continue;
 
-        ObjString* key = entry->key;
+        ObjString* key = AS_STRING(entry->key);
         if (!is_valid_identifier(key->chars, key->length)) continue;
         if (!starts_with(key->chars, key->length, prefix, prefix_len)) continue;
         add_completion_candidate(buf, member_start, key->chars, lc);
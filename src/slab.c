@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "slab.h"
+
+#if defined(__SANITIZE_ADDRESS__)
+#define TOI_NO_SLAB
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TOI_NO_SLAB
+#endif
+#endif
+
+typedef struct SlabSlot {
+    struct SlabSlot* next;
+} SlabSlot;
+
+typedef struct SlabBlock {
+    struct SlabBlock* next;
+} SlabBlock;
+
+#ifndef TOI_NO_SLAB
+static int size_class(size_t size) {
+    return (int)((size + SLAB_GRANULE - 1) / SLAB_GRANULE) - 1;
+}
+
+static void* carve(SlabArena* arena, size_t slot_size) {
+    if (arena->cursor == NULL || (size_t)(arena->limit - arena->cursor) < slot_size) {
+        // The unused tail of the old block is too small for this class;
+        // hand it to the smaller classes instead of wasting it.
+        while (arena->cursor != NULL && (size_t)(arena->limit - arena->cursor) >= SLAB_GRANULE) {
+            size_t left = (size_t)(arena->limit - arena->cursor);
+            size_t piece = left > SLAB_MAX_SIZE ? SLAB_MAX_SIZE : left - left % SLAB_GRANULE;
+            SlabSlot* slot = (SlabSlot*)arena->cursor;
+            int cls = size_class(piece);
+            slot->next = arena->free_lists[cls];
+            arena->free_lists[cls] = slot;
+            arena->cursor += piece;
+        }
+        SlabBlock* block = (SlabBlock*)malloc(SLAB_BLOCK_SIZE);
+        if (block == NULL) {
+            fprintf(stderr, "Out of memory allocating slab block.\n");
+            exit(1);
+        }
+        block->next = arena->blocks;
+        arena->blocks = block;
+        arena->reserved += SLAB_BLOCK_SIZE;
+        // Keep slots SLAB_GRANULE-aligned after the block header.
+        arena->cursor = (char*)block + SLAB_GRANULE;
+        arena->limit = (char*)block + SLAB_BLOCK_SIZE;
+    }
+    void* slot = arena->cursor;
+    arena->cursor += slot_size;
+    return slot;
+}
+#endif
+
+void* slab_alloc(SlabArena* arena, size_t size) {
+#ifndef TOI_NO_SLAB
+    if (size > 0 && size <= SLAB_MAX_SIZE) {
+        int cls = size_class(size);
+        SlabSlot* slot = arena->free_lists[cls];
+        if (slot != NULL) {
+            arena->free_lists[cls] = slot->next;
+            return slot;
+        }
+        return carve(arena, (size_t)(cls + 1) * SLAB_GRANULE);
+    }
+#else
+    (void)arena;
+#endif
+    void* ptr = malloc(size);
+    if (ptr == NULL) {
+        fprintf(stderr, "Out of memory.\n");
+        exit(1);
+    }
+    return ptr;
+}
+
+void slab_free(SlabArena* arena, void* ptr, size_t size) {
+    if (ptr == NULL) return;
+#ifndef TOI_NO_SLAB
+    if (size > 0 && size <= SLAB_MAX_SIZE) {
+        int cls = size_class(size);
+        SlabSlot* slot = (SlabSlot*)ptr;
+        slot->next = arena->free_lists[cls];
+        arena->free_lists[cls] = slot;
+        return;
+    }
+#else
+    (void)arena;
+    (void)size;
+#endif
+    free(ptr);
+}
+
+void slab_release(SlabArena* arena) {
+    SlabBlock* block = arena->blocks;
+    while (block != NULL) {
+        SlabBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    memset(arena, 0, sizeof(*arena));
+}
@@ -0,0 +1,36 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+// Size-class allocator for heap objects. Requests up to SLAB_MAX_SIZE bytes
+// are rounded up to a multiple of SLAB_GRANULE and served from per-class
+// free lists carved out of SLAB_BLOCK_SIZE blocks; larger requests go to
+// malloc. Freed slots are reused by the same class and blocks are never
+// returned, so a steady workload stops calling malloc once warm.
+//
+// `make SLAB=0` (and any AddressSanitizer build) sends everything to
+// malloc so use-after-free still reports against the exact object.
+#define SLAB_GRANULE 16
+#define SLAB_MAX_SIZE 512
+#define SLAB_BLOCK_SIZE (64 * 1024)
+#define SLAB_CLASSES (SLAB_MAX_SIZE / SLAB_GRANULE)
+
+// One arena per GC heap. Blocks are carved front to back; `cursor` and
+// `limit` bound the unused tail of the newest one, which every class
+// shares.
+typedef struct {
+    struct SlabSlot* free_lists[SLAB_CLASSES];
+    struct SlabBlock* blocks;
+    char* cursor;
+    char* limit;
+    size_t reserved;    // Bytes reserved from malloc for blocks.
+} SlabArena;
+
+void* slab_alloc(SlabArena* arena, size_t size);
+void slab_free(SlabArena* arena, void* ptr, size_t size);
+
+// Returns every block to malloc. Only for an arena whose heap is gone.
+void slab_release(SlabArena* arena);
+
+#endif
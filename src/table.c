@@ -1,3 +1,4 @@
+#include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,6 +14,7 @@ void init_table(Table* table) {
     table->capacity = 0;
     table->entries = NULL;
     table->version = 0;
+    table->in_object = 0;
     table->array = NULL;
     table->array_capacity = 0;
     table->array_max = 0;
@@ -24,21 +26,47 @@ void free_table(Table* table) {
     init_table(table);
 }
 
-static Entry* find_entry(Entry* entries, int capacity, ObjString* key) {
-    uint32_t index = key->hash % capacity;
+static uint32_t hash_number(double num) {
+    uint64_t bits;
+    memcpy(&bits, &num, sizeof(bits));
+    // 64-bit finalizer (splitmix64) so consecutive ids spread across slots.
+    bits ^= bits >> 30;
+    bits *= 0xbf58476d1ce4e5b9ULL;
+    bits ^= bits >> 27;
+    bits *= 0x94d049bb133111ebULL;
+    bits ^= bits >> 31;
+    return (uint32_t)bits;
+}
+
+static inline uint32_t hash_key(Value key) {
+    if (IS_OBJ(key)) return ((ObjString*)AS_OBJ(key))->hash;
+    return hash_number(AS_NUMBER(key));
+}
+
+static inline int keys_equal(Value a, Value b) {
+    // Strings are interned, so equal string keys are the same object.
+    if (IS_OBJ(a)) return IS_OBJ(b) && AS_OBJ(a) == AS_OBJ(b);
+    return IS_NUMBER(b) && AS_NUMBER(a) == AS_NUMBER(b);
+}
+
+static inline Value normalize_key(Value key) {
+    // -0 and 0 name the same slot.
+    if (IS_NUMBER(key) && AS_NUMBER(key) == 0) return NUMBER_VAL(0.0);
+    return key;
+}
+
+static Entry* find_entry(Entry* entries, int capacity, Value key) {
+    uint32_t index = hash_key(key) % capacity;
     Entry* tombstone = NULL;
     for (;;) {
         Entry* entry = &entries[index];
         // In open addressing, we find either the matching key or an empty slot.
-        if (entry->key == NULL) {
+        if (IS_NIL(entry->key)) {
             if (IS_NIL(entry->value)) {
                 return tombstone != NULL ? tombstone : entry;
             }
             if (tombstone == NULL) tombstone = entry;
-        } else if (entry->key == key ||
-                   (entry->key->length == key->length &&
-                    entry->key->hash == key->hash &&
-                    memcmp(entry->key->chars, key->chars, key->length) == 0)) {
+        } else if (keys_equal(key, entry->key)) {
             return entry;
         }
 
@@ -46,10 +74,17 @@ static Entry* find_entry(Entry* entries, int capacity, ObjString* key) {
     }
 }
 
+static inline void table_write_barrier(Table* table, Value key, Value value) {
+    if (!table->in_object) return;
+    struct Obj* owner = (struct Obj*)((char*)table - offsetof(ObjTable, table));
+    gc_write_barrier(owner, key);
+    gc_write_barrier(owner, value);
+}
+
 static void adjust_capacity(Table* table, int capacity) {
     Entry* entries = (Entry*)malloc(sizeof(Entry) * capacity);
     for (int i = 0; i < capacity; i++) {
-        entries[i].key = NULL;
+        entries[i].key = NIL_VAL;
         entries[i].value = NIL_VAL;
     }
 
@@ -57,7 +92,7 @@ static void adjust_capacity(Table* table, int capacity) {
     table->count = 0;
     for (int i = 0; i < table->capacity; i++) {
         Entry* entry = &table->entries[i];
-        if (entry->key == NULL) continue;
+        if (IS_NIL(entry->key)) continue;
 
         Entry* dest = find_entry(entries, capacity, entry->key);
         dest->key = entry->key;
@@ -70,46 +105,68 @@ static void adjust_capacity(Table* table, int capacity) {
     table->capacity = capacity;
 }
 
-int table_get(Table* table, ObjString* key, Value* value) {
+int table_get_value(Table* table, Value key, Value* value) {
     if (table->count == 0) return 0;
 
-    Entry* entry = find_entry(table->entries, table->capacity, key);
-    if (entry->key == NULL) return 0;
+    Entry* entry = find_entry(table->entries, table->capacity, normalize_key(key));
+    if (IS_NIL(entry->key)) return 0;
 
     *value = entry->value;
     return 1;
 }
 
-int table_set(Table* table, ObjString* key, Value value) {
+int table_set_value(Table* table, Value key, Value value) {
     if (table->count + 1 > table->capacity * TABLE_MAX_LOAD) {
         int capacity = table->capacity < 8 ? 8 : table->capacity * 2;
         adjust_capacity(table, capacity);
     }
 
+    key = normalize_key(key);
     Entry* entry = find_entry(table->entries, table->capacity, key);
 
-    int is_new_key = entry->key == NULL;
+    int is_new_key = IS_NIL(entry->key);
     if (is_new_key && IS_NIL(entry->value)) table->count++;
 
     entry->key = key;
     entry->value = value;
     table->version++;
+    table_write_barrier(table, key, value);
     return is_new_key;
 }
 
-int table_delete(Table* table, ObjString* key) {
+int table_delete_value(Table* table, Value key) {
     if (table->count == 0) return 0;
 
-    Entry* entry = find_entry(table->entries, table->capacity, key);
-    if (entry->key == NULL) return 0;
+    Entry* entry = find_entry(table->entries, table->capacity, normalize_key(key));
+    if (IS_NIL(entry->key)) return 0;
 
     // Place a tombstone.
-    entry->key = NULL;
+    entry->key = NIL_VAL;
     entry->value = BOOL_VAL(1);
     table->version++;
     return 1;
 }
 
+int table_get(Table* table, ObjString* key, Value* value) {
+    return table_get_value(table, OBJ_VAL(key), value);
+}
+
+int table_set(Table* table, ObjString* key, Value value) {
+    return table_set_value(table, OBJ_VAL(key), value);
+}
+
+int table_delete(Table* table, ObjString* key) {
+    return table_delete_value(table, OBJ_VAL(key));
+}
+
+int table_find_slot(Table* table, Value key) {
+    if (table->count == 0) return -1;
+
+    Entry* entry = find_entry(table->entries, table->capacity, normalize_key(key));
+    if (IS_NIL(entry->key)) return -1;
+    return (int)(entry - table->entries);
+}
+
 int table_get_array(Table* table, int index, Value* value) {
     // 1-based indexing for Lua compatibility
     int raw_index = index - 1;
@@ -145,6 +202,7 @@ int table_set_array(Table* table, int index, Value value) {
     }
 
     table->array[raw_index] = value;
+    table_write_barrier(table, NIL_VAL, value);
     if (!IS_NIL(value)) {
         if (index > table->array_max) table->array_max = index;
     } else if (index == table->array_max) {
@@ -161,8 +219,8 @@ int table_set_array(Table* table, int index, Value value) {
 void table_add_all(Table* from, Table* to) {
     for (int i = 0; i < from->capacity; i++) {
         Entry* entry = &from->entries[i];
-        if (entry->key != NULL) {
-            table_set(to, entry->key, entry->value);
+        if (!IS_NIL(entry->key)) {
+            table_set_value(to, entry->key, entry->value);
         }
     }
 }
@@ -173,14 +231,17 @@ ObjString* table_find_string(Table* table, const char* chars, int length, uint32
     uint32_t index = hash % table->capacity;
     for (;;) {
         Entry* entry = &table->entries[index];
-        if (entry->key == NULL) {
+        if (IS_NIL(entry->key)) {
             // Stop if we find an empty non-tombstone slot.
             if (IS_NIL(entry->value)) return NULL; 
-        } else if (entry->key->length == length &&
-                   entry->key->hash == hash &&
-                   memcmp(entry->key->chars, chars, length) == 0) {
-            // Found it.
-            return entry->key;
+        } else if (IS_STRING(entry->key)) {
+            ObjString* key = AS_STRING(entry->key);
+            if (key->length == length &&
+                key->hash == hash &&
+                memcmp(key->chars, chars, length) == 0) {
+                // Found it.
+                return key;
+            }
         }
 
         index = (index + 1) % table->capacity;
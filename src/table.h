@@ -7,8 +7,10 @@
 
 struct ObjString;
 
+// Hash-part slot. `key` is a string or number; an empty slot has a nil key
+// and nil value, a tombstone has a nil key and a non-nil value.
 typedef struct {
-    struct ObjString* key;
+    Value key;
     Value value;
 } Entry;
 
@@ -17,6 +19,7 @@ typedef struct {
     int capacity;
     Entry* entries;
     uint32_t version;
+    uint8_t in_object;  // Embedded in an ObjTable, so stores need a GC barrier.
     
     // Array optimization
     Value* array;
@@ -29,6 +32,13 @@ void free_table(Table* table);
 int table_get(Table* table, struct ObjString* key, Value* value);
 int table_set(Table* table, struct ObjString* key, Value value);
 int table_delete(Table* table, struct ObjString* key);
+// Hash-part access with an arbitrary string or number key. Numbers are
+// stored natively, so sparse integer ids and floats never become strings.
+int table_get_value(Table* table, Value key, Value* value);
+int table_set_value(Table* table, Value key, Value value);
+int table_delete_value(Table* table, Value key);
+// Returns the hash-part slot index holding `key`, or -1 when absent.
+int table_find_slot(Table* table, Value key);
 void table_add_all(Table* from, Table* to);
 // ObjString* table_find_string(Table* table, const char* chars, int length, uint32_t hash); // Needs full definition?
 // No, returns pointer.
@@ -0,0 +1,761 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "toic.h"
+#include "compiler.h"
+
+#ifndef TOI_WASM
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// File layout (native byte order):
+//   header   "TOIC", u32 byte-order mark, u32 TOI_BYTECODE_VERSION,
+//            i64 source mtime sec, i64 source mtime nsec, i64 source size
+//   function u32 arity, u32 upvalue_count, u32 max_locals, u8 is_variadic, u8 is_self,
+//            u8 is_generator, string name, string doc,
+//            u32 code count, code bytes, i32 line per byte,
+//            u32 constant count, values,
+//            u32 default count, values,
+//            u32 param type count, type bytes,
+//            u32 param name count, strings
+//   string   u32 length (UINT32_MAX for none), bytes
+//   value    u8 tag, then a double, a string or a nested function
+#define TOIC_MAGIC "TOIC"
+#define TOIC_BYTE_ORDER 0x01020304u
+#define TOIC_NO_STRING 0xffffffffu
+
+enum {
+    TOIC_NIL,
+    TOIC_FALSE,
+    TOIC_TRUE,
+    TOIC_NUMBER,
+    TOIC_STRING,
+    TOIC_FUNCTION
+};
+
+static int cache_disabled(void) {
+    const char* env = getenv("TOI_NO_CACHE");
+    return env != NULL && (env[0] == '1' || env[0] == 'y' || env[0] == 'Y');
+}
+
+#ifndef TOI_WASM
+
+// ---- Writing ----
+
+typedef struct {
+    uint8_t* data;
+    size_t length;
+    size_t capacity;
+    int ok;
+} Writer;
+
+static void put_bytes(Writer* w, const void* bytes, size_t n) {
+    if (n == 0) return;
+    if (!w->ok) return;
+    if (w->length + n > w->capacity) {
+        size_t capacity = w->capacity == 0 ? 4096 : w->capacity;
+        while (w->length + n > capacity) capacity *= 2;
+        uint8_t* grown = (uint8_t*)realloc(w->data, capacity);
+        if (grown == NULL) {
+            w->ok = 0;
+            return;
+        }
+        w->data = grown;
+        w->capacity = capacity;
+    }
+    memcpy(w->data + w->length, bytes, n);
+    w->length += n;
+}
+
+static void put_u8(Writer* w, uint8_t v) { put_bytes(w, &v, sizeof(v)); }
+static void put_u32(Writer* w, uint32_t v) { put_bytes(w, &v, sizeof(v)); }
+static void put_i64(Writer* w, int64_t v) { put_bytes(w, &v, sizeof(v)); }
+
+static void put_string(Writer* w, ObjString* string) {
+    if (string == NULL) {
+        put_u32(w, TOIC_NO_STRING);
+        return;
+    }
+    put_u32(w, (uint32_t)string->length);
+    put_bytes(w, string->chars, (size_t)string->length);
+}
+
+static void put_function(Writer* w, ObjFunction* function);
+
+static void put_value(Writer* w, Value value) {
+    if (IS_NIL(value)) {
+        put_u8(w, TOIC_NIL);
+    } else if (IS_BOOL(value)) {
+        put_u8(w, AS_BOOL(value) ? TOIC_TRUE : TOIC_FALSE);
+    } else if (IS_NUMBER(value)) {
+        double number = AS_NUMBER(value);
+        put_u8(w, TOIC_NUMBER);
+        put_bytes(w, &number, sizeof(number));
+    } else if (IS_STRING(value)) {
+        put_u8(w, TOIC_STRING);
+        put_string(w, AS_STRING(value));
+    } else if (IS_FUNCTION(value)) {
+        put_u8(w, TOIC_FUNCTION);
+        put_function(w, AS_FUNCTION(value));
+    } else {
+        // Nothing else is emitted as a constant today; refuse rather than
+        // write a cache that can't be read back.
+        w->ok = 0;
+    }
+}
+
+static void put_function(Writer* w, ObjFunction* function) {
+    put_u32(w, (uint32_t)function->arity);
+    put_u32(w, (uint32_t)function->upvalue_count);
+    put_u32(w, (uint32_t)function->max_locals);
+    put_u8(w, (uint8_t)function->is_variadic);
+    put_u8(w, function->is_self);
+    put_u8(w, function->is_generator);
+    put_string(w, function->name);
+    put_string(w, function->doc);
+
+    Chunk* chunk = &function->chunk;
+    put_u32(w, (uint32_t)chunk->count);
+    put_bytes(w, chunk->code, (size_t)chunk->count);
+    for (int i = 0; i < chunk->count; i++) {
+        put_u32(w, (uint32_t)chunk->lines[i]);
+    }
+
+    put_u32(w, (uint32_t)chunk->constants.count);
+    for (int i = 0; i < chunk->constants.count; i++) {
+        put_value(w, chunk->constants.values[i]);
+    }
+
+    put_u32(w, (uint32_t)function->defaults_count);
+    for (int i = 0; i < function->defaults_count; i++) {
+        put_value(w, function->defaults[i]);
+    }
+
+    put_u32(w, (uint32_t)function->param_types_count);
+    put_bytes(w, function->param_types, (size_t)function->param_types_count);
+
+    put_u32(w, (uint32_t)function->param_names_count);
+    for (int i = 0; i < function->param_names_count; i++) {
+        put_string(w, function->param_names[i]);
+    }
+}
+
+// ---- Reading ----
+
+typedef struct {
+    const uint8_t* p;
+    const uint8_t* end;
+    int ok;
+} Reader;
+
+static int get_bytes(Reader* r, void* out, size_t n) {
+    if (!r->ok || (size_t)(r->end - r->p) < n) {
+        r->ok = 0;
+        return 0;
+    }
+    memcpy(out, r->p, n);
+    r->p += n;
+    return 1;
+}
+
+static uint8_t get_u8(Reader* r) {
+    uint8_t v = 0;
+    get_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+static uint32_t get_u32(Reader* r) {
+    uint32_t v = 0;
+    get_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+static int64_t get_i64(Reader* r) {
+    int64_t v = 0;
+    get_bytes(r, &v, sizeof(v));
+    return v;
+}
+
+// Reads a count and checks that at least `count * min_size` bytes remain,
+// so a corrupt file can't ask for a huge allocation.
+static int get_count(Reader* r, size_t min_size) {
+    uint32_t count = get_u32(r);
+    if (!r->ok || count > INT_MAX || (uint64_t)count * min_size > (uint64_t)(r->end - r->p)) {
+        r->ok = 0;
+        return 0;
+    }
+    return (int)count;
+}
+
+static ObjString* get_string(Reader* r) {
+    uint32_t length = get_u32(r);
+    if (!r->ok || length == TOIC_NO_STRING) return NULL;
+    if (length > INT_MAX || (size_t)(r->end - r->p) < length) {
+        r->ok = 0;
+        return NULL;
+    }
+    ObjString* string = copy_string((const char*)r->p, (int)length);
+    r->p += length;
+    return string;
+}
+
+static ObjFunction* get_function(Reader* r, int depth);
+
+static Value get_value(Reader* r, int depth) {
+    switch (get_u8(r)) {
+        case TOIC_NIL: return NIL_VAL;
+        case TOIC_FALSE: return BOOL_VAL(0);
+        case TOIC_TRUE: return BOOL_VAL(1);
+        case TOIC_NUMBER: {
+            double number = 0;
+            get_bytes(r, &number, sizeof(number));
+            return NUMBER_VAL(number);
+        }
+        case TOIC_STRING: {
+            ObjString* string = get_string(r);
+            if (string == NULL) r->ok = 0;
+            return string == NULL ? NIL_VAL : OBJ_VAL(string);
+        }
+        case TOIC_FUNCTION: {
+            ObjFunction* function = get_function(r, depth + 1);
+            return function == NULL ? NIL_VAL : OBJ_VAL(function);
+        }
+        default:
+            r->ok = 0;
+            return NIL_VAL;
+    }
+}
+
+// ---- Verifying ----
+
+// vm_run trusts the compiler: it dispatches on opcode bytes and indexes
+// constants, locals and upvalues without bounds checks. A cache that was
+// truncated or corrupted on disk must not reach it, so every function is
+// checked against the limits compiled code already obeys before it is
+// used: known opcodes, whole instructions, constant indices in range and of
+// the type the instruction expects, local slots below max_locals, upvalue
+// indices below upvalue_count, and jumps that land on an instruction.
+// Nested functions are checked as they are read, before their parent.
+
+static int valid_constant(Chunk* chunk, int index) {
+    return index < chunk->constants.count;
+}
+
+static int valid_string_constant(Chunk* chunk, int index) {
+    return valid_constant(chunk, index) && IS_STRING(chunk->constants.values[index]);
+}
+
+static int valid_local(ObjFunction* function, int slot) {
+    return slot < function->max_locals;
+}
+
+static int jump_operand(const uint8_t* code, int at) {
+    return (code[at] << 8) | code[at + 1];
+}
+
+// Returns the instruction's length, or 0 when its operands are invalid.
+static int verify_instruction(ObjFunction* function, int offset) {
+    Chunk* chunk = &function->chunk;
+    const uint8_t* code = chunk->code;
+    int left = chunk->count - offset;
+
+    switch (code[offset]) {
+        case OP_CONSTANT:
+        case OP_ADD_CONST:
+        case OP_SUB_CONST:
+        case OP_MUL_CONST:
+        case OP_DIV_CONST:
+        case OP_MOD_CONST:
+            return left >= 2 && valid_constant(chunk, code[offset + 1]) ? 2 : 0;
+        case OP_GET_GLOBAL:
+        case OP_DEFINE_GLOBAL:
+        case OP_SET_GLOBAL:
+        case OP_DELETE_GLOBAL:
+        case OP_IMPORT:
+            return left >= 2 && valid_string_constant(chunk, code[offset + 1]) ? 2 : 0;
+        case OP_GET_LOCAL:
+        case OP_SET_LOCAL:
+        case OP_ADD_SET_LOCAL:
+        case OP_SUB_SET_LOCAL:
+        case OP_MUL_SET_LOCAL:
+        case OP_DIV_SET_LOCAL:
+        case OP_MOD_SET_LOCAL:
+            return left >= 2 && valid_local(function, code[offset + 1]) ? 2 : 0;
+        case OP_INC_LOCAL:
+        case OP_SUB_LOCAL_CONST:
+        case OP_MUL_LOCAL_CONST:
+        case OP_DIV_LOCAL_CONST:
+        case OP_MOD_LOCAL_CONST:
+            return left >= 3 && valid_local(function, code[offset + 1]) &&
+                   valid_constant(chunk, code[offset + 2]) ? 3 : 0;
+        case OP_GET_UPVALUE:
+        case OP_SET_UPVALUE:
+            return left >= 2 && code[offset + 1] < function->upvalue_count ? 2 : 0;
+        case OP_RETURN_N:
+        case OP_ADJUST_STACK:
+        case OP_CALL:
+        case OP_CALL_NAMED:
+        case OP_CALL_EXPAND:
+        case OP_BUILD_STRING:
+        case OP_PRINT:
+            return left >= 2 ? 2 : 0;
+        case OP_UNPACK:
+        case OP_JUMP:
+        case OP_JUMP_IF_FALSE:
+        case OP_JUMP_IF_TRUE:
+        case OP_LOOP:
+            return left >= 3 ? 3 : 0;
+        case OP_FOR_PREP:
+        case OP_FOR_LOOP:
+            return left >= 5 && valid_local(function, code[offset + 1]) &&
+                   valid_local(function, code[offset + 2]) ? 5 : 0;
+        case OP_TRY:
+            return left >= 7 ? 7 : 0;
+        case OP_CLOSURE: {
+            if (left < 2 || !valid_constant(chunk, code[offset + 1])) return 0;
+            Value value = chunk->constants.values[code[offset + 1]];
+            if (!IS_FUNCTION(value)) return 0;
+            int length = 2 + AS_FUNCTION(value)->upvalue_count * 2;
+            if (left < length) return 0;
+            for (int i = offset + 2; i < offset + length; i += 2) {
+                uint8_t is_local = code[i];
+                uint8_t index = code[i + 1];
+                if (is_local > 1) return 0;
+                if (is_local ? !valid_local(function, index) : index >= function->upvalue_count) return 0;
+            }
+            return length;
+        }
+        default:
+            return code[offset] <= OP_SLICE ? 1 : 0;
+    }
+}
+
+// Jump targets are checked once every instruction start is known.
+static int valid_target(const uint8_t* starts, int count, int target) {
+    return target >= 0 && target < count && starts[target];
+}
+
+static int verify_jumps(Chunk* chunk, const uint8_t* starts) {
+    const uint8_t* code = chunk->code;
+    for (int offset = 0; offset < chunk->count; offset++) {
+        if (!starts[offset]) continue;
+        int target = -1;
+        switch (code[offset]) {
+            case OP_JUMP:
+            case OP_JUMP_IF_FALSE:
+            case OP_JUMP_IF_TRUE:
+                target = offset + 3 + jump_operand(code, offset + 1);
+                break;
+            case OP_LOOP:
+                target = offset + 3 - jump_operand(code, offset + 1);
+                break;
+            case OP_FOR_PREP:
+                target = offset + 5 + jump_operand(code, offset + 3);
+                break;
+            case OP_FOR_LOOP:
+                target = offset + 5 - jump_operand(code, offset + 3);
+                break;
+            case OP_TRY: {
+                uint8_t flags = code[offset + 2];
+                if ((flags & 0x1) &&
+                    !valid_target(starts, chunk->count, offset + 7 + jump_operand(code, offset + 3))) {
+                    return 0;
+                }
+                if ((flags & 0x2) &&
+                    !valid_target(starts, chunk->count, offset + 7 + jump_operand(code, offset + 5))) {
+                    return 0;
+                }
+                continue;
+            }
+            default:
+                continue;
+        }
+        if (!valid_target(starts, chunk->count, target)) return 0;
+    }
+    return 1;
+}
+
+static int verify_code(ObjFunction* function) {
+    Chunk* chunk = &function->chunk;
+    if (chunk->count == 0 || function->max_locals < 1 || function->max_locals > UINT8_MAX + 1) return 0;
+
+    uint8_t* starts = (uint8_t*)calloc((size_t)chunk->count, 1);
+    if (starts == NULL) return 0;
+
+    int ok = 1;
+    int last = 0;
+    for (int offset = 0; offset < chunk->count;) {
+        int length = verify_instruction(function, offset);
+        if (length == 0) {
+            ok = 0;
+            break;
+        }
+        starts[offset] = 1;
+        last = offset;
+        offset += length;
+    }
+    // Execution must never run off the end of the code.
+    if (ok) {
+        uint8_t op = chunk->code[last];
+        ok = op == OP_RETURN || op == OP_RETURN_N || op == OP_THROW || op == OP_JUMP || op == OP_LOOP;
+    }
+    if (ok) ok = verify_jumps(chunk, starts);
+    free(starts);
+    return ok;
+}
+
+// A half-read function is simply dropped: it is already on the heap and
+// the collector frees it along with anything it points to.
+static ObjFunction* get_function(Reader* r, int depth) {
+    if (depth > 256) {
+        r->ok = 0;
+        return NULL;
+    }
+    ObjFunction* function = new_function();
+    function->arity = (int)get_u32(r);
+    function->upvalue_count = (int)get_u32(r);
+    function->max_locals = (int)get_u32(r);
+    function->is_variadic = get_u8(r);
+    function->is_self = get_u8(r);
+    function->is_generator = get_u8(r);
+    function->name = get_string(r);
+    function->doc = get_string(r);
+
+    Chunk* chunk = &function->chunk;
+    int count = get_count(r, 1 + sizeof(uint32_t));
+    if (!r->ok) return NULL;
+    if (count > 0) {
+        reserve_chunk(chunk, count);
+        get_bytes(r, chunk->code, (size_t)count);
+        for (int i = 0; i < count; i++) {
+            chunk->lines[i] = (int)get_u32(r);
+        }
+        chunk->count = count;
+    }
+
+    int constants = get_count(r, 1);
+    for (int i = 0; i < constants && r->ok; i++) {
+        add_constant(chunk, get_value(r, depth));
+    }
+
+    int defaults = get_count(r, 1);
+    if (defaults > 0) {
+        function->defaults = (Value*)malloc(sizeof(Value) * (size_t)defaults);
+        function->defaults_count = defaults;
+        for (int i = 0; i < defaults; i++) function->defaults[i] = NIL_VAL;
+        for (int i = 0; i < defaults && r->ok; i++) {
+            function->defaults[i] = get_value(r, depth);
+        }
+    }
+
+    int types = get_count(r, 1);
+    if (types > 0) {
+        function->param_types = (uint8_t*)malloc((size_t)types);
+        function->param_types_count = types;
+        get_bytes(r, function->param_types, (size_t)types);
+    }
+
+    int names = get_count(r, sizeof(uint32_t));
+    if (names > 0) {
+        function->param_names = (ObjString**)calloc((size_t)names, sizeof(ObjString*));
+        function->param_names_count = names;
+        for (int i = 0; i < names && r->ok; i++) {
+            function->param_names[i] = get_string(r);
+        }
+    }
+
+    if (!r->ok || !verify_code(function)) {
+        r->ok = 0;
+        return NULL;
+    }
+    return function;
+}
+
+uint8_t* toic_serialize(ObjFunction* function, size_t* out_len) {
+    Writer w = {NULL, 0, 0, 1};
+    put_function(&w, function);
+    if (!w.ok) {
+        free(w.data);
+        return NULL;
+    }
+    *out_len = w.length;
+    return w.data;
+}
+
+ObjFunction* toic_deserialize(const uint8_t* data, size_t len) {
+    Reader r = {data, data + len, 1};
+    ObjFunction* function = get_function(&r, 0);
+    return r.p == r.end ? function : NULL;
+}
+
+// ---- Cache files ----
+
+int toic_stamp(const char* path, ToicStamp* stamp) {
+    struct stat st;
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) return 0;
+    stamp->mtime_sec = (int64_t)st.st_mtime;
+#if defined(__APPLE__)
+    stamp->mtime_nsec = (int64_t)st.st_mtimespec.tv_nsec;
+#else
+    stamp->mtime_nsec = (int64_t)st.st_mtim.tv_nsec;
+#endif
+    stamp->size = (int64_t)st.st_size;
+    return 1;
+}
+
+// `lib/db.toi` -> `lib/db.toic`, or `$TOI_CACHE_DIR/%abs%path%lib%db.toic`.
+// In the cache dir '/' becomes '%', and a literal '%' or '=' is escaped as
+// "=%" or "==", so two different sources never share a cache file.
+static int cache_path(const char* source_path, char* out, size_t out_size) {
+    const char* dir = getenv("TOI_CACHE_DIR");
+    if (dir == NULL || dir[0] == '\0') {
+        int n = snprintf(out, out_size, "%sc", source_path);
+        return n > 0 && (size_t)n < out_size;
+    }
+
+    char absolute[PATH_MAX];
+    if (source_path[0] == '/') {
+        snprintf(absolute, sizeof(absolute), "%s", source_path);
+    } else {
+        char cwd[PATH_MAX];
+        if (getcwd(cwd, sizeof(cwd)) == NULL) return 0;
+        int n = snprintf(absolute, sizeof(absolute), "%s/%s", cwd, source_path);
+        if (n <= 0 || (size_t)n >= sizeof(absolute)) return 0;
+    }
+    int n = snprintf(out, out_size, "%s/", dir);
+    if (n <= 0 || (size_t)n >= out_size) return 0;
+    size_t len = (size_t)n;
+    for (const char* c = absolute; *c != '\0'; c++) {
+        if (len + 3 >= out_size) return 0;
+        if (*c == '%' || *c == '=') out[len++] = '=';
+        out[len++] = *c == '/' ? '%' : *c;
+    }
+    out[len++] = 'c';
+    out[len] = '\0';
+    return 1;
+}
+
+ObjFunction* toic_load(const char* source_path, const ToicStamp* stamp) {
+    if (cache_disabled()) return NULL;
+
+    char path[PATH_MAX];
+    if (!cache_path(source_path, path, sizeof(path))) return NULL;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    Reader r = {(const uint8_t*)map, (const uint8_t*)map + size, 1};
+    char magic[4];
+    get_bytes(&r, magic, sizeof(magic));
+    ObjFunction* function = NULL;
+    if (r.ok &&
+        memcmp(magic, TOIC_MAGIC, 4) == 0 &&
+        get_u32(&r) == TOIC_BYTE_ORDER &&
+        get_u32(&r) == TOI_BYTECODE_VERSION &&
+        get_i64(&r) == stamp->mtime_sec &&
+        get_i64(&r) == stamp->mtime_nsec &&
+        get_i64(&r) == stamp->size) {
+        function = get_function(&r, 0);
+        if (r.p != r.end) function = NULL;
+    }
+    munmap(map, size);
+    return function;
+}
+
+static int store_to(const char* path, const ToicStamp* stamp, ObjFunction* function) {
+    Writer w = {NULL, 0, 0, 1};
+    put_bytes(&w, TOIC_MAGIC, 4);
+    put_u32(&w, TOIC_BYTE_ORDER);
+    put_u32(&w, TOI_BYTECODE_VERSION);
+    put_i64(&w, stamp->mtime_sec);
+    put_i64(&w, stamp->mtime_nsec);
+    put_i64(&w, stamp->size);
+    put_function(&w, function);
+    if (!w.ok) {
+        free(w.data);
+        return 0;
+    }
+
+    // Write to a private temporary and rename it into place, so a process
+    // reading the cache never sees a partial file. The pid and a counter
+    // make the name unique per call, so threads and isolates caching the
+    // same module never write into each other's temporary.
+    static unsigned long tmp_counter = 0;
+    char tmp[PATH_MAX + 64];
+    int fd = -1;
+    for (int attempt = 0; fd < 0 && attempt < 8; attempt++) {
+        unsigned long id = __atomic_fetch_add(&tmp_counter, 1, __ATOMIC_RELAXED);
+        snprintf(tmp, sizeof(tmp), "%s.%ld.%lu.tmp", path, (long)getpid(), id);
+        fd = open(tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+        if (fd < 0 && errno != EEXIST) break;
+    }
+    int ok = 0;
+    if (fd >= 0) {
+        ok = 1;
+        for (size_t done = 0; ok && done < w.length;) {
+            ssize_t n = write(fd, w.data + done, w.length - done);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            if (ok) done += (size_t)n;
+        }
+        ok = close(fd) == 0 && ok;
+        if (ok) ok = rename(tmp, path) == 0;
+        if (!ok) remove(tmp);
+    }
+    free(w.data);
+    return ok;
+}
+
+int toic_store(const char* source_path, const ToicStamp* stamp, ObjFunction* function) {
+    if (cache_disabled()) return 0;
+    char path[PATH_MAX];
+    if (!cache_path(source_path, path, sizeof(path))) return 0;
+    return store_to(path, stamp, function);
+}
+
+// ---- toi compile ----
+
+static char* read_source(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return NULL;
+    fseek(file, 0L, SEEK_END);
+    long size = ftell(file);
+    rewind(file);
+    char* buffer = size < 0 ? NULL : (char*)malloc((size_t)size + 1);
+    if (buffer == NULL) {
+        fclose(file);
+        return NULL;
+    }
+    size_t bytes_read = fread(buffer, 1, (size_t)size, file);
+    buffer[bytes_read] = '\0';
+    fclose(file);
+    return buffer;
+}
+
+static int compile_file(const char* path) {
+    ToicStamp stamp;
+    char* source = NULL;
+    if (!toic_stamp(path, &stamp) || (source = read_source(path)) == NULL) {
+        fprintf(stderr, "Could not read '%s'.\n", path);
+        return 74;
+    }
+
+    ObjFunction* function = compile(source);
+    free(source);
+    if (function == NULL) {
+        fprintf(stderr, "Failed to compile '%s'.\n", path);
+        return 65;
+    }
+
+    char out[PATH_MAX];
+    if (!cache_path(path, out, sizeof(out)) || !store_to(out, &stamp, function)) {
+        fprintf(stderr, "Could not write cache for '%s'.\n", path);
+        return 74;
+    }
+    return 0;
+}
+
+static int has_toi_suffix(const char* name) {
+    size_t len = strlen(name);
+    return len > 4 && strcmp(name + len - 4, ".toi") == 0;
+}
+
+static int compile_tree(const char* path) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Could not read '%s'.\n", path);
+        return 74;
+    }
+    if (!S_ISDIR(st.st_mode)) return compile_file(path);
+
+    DIR* dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Could not open directory '%s'.\n", path);
+        return 74;
+    }
+    int rc = 0;
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        if (ent->d_name[0] == '.') continue;
+        char child[PATH_MAX];
+        int n = snprintf(child, sizeof(child), "%s/%s", path, ent->d_name);
+        if (n <= 0 || (size_t)n >= sizeof(child)) continue;
+        struct stat child_st;
+        if (stat(child, &child_st) != 0) continue;
+        int child_rc = 0;
+        if (S_ISDIR(child_st.st_mode)) {
+            child_rc = compile_tree(child);
+        } else if (S_ISREG(child_st.st_mode) && has_toi_suffix(ent->d_name)) {
+            child_rc = compile_file(child);
+        }
+        if (rc == 0) rc = child_rc;
+    }
+    closedir(dir);
+    return rc;
+}
+
+int toic_compile_path(const char* path) {
+    return compile_tree(path);
+}
+
+#else
+
+int toic_stamp(const char* path, ToicStamp* stamp) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) return 0;
+    fclose(file);
+    stamp->mtime_sec = 0;
+    stamp->mtime_nsec = 0;
+    stamp->size = 0;
+    return 1;
+}
+
+ObjFunction* toic_load(const char* source_path, const ToicStamp* stamp) {
+    (void)source_path;
+    (void)stamp;
+    (void)cache_disabled;
+    return NULL;
+}
+
+int toic_store(const char* source_path, const ToicStamp* stamp, ObjFunction* function) {
+    (void)source_path;
+    (void)stamp;
+    (void)function;
+    return 0;
+}
+
+uint8_t* toic_serialize(ObjFunction* function, size_t* out_len) {
+    (void)function;
+    (void)out_len;
+    return NULL;
+}
+
+ObjFunction* toic_deserialize(const uint8_t* data, size_t len) {
+    (void)data;
+    (void)len;
+    return NULL;
+}
+
+int toic_compile_path(const char* path) {
+    (void)path;
+    fprintf(stderr, "toi compile is not supported in this build.\n");
+    return 64;
+}
+
+#endif
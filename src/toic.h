@@ -0,0 +1,44 @@
+#ifndef TOIC_H
+#define TOIC_H
+
+#include <stdint.h>
+
+#include "object.h"
+
+// Compiled-bytecode cache for imported modules.
+//
+// A module's compiled function tree is serialized to `<source>c` (so
+// `lib/db.toi` caches to `lib/db.toic`), or into $TOI_CACHE_DIR when that
+// is set. A cache is only used when its recorded source mtime and size
+// and its TOI_BYTECODE_VERSION all match; anything else falls back to
+// compiling the source and rewriting the cache. `TOI_NO_CACHE=1` turns
+// the cache off.
+
+typedef struct {
+    int64_t mtime_sec;
+    int64_t mtime_nsec;
+    int64_t size;
+} ToicStamp;
+
+// Fills `stamp` from the source file. Returns 0 if `path` is not a
+// readable regular file.
+int toic_stamp(const char* path, ToicStamp* stamp);
+
+// Loads the cached compilation of `source_path`, or returns NULL when
+// there is no valid cache for `stamp`.
+ObjFunction* toic_load(const char* source_path, const ToicStamp* stamp);
+
+// Writes the cache for `source_path`. Failures are silent: the cache is
+// only an optimization. Returns 1 if a cache file was written.
+int toic_store(const char* source_path, const ToicStamp* stamp, ObjFunction* function);
+
+// The same encoding without a file or header, for handing a function to
+// another VM (thread.isolate). toic_serialize returns a malloc'd buffer.
+uint8_t* toic_serialize(ObjFunction* function, size_t* out_len);
+ObjFunction* toic_deserialize(const uint8_t* data, size_t len);
+
+// `toi compile`: precompiles a .toi file or every .toi file below a
+// directory. Returns a process exit code.
+int toic_compile_path(const char* path);
+
+#endif
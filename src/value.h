@@ -1,6 +1,64 @@
 #ifndef VALUE_H
 #define VALUE_H
 
+#include <stdint.h>
+
+struct Obj;
+
+#ifdef TOI_NAN_BOXING
+
+// NaN-boxed representation (`make NAN_BOXING=1`): every Value is a single
+// 64-bit word. Numbers are stored as raw doubles; nil/bools/objects live in
+// the payload of a quiet NaN. Objects set the sign bit and keep the pointer
+// in the low 48 bits.
+typedef uint64_t Value;
+
+#define SIGN_BIT ((uint64_t)0x8000000000000000)
+#define QNAN     ((uint64_t)0x7ffc000000000000)
+#define CANONICAL_NAN ((uint64_t)0x7ff8000000000000)
+
+#define TAG_NIL   1
+#define TAG_FALSE 2
+#define TAG_TRUE  3
+
+#define IS_NUMBER(value)  (((value) & QNAN) != QNAN)
+#define IS_NIL(value)     ((value) == NIL_VAL)
+#define IS_BOOL(value)    (((value) | 1) == TRUE_VAL)
+#define IS_OBJ(value)     (((value) & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT))
+
+#define AS_NUMBER(value)  value_to_num(value)
+#define AS_BOOL(value)    ((value) == TRUE_VAL)
+#define AS_OBJ(value)     ((struct Obj*)(uintptr_t)((value) & ~(SIGN_BIT | QNAN)))
+
+#define NUMBER_VAL(num)   num_to_value(num)
+#define NIL_VAL           ((Value)(uint64_t)(QNAN | TAG_NIL))
+#define FALSE_VAL         ((Value)(uint64_t)(QNAN | TAG_FALSE))
+#define TRUE_VAL          ((Value)(uint64_t)(QNAN | TAG_TRUE))
+#define BOOL_VAL(b)       ((b) ? TRUE_VAL : FALSE_VAL)
+#define OBJ_VAL(obj)      ((Value)(SIGN_BIT | QNAN | (uint64_t)(uintptr_t)(obj)))
+
+typedef union {
+    uint64_t bits;
+    double num;
+} DoubleBits;
+
+static inline double value_to_num(Value value) {
+    DoubleBits data;
+    data.bits = value;
+    return data.num;
+}
+
+static inline Value num_to_value(double num) {
+    DoubleBits data;
+    data.num = num;
+    // Arithmetic can produce NaNs with arbitrary payloads; fold them into
+    // one canonical NaN so they can never alias a tagged value.
+    if (num != num) return CANONICAL_NAN;
+    return data.bits;
+}
+
+#else
+
 typedef enum {
     VAL_NUMBER,
     VAL_NIL,
@@ -8,8 +66,6 @@ typedef enum {
     VAL_OBJ
 } ValueType;
 
-struct Obj;
-
 typedef struct {
     ValueType type;
     union {
@@ -33,6 +89,8 @@ typedef struct {
 #define BOOL_VAL(value)   ((Value){VAL_BOOL, {.boolean = (value) ? 1 : 0}})
 #define OBJ_VAL(object)   ((Value){VAL_OBJ, {.obj = (struct Obj*)object}})
 
+#endif
+
 typedef struct {
     int capacity;
     int count;
@@ -236,10 +236,8 @@ static void report_exception(VM* vm) {
         ObjTable* t = AS_TABLE(ex);
         Value msg = NIL_VAL;
         Value type = NIL_VAL;
-        ObjString* msg_key = copy_string("msg", 3);
-        ObjString* type_key = copy_string("type", 4);
-        table_get(&t->table, msg_key, &msg);
-        table_get(&t->table, type_key, &type);
+        table_get(&t->table, vm->msg_key, &msg);
+        table_get(&t->table, vm->type_key, &type);
 
         const char* msg_s = IS_STRING(msg) ? AS_CSTRING(msg) : "<exception>";
         const char* type_s = IS_STRING(type) ? AS_CSTRING(type) : "Error";
@@ -261,10 +259,6 @@ static void report_exception(VM* vm) {
     }
 }
 
-Value peek(VM* vm, int distance) {
-    return vm_current_thread(vm)->stack_top[-1 - distance];
-}
-
 static int handle_exception(VM* vm, CallFrame** frame, uint8_t** ip) {
     if (!vm_current_thread(vm)->has_exception) return 0;
     ObjThread* thread = vm_current_thread(vm);
@@ -316,30 +310,14 @@ static int handle_exception(VM* vm, CallFrame** frame, uint8_t** ip) {
 static volatile sig_atomic_t interrupt_requested = 0;
 
 #ifndef TOI_WASM
-static pthread_key_t current_thread_key;
-static pthread_once_t current_thread_key_once = PTHREAD_ONCE_INIT;
-
-static void make_current_thread_key(void) {
-    pthread_key_create(&current_thread_key, NULL);
-}
-
-ObjThread* vm_current_thread(VM* vm) {
-    if (!vm->use_thread_tls) {
-        return vm->current_thread;
-    }
-    pthread_once(&current_thread_key_once, make_current_thread_key);
-    ObjThread* t = (ObjThread*)pthread_getspecific(current_thread_key);
-    if (t != NULL) return t;
-    return vm->current_thread;
-}
+TOI_THREAD_LOCAL ObjThread* vm_tls_thread = NULL;
 
 void vm_set_current_thread(VM* vm, ObjThread* thread) {
     if (!vm->use_thread_tls) {
         vm->current_thread = thread;
         return;
     }
-    pthread_once(&current_thread_key_once, make_current_thread_key);
-    pthread_setspecific(current_thread_key, thread);
+    vm_tls_thread = thread;
     if (thread == NULL || thread == vm->current_thread) return;
     if (vm->current_thread == NULL) {
         vm->current_thread = thread;
@@ -349,14 +327,9 @@ void vm_set_current_thread(VM* vm, ObjThread* thread) {
 void vm_enable_thread_tls(VM* vm) {
     if (vm->use_thread_tls) return;
     vm->use_thread_tls = 1;
-    pthread_once(&current_thread_key_once, make_current_thread_key);
-    pthread_setspecific(current_thread_key, vm->current_thread);
+    vm_tls_thread = vm->current_thread;
 }
 #else
-ObjThread* vm_current_thread(VM* vm) {
-    return vm->current_thread;
-}
-
 void vm_set_current_thread(VM* vm, ObjThread* thread) {
     vm->current_thread = thread;
 }
@@ -370,16 +343,6 @@ void vm_request_interrupt(void) {
     interrupt_requested = 1;
 }
 
-void push(VM* vm, Value value) {
-    *vm_current_thread(vm)->stack_top = value;
-    vm_current_thread(vm)->stack_top++;
-}
-
-Value pop(VM* vm) {
-    vm_current_thread(vm)->stack_top--;
-    return *vm_current_thread(vm)->stack_top;
-}
-
 static Value get_metamethod_cached(VM* vm, Value val, ObjString* name);
 static int call_named(VM* vm, ObjClosure* closure, int arg_count);
 
@@ -703,6 +666,8 @@ static void close_upvalues(VM* vm, Value* last) {
 
         upvalue->location = &upvalue->closed;
 
+        gc_write_barrier(&upvalue->obj, upvalue->closed);
+
         vm_current_thread(vm)->open_upvalues = upvalue->next;
 
     }
@@ -829,7 +794,7 @@ static int call_named(VM* vm, ObjClosure* closure, int arg_count) {
         varargs = new_table();
     }
     ObjTable* legacy_options = NULL;
-    ObjString* first_unexpected = NULL;
+    Value first_unexpected = NIL_VAL;
 
     int positional_to_bind = positional_count < non_variadic_arity ? positional_count : non_variadic_arity;
     for (int i = 0; i < positional_to_bind; i++) {
@@ -849,12 +814,14 @@ static int call_named(VM* vm, ObjClosure* closure, int arg_count) {
 
     for (int i = 0; i < named_args->table.capacity; i++) {
         Entry* entry = &named_args->table.entries[i];
-        if (entry->key == NULL) continue;
+        if (IS_NIL(entry->key)) continue;
 
-        int index = find_named_param_index(function, entry->key, non_variadic_arity);
+        int index = IS_STRING(entry->key)
+            ? find_named_param_index(function, AS_STRING(entry->key), non_variadic_arity)
+            : -1;
         if (index >= 0) {
             if (assigned[index]) {
-                vm_runtime_error(vm, "Multiple values for argument '%s'.", entry->key->chars);
+                vm_runtime_error(vm, "Multiple values for argument '%s'.", AS_CSTRING(entry->key));
                 return 0;
             }
             bound_args[index] = entry->value;
@@ -863,7 +830,7 @@ static int call_named(VM* vm, ObjClosure* closure, int arg_count) {
         }
 
         if (function->is_variadic) {
-            table_set(&varargs->table, entry->key, entry->value);
+            table_set_value(&varargs->table, entry->key, entry->value);
             continue;
         }
 
@@ -871,7 +838,7 @@ static int call_named(VM* vm, ObjClosure* closure, int arg_count) {
             legacy_options = new_table();
             first_unexpected = entry->key;
         }
-        table_set(&legacy_options->table, entry->key, entry->value);
+        table_set_value(&legacy_options->table, entry->key, entry->value);
     }
 
     if (legacy_options != NULL) {
@@ -888,7 +855,11 @@ static int call_named(VM* vm, ObjClosure* closure, int arg_count) {
             bound_args[target] = OBJ_VAL(legacy_options);
             assigned[target] = 1;
         } else {
-            vm_runtime_error(vm, "Unexpected named argument '%s'.", first_unexpected->chars);
+            if (IS_STRING(first_unexpected)) {
+                vm_runtime_error(vm, "Unexpected named argument '%s'.", AS_CSTRING(first_unexpected));
+            } else {
+                vm_runtime_error(vm, "Unexpected named argument '%g'.", AS_NUMBER(first_unexpected));
+            }
             return 0;
         }
     }
@@ -944,6 +915,24 @@ static void mark_roots(VM* vm) {
         vm->module_name_key,
         vm->module_file_key,
         vm->module_main_key,
+        vm->next_name,
+        vm->msg_key,
+        vm->type_key,
+        vm->gen_next_name,
+        vm->inext_name,
+        vm->range_name,
+        vm->await_name,
+        vm->fd_key,
+        vm->events_key,
+        vm->data_key,
+        vm->index_key,
+        vm->in_key,
+        vm->out_key,
+        vm->pri_key,
+        vm->err_key,
+        vm->hup_key,
+        vm->nval_key,
+        vm->revents_key,
     };
     for (size_t i = 0; i < sizeof(rooted_strings) / sizeof(rooted_strings[0]); i++) {
         if (rooted_strings[i] != NULL) {
@@ -951,7 +940,7 @@ static void mark_roots(VM* vm) {
         }
     }
 
-    Value* rooted_values[] = {&vm->str_upper_fn, &vm->str_lower_fn};
+    Value* rooted_values[] = {&vm->str_upper_fn, &vm->str_lower_fn, &vm->table_iter_fn};
     for (size_t i = 0; i < sizeof(rooted_values) / sizeof(rooted_values[0]); i++) {
         if (!IS_NIL(*rooted_values[i])) {
             mark_value(*rooted_values[i]);
@@ -960,18 +949,24 @@ static void mark_roots(VM* vm) {
     // Mark globals
     for (int i = 0; i < vm->globals.capacity; i++) {
         Entry* entry = &vm->globals.entries[i];
-        if (entry->key != NULL) {
-            mark_object((struct Obj*)entry->key);
+        if (!IS_NIL(entry->key)) {
+            mark_value(entry->key);
             mark_value(entry->value);
         }
     }
     for (int i = 0; i < vm->modules.capacity; i++) {
         Entry* entry = &vm->modules.entries[i];
-        if (entry->key != NULL) {
-            mark_object((struct Obj*)entry->key);
+        if (!IS_NIL(entry->key)) {
+            mark_value(entry->key);
             mark_value(entry->value);
         }
     }
+    for (int i = 0; i < vm->pinned_keys.capacity; i++) {
+        Entry* entry = &vm->pinned_keys.entries[i];
+        if (!IS_NIL(entry->key)) {
+            mark_value(entry->key);
+        }
+    }
 }
 
 void init_vm(VM* vm) {
@@ -980,6 +975,10 @@ void init_vm(VM* vm) {
    vm_current_thread(vm)->vm = vm;
    vm->gc_parked_threads = NULL;
    vm->use_thread_tls = 0;
+   vm->switch_request = 0;
+   vm->switch_hook = NULL;
+   vm->blocking_begin = NULL;
+   vm->blocking_end = NULL;
    vm->disable_gc = 0;
    vm->is_repl = 0;
    vm->mm_index = NULL;
@@ -997,11 +996,31 @@ void init_vm(VM* vm) {
    vm->module_name_key = NULL;
    vm->module_file_key = NULL;
    vm->module_main_key = NULL;
+   vm->next_name = NULL;
+   vm->msg_key = NULL;
+   vm->type_key = NULL;
+   vm->gen_next_name = NULL;
+   vm->inext_name = NULL;
+   vm->range_name = NULL;
+   vm->await_name = NULL;
+   vm->fd_key = NULL;
+   vm->events_key = NULL;
+   vm->data_key = NULL;
+   vm->index_key = NULL;
+   vm->in_key = NULL;
+   vm->out_key = NULL;
+   vm->pri_key = NULL;
+   vm->err_key = NULL;
+   vm->hup_key = NULL;
+   vm->nval_key = NULL;
+   vm->revents_key = NULL;
    vm->str_upper_fn = NIL_VAL;
    vm->str_lower_fn = NIL_VAL;
+   vm->table_iter_fn = NIL_VAL;
 
     init_table(&vm->globals);
     init_table(&vm->modules);
+    init_table(&vm->pinned_keys);
     vm->cli_argc = 0;
     vm->cli_argv = NULL;
    vm_current_thread(vm)->open_upvalues = NULL;
@@ -1021,6 +1040,24 @@ void init_vm(VM* vm) {
     vm->module_name_key = copy_string("__name", 6);
     vm->module_file_key = copy_string("__file", 6);
     vm->module_main_key = copy_string("__main", 6);
+    vm->next_name = copy_string("next", 4);
+    vm->msg_key = copy_string("msg", 3);
+    vm->type_key = copy_string("type", 4);
+    vm->gen_next_name = copy_string("gen_next", 8);
+    vm->inext_name = copy_string("inext", 5);
+    vm->range_name = copy_string("range", 5);
+    vm->await_name = copy_string("await", 5);
+    vm->fd_key = copy_string("fd", 2);
+    vm->events_key = copy_string("events", 6);
+    vm->data_key = copy_string("data", 4);
+    vm->index_key = copy_string("index", 5);
+    vm->in_key = copy_string("in", 2);
+    vm->out_key = copy_string("out", 3);
+    vm->pri_key = copy_string("pri", 3);
+    vm->err_key = copy_string("err", 3);
+    vm->hup_key = copy_string("hup", 3);
+    vm->nval_key = copy_string("nval", 4);
+    vm->revents_key = copy_string("revents", 7);
 
     // Register built-in native functions (from libs module)
     register_libs(vm);
@@ -1029,6 +1066,7 @@ void init_vm(VM* vm) {
 void free_vm(VM* vm) {
    free_table(&vm->globals);
    free_table(&vm->modules);
+   free_table(&vm->pinned_keys);
    // The current_thread will be freed as part of GC if it's reachable.
     // We manually free the main thread if it's not part of GC collection.
     // Since we explicitly control it, we can free it here.
@@ -1041,19 +1079,137 @@ void free_vm(VM* vm) {
 #endif
 }
 
+static double gc_now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+// Threads and userdata change without barriers and the VM roots are not
+// objects, so both are traced again before marking can finish.
+static void finish_marking(VM* vm) {
+    mark_roots(vm);
+    gc_trace_remembered();
+    gc_drain_gray(-1);
+    gc_finish_mark();
+}
+
+static void finish_major(VM* vm) {
+    if (gc_heap->phase == GC_MARKING) finish_marking(vm);
+    if (gc_heap->phase == GC_SWEEPING) gc_sweep_step(-1);
+}
+
+// Runs whatever is left of the current major collection, then a complete
+// one, in a single pause.
 void collect_garbage(VM* vm) {
+    double start = gc_now_us();
+    finish_major(vm);
+    gc_begin_major();
+    finish_major(vm);
+    gc_heap->bytes_after_gc = gc_heap->bytes_allocated;
+    gc_record_pause(1, gc_now_us() - start);
+}
+
+#ifndef TOI_NO_GENERATIONAL_GC
+// Traces only the nursery: old objects are still marked from the last
+// major collection, so marking stops at them. Nursery objects stored into
+// old ones were marked by the write barrier and wait on the gray stack.
+static void collect_young_garbage(VM* vm) {
+    double start = gc_now_us();
     mark_roots(vm);
-    sweep_objects();
+    gc_trace_remembered();
+    gc_drain_gray(-1);
+    sweep_young_objects();
+    gc_heap->bytes_after_gc = gc_heap->bytes_allocated;
+    gc_record_pause(0, gc_now_us() - start);
+}
+#endif
+
+// Sweeping frees old objects; keep measuring nursery growth from the same
+// baseline so minor collections still run on time.
+static void discount_swept_bytes(size_t bytes_before) {
+    size_t freed = bytes_before > gc_heap->bytes_allocated ? bytes_before - gc_heap->bytes_allocated : 0;
+    gc_heap->bytes_after_gc = gc_heap->bytes_after_gc > freed ? gc_heap->bytes_after_gc - freed : 0;
+}
+
+// Objects traced or swept between two looks at the clock.
+#define GC_STEP_CHUNK 256
+
+// One bounded slice of major work. The final re-mark of the roots is not
+// divisible, but by then the gray stack is usually close to empty.
+static void gc_major_step(VM* vm, long objects_left) {
+    double start = gc_now_us();
+    size_t bytes_before = gc_heap->bytes_allocated;
+    for (;;) {
+        long chunk = GC_STEP_CHUNK;
+        if (objects_left >= 0 && objects_left < chunk) chunk = objects_left;
+        int done = gc_heap->phase == GC_MARKING ? gc_drain_gray(chunk) : gc_sweep_step(chunk);
+        if (done && gc_heap->phase == GC_MARKING) {
+            finish_marking(vm);
+            done = 0;
+        }
+        if (done || gc_heap->phase == GC_IDLE) break;
+        if (objects_left >= 0) {
+            objects_left -= chunk;
+            if (objects_left <= 0) break;
+        }
+        if (gc_heap->config.pause_us > 0 && gc_now_us() - start >= gc_heap->config.pause_us) break;
+    }
+    discount_swept_bytes(bytes_before);
+    gc_heap->next_gc_step = gc_heap->bytes_allocated + (size_t)gc_heap->config.step_kb * 1024;
+    gc_record_pause(1, gc_now_us() - start);
 }
 
 void maybe_collect_garbage(VM* vm) {
     if (vm->disable_gc) return;  // Skip GC if disabled
 
-    extern size_t bytes_allocated;
-    extern size_t next_gc;
-    if (bytes_allocated > next_gc) {
-        collect_garbage(vm);
+#ifdef DEBUG_STRESS_GC
+#ifdef TOI_NO_GENERATIONAL_GC
+    collect_garbage(vm);
+    return;
+#else
+    if (gc_heap->phase != GC_IDLE) {
+        gc_major_step(vm, 32);
+    } else if (gc_heap->stats.minor_count % 64 == 63) {
+        gc_begin_major();
+        mark_roots(vm);
     }
+    if (gc_heap->phase != GC_MARKING) collect_young_garbage(vm);
+    return;
+#endif
+#endif
+    long step_objects = gc_heap->config.step_objects > 0 ? gc_heap->config.step_objects : -1;
+    if (gc_heap->phase == GC_IDLE && gc_heap->bytes_allocated > gc_heap->next_gc) {
+        if (!gc_heap->config.incremental) {
+            collect_garbage(vm);
+            return;
+        }
+        double start = gc_now_us();
+        gc_begin_major();
+        mark_roots(vm);
+        gc_heap->next_gc_step = gc_heap->bytes_allocated + (size_t)gc_heap->config.step_kb * 1024;
+        gc_record_pause(1, gc_now_us() - start);
+        return;
+    }
+    if (gc_heap->phase != GC_IDLE) {
+        if (gc_heap->bytes_allocated > gc_heap->next_gc * 2) {
+            // The mutator is outrunning the collector; finish in one pause
+            // rather than let the heap grow without bound.
+            double start = gc_now_us();
+            size_t bytes_before = gc_heap->bytes_allocated;
+            finish_major(vm);
+            discount_swept_bytes(bytes_before);
+            gc_record_pause(1, gc_now_us() - start);
+        } else if (gc_heap->bytes_allocated >= gc_heap->next_gc_step) {
+            gc_major_step(vm, step_objects);
+        }
+        if (gc_heap->phase == GC_MARKING) return;
+    }
+#ifndef TOI_NO_GENERATIONAL_GC
+    if (gc_heap->bytes_allocated > gc_heap->bytes_after_gc + (size_t)gc_heap->config.nursery_kb * 1024) {
+        collect_young_garbage(vm);
+    }
+#endif
 }
 
 void define_native(VM* vm, const char* name, NativeFn function) {
@@ -1065,21 +1221,21 @@ void define_native(VM* vm, const char* name, NativeFn function) {
     pop(vm); // Native name.
 }
 
-ObjString* number_key_string(double num) {
-    if (num == 0) num = 0.0; // normalize -0 to 0
-    char numbuf[32];
-    snprintf(numbuf, sizeof(numbuf), "%.17g", num);
-    char buffer[2 + 32];
-    buffer[0] = '\x1F';
-    buffer[1] = 'n';
-    size_t len = strlen(numbuf);
-    memcpy(buffer + 2, numbuf, len);
-    return copy_string(buffer, (int)(2 + len));
+// Returns the interned string for a constant C key and pins it for the
+// lifetime of the VM, so repeated lookups neither allocate nor create
+// garbage. Each call still hashes the key; keys used on hot paths are
+// created once in init_vm instead.
+ObjString* vm_intern_key(VM* vm, const char* chars) {
+    int length = (int)strlen(chars);
+    ObjString* key = copy_string(chars, length);
+    if (table_find_slot(&vm->pinned_keys, OBJ_VAL(key)) < 0) {
+        table_set(&vm->pinned_keys, key, NIL_VAL);
+    }
+    return key;
 }
 
 Value get_metamethod(VM* vm, Value val, const char* name) {
-    ObjString* method_name = copy_string(name, (int)strlen(name));
-    push(vm, OBJ_VAL(method_name)); // Protect from GC
+    ObjString* method_name = vm_intern_key(vm, name);
     Value method = NIL_VAL;
 
     if (IS_TABLE(val)) {
@@ -1093,11 +1249,17 @@ Value get_metamethod(VM* vm, Value val, const char* name) {
             table_get(&udata->metatable->table, method_name, &method);
         }
     }
-    pop(vm); // Pop method_name
     return method;
 }
 
-static ObjThread* run_stop_thread = NULL;
+static TOI_THREAD_LOCAL ObjThread* run_stop_thread = NULL;
+static TOI_THREAD_LOCAL int run_keeps_result = 0;
+
+// Direct-threaded dispatch through labels-as-values on GCC and Clang. The
+// wasm build and other compilers fall back to the portable switch.
+#if defined(__GNUC__) && !defined(TOI_WASM) && !defined(TOI_NO_COMPUTED_GOTO)
+#define TOI_COMPUTED_GOTO
+#endif
 
 static void set_global_value(VM* vm, ObjString* key, Value value) {
     push(vm, OBJ_VAL(key));
@@ -1139,216 +1301,359 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
 #define READ_CONSTANT() (frame->closure->function->chunk.constants.values[READ_BYTE()])
 #define READ_STRING() AS_STRING(READ_CONSTANT())
 
-    for (;;) {
-        if (run_stop_thread != NULL && vm_current_thread(vm) == run_stop_thread) {
-            return INTERPRET_OK;
-        }
-        if (interrupt_requested) {
-            interrupt_requested = 0;
-            vm_runtime_error(vm, "Interrupted.");
-            goto runtime_error;
-        }
 #ifdef DEBUG_TRACE_EXECUTION
-        printf("          ");
-        for (Value* slot = vm_current_thread(vm)->stack; slot < vm_current_thread(vm)->stack_top; slot++) {
-            printf("[ ");
-            print_value(*slot);
-            printf(" ]");
-        }
-        printf("\n");
-        disassemble_instruction(&frame->closure->function->chunk, (int)(ip - frame->closure->function->chunk.code));
+#define TRACE_INSTRUCTION() \
+    do { \
+        printf("          "); \
+        for (Value* slot = vm_current_thread(vm)->stack; slot < vm_current_thread(vm)->stack_top; slot++) { \
+            printf("[ "); \
+            print_value(*slot); \
+            printf(" ]"); \
+        } \
+        printf("\n"); \
+        disassemble_instruction(&frame->closure->function->chunk, (int)(ip - frame->closure->function->chunk.code)); \
+    } while (0)
+#else
+#define TRACE_INSTRUCTION() ((void)0)
+#endif
+
+// Stop-thread, interrupt and lock-handoff checks run only where control
+// can loop or change threads: backward jumps, calls, returns into a caller
+// thread and handled exceptions. Straight-line code never pays for them.
+#define SAFEPOINT() \
+    do { \
+        if (run_stop_thread != NULL && vm_current_thread(vm) == run_stop_thread) { \
+            return INTERPRET_OK; \
+        } \
+        if (interrupt_requested) { \
+            interrupt_requested = 0; \
+            vm_runtime_error(vm, "Interrupted."); \
+            goto runtime_error; \
+        } \
+        if (vm->switch_request) { \
+            frame->ip = ip; \
+            vm->switch_hook(vm); \
+        } \
+    } while (0)
+
+#ifdef TOI_COMPUTED_GOTO
+#define DISPATCH() \
+    do { \
+        TRACE_INSTRUCTION(); \
+        goto *dispatch_table[READ_BYTE()]; \
+    } while (0)
+#define OPCASE(op) op_##op
+#define NEXT() DISPATCH()
+#else
+#define OPCASE(op) case op
+#define NEXT() continue
+#endif
+
+    // A caller may hand us a thread that is already the stop thread, or
+    // a pending interrupt; honour both before the first instruction.
+    SAFEPOINT();
+
+#ifdef TOI_COMPUTED_GOTO
+    static void* const dispatch_table[] = {
+        [OP_CONSTANT] = &&op_OP_CONSTANT,
+        [OP_APPEND] = &&op_OP_APPEND,
+        [OP_ADD] = &&op_OP_ADD,
+        [OP_ADD_INPLACE] = &&op_OP_ADD_INPLACE,
+        [OP_ADD_CONST] = &&op_OP_ADD_CONST,
+        [OP_SUBTRACT] = &&op_OP_SUBTRACT,
+        [OP_SUB_CONST] = &&op_OP_SUB_CONST,
+        [OP_MULTIPLY] = &&op_OP_MULTIPLY,
+        [OP_MUL_CONST] = &&op_OP_MUL_CONST,
+        [OP_DIVIDE] = &&op_OP_DIVIDE,
+        [OP_DIV_CONST] = &&op_OP_DIV_CONST,
+        [OP_NOT] = &&op_OP_NOT,
+        [OP_NEGATE] = &&op_OP_NEGATE,
+        [OP_LENGTH] = &&op_OP_LENGTH,
+        [OP_PRINT] = &&op_OP_PRINT,
+        [OP_POP] = &&op_OP_POP,
+        [OP_GET_GLOBAL] = &&op_OP_GET_GLOBAL,
+        [OP_DEFINE_GLOBAL] = &&op_OP_DEFINE_GLOBAL,
+        [OP_SET_GLOBAL] = &&op_OP_SET_GLOBAL,
+        [OP_DELETE_GLOBAL] = &&op_OP_DELETE_GLOBAL,
+        [OP_GET_LOCAL] = &&op_OP_GET_LOCAL,
+        [OP_SET_LOCAL] = &&op_OP_SET_LOCAL,
+        [OP_ADD_SET_LOCAL] = &&op_OP_ADD_SET_LOCAL,
+        [OP_SUB_SET_LOCAL] = &&op_OP_SUB_SET_LOCAL,
+        [OP_MUL_SET_LOCAL] = &&op_OP_MUL_SET_LOCAL,
+        [OP_DIV_SET_LOCAL] = &&op_OP_DIV_SET_LOCAL,
+        [OP_MOD_SET_LOCAL] = &&op_OP_MOD_SET_LOCAL,
+        [OP_INC_LOCAL] = &&op_OP_INC_LOCAL,
+        [OP_SUB_LOCAL_CONST] = &&op_OP_SUB_LOCAL_CONST,
+        [OP_MUL_LOCAL_CONST] = &&op_OP_MUL_LOCAL_CONST,
+        [OP_DIV_LOCAL_CONST] = &&op_OP_DIV_LOCAL_CONST,
+        [OP_MOD_LOCAL_CONST] = &&op_OP_MOD_LOCAL_CONST,
+        [OP_GET_UPVALUE] = &&op_OP_GET_UPVALUE,
+        [OP_SET_UPVALUE] = &&op_OP_SET_UPVALUE,
+        [OP_CLOSE_UPVALUE] = &&op_OP_CLOSE_UPVALUE,
+        [OP_GET_TABLE] = &&op_OP_GET_TABLE,
+        [OP_GET_META_TABLE] = &&op_OP_GET_META_TABLE,
+        [OP_SET_TABLE] = &&op_OP_SET_TABLE,
+        [OP_DELETE_TABLE] = &&op_OP_DELETE_TABLE,
+        [OP_NEW_TABLE] = &&op_OP_NEW_TABLE,
+        [OP_DUP] = &&op_OP_DUP,
+        [OP_JUMP] = &&op_OP_JUMP,
+        [OP_JUMP_IF_FALSE] = &&op_OP_JUMP_IF_FALSE,
+        [OP_JUMP_IF_TRUE] = &&op_OP_JUMP_IF_TRUE,
+        [OP_LOOP] = &&op_OP_LOOP,
+        [OP_CALL] = &&op_OP_CALL,
+        [OP_CALL0] = &&op_OP_CALL0,
+        [OP_CALL1] = &&op_OP_CALL1,
+        [OP_CALL2] = &&op_OP_CALL2,
+        [OP_CALL_NAMED] = &&op_OP_CALL_NAMED,
+        [OP_CALL_EXPAND] = &&op_OP_CALL_EXPAND,
+        [OP_CLOSURE] = &&op_OP_CLOSURE,
+        [OP_RETURN] = &&op_OP_RETURN,
+        [OP_TRUE] = &&op_OP_TRUE,
+        [OP_FALSE] = &&op_OP_FALSE,
+        [OP_NIL] = &&op_OP_NIL,
+        [OP_EQUAL] = &&op_OP_EQUAL,
+        [OP_GREATER] = &&op_OP_GREATER,
+        [OP_LESS] = &&op_OP_LESS,
+        [OP_HAS] = &&op_OP_HAS,
+        [OP_IN] = &&op_OP_IN,
+        [OP_POWER] = &&op_OP_POWER,
+        [OP_INT_DIV] = &&op_OP_INT_DIV,
+        [OP_MODULO] = &&op_OP_MODULO,
+        [OP_IADD] = &&op_OP_IADD,
+        [OP_ISUB] = &&op_OP_ISUB,
+        [OP_IMUL] = &&op_OP_IMUL,
+        [OP_IDIV] = &&op_OP_IDIV,
+        [OP_IMOD] = &&op_OP_IMOD,
+        [OP_FADD] = &&op_OP_FADD,
+        [OP_FSUB] = &&op_OP_FSUB,
+        [OP_FMUL] = &&op_OP_FMUL,
+        [OP_FDIV] = &&op_OP_FDIV,
+        [OP_FMOD] = &&op_OP_FMOD,
+        [OP_MOD_CONST] = &&op_OP_MOD_CONST,
+        [OP_GC] = &&op_OP_GC,
+        [OP_GC_CONFIG] = &&op_OP_GC_CONFIG,
+        [OP_SET_METATABLE] = &&op_OP_SET_METATABLE,
+        [OP_RETURN_N] = &&op_OP_RETURN_N,
+        [OP_ADJUST_STACK] = &&op_OP_ADJUST_STACK,
+        [OP_UNPACK] = &&op_OP_UNPACK,
+        [OP_TRY] = &&op_OP_TRY,
+        [OP_END_TRY] = &&op_OP_END_TRY,
+        [OP_END_FINALLY] = &&op_OP_END_FINALLY,
+        [OP_IMPORT] = &&op_OP_IMPORT,
+        [OP_IMPORT_STAR] = &&op_OP_IMPORT_STAR,
+        [OP_THROW] = &&op_OP_THROW,
+        [OP_BUILD_STRING] = &&op_OP_BUILD_STRING,
+        [OP_ITER_PREP] = &&op_OP_ITER_PREP,
+        [OP_ITER_PREP_IPAIRS] = &&op_OP_ITER_PREP_IPAIRS,
+        [OP_RANGE] = &&op_OP_RANGE,
+        [OP_FOR_PREP] = &&op_OP_FOR_PREP,
+        [OP_FOR_LOOP] = &&op_OP_FOR_LOOP,
+        [OP_SLICE] = &&op_OP_SLICE
+    };
 #endif
 
+    for (;;) {
+#ifdef TOI_COMPUTED_GOTO
+        DISPATCH();
+#else
+        TRACE_INSTRUCTION();
         uint8_t instruction = READ_BYTE();
         switch (instruction) {
-            case OP_TRY: {
+#endif
+            OPCASE(OP_TRY): {
                 if (!vm_handle_op_try(vm, frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_END_TRY: {
+            OPCASE(OP_END_TRY): {
                 vm_handle_op_end_try(vm);
-                break;
+                NEXT();
             }
-            case OP_END_FINALLY: {
+            OPCASE(OP_END_FINALLY): {
                 if (!vm_handle_op_end_finally(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_THROW: {
+            OPCASE(OP_THROW): {
                 vm_handle_op_throw(vm);
                 goto runtime_error;
             }
-            case OP_CONSTANT: {
+            OPCASE(OP_CONSTANT): {
                 vm_handle_op_constant(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_BUILD_STRING: {
+            OPCASE(OP_BUILD_STRING): {
                 uint8_t part_count = READ_BYTE();
                 if (!vm_build_string(vm, part_count)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_NIL: push(vm, NIL_VAL); break;
-            case OP_TRUE: push(vm, BOOL_VAL(1)); break;
-            case OP_FALSE: push(vm, BOOL_VAL(0)); break;
-            case OP_POP: pop(vm); break;
-            case OP_GET_GLOBAL: {
+            OPCASE(OP_NIL): push(vm, NIL_VAL); NEXT();
+            OPCASE(OP_TRUE): push(vm, BOOL_VAL(1)); NEXT();
+            OPCASE(OP_FALSE): push(vm, BOOL_VAL(0)); NEXT();
+            OPCASE(OP_POP): pop(vm); NEXT();
+            OPCASE(OP_GET_GLOBAL): {
                 if (!vm_handle_op_get_global(vm, frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_DEFINE_GLOBAL: {
+            OPCASE(OP_DEFINE_GLOBAL): {
                 vm_handle_op_define_global(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_SET_GLOBAL: {
+            OPCASE(OP_SET_GLOBAL): {
                 vm_handle_op_set_global(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_DELETE_GLOBAL: {
+            OPCASE(OP_DELETE_GLOBAL): {
                 if (!vm_handle_op_delete_global(vm, frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_GET_LOCAL: {
+            OPCASE(OP_GET_LOCAL): {
                 vm_handle_op_get_local(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_SET_LOCAL: {
+            OPCASE(OP_SET_LOCAL): {
                 vm_handle_op_set_local(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_ADD_SET_LOCAL: {
+            OPCASE(OP_ADD_SET_LOCAL): {
                 if (!vm_handle_op_add_set_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_SUB_SET_LOCAL: {
+            OPCASE(OP_SUB_SET_LOCAL): {
                 if (!vm_handle_op_sub_set_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_MUL_SET_LOCAL: {
+            OPCASE(OP_MUL_SET_LOCAL): {
                 if (!vm_handle_op_mul_set_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_DIV_SET_LOCAL: {
+            OPCASE(OP_DIV_SET_LOCAL): {
                 if (!vm_handle_op_div_set_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_MOD_SET_LOCAL: {
+            OPCASE(OP_MOD_SET_LOCAL): {
                 if (!vm_handle_op_mod_set_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_INC_LOCAL: {
+            OPCASE(OP_INC_LOCAL): {
                 if (!vm_handle_op_inc_local(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_SUB_LOCAL_CONST: {
+            OPCASE(OP_SUB_LOCAL_CONST): {
                 if (!vm_handle_op_sub_local_const(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_MUL_LOCAL_CONST: {
+            OPCASE(OP_MUL_LOCAL_CONST): {
                 if (!vm_handle_op_mul_local_const(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_DIV_LOCAL_CONST: {
+            OPCASE(OP_DIV_LOCAL_CONST): {
                 if (!vm_handle_op_div_local_const(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_MOD_LOCAL_CONST: {
+            OPCASE(OP_MOD_LOCAL_CONST): {
                 if (!vm_handle_op_mod_local_const(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_GET_UPVALUE: {
+            OPCASE(OP_GET_UPVALUE): {
                 vm_handle_op_get_upvalue(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_SET_UPVALUE: {
+            OPCASE(OP_SET_UPVALUE): {
                 vm_handle_op_set_upvalue(vm, frame, &ip);
-                break;
+                NEXT();
             }
-            case OP_CLOSE_UPVALUE: {
+            OPCASE(OP_CLOSE_UPVALUE): {
                 close_upvalues(vm, vm_current_thread(vm)->stack_top - 1);
                 pop(vm);
-                break;
+                NEXT();
             }
-            case OP_NEW_TABLE: {
+            OPCASE(OP_NEW_TABLE): {
                 if (!vm_handle_op_new_table(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_SET_METATABLE: {
+            OPCASE(OP_SET_METATABLE): {
                 if (!vm_handle_op_set_metatable(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_DUP: push(vm, peek(vm, 0)); break;
-            case OP_GET_TABLE: {
+            OPCASE(OP_DUP): push(vm, peek(vm, 0)); NEXT();
+            OPCASE(OP_GET_TABLE): {
                 if (!vm_handle_op_get_table(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_GET_META_TABLE: {
+            OPCASE(OP_GET_META_TABLE): {
                 if (!vm_handle_op_get_meta_table(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_SET_TABLE: {
+            OPCASE(OP_SET_TABLE): {
                 if (!vm_handle_op_set_table(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_DELETE_TABLE: {
+            OPCASE(OP_DELETE_TABLE): {
                 if (!vm_handle_op_delete_table(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_PRINT: {
+            OPCASE(OP_PRINT): {
                 uint8_t arg_count = READ_BYTE();
                 InterpretResult print_result = INTERPRET_OK;
                 int print_status = vm_handle_op_print(vm, &frame, &ip, arg_count, &print_result);
                 if (print_status < 0) goto runtime_error;
                 if (print_status == 0) return print_result;
-                break;
+                NEXT();
             }
-            case OP_JUMP: {
+            OPCASE(OP_JUMP): {
                 vm_handle_op_jump(&ip);
-                break;
+                NEXT();
             }
-            case OP_JUMP_IF_FALSE: {
+            OPCASE(OP_JUMP_IF_FALSE): {
                 vm_handle_op_jump_if_false(vm, &ip);
-                break;
+                NEXT();
             }
-            case OP_JUMP_IF_TRUE: {
+            OPCASE(OP_JUMP_IF_TRUE): {
                 vm_handle_op_jump_if_true(vm, &ip);
-                break;
+                NEXT();
             }
-            case OP_LOOP: {
+            OPCASE(OP_LOOP): {
                 vm_handle_op_loop(&ip);
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL: {
+            OPCASE(OP_CALL): {
                 int arg_count = READ_BYTE();
                 if (!invoke_call_with_arg_count(vm, arg_count, &frame, &ip)) {
                     goto runtime_error;
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL0: {
+            OPCASE(OP_CALL0): {
                 if (!invoke_call_with_arg_count(vm, 0, &frame, &ip)) {
                     goto runtime_error;
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL1: {
+            OPCASE(OP_CALL1): {
                 if (!invoke_call_with_arg_count(vm, 1, &frame, &ip)) {
                     goto runtime_error;
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL2: {
+            OPCASE(OP_CALL2): {
                 if (!invoke_call_with_arg_count(vm, 2, &frame, &ip)) {
                     goto runtime_error;
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL_NAMED: {
+            OPCASE(OP_CALL_NAMED): {
                 int arg_count = READ_BYTE();
                 if (!invoke_call_with_named_arg_count(vm, arg_count, &frame, &ip)) {
                     goto runtime_error;
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_CALL_EXPAND: {
+            OPCASE(OP_CALL_EXPAND): {
                 int fixed_arg_count = READ_BYTE();
                 Value spread = peek(vm, 0);
                 if (!IS_TABLE(spread)) {
@@ -1395,33 +1700,35 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
                         goto runtime_error;
                     }
                 }
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_ITER_PREP: {
+            OPCASE(OP_ITER_PREP): {
                 if (!vm_handle_op_iter_prep(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_ITER_PREP_IPAIRS: {
+            OPCASE(OP_ITER_PREP_IPAIRS): {
                 if (!vm_handle_op_iter_prep_i_pairs(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_RANGE: {
+            OPCASE(OP_RANGE): {
                 if (!vm_handle_op_range(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_FOR_PREP: {
+            OPCASE(OP_FOR_PREP): {
                 if (!vm_handle_op_for_prep(vm, frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_FOR_LOOP: {
+            OPCASE(OP_FOR_LOOP): {
                 if (!vm_handle_op_for_loop(vm, frame, &ip)) goto runtime_error;
-                break;
+                SAFEPOINT();
+                NEXT();
             }
-            case OP_SLICE: {
+            OPCASE(OP_SLICE): {
                 if (!vm_handle_op_slice(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_CLOSURE: {
+            OPCASE(OP_CLOSURE): {
                 ObjFunction* function = AS_FUNCTION(READ_CONSTANT());
                 ObjClosure* closure = new_closure(function);
                 push(vm, OBJ_VAL(closure));
@@ -1438,9 +1745,9 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
                     }
                 }
                 closure->upvalue_count = function->upvalue_count;
-                break;
+                NEXT();
             }
-            case OP_RETURN: {
+            OPCASE(OP_RETURN): {
                 Value result = pop(vm);
                 if (frame->cache_module_result && IS_STRING(frame->module_cache_name)) {
                     table_set(&vm->modules, AS_STRING(frame->module_cache_name), result);
@@ -1482,12 +1789,13 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
                         vm_set_current_thread(vm, caller);
                         frame = &vm_current_thread(vm)->frames[vm_current_thread(vm)->frame_count - 1];
                         ip = frame->ip;
-                        break;
+                        SAFEPOINT();
+                        NEXT();
                     }
 
                     // In REPL mode, leave the result on stack so it can be printed
                     // In normal mode, pop the script closure
-                    if (min_frame_count == 0 && !vm->is_repl) {
+                    if (min_frame_count == 0 && !vm->is_repl && !run_keeps_result) {
                         pop(vm);  // Pop the script closure when completely done
                     }
                     return INTERPRET_OK;
@@ -1495,9 +1803,9 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
 
                 frame = &vm_current_thread(vm)->frames[vm_current_thread(vm)->frame_count - 1];
                 ip = frame->ip;
-                break;
+                NEXT();
             }
-            case OP_RETURN_N: {
+            OPCASE(OP_RETURN_N): {
                 uint8_t count = READ_BYTE();
                 Value* results = vm_current_thread(vm)->stack_top - count;
                 if (frame->cache_module_result && IS_STRING(frame->module_cache_name)) {
@@ -1556,10 +1864,11 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
                         vm_set_current_thread(vm, caller);
                         frame = &vm_current_thread(vm)->frames[vm_current_thread(vm)->frame_count - 1];
                         ip = frame->ip;
-                        break;
+                        SAFEPOINT();
+                        NEXT();
                     }
 
-                    if (min_frame_count == 0) {
+                    if (min_frame_count == 0 && !run_keeps_result) {
                         vm_current_thread(vm)->stack_top -= count;
                     }
                     return INTERPRET_OK;
@@ -1567,160 +1876,167 @@ InterpretResult vm_run(VM* vm, int min_frame_count) {
 
                 frame = &vm_current_thread(vm)->frames[vm_current_thread(vm)->frame_count - 1];
                 ip = frame->ip;
-                break;
+                NEXT();
             }
-            case OP_ADJUST_STACK: {
+            OPCASE(OP_ADJUST_STACK): {
                 uint8_t target_depth = READ_BYTE();
                 vm_current_thread(vm)->stack_top = frame->slots + target_depth;
                 #ifdef DEBUG_MULTI_RETURN
                 printf("OP_ADJUST_STACK: target depth=%d, new stack_top offset=%ld\n",
                        target_depth, vm_current_thread(vm)->stack_top - vm_current_thread(vm)->stack);
                 #endif
-                break;
+                NEXT();
             }
-            case OP_UNPACK: {
+            OPCASE(OP_UNPACK): {
                 if (!vm_handle_op_unpack(vm, frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_ADD_CONST: {
+            OPCASE(OP_ADD_CONST): {
                 Value b = READ_CONSTANT();
                 if (!vm_handle_op_add_const(vm, &frame, &ip, b)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_ADD:
+            OPCASE(OP_ADD):
                 if (!vm_handle_op_add(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_ADD_INPLACE:
+                NEXT();
+            OPCASE(OP_ADD_INPLACE):
                 if (!vm_handle_op_add_inplace(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_SUBTRACT:
+                NEXT();
+            OPCASE(OP_SUBTRACT):
                 if (!vm_handle_op_subtract(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_MULTIPLY:
+                NEXT();
+            OPCASE(OP_MULTIPLY):
                 if (!vm_handle_op_multiply(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_DIVIDE:
+                NEXT();
+            OPCASE(OP_DIVIDE):
                 if (!vm_handle_op_divide(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_MODULO:
+                NEXT();
+            OPCASE(OP_MODULO):
                 if (!vm_handle_op_modulo(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_APPEND:
+                NEXT();
+            OPCASE(OP_APPEND):
                 if (!vm_handle_op_append(vm, &frame, &ip)) goto runtime_error;
-                break;
-            case OP_IADD:
+                NEXT();
+            OPCASE(OP_IADD):
                 vm_handle_op_i_add(vm);
-                break;
-            case OP_SUB_CONST: {
+                NEXT();
+            OPCASE(OP_SUB_CONST): {
                 Value b = READ_CONSTANT();
                 if (!vm_handle_op_sub_const(vm, &frame, &ip, b)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_ISUB:
+            OPCASE(OP_ISUB):
                 vm_handle_op_i_sub(vm);
-                break;
-            case OP_MUL_CONST: {
+                NEXT();
+            OPCASE(OP_MUL_CONST): {
                 Value b = READ_CONSTANT();
                 if (!vm_handle_op_mul_const(vm, &frame, &ip, b)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_IMUL:
+            OPCASE(OP_IMUL):
                 vm_handle_op_i_mul(vm);
-                break;
-            case OP_DIV_CONST: {
+                NEXT();
+            OPCASE(OP_DIV_CONST): {
                 Value b = READ_CONSTANT();
                 if (!vm_handle_op_div_const(vm, &frame, &ip, b)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_IDIV:
+            OPCASE(OP_IDIV):
                 vm_handle_op_i_div(vm);
-                break;
-            case OP_NEGATE:
+                NEXT();
+            OPCASE(OP_NEGATE):
                 vm_handle_op_negate(vm);
-                break;
-            case OP_NOT:
+                NEXT();
+            OPCASE(OP_NOT):
                 vm_handle_op_not(vm);
-                break;
-            case OP_LENGTH:
+                NEXT();
+            OPCASE(OP_LENGTH):
                 if (!vm_handle_op_length(vm)) goto runtime_error;
-                break;
-            case OP_EQUAL: {
+                NEXT();
+            OPCASE(OP_EQUAL): {
                 if (!vm_handle_op_equal(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_GREATER: {
+            OPCASE(OP_GREATER): {
                 if (!vm_handle_op_greater(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_LESS: {
+            OPCASE(OP_LESS): {
                 if (!vm_handle_op_less(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_HAS: {
+            OPCASE(OP_HAS): {
                 if (!vm_handle_op_has(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_IN: {
+            OPCASE(OP_IN): {
                 if (!vm_handle_op_in(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_POWER: {
+            OPCASE(OP_POWER): {
                 if (!vm_handle_op_power(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_INT_DIV: {
+            OPCASE(OP_INT_DIV): {
                 if (!vm_handle_op_int_div(vm, &frame, &ip)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_IMOD: {
+            OPCASE(OP_IMOD): {
                 vm_handle_op_i_mod(vm);
-                break;
+                NEXT();
             }
-            case OP_FADD: {
+            OPCASE(OP_FADD): {
                 vm_handle_op_f_add(vm);
-                break;
+                NEXT();
             }
-            case OP_FSUB: {
+            OPCASE(OP_FSUB): {
                 vm_handle_op_f_sub(vm);
-                break;
+                NEXT();
             }
-            case OP_FMUL: {
+            OPCASE(OP_FMUL): {
                 vm_handle_op_f_mul(vm);
-                break;
+                NEXT();
             }
-            case OP_FDIV: {
+            OPCASE(OP_FDIV): {
                 vm_handle_op_f_div(vm);
-                break;
+                NEXT();
             }
-            case OP_FMOD: {
+            OPCASE(OP_FMOD): {
                 vm_handle_op_f_mod(vm);
-                break;
+                NEXT();
             }
-            case OP_MOD_CONST: {
+            OPCASE(OP_MOD_CONST): {
                 Value b = READ_CONSTANT();
                 if (!vm_handle_op_mod_const(vm, &frame, &ip, b)) goto runtime_error;
-                break;
+                NEXT();
             }
-            case OP_GC: {
+            OPCASE(OP_GC): {
                 collect_garbage(vm);
-                break;
+                NEXT();
+            }
+            OPCASE(OP_GC_CONFIG): {
+                if (!vm_handle_op_gc_config(vm)) goto runtime_error;
+                NEXT();
             }
-            case OP_IMPORT: {
+            OPCASE(OP_IMPORT): {
                ObjString* module_name = READ_STRING();
                InterpretResult import_result = vm_handle_op_import(vm, module_name, &frame, &ip);
                if (import_result == INTERPRET_RUNTIME_ERROR) goto runtime_error;
                if (import_result == INTERPRET_COMPILE_ERROR) return INTERPRET_COMPILE_ERROR;
-                break;
+                NEXT();
             }
-            case OP_IMPORT_STAR: {
+            OPCASE(OP_IMPORT_STAR): {
                 if (!vm_handle_op_import_star(vm)) goto runtime_error;
-                break;
+                NEXT();
             }
+#ifndef TOI_COMPUTED_GOTO
         }
         continue;
+#endif
 runtime_error:
         if (handle_exception(vm, &frame, &ip)) {
-            continue;
+            SAFEPOINT();
+            NEXT();
         }
         return INTERPRET_RUNTIME_ERROR;
     }
@@ -1729,6 +2045,13 @@ runtime_error:
 #undef READ_SHORT
 #undef READ_CONSTANT
 #undef READ_STRING
+#undef TRACE_INSTRUCTION
+#undef SAFEPOINT
+#undef OPCASE
+#undef NEXT
+#ifdef TOI_COMPUTED_GOTO
+#undef DISPATCH
+#endif
 }
 
 InterpretResult vm_run_until_thread(VM* vm, int min_frame_count, ObjThread* stop_thread) {
@@ -1739,6 +2062,14 @@ InterpretResult vm_run_until_thread(VM* vm, int min_frame_count, ObjThread* stop
     return result;
 }
 
+InterpretResult vm_run_entry(VM* vm) {
+    int saved_keeps_result = run_keeps_result;
+    run_keeps_result = 1;
+    InterpretResult result = vm_run(vm, 0);
+    run_keeps_result = saved_keeps_result;
+    return result;
+}
+
 InterpretResult interpret(VM* vm, ObjFunction* function) {
     ObjClosure* closure = new_closure(function);
     push(vm, OBJ_VAL(closure));
@@ -10,7 +10,16 @@ typedef struct VM {
    ObjThread* gc_parked_threads;
    Table globals;
    Table modules;  // Cache of loaded modules (native and .toi)
+   Table pinned_keys;  // Interned constant keys kept alive for natives
    int use_thread_tls;
+   // Raised by a thread that has waited a switch interval for the VM lock;
+   // the running thread calls switch_hook at its next safepoint.
+   volatile int switch_request;
+   void (*switch_hook)(struct VM* vm);
+   // Set by the thread module: let other threads run during a blocking
+   // system call. blocking_end restores the thread blocking_begin returned.
+   ObjThread* (*blocking_begin)(struct VM* vm);
+   void (*blocking_end)(struct VM* vm, ObjThread* caller);
    int cli_argc;
    char** cli_argv;
     int disable_gc;
@@ -30,8 +39,28 @@ typedef struct VM {
     ObjString* module_name_key;
     ObjString* module_file_key;
     ObjString* module_main_key;
+    ObjString* next_name;
+    ObjString* msg_key;
+    ObjString* type_key;
+    ObjString* gen_next_name;
+    ObjString* inext_name;
+    ObjString* range_name;
+    ObjString* await_name;
+    // Row keys of poll.wait and loop.wait results.
+    ObjString* fd_key;
+    ObjString* events_key;
+    ObjString* data_key;
+    ObjString* index_key;
+    ObjString* in_key;
+    ObjString* out_key;
+    ObjString* pri_key;
+    ObjString* err_key;
+    ObjString* hup_key;
+    ObjString* nval_key;
+    ObjString* revents_key;
     Value str_upper_fn;
     Value str_lower_fn;
+    Value table_iter_fn;
 } VM;
 
 typedef enum {
@@ -44,21 +73,51 @@ typedef enum {
 void init_vm(VM* vm);
 void free_vm(VM* vm);
 InterpretResult interpret(VM* vm, ObjFunction* function);
-void push(VM* vm, Value value);
-Value pop(VM* vm);
-Value peek(VM* vm, int distance);
 void define_native(VM* vm, const char* name, NativeFn function);
 void vm_runtime_error(VM* vm, const char* format, ...);
-ObjString* number_key_string(double num);
+ObjString* vm_intern_key(VM* vm, const char* chars);
 int call(VM* vm, ObjClosure* closure, int arg_count);
 int call_value(VM* vm, Value callee, int arg_count, CallFrame** frame, uint8_t** ip);
 void maybe_collect_garbage(VM* vm);
 InterpretResult vm_run(VM* vm, int min_frame_count);
 InterpretResult vm_run_until_thread(VM* vm, int min_frame_count, ObjThread* stop_thread);
+// Runs the function called as the first frame of a thread (a thread.spawn
+// worker, an isolate or pool entry) to completion, leaving its results on
+// the stack.
+InterpretResult vm_run_entry(VM* vm);
 Value get_metamethod(VM* vm, Value val, const char* name);
 void vm_request_interrupt(void);
-ObjThread* vm_current_thread(VM* vm);
 void vm_set_current_thread(VM* vm, ObjThread* thread);
 void vm_enable_thread_tls(VM* vm);
 
+// The running ObjThread. Once threads are in use each OS thread tracks its
+// own in a native thread-local, so the lookup stays a plain load; push,
+// pop and peek are inline for the same reason, since every opcode uses them.
+#ifndef TOI_WASM
+extern TOI_THREAD_LOCAL ObjThread* vm_tls_thread;
+#endif
+
+static inline ObjThread* vm_current_thread(VM* vm) {
+#ifndef TOI_WASM
+    if (vm->use_thread_tls && vm_tls_thread != NULL) {
+        return vm_tls_thread;
+    }
+#endif
+    return vm->current_thread;
+}
+
+static inline void push(VM* vm, Value value) {
+    ObjThread* thread = vm_current_thread(vm);
+    *thread->stack_top++ = value;
+}
+
+static inline Value pop(VM* vm) {
+    ObjThread* thread = vm_current_thread(vm);
+    return *--thread->stack_top;
+}
+
+static inline Value peek(VM* vm, int distance) {
+    return vm_current_thread(vm)->stack_top[-1 - distance];
+}
+
 #endif
@@ -70,7 +70,7 @@ int vm_handle_op_has(VM* vm, CallFrame** frame, uint8_t** ip) {
         if (!found) {
             for (int i = 0; i < t->table.capacity; i++) {
                 Entry* entry = &t->table.entries[i];
-                if (entry->key != NULL && values_equal_simple_local(entry->value, b)) {
+                if (!IS_NIL(entry->key) && values_equal_simple_local(entry->value, b)) {
                     found = 1;
                     break;
                 }
@@ -122,7 +122,7 @@ int vm_handle_op_in(VM* vm, CallFrame** frame, uint8_t** ip) {
         if (!found) {
             for (int i = 0; i < t->table.capacity; i++) {
                 Entry* entry = &t->table.entries[i];
-                if (entry->key != NULL && values_equal_simple_local(entry->value, needle)) {
+                if (!IS_NIL(entry->key) && values_equal_simple_local(entry->value, needle)) {
                     found = 1;
                     break;
                 }
@@ -3,6 +3,7 @@
 #include <string.h>
 
 #include "../lib/libs.h"
+#include "../toic.h"
 #include "ops_import.h"
 
 ObjFunction* compile(const char* source);
@@ -66,7 +67,8 @@ InterpretResult vm_handle_op_import(VM* vm, ObjString* module_name, CallFrame**
     module_path[j] = '\0';
 
     char filename[512];
-    FILE* file = NULL;
+    ToicStamp stamp;
+    int found = 0;
     const char* candidates[4] = {
         "%s.toi",
         "%s/__.toi",
@@ -74,39 +76,51 @@ InterpretResult vm_handle_op_import(VM* vm, ObjString* module_name, CallFrame**
         "lib/%s/__.toi"
     };
 
-    for (int ci = 0; ci < 4 && file == NULL; ci++) {
+    // stat() the candidates rather than opening each one; the stamp is
+    // also what validates the bytecode cache.
+    for (int ci = 0; ci < 4 && !found; ci++) {
         snprintf(filename, sizeof(filename), candidates[ci], module_path);
-        file = fopen(filename, "rb");
+        found = toic_stamp(filename, &stamp);
     }
 
-    if (file == NULL) {
+    if (!found) {
         printf("\033[31mCould not open module '%s'\033[0m (tried '%s.toi', '%s/__.toi', "
                "'lib/%s.toi', and 'lib/%s/__.toi').\n",
                module_name->chars, module_path, module_path, module_path, module_path);
         return INTERPRET_RUNTIME_ERROR;
     }
 
-    fseek(file, 0L, SEEK_END);
-    size_t file_size = ftell(file);
-    rewind(file);
+    ObjFunction* module_function = toic_load(filename, &stamp);
+    if (module_function == NULL) {
+        FILE* file = fopen(filename, "rb");
+        if (file == NULL) {
+            printf("\033[31mCould not open module '%s'\033[0m ('%s').\n", module_name->chars, filename);
+            return INTERPRET_RUNTIME_ERROR;
+        }
 
-    char* buffer = (char*)malloc(file_size + 1);
-    if (buffer == NULL) {
-        fclose(file);
-        printf("Not enough memory to read module '%s'.\n", module_name->chars);
-        return INTERPRET_RUNTIME_ERROR;
-    }
+        fseek(file, 0L, SEEK_END);
+        size_t file_size = ftell(file);
+        rewind(file);
 
-    size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
-    buffer[bytes_read] = '\0';
-    fclose(file);
+        char* buffer = (char*)malloc(file_size + 1);
+        if (buffer == NULL) {
+            fclose(file);
+            printf("Not enough memory to read module '%s'.\n", module_name->chars);
+            return INTERPRET_RUNTIME_ERROR;
+        }
 
-    ObjFunction* module_function = compile(buffer);
-    free(buffer);
+        size_t bytes_read = fread(buffer, sizeof(char), file_size, file);
+        buffer[bytes_read] = '\0';
+        fclose(file);
 
-    if (module_function == NULL) {
-        printf("Failed to compile module '%s'.\n", module_name->chars);
-        return INTERPRET_COMPILE_ERROR;
+        module_function = compile(buffer);
+        free(buffer);
+
+        if (module_function == NULL) {
+            printf("Failed to compile module '%s'.\n", module_name->chars);
+            return INTERPRET_COMPILE_ERROR;
+        }
+        toic_store(filename, &stamp, module_function);
     }
 
     ObjClosure* module_closure = new_closure(module_function);
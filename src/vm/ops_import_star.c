@@ -10,8 +10,8 @@ int vm_handle_op_import_star(VM* vm) {
     ObjTable* t = AS_TABLE(module);
     for (int i = 0; i < t->table.capacity; i++) {
         Entry* entry = &t->table.entries[i];
-        if (entry->key != NULL && !IS_NIL(entry->value)) {
-            table_set(&vm->globals, entry->key, entry->value);
+        if (IS_STRING(entry->key) && !IS_NIL(entry->value)) {
+            table_set(&vm->globals, AS_STRING(entry->key), entry->value);
         }
     }
     maybe_collect_garbage(vm);
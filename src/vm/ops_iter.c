@@ -1,3 +1,4 @@
+#include "../lib/libs.h"
 #include "ops_iter.h"
 
 static int is_callable_value_local(Value value) {
@@ -24,7 +25,7 @@ static Value get_metamethod_cached_local(VM* vm, Value val, ObjString* name) {
 static Value get_iterator_next_function_local(VM* vm, Value iterable) {
     if (IS_THREAD(iterable)) {
         Value next = NIL_VAL;
-        ObjString* name = copy_string("gen_next", 8);
+        ObjString* name = vm->gen_next_name;
         if (table_get(&vm->globals, name, &next) && is_callable_value_local(next)) {
             return next;
         }
@@ -41,6 +42,81 @@ static Value get_iterator_next_function_local(VM* vm, Value iterable) {
     return NIL_VAL;
 }
 
+// Cursor state for implicit `for k, v in table` loops. Instead of handing
+// the last key back to `next` (which rescans the hash part from slot 0),
+// the loop keeps the array index and hash slot where the previous step
+// stopped, so each step is O(1) amortized. The cursor is the inline payload
+// of the loop's state userdata, so starting a loop costs one allocation.
+//
+// Mutation during iteration: value updates and deletions never move
+// entries, and an insertion into a free slot leaves the others where they
+// are, so the cursor stays valid and every remaining key is visited once.
+// Inserted keys may or may not be visited. An insertion that grows the hash
+// part rehashes every entry into a new order; no cursor position survives
+// that, so the next step raises an error rather than skip or repeat keys.
+typedef struct {
+    ObjTable* table;
+    int array_index;
+    int slot;
+    int capacity;
+} TableIter;
+
+static void table_iter_mark(void* data) {
+    TableIter* iter = (TableIter*)data;
+    mark_object((struct Obj*)iter->table);
+}
+
+static int table_iter_next(VM* vm, int arg_count, Value* args) {
+    (void)arg_count;
+    TableIter* iter = (TableIter*)AS_USERDATA(args[0])->data;
+    Table* table = &iter->table->table;
+
+    while (iter->array_index <= table->array_capacity) {
+        int index = iter->array_index++;
+        Value value = table->array[index - 1];
+        if (!IS_NIL(value)) {
+            push(vm, NUMBER_VAL((double)index));
+            push(vm, value);
+            return 2;
+        }
+    }
+
+    if (iter->capacity != table->capacity) {
+        vm_runtime_error(vm, "Table grew while iterating over it; collect new keys and add them after the loop.");
+        return 0;
+    }
+
+    while (iter->slot < table->capacity) {
+        Entry* entry = &table->entries[iter->slot++];
+        if (IS_NIL(entry->key)) continue;
+        push(vm, entry->key);
+        push(vm, entry->value);
+        return 2;
+    }
+
+    push(vm, NIL_VAL);
+    push(vm, NIL_VAL);
+    return 2;
+}
+
+static int push_table_iter(VM* vm, ObjTable* table) {
+    if (IS_NIL(vm->table_iter_fn)) {
+        vm->table_iter_fn = OBJ_VAL(new_native(table_iter_next, NULL));
+    }
+
+    ObjUserdata* state = new_userdata_inline(sizeof(TableIter), table_iter_mark);
+    TableIter* iter = (TableIter*)state->data;
+    iter->table = table;
+    iter->array_index = 1;
+    iter->slot = 0;
+    iter->capacity = table->table.capacity;
+    pop(vm);
+    push(vm, vm->table_iter_fn);
+    push(vm, OBJ_VAL(state));
+    push(vm, NIL_VAL);
+    return 1;
+}
+
 int vm_handle_op_iter_prep(VM* vm) {
     Value val = peek(vm, 0);
     Value next_method = get_iterator_next_function_local(vm, val);
@@ -54,8 +130,7 @@ int vm_handle_op_iter_prep(VM* vm) {
 
     if (IS_TABLE(val) || IS_STRING(val)) {
         Value next_fn = NIL_VAL;
-        ObjString* name = copy_string("next", 4);
-        if (!table_get(&vm->globals, name, &next_fn)) {
+        if (!table_get(&vm->globals, vm->next_name, &next_fn)) {
             vm_runtime_error(vm, "Global 'next' not found for implicit iteration.");
             return 0;
         }
@@ -64,6 +139,10 @@ int vm_handle_op_iter_prep(VM* vm) {
             return 0;
         }
 
+        if (IS_TABLE(val) && IS_NATIVE(next_fn) && AS_NATIVE(next_fn) == core_next) {
+            return push_table_iter(vm, AS_TABLE(val));
+        }
+
         pop(vm);
         push(vm, next_fn);
         push(vm, val);
@@ -79,7 +158,7 @@ int vm_handle_op_iter_prep_i_pairs(VM* vm) {
     Value val = peek(vm, 0);
     if (IS_TABLE(val)) {
         Value inext_fn = NIL_VAL;
-        ObjString* name = copy_string("inext", 5);
+        ObjString* name = vm->inext_name;
         if (!table_get(&vm->globals, name, &inext_fn)) {
             vm_runtime_error(vm, "Global 'inext' not found for implicit iteration.");
             return 0;
@@ -101,7 +180,7 @@ int vm_handle_op_range(VM* vm, CallFrame** frame, uint8_t** ip) {
     Value end = pop(vm);
     Value start = pop(vm);
     Value range_fn = NIL_VAL;
-    ObjString* name = copy_string("range", 5);
+    ObjString* name = vm->range_name;
     if (!table_get(&vm->globals, name, &range_fn)) {
         vm_runtime_error(vm, "range not found.");
         return 0;
@@ -29,13 +29,20 @@ static void concatenate_local(VM* vm) {
     ObjString* b = AS_STRING(pop(vm));
     ObjString* a = AS_STRING(pop(vm));
 
+    // String bytes live inline in the object, so short results are built
+    // on the stack and copied once instead of going through malloc.
     int length = a->length + b->length;
-    char* chars = (char*)malloc((size_t)length + 1);
+    char small[256];
+    char* chars = length < (int)sizeof(small) ? small : (char*)malloc((size_t)length + 1);
     memcpy(chars, a->chars, (size_t)a->length);
     memcpy(chars + a->length, b->chars, (size_t)b->length);
     chars[length] = '\0';
 
-    push(vm, OBJ_VAL(take_string(chars, length)));
+    if (chars == small) {
+        push(vm, OBJ_VAL(copy_string(chars, length)));
+    } else {
+        push(vm, OBJ_VAL(take_string(chars, length)));
+    }
 }
 
 static void table_add_local(ObjTable* ta, ObjTable* tb, ObjTable* result) {
@@ -40,6 +40,7 @@ int vm_handle_op_set_metatable(VM* vm, CallFrame** frame, uint8_t** ip) {
         return 0;
     }
     AS_TABLE(table)->metatable = IS_NIL(metatable) ? NULL : AS_TABLE(metatable);
+    gc_write_barrier(AS_OBJ(table), metatable);
 
     int constructor_called = 0;
     if (!IS_NIL(metatable)) {
@@ -1,3 +1,5 @@
+#include <string.h>
+
 #include "ops_state.h"
 
 void vm_handle_op_constant(VM* vm, CallFrame* frame, uint8_t** ip) {
@@ -32,6 +34,7 @@ int vm_handle_op_get_global(VM* vm, CallFrame* frame, uint8_t** ip) {
         chunk->global_ic_names[opcode_offset] = name;
         chunk->global_ic_versions[opcode_offset] = vm->globals.version;
         chunk->global_ic_values[opcode_offset] = value;
+        gc_write_barrier(&frame->closure->function->obj, value);
     }
     push(vm, value);
     return 1;
@@ -76,5 +79,59 @@ void vm_handle_op_get_upvalue(VM* vm, CallFrame* frame, uint8_t** ip) {
 
 void vm_handle_op_set_upvalue(VM* vm, CallFrame* frame, uint8_t** ip) {
     uint8_t slot = *(*ip)++;
-    *frame->closure->upvalues[slot]->location = peek(vm, 0);
+    ObjUpvalue* upvalue = frame->closure->upvalues[slot];
+    *upvalue->location = peek(vm, 0);
+    gc_write_barrier(&upvalue->obj, peek(vm, 0));
+}
+
+static int gc_option_number(VM* vm, ObjString* key, Value value, int minimum, int* out) {
+    if (!IS_NUMBER(value) || AS_NUMBER(value) < minimum || AS_NUMBER(value) > 1e9) {
+        vm_runtime_error(vm, "gc option '%s' must be a number >= %d.", key->chars, minimum);
+        return 0;
+    }
+    *out = (int)AS_NUMBER(value);
+    return 1;
+}
+
+// gc({incremental = true, pause_us = 500, step_objects = 0, step_kb = 64, nursery_kb = 512})
+int vm_handle_op_gc_config(VM* vm) {
+    Value options = peek(vm, 0);
+    if (!IS_TABLE(options)) {
+        vm_runtime_error(vm, "gc options must be a table.");
+        return 0;
+    }
+    GcConfig config = gc_heap->config;
+    Table* table = &AS_TABLE(options)->table;
+    for (int i = 0; i < table->capacity; i++) {
+        Entry* entry = &table->entries[i];
+        if (IS_NIL(entry->key)) continue;
+        if (!IS_STRING(entry->key)) {
+            vm_runtime_error(vm, "gc option names must be strings.");
+            return 0;
+        }
+        ObjString* key = AS_STRING(entry->key);
+        int ok = 1;
+        if (strcmp(key->chars, "incremental") == 0) {
+            if (!IS_BOOL(entry->value)) {
+                vm_runtime_error(vm, "gc option 'incremental' must be a boolean.");
+                return 0;
+            }
+            config.incremental = AS_BOOL(entry->value);
+        } else if (strcmp(key->chars, "pause_us") == 0) {
+            ok = gc_option_number(vm, key, entry->value, 0, &config.pause_us);
+        } else if (strcmp(key->chars, "step_objects") == 0) {
+            ok = gc_option_number(vm, key, entry->value, 0, &config.step_objects);
+        } else if (strcmp(key->chars, "step_kb") == 0) {
+            ok = gc_option_number(vm, key, entry->value, 1, &config.step_kb);
+        } else if (strcmp(key->chars, "nursery_kb") == 0) {
+            ok = gc_option_number(vm, key, entry->value, 1, &config.nursery_kb);
+        } else {
+            vm_runtime_error(vm, "Unknown gc option '%s'.", key->chars);
+            return 0;
+        }
+        if (!ok) return 0;
+    }
+    gc_heap->config = config;
+    pop(vm);
+    return 1;
 }
@@ -12,5 +12,6 @@ void vm_handle_op_get_local(VM* vm, CallFrame* frame, uint8_t** ip);
 void vm_handle_op_set_local(VM* vm, CallFrame* frame, uint8_t** ip);
 void vm_handle_op_get_upvalue(VM* vm, CallFrame* frame, uint8_t** ip);
 void vm_handle_op_set_upvalue(VM* vm, CallFrame* frame, uint8_t** ip);
+int vm_handle_op_gc_config(VM* vm);
 
 #endif
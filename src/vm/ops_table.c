@@ -55,8 +55,7 @@ static int handle_index_metamethod_local(
         if (IS_STRING(key)) {
             table_get(&AS_TABLE(idx_val)->table, AS_STRING(key), result);
         } else if (IS_NUMBER(key)) {
-            ObjString* n_key = number_key_string(AS_NUMBER(key));
-            table_get(&AS_TABLE(idx_val)->table, n_key, result);
+            table_get_value(&AS_TABLE(idx_val)->table, key, result);
         }
         return 1;
     }
@@ -66,8 +65,7 @@ static int handle_index_metamethod_local(
 static int append_to_table_local(ObjTable* table, Value value) {
     int index = table->table.array_max + 1;
     if (!table_set_array(&table->table, index, value)) {
-        ObjString* key = number_key_string((double)index);
-        table_set(&table->table, key, value);
+        table_set_value(&table->table, NUMBER_VAL((double)index), value);
     }
     return index;
 }
@@ -139,6 +137,10 @@ int vm_handle_op_get_table(VM* vm, CallFrame** frame, uint8_t** ip) {
                     chunk->get_table_ic_keys[opcode_offset] = key_str;
                     chunk->get_table_ic_versions[opcode_offset] = t->table.version;
                     chunk->get_table_ic_values[opcode_offset] = result;
+                    struct Obj* function = &(*frame)->closure->function->obj;
+                    gc_write_barrier(function, table);
+                    gc_write_barrier(function, key);
+                    gc_write_barrier(function, result);
                 }
                 result = maybe_bind_self_local(table, result);
             } else if (t->metatable) {
@@ -170,8 +172,7 @@ int vm_handle_op_get_table(VM* vm, CallFrame** frame, uint8_t** ip) {
                 }
             }
 
-            ObjString* n_key = number_key_string(num_key);
-            if (table_get(&t->table, n_key, &result)) {
+            if (table_get_value(&t->table, key, &result)) {
                 result = maybe_bind_self_local(table, result);
                 push(vm, result);
             } else if (t->metatable) {
@@ -302,7 +303,8 @@ int vm_handle_op_get_table(VM* vm, CallFrame** frame, uint8_t** ip) {
         if (IS_OBJ(table)) {
             printf("DEBUG: Attempt to index non-table object type: %d\n", OBJ_TYPE(table));
         } else {
-            printf("DEBUG: Attempt to index non-table value type: %d\n", table.type);
+            printf("DEBUG: Attempt to index non-table value type: %s\n",
+                   IS_NIL(table) ? "nil" : (IS_BOOL(table) ? "bool" : "number"));
         }
         vm_runtime_error(vm, "Attempt to index non-table.");
         return 0;
@@ -330,8 +332,7 @@ static int handle_new_index_metamethod_local(
         if (IS_STRING(key)) {
             table_set(&AS_TABLE(ni)->table, AS_STRING(key), value);
         } else if (IS_NUMBER(key)) {
-            ObjString* n_key = number_key_string(AS_NUMBER(key));
-            table_set(&AS_TABLE(ni)->table, n_key, value);
+            table_set_value(&AS_TABLE(ni)->table, key, value);
         }
         return 1;
     }
@@ -387,6 +388,12 @@ int vm_handle_op_set_table(VM* vm, CallFrame** frame, uint8_t** ip) {
         }
     } else if (IS_NUMBER(key)) {
         double num_key = AS_NUMBER(key);
+        // NaN never equals itself, so a value stored under it could never
+        // be read back.
+        if (num_key != num_key) {
+            vm_runtime_error(vm, "Table index is NaN.");
+            return 0;
+        }
         int idx = (int)num_key;
         int is_array = 0;
         if (num_key == (double)idx) {
@@ -407,16 +414,15 @@ int vm_handle_op_set_table(VM* vm, CallFrame** frame, uint8_t** ip) {
         }
 
         if (!is_array) {
-            ObjString* n_key = number_key_string(num_key);
             Value dummy;
-            if (table_get(&t->table, n_key, &dummy)) {
-                table_set(&t->table, n_key, value);
+            if (table_get_value(&t->table, key, &dummy)) {
+                table_set_value(&t->table, key, value);
             } else if (t->metatable) {
                 int handled = handle_new_index_metamethod_local(vm, t, table, key, value, frame, ip);
                 if (handled < 0) return 0;
-                if (handled == 0) table_set(&t->table, n_key, value);
+                if (handled == 0) table_set_value(&t->table, key, value);
             } else {
-                table_set(&t->table, n_key, value);
+                table_set_value(&t->table, key, value);
             }
         }
     }
@@ -467,8 +473,7 @@ int vm_handle_op_delete_table(VM* vm) {
             }
         }
 
-        ObjString* n_key = number_key_string(num_key);
-        if (!table_delete(&t->table, n_key)) {
+        if (!table_delete_value(&t->table, key)) {
             vm_runtime_error(vm, "Key not found.");
             return 0;
         }